@@ -593,6 +593,10 @@ asmlinkage unsigned int do_IRQ(struct pt_regs regs)
 	}
 #endif
 
+#ifdef CONFIG_DYNAMIC_TICK
+	if (dyntick_skipping)
+		dyntick_wakeup(irq);
+#endif
 	kstat.irqs[cpu][irq]++;
 	spin_lock(&desc->lock);
 	desc->handler->ack(irq);
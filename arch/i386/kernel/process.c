@@ -139,8 +139,12 @@ void cpu_idle (void)
 		void (*idle)(void) = pm_idle;
 		if (!idle)
 			idle = default_idle;
-		while (!current->need_resched)
+		while (!current->need_resched) {
+#ifdef CONFIG_DYNAMIC_TICK
+			dyntick_idle();
+#endif
 			idle();
+		}
 		schedule();
 		check_pgt_cache();
 	}
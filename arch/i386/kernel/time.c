@@ -42,6 +42,8 @@
 #include <linux/delay.h>
 #include <linux/init.h>
 #include <linux/smp.h>
+#include <linux/hrtimer.h>
+#include <linux/proc_fs.h>
 
 #include <asm/io.h>
 #include <asm/smp.h>
@@ -51,6 +53,8 @@
 #include <asm/mpspec.h>
 #include <asm/uaccess.h>
 #include <asm/processor.h>
+#include <asm/div64.h>
+#include <asm/apic.h>
 
 #include <linux/mc146818rtc.h>
 #include <linux/timex.h>
@@ -71,6 +75,9 @@ unsigned long cpu_khz;	/* Detected as we calibrate the TSC */
 static int delay_at_last_interrupt;
 
 static unsigned long last_tsc_low; /* lsb 32 bits of Time Stamp Counter */
+#ifdef CONFIG_HIGH_RES_TIMERS
+static unsigned long last_tsc_high;
+#endif
 
 /* Cached *multiplier* to convert TSC counts to microseconds.
  * (see the equation below).
@@ -637,6 +644,345 @@ static inline void do_timer_interrupt(int irq, void *dev_id, struct pt_regs *reg
 
 static int use_tsc;
 
+#ifdef CONFIG_HIGH_RES_TIMERS
+/*
+ * High-resolution timers run the PIT in one-shot mode (mode 0): it is
+ * programmed for the next jiffy tick or the first hrtimer, whichever is
+ * earlier. The ticks are counted off the TSC, so they keep the length
+ * of a periodic PIT tick whatever the PIT was last programmed for.
+ */
+#define HR_CYC2NS_SHIFT	22
+#define HR_TICK_NS	((unsigned long)((unsigned long long)LATCH * 1000000000 / CLOCK_TICK_RATE))
+#define HR_NS2PIT	((unsigned long)(((unsigned long long)CLOCK_TICK_RATE << 32) / 1000000000))
+#define HR_PIT_MIN	4		/* PIT clocks, a few usecs */
+#define HR_PIT_MAX	0xffff
+
+static int hr_pit_oneshot;
+static int nohrtimers __initdata;
+static unsigned long hr_cyc2ns;		/* ns per TSC cycle << HR_CYC2NS_SHIFT */
+static u64 hr_tick_next;		/* when the next jiffy is due */
+static u64 hr_event_next = HRTIMER_NEVER; /* the PIT will interrupt by then */
+
+/* The first tick seen with the TSC, to calibrate it against */
+static unsigned long long hr_calib_tsc;
+static unsigned long hr_calib_jiffies;
+
+static inline u64 hr_cycles_to_ns(unsigned long lo, unsigned long hi)
+{
+	return (((u64)lo * hr_cyc2ns) >> HR_CYC2NS_SHIFT) +
+	       (((u64)hi * hr_cyc2ns) << (32 - HR_CYC2NS_SHIFT));
+}
+
+u64 hrtimer_now(void)
+{
+	unsigned long lo, hi;
+
+	rdtsc(lo, hi);
+	return hr_cycles_to_ns(lo, hi);
+}
+
+EXPORT_SYMBOL(hrtimer_now);
+
+/* Called with i8253_lock held */
+static void hr_pit_set(u64 expires)
+{
+	u64 now = hrtimer_now();
+	unsigned long count = HR_PIT_MIN;
+
+	if (expires > now) {
+		u64 delta = expires - now;
+
+		if (delta < (u64)HR_PIT_MAX * 1000)
+			count = (((u64)(unsigned long)delta * HR_NS2PIT) >> 32) + 1;
+		else
+			count = HR_PIT_MAX;
+		if (count < HR_PIT_MIN)
+			count = HR_PIT_MIN;
+		else if (count > HR_PIT_MAX)
+			count = HR_PIT_MAX;
+	}
+	outb_p(0x30, 0x43);		/* binary, mode 0, LSB/MSB, ch 0 */
+	outb_p(count & 0xff, 0x40);
+	outb(count >> 8, 0x40);
+}
+
+/*
+ * Have the PIT interrupt by "expires". This only ever brings the
+ * interrupt forward; the interrupt itself programs the next one.
+ */
+void hrtimer_program(u64 expires)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&i8253_lock, flags);
+	if (expires < hr_event_next) {
+		hr_event_next = expires;
+		hr_pit_set(expires);
+	}
+	spin_unlock_irqrestore(&i8253_lock, flags);
+}
+
+static void hr_timer_interrupt(int irq, struct pt_regs *regs)
+{
+	unsigned long lo, hi, ticks = 0;
+	u64 now, next;
+
+	spin_lock(&i8253_lock);
+	hr_event_next = HRTIMER_NEVER;
+	spin_unlock(&i8253_lock);
+
+	write_lock(&xtime_lock);
+	rdtsc(lo, hi);
+	now = hr_cycles_to_ns(lo, hi);
+	if (now >= hr_tick_next) {
+		do {
+			hr_tick_next += HR_TICK_NS;
+			ticks++;
+		} while (now >= hr_tick_next);
+
+		last_tsc_low = lo;
+		delay_at_last_interrupt =
+			(unsigned long)(now - (hr_tick_next - HR_TICK_NS)) / 1000;
+		/* ticks we were too late for only count in jiffies */
+		if (ticks > 1)
+			jiffies += ticks - 1;
+		do_timer_interrupt(irq, NULL, regs);
+	}
+	write_unlock(&xtime_lock);
+
+	next = hrtimer_run_queue();
+	if (next > hr_tick_next)
+		next = hr_tick_next;
+	hrtimer_program(next);
+}
+
+#ifdef CONFIG_DYNAMIC_TICK
+/*
+ * Dynamic tick: when the CPU goes idle, the PIT is programmed for the
+ * first timer_list or hrtimer that is due, as far as its 16-bit count
+ * reaches, instead of for the next tick. The first interrupt after
+ * that, whatever its source, counts the ticks that went by in jiffies
+ * from do_IRQ() before its handler runs, and has the PIT tick again.
+ * Wall time and the timer list catch up from the timer bottom half, as
+ * they do for ticks that were late.
+ */
+int dyntick_skipping;
+static int dyntick_on;
+static int nodyntick __initdata;
+
+static struct {
+	unsigned long sleeps;		/* idle periods with the tick off */
+	unsigned long skipped;		/* ticks that had no interrupt */
+	unsigned long longest;		/* most ticks in one sleep */
+	unsigned long timer_wakeups;	/* sleeps ended by the PIT */
+	unsigned long irq_wakeups;	/* by another interrupt */
+} dyntick_stats;
+
+/* Called from cpu_idle() before each attempt to halt */
+void dyntick_idle(void)
+{
+	unsigned long flags, ticks;
+	u64 expires, hr;
+
+	if (!dyntick_on || dyntick_skipping)
+		return;
+
+	__save_flags(flags);
+	__cli();
+	if (current->need_resched || softirq_pending(smp_processor_id()) ||
+	    TQ_ACTIVE(tq_timer))
+		goto out;
+
+	ticks = next_timer_interrupt() - jiffies;
+	if ((long)ticks <= 1)
+		goto out;
+	expires = hr_tick_next + (u64)(ticks - 1) * HR_TICK_NS;
+	hr = hrtimer_next_expiry();
+	if (hr < expires)
+		expires = hr;
+	if (expires <= hr_tick_next)
+		goto out;
+
+	spin_lock(&i8253_lock);
+	hr_event_next = expires;
+	hr_pit_set(expires);
+	spin_unlock(&i8253_lock);
+	dyntick_skipping = 1;
+	dyntick_stats.sleeps++;
+out:
+	__restore_flags(flags);
+}
+
+/* Called from do_IRQ(), with interrupts off, while dyntick_skipping */
+void dyntick_wakeup(int irq)
+{
+	unsigned long lo, hi, ticks = 0;
+	u64 now, next;
+
+	dyntick_skipping = 0;
+
+	write_lock(&xtime_lock);
+	rdtsc(lo, hi);
+	now = hr_cycles_to_ns(lo, hi);
+	while (now >= hr_tick_next) {
+		hr_tick_next += HR_TICK_NS;
+		ticks++;
+	}
+	if (ticks) {
+		last_tsc_low = lo;
+		delay_at_last_interrupt =
+			(unsigned long)(now - (hr_tick_next - HR_TICK_NS)) / 1000;
+		jiffies += ticks;
+		mark_bh(TIMER_BH);
+	}
+	write_unlock(&xtime_lock);
+
+	dyntick_stats.skipped += ticks;
+	if (ticks > dyntick_stats.longest)
+		dyntick_stats.longest = ticks;
+	if (irq == 0)
+		dyntick_stats.timer_wakeups++;
+	else
+		dyntick_stats.irq_wakeups++;
+
+	spin_lock(&i8253_lock);
+	hr_event_next = HRTIMER_NEVER;
+	spin_unlock(&i8253_lock);
+	next = hrtimer_next_expiry();
+	hrtimer_program(next < hr_tick_next ? next : hr_tick_next);
+}
+
+static int __init nodyntick_setup(char *str)
+{
+	nodyntick = 1;
+	return 1;
+}
+
+__setup("nodyntick", nodyntick_setup);
+
+#ifdef CONFIG_PROC_FS
+static int dyntick_read_proc(char *page, char **start, off_t off,
+			     int count, int *eof, void *data)
+{
+	int len;
+
+	len = sprintf(page, "active:        %d\n"
+		      "sleeps:        %lu\n"
+		      "skipped:       %lu\n"
+		      "longest:       %lu\n"
+		      "timer wakeups: %lu\n"
+		      "irq wakeups:   %lu\n",
+		      dyntick_on, dyntick_stats.sleeps, dyntick_stats.skipped,
+		      dyntick_stats.longest, dyntick_stats.timer_wakeups,
+		      dyntick_stats.irq_wakeups);
+
+	if (len <= off + count)
+		*eof = 1;
+	*start = page + off;
+	len -= off;
+	if (len > count)
+		len = count;
+	if (len < 0)
+		len = 0;
+	return len;
+}
+#endif
+
+static void __init dyntick_init(void)
+{
+	if (nodyntick)
+		return;
+#ifdef CONFIG_X86_LOCAL_APIC
+	/* these want an interrupt every tick */
+	if (using_apic_timer || nmi_watchdog != NMI_NONE)
+		return;
+#endif
+	dyntick_on = 1;
+#ifdef CONFIG_PROC_FS
+	create_proc_read_entry("dyntick", 0, 0, dyntick_read_proc, NULL);
+#endif
+}
+#endif /* CONFIG_DYNAMIC_TICK */
+
+static int __init nohrtimers_setup(char *str)
+{
+	nohrtimers = 1;
+	return 1;
+}
+
+__setup("nohrtimers", nohrtimers_setup);
+
+/*
+ * Switch the PIT to one-shot mode. This is left until the initcalls,
+ * when the local APIC timer has been calibrated against the periodic
+ * PIT, and the TSC can be measured against all the ticks since boot
+ * rather than the 50ms calibrate_tsc() had.
+ */
+static int __init hr_timer_init(void)
+{
+	unsigned long long tsc, cycles;
+	unsigned long ticks, tick_cycles;
+	unsigned long flags;
+
+	if (nohrtimers || !use_tsc || !hr_calib_tsc)
+		return 0;
+#ifdef CONFIG_MCA
+	if (MCA_bus)
+		return 0;
+#endif
+#ifdef CONFIG_X86_IO_APIC
+	/* the timer IRQ is acked by hand, in do_timer_interrupt() only */
+	if (timer_ack)
+		return 0;
+#endif
+
+	read_lock_irqsave(&xtime_lock, flags);
+	tsc = (unsigned long long)last_tsc_high << 32 | last_tsc_low;
+	/* jiffies has counted the last tick already */
+	ticks = jiffies - 1 - hr_calib_jiffies;
+	read_unlock_irqrestore(&xtime_lock, flags);
+
+	/* 2^32 / fast_gettimeoffset_quotient is cycles per usec */
+	cycles = ((unsigned long long)HR_TICK_NS << 32) / 1000;
+	do_div(cycles, fast_gettimeoffset_quotient);
+	tick_cycles = (unsigned long)cycles;
+
+	cycles = tsc - hr_calib_tsc;
+	if (ticks >= HZ / 2) {
+		unsigned long measured;
+
+		do_div(cycles, ticks);
+		measured = (unsigned long)cycles;
+		/* a lost tick makes the measurement off by a lot more */
+		if (measured > tick_cycles - tick_cycles / 1000 &&
+		    measured < tick_cycles + tick_cycles / 1000)
+			tick_cycles = measured;
+	}
+	cycles = (unsigned long long)HR_TICK_NS << HR_CYC2NS_SHIFT;
+	do_div(cycles, tick_cycles);
+	hr_cyc2ns = (unsigned long)cycles;
+
+	write_lock_irqsave(&xtime_lock, flags);
+	hr_tick_next = hr_cycles_to_ns(last_tsc_low, last_tsc_high) + HR_TICK_NS;
+	spin_lock(&i8253_lock);
+	hr_event_next = hr_tick_next;
+	hr_pit_set(hr_tick_next);
+	spin_unlock(&i8253_lock);
+	hr_pit_oneshot = 1;
+	hrtimer_active = 1;
+	write_unlock_irqrestore(&xtime_lock, flags);
+
+	printk(KERN_INFO "High-resolution timers: PIT one-shot, %lu TSC cycles per tick.\n",
+	       tick_cycles);
+#ifdef CONFIG_DYNAMIC_TICK
+	dyntick_init();
+#endif
+	return 0;
+}
+
+__initcall(hr_timer_init);
+#endif /* CONFIG_HIGH_RES_TIMERS */
+
 /*
  * This is the same as the above, except we _also_ save the current
  * Time Stamp Counter value at the time of the timer interrupt, so that
@@ -646,6 +992,13 @@ static void timer_interrupt(int irq, void *dev_id, struct pt_regs *regs)
 {
 	int count;
 
+#ifdef CONFIG_HIGH_RES_TIMERS
+	if (hr_pit_oneshot) {
+		hr_timer_interrupt(irq, regs);
+		return;
+	}
+#endif
+
 	/*
 	 * Here we are in the timer irq handler. We just have irqs locally
 	 * disabled but we don't know if the timer_bh is running on the other
@@ -672,7 +1025,16 @@ static void timer_interrupt(int irq, void *dev_id, struct pt_regs *regs)
 	
 		/* read Pentium cycle counter */
 
+#ifdef CONFIG_HIGH_RES_TIMERS
+		rdtsc(last_tsc_low, last_tsc_high);
+		if (!hr_calib_tsc) {
+			hr_calib_tsc = (unsigned long long)last_tsc_high << 32 |
+				       last_tsc_low;
+			hr_calib_jiffies = jiffies;
+		}
+#else
 		rdtscl(last_tsc_low);
+#endif
 
 		spin_lock(&i8253_lock);
 		outb_p(0x00, 0x43);     /* latch the count ASAP */
@@ -34,6 +34,16 @@ static inline void crypto_alg_put(struct crypto_alg *alg)
 		__MOD_DEC_USE_COUNT(alg->cra_module);
 }
 
+static inline const char *crypto_alg_driver_name(struct crypto_alg *alg)
+{
+	return alg->cra_driver_name[0] ? alg->cra_driver_name : alg->cra_name;
+}
+
+/*
+ * An exact driver name match wins; otherwise the highest priority
+ * implementation registered under the algorithm name is used.  One
+ * whose module is going away is passed over for the next best.
+ */
 struct crypto_alg *crypto_alg_lookup(const char *name)
 {
 	struct crypto_alg *q, *alg = NULL;
@@ -44,11 +54,19 @@ struct crypto_alg *crypto_alg_lookup(const char *name)
 	down_read(&crypto_alg_sem);
 	
 	list_for_each_entry(q, &crypto_alg_list, cra_list) {
-		if (!(strcmp(q->cra_name, name))) {
-			if (crypto_alg_get(q))
-				alg = q;
+		int exact = q->cra_driver_name[0] &&
+			    !strcmp(q->cra_driver_name, name);
+
+		if (!exact && (strcmp(q->cra_name, name) ||
+			       (alg && q->cra_priority <= alg->cra_priority)))
+			continue;
+		if (!crypto_alg_get(q))
+			continue;
+		if (alg)
+			crypto_alg_put(alg);
+		alg = q;
+		if (exact)
 			break;
-		}
 	}
 	
 	up_read(&crypto_alg_sem);
@@ -169,7 +187,8 @@ int crypto_register_alg(struct crypto_alg *alg)
 	down_write(&crypto_alg_sem);
 	
 	list_for_each_entry(q, &crypto_alg_list, cra_list) {
-		if (!(strcmp(q->cra_name, alg->cra_name))) {
+		if (!strcmp(crypto_alg_driver_name(q),
+			    crypto_alg_driver_name(alg))) {
 			ret = -EEXIST;
 			goto out;
 		}
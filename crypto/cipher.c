@@ -24,7 +24,7 @@
 
 typedef void (cryptfn_t)(void *, u8 *, const u8 *);
 typedef void (procfn_t)(struct crypto_tfm *, u8 *,
-                        u8*, cryptfn_t, int enc, void *);
+                        u8*, cryptfn_t, int enc, void *, unsigned int);
 
 struct scatter_walk {
 	struct scatterlist	*sg;
@@ -161,8 +161,12 @@ static int copy_chunks(void *buf, struct scatter_walk *walk,
 
 /* 
  * Generic encrypt/decrypt wrapper for ciphers, handles operations across
- * multiple page boundaries by using temporary blocks.  In user context,
- * the kernel is given a chance to schedule us once per block.
+ * multiple page boundaries by using temporary blocks.  Whole blocks that
+ * lie within one page of both the source and the destination are handed
+ * to the mode function as one run, so it usually sees up to a page at a
+ * time; only a block that straddles a page goes through the temporaries.
+ * In user context, the kernel is given a chance to schedule us once per
+ * run.
  */
 static int crypt(struct crypto_tfm *tfm,
 		 struct scatterlist *dst,
@@ -172,8 +176,8 @@ static int crypt(struct crypto_tfm *tfm,
 {
 	struct scatter_walk walk_in, walk_out;
 	const unsigned int bsize = crypto_tfm_alg_blocksize(tfm);
-	u8 tmp_src[nbytes > src->length ? bsize : 0];
-	u8 tmp_dst[nbytes > dst->length ? bsize : 0];
+	u8 tmp_src[bsize];
+	u8 tmp_dst[bsize];
 
 	if (!nbytes)
 		return 0;
@@ -188,21 +192,32 @@ static int crypt(struct crypto_tfm *tfm,
 
 	for(;;) {
 		u8 *src_p, *dst_p;
+		unsigned int n;
 
 		scatterwalk_map(&walk_in, 0);
 		scatterwalk_map(&walk_out, 1);
-		src_p = which_buf(&walk_in, bsize, tmp_src);
-		dst_p = which_buf(&walk_out, bsize, tmp_dst);
 
-		nbytes -= bsize;
+		n = min(walk_in.len_this_page, walk_out.len_this_page);
+		n = min(n, nbytes);
+		n -= n % bsize;
+		if (n) {
+			src_p = walk_in.data;
+			dst_p = walk_out.data;
+		} else {
+			n = bsize;
+			src_p = which_buf(&walk_in, bsize, tmp_src);
+			dst_p = which_buf(&walk_out, bsize, tmp_dst);
+		}
+
+		nbytes -= n;
 
-		copy_chunks(src_p, &walk_in, bsize, 0);
+		copy_chunks(src_p, &walk_in, n, 0);
 
-		prfn(tfm, dst_p, src_p, crfn, enc, info);
+		prfn(tfm, dst_p, src_p, crfn, enc, info, n);
 
 		scatter_done(&walk_in, 0, nbytes);
 
-		copy_chunks(dst_p, &walk_out, bsize, 1);
+		copy_chunks(dst_p, &walk_out, n, 1);
 		scatter_done(&walk_out, 1, nbytes);
 
 		if (!nbytes)
@@ -212,9 +227,17 @@ static int crypt(struct crypto_tfm *tfm,
 	}
 }
 
-static void cbc_process(struct crypto_tfm *tfm,
-                        u8 *dst, u8 *src, cryptfn_t fn, int enc, void *info)
+/* 
+ * The mode functions process a run of nbytes, a non-zero multiple of the
+ * block size, between src and dst, which are either the same or do not
+ * overlap.
+ */
+static void cbc_process(struct crypto_tfm *tfm, u8 *dst, u8 *src,
+                        cryptfn_t fn, int enc, void *info, unsigned int nbytes)
 {
+	const unsigned int bsize = crypto_tfm_alg_blocksize(tfm);
+	void (*xor)(u8 *, const u8 *) = tfm->crt_u.cipher.cit_xor_block;
+	void *ctx = crypto_tfm_ctx(tfm);
 	u8 *iv = info;
 	
 	/* Null encryption */
@@ -222,26 +245,42 @@ static void cbc_process(struct crypto_tfm *tfm,
 		return;
 		
 	if (enc) {
-		tfm->crt_u.cipher.cit_xor_block(iv, src);
-		fn(crypto_tfm_ctx(tfm), dst, iv);
-		memcpy(iv, dst, crypto_tfm_alg_blocksize(tfm));
+		do {
+			xor(iv, src);
+			fn(ctx, dst, iv);
+			memcpy(iv, dst, bsize);
+			src += bsize;
+			dst += bsize;
+		} while (nbytes -= bsize);
 	} else {
 		const int need_stack = (src == dst);
-		u8 stack[need_stack ? crypto_tfm_alg_blocksize(tfm) : 0];
-		u8 *buf = need_stack ? stack : dst;
+		u8 stack[need_stack ? bsize : 0];
 		
-		fn(crypto_tfm_ctx(tfm), buf, src);
-		tfm->crt_u.cipher.cit_xor_block(buf, iv);
-		memcpy(iv, src, crypto_tfm_alg_blocksize(tfm));
-		if (buf != dst)
-			memcpy(dst, buf, crypto_tfm_alg_blocksize(tfm));
+		do {
+			u8 *buf = need_stack ? stack : dst;
+
+			fn(ctx, buf, src);
+			xor(buf, iv);
+			memcpy(iv, src, bsize);
+			if (buf != dst)
+				memcpy(dst, buf, bsize);
+			src += bsize;
+			dst += bsize;
+		} while (nbytes -= bsize);
 	}
 }
 
 static void ecb_process(struct crypto_tfm *tfm, u8 *dst, u8 *src,
-                        cryptfn_t fn, int enc, void *info)
+                        cryptfn_t fn, int enc, void *info, unsigned int nbytes)
 {
-	fn(crypto_tfm_ctx(tfm), dst, src);
+	const unsigned int bsize = crypto_tfm_alg_blocksize(tfm);
+	void *ctx = crypto_tfm_ctx(tfm);
+
+	do {
+		fn(ctx, dst, src);
+		src += bsize;
+		dst += bsize;
+	} while (nbytes -= bsize);
 }
 
 static int setkey(struct crypto_tfm *tfm, const u8 *key, unsigned int keylen)
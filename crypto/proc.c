@@ -53,6 +53,9 @@ static int c_show(struct seq_file *m, void *p)
 	struct crypto_alg *alg = (struct crypto_alg *)p;
 	
 	seq_printf(m, "name         : %s\n", alg->cra_name);
+	seq_printf(m, "driver       : %s\n",
+		   alg->cra_driver_name[0] ? alg->cra_driver_name : alg->cra_name);
+	seq_printf(m, "priority     : %d\n", alg->cra_priority);
 	seq_printf(m, "module       : %s\n",
 		   (alg->cra_module ?
 		    alg->cra_module->name :
@@ -24,6 +24,9 @@
 #include <linux/string.h>
 #include <linux/crypto.h>
 #include <linux/highmem.h>
+#include <linux/time.h>
+#include <asm/timex.h>
+#include <asm/div64.h>
 #include "tcrypt.h"
 
 #define offset_in_page(p) ((unsigned long)(p) & ~PAGE_MASK)
@@ -57,6 +60,7 @@
 static unsigned int IDX[8] = { IDX1, IDX2, IDX3, IDX4, IDX5, IDX6, IDX7, IDX8 };
 
 static int mode;
+static char *alg;
 static char *xbuf;
 static char *tvmem;
 
@@ -506,6 +510,201 @@ test_available(void)
 	}	
 }
 
+/*
+ * Throughput: each measurement runs SPEED_BYTES through the transform in
+ * requests of one block size, and reports the TSC cycles per byte, or the
+ * time taken where there is no cycle counter.  Implementations are named
+ * by driver name, so that the generic and the optimized ones of one
+ * algorithm can be compared; those that are not available are skipped.
+ */
+#define SPEED_BYTES	(1 << 20)
+
+static unsigned int speed_sizes[] = { 16, 64, 256, 1024, 8192, 0 };
+
+static struct {
+	char *algo;
+	unsigned int klen;
+} speed_ciphers[] = {
+	{ "des",		8 },
+	{ "des3_ede",		24 },
+	{ "blowfish",		16 },
+	{ "twofish",		16 },
+	{ "aes-generic",	16 },
+	{ "aes-generic",	24 },
+	{ "aes-generic",	32 },
+	{ "aes-i586",		16 },
+	{ "aes-i586",		24 },
+	{ "aes-i586",		32 },
+	{ NULL,			0 }
+};
+
+static char *speed_digests[] = {
+	"md5-generic", "md5-i586", "sha1-generic", "sha1-i586", "sha256",
+	NULL
+};
+
+static u64
+speed_clock(void)
+{
+	struct timeval tv;
+	cycles_t c = get_cycles();
+
+	if (c)
+		return c;
+	do_gettimeofday(&tv);
+	return (u64)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static void
+speed_report(unsigned int bs, u64 elapsed, unsigned int bytes)
+{
+	if (get_cycles()) {
+		/* in tenths */
+		elapsed *= 10;
+		do_div(elapsed, bytes);
+		printk("%5u byte blocks: %3lu.%lu cycles/byte\n", bs,
+		       (unsigned long)elapsed / 10,
+		       (unsigned long)elapsed % 10);
+	} else
+		printk("%5u byte blocks: %u bytes in %lu usec\n", bs, bytes,
+		       (unsigned long)elapsed);
+}
+
+static void
+speed_cipher(char *algo, int mode, int enc, unsigned int klen)
+{
+	struct crypto_tfm *tfm;
+	struct scatterlist sg[1];
+	unsigned int i, n, *bs;
+	u64 start;
+	int ret;
+
+	tfm = crypto_alloc_tfm(algo, mode == MODE_ECB ? 0 :
+			       CRYPTO_TFM_MODE_CBC);
+	if (tfm == NULL) {
+		printk("\n%s not available\n", algo);
+		return;
+	}
+
+	if (!klen)
+		klen = crypto_tfm_alg_min_keysize(tfm);
+	printk("\n%s (%s) %s %s, %u bit key\n", algo,
+	       crypto_tfm_alg_driver_name(tfm), mode == MODE_ECB ? "ECB" : "CBC",
+	       enc == ENCRYPT ? "encryption" : "decryption", klen * 8);
+
+	memset(tvmem, 0x55, klen);
+	ret = crypto_cipher_setkey(tfm, tvmem, klen);
+	if (ret) {
+		printk("setkey() failed flags=%x\n", tfm->crt_flags);
+		goto out;
+	}
+	if (mode == MODE_CBC) {
+		memset(tvmem, 0, crypto_tfm_alg_ivsize(tfm));
+		crypto_cipher_set_iv(tfm, tvmem, crypto_tfm_alg_ivsize(tfm));
+	}
+
+	memset(xbuf, 0xaa, XBUFSIZE);
+	sg[0].page = virt_to_page(xbuf);
+	sg[0].offset = offset_in_page(xbuf);
+
+	for (bs = speed_sizes; *bs; bs++) {
+		if (*bs % crypto_tfm_alg_blocksize(tfm))
+			continue;
+		sg[0].length = *bs;
+		n = SPEED_BYTES / *bs;
+
+		start = speed_clock();
+		for (i = 0; i < n; i++) {
+			if (enc == ENCRYPT)
+				ret = crypto_cipher_encrypt(tfm, sg, sg, *bs);
+			else
+				ret = crypto_cipher_decrypt(tfm, sg, sg, *bs);
+			if (ret) {
+				printk("%s () failed flags=%x\n",
+				       enc == ENCRYPT ? "encryption" :
+				       "decryption", tfm->crt_flags);
+				goto out;
+			}
+		}
+		speed_report(*bs, speed_clock() - start, n * *bs);
+	}
+out:
+	crypto_free_tfm(tfm);
+}
+
+static void
+speed_cipher_all(char *algo, unsigned int klen)
+{
+	speed_cipher(algo, MODE_ECB, ENCRYPT, klen);
+	speed_cipher(algo, MODE_ECB, DECRYPT, klen);
+	speed_cipher(algo, MODE_CBC, ENCRYPT, klen);
+	speed_cipher(algo, MODE_CBC, DECRYPT, klen);
+}
+
+/* the data goes through update() in pieces of one block size */
+static void
+speed_hash(char *algo)
+{
+	struct crypto_tfm *tfm;
+	struct scatterlist sg[1];
+	unsigned int i, n, *bs;
+	char result[64];
+	u64 start;
+
+	tfm = crypto_alloc_tfm(algo, 0);
+	if (tfm == NULL) {
+		printk("\n%s not available\n", algo);
+		return;
+	}
+	printk("\n%s (%s)\n", algo, crypto_tfm_alg_driver_name(tfm));
+
+	memset(xbuf, 0xaa, XBUFSIZE);
+	sg[0].page = virt_to_page(xbuf);
+	sg[0].offset = offset_in_page(xbuf);
+
+	for (bs = speed_sizes; *bs; bs++) {
+		sg[0].length = *bs;
+		n = SPEED_BYTES / *bs;
+
+		start = speed_clock();
+		crypto_digest_init(tfm);
+		for (i = 0; i < n; i++)
+			crypto_digest_update(tfm, sg, 1);
+		crypto_digest_final(tfm, result);
+		speed_report(*bs, speed_clock() - start, n * *bs);
+	}
+
+	crypto_free_tfm(tfm);
+}
+
+static void
+test_speed_ciphers(void)
+{
+	unsigned int i;
+
+	printk("\ncipher throughput, %u bytes per measurement\n", SPEED_BYTES);
+	if (alg) {
+		speed_cipher_all(alg, 0);
+		return;
+	}
+	for (i = 0; speed_ciphers[i].algo; i++)
+		speed_cipher_all(speed_ciphers[i].algo, speed_ciphers[i].klen);
+}
+
+static void
+test_speed_digests(void)
+{
+	char **name = speed_digests;
+
+	printk("\ndigest throughput, %u bytes per measurement\n", SPEED_BYTES);
+	if (alg) {
+		speed_hash(alg);
+		return;
+	}
+	while (*name)
+		speed_hash(*name++);
+}
+
 static void
 do_test(void)
 {
@@ -655,6 +854,14 @@ do_test(void)
 
 #endif
 
+	case 200:
+		test_speed_ciphers();
+		break;
+
+	case 201:
+		test_speed_digests();
+		break;
+
 	case 1000:
 		test_available();
 		break;
@@ -696,6 +903,7 @@ module_init(init);
 module_exit(fini);
 
 MODULE_PARM(mode, "i");
+MODULE_PARM(alg, "s");
 
 MODULE_LICENSE("GPL");
 MODULE_DESCRIPTION("Quick & dirty crypto testing module");
@@ -0,0 +1,202 @@
+/*
+ *  linux/drivers/block/cryptoloop.c
+ *
+ *  Loop transfer through the kernel crypto API.
+ *
+ *  The cipher is named in lo_name as "cipher" or "cipher-mode", e.g.
+ *  "aes", "aes-cbc" or "twofish-ecb"; the mode defaults to CBC. The key
+ *  is lo_encrypt_key. In CBC mode each 512-byte sector is chained on
+ *  its own, with the sector number (little endian, zero padded) as IV,
+ *  so any sector can be read or written by itself.
+ *
+ *  One transform is shared by all the loop worker threads: the IV is
+ *  passed with each call and the key schedule is only read, so they can
+ *  all be in it at once.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ */
+
+#include <linux/config.h>
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/errno.h>
+#include <linux/fs.h>
+#include <linux/string.h>
+#include <linux/crypto.h>
+#include <linux/loop.h>
+#include <asm/scatterlist.h>
+#include <asm/byteorder.h>
+
+#define LOOP_IV_SECTOR_BITS	9
+#define LOOP_IV_SECTOR_SIZE	(1 << LOOP_IV_SECTOR_BITS)
+#define CRYPTOLOOP_MAX_IV	32	/* bytes */
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("loop blockdevice transferfunction adaptor / CryptoAPI");
+
+static int cryptoloop_init(struct loop_device *lo, struct loop_info *info)
+{
+	char cms[LO_NAME_SIZE];		/* cipher-mode string */
+	char *cipher, *mode;
+	u32 flags = CRYPTO_TFM_MODE_CBC;
+	struct crypto_tfm *tfm;
+	int err;
+
+	/* IVs are per sector of the loop device */
+	if (info->lo_offset & (LOOP_IV_SECTOR_SIZE - 1))
+		return -EINVAL;
+
+	strncpy(cms, info->lo_name, LO_NAME_SIZE);
+	cms[LO_NAME_SIZE - 1] = 0;
+	cipher = cms;
+	mode = strchr(cms, '-');
+	if (mode != NULL) {
+		*mode++ = 0;
+		if (!strcmp(mode, "ecb"))
+			flags = CRYPTO_TFM_MODE_ECB;
+		else if (strcmp(mode, "cbc"))
+			return -EINVAL;
+	}
+
+	tfm = crypto_alloc_tfm(cipher, flags);
+	if (tfm == NULL)
+		return -EINVAL;
+	if (flags == CRYPTO_TFM_MODE_CBC &&
+	    crypto_tfm_alg_ivsize(tfm) > CRYPTOLOOP_MAX_IV) {
+		crypto_free_tfm(tfm);
+		return -EINVAL;
+	}
+
+	err = crypto_cipher_setkey(tfm, info->lo_encrypt_key,
+				   info->lo_encrypt_key_size);
+	if (err) {
+		crypto_free_tfm(tfm);
+		return err;
+	}
+
+	lo->key_data = tfm;
+	return 0;
+}
+
+static int cryptoloop_transfer_page(struct loop_device *lo, int cmd,
+				    struct page *raw_page, unsigned raw_off,
+				    struct page *loop_page, unsigned loop_off,
+				    int size, unsigned long sector)
+{
+	struct crypto_tfm *tfm = (struct crypto_tfm *) lo->key_data;
+	struct scatterlist sg_out = { 0, };
+	struct scatterlist sg_in = { 0, };
+	u32 iv[CRYPTOLOOP_MAX_IV / sizeof(u32)];
+	int err;
+
+	if (cmd == READ) {
+		sg_in.page = raw_page;
+		sg_in.offset = raw_off;
+		sg_out.page = loop_page;
+		sg_out.offset = loop_off;
+	} else {
+		sg_in.page = loop_page;
+		sg_in.offset = loop_off;
+		sg_out.page = raw_page;
+		sg_out.offset = raw_off;
+	}
+
+	if (tfm->crt_cipher.cit_mode == CRYPTO_TFM_MODE_ECB) {
+		sg_in.length = sg_out.length = size;
+		if (cmd == READ)
+			return crypto_cipher_decrypt(tfm, &sg_out, &sg_in, size);
+		return crypto_cipher_encrypt(tfm, &sg_out, &sg_in, size);
+	}
+
+	while (size > 0) {
+		const int sz = min(size, LOOP_IV_SECTOR_SIZE);
+
+		memset(iv, 0, crypto_tfm_alg_ivsize(tfm));
+		iv[0] = cpu_to_le32(sector);
+		sg_in.length = sg_out.length = sz;
+
+		if (cmd == READ)
+			err = crypto_cipher_decrypt_iv(tfm, &sg_out, &sg_in,
+						       sz, (u8 *) iv);
+		else
+			err = crypto_cipher_encrypt_iv(tfm, &sg_out, &sg_in,
+						       sz, (u8 *) iv);
+		if (err)
+			return err;
+
+		size -= sz;
+		sg_in.offset += sz;
+		sg_out.offset += sz;
+		sector++;
+	}
+	return 0;
+}
+
+/* the virtual address interface is not used, transfer_page always is */
+static int cryptoloop_transfer(struct loop_device *lo, int cmd,
+			       char *raw_buf, char *loop_buf, int size,
+			       int real_block)
+{
+	return -EINVAL;
+}
+
+static int cryptoloop_ioctl(struct loop_device *lo, int cmd, unsigned long arg)
+{
+	return -EINVAL;
+}
+
+static int cryptoloop_release(struct loop_device *lo)
+{
+	struct crypto_tfm *tfm = (struct crypto_tfm *) lo->key_data;
+
+	if (tfm != NULL) {
+		crypto_free_tfm(tfm);
+		lo->key_data = NULL;
+		return 0;
+	}
+	printk(KERN_ERR "cryptoloop_release(): tfm == NULL?\n");
+	return -EINVAL;
+}
+
+static void cryptoloop_lock(struct loop_device *lo)
+{
+	MOD_INC_USE_COUNT;
+}
+
+static void cryptoloop_unlock(struct loop_device *lo)
+{
+	MOD_DEC_USE_COUNT;
+}
+
+static struct loop_func_table cryptoloop_funcs = {
+	number:		LO_CRYPT_CRYPTOAPI,
+	init:		cryptoloop_init,
+	ioctl:		cryptoloop_ioctl,
+	transfer:	cryptoloop_transfer,
+	transfer_page:	cryptoloop_transfer_page,
+	release:	cryptoloop_release,
+	lock:		cryptoloop_lock,
+	unlock:		cryptoloop_unlock,
+};
+
+static int __init init_cryptoloop(void)
+{
+	int rc = loop_register_transfer(&cryptoloop_funcs);
+
+	if (rc)
+		printk(KERN_ERR "cryptoloop: loop_register_transfer failed\n");
+	return rc;
+}
+
+static void __exit cleanup_cryptoloop(void)
+{
+	if (loop_unregister_transfer(LO_CRYPT_CRYPTOAPI))
+		printk(KERN_ERR
+			"cryptoloop: loop_unregister_transfer failed\n");
+}
+
+module_init(init_cryptoloop);
+module_exit(cleanup_cryptoloop);
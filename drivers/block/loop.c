@@ -39,6 +39,10 @@
  * Support up to 256 loop devices
  * Heinz Mauelshagen <mge@sistina.com>, Feb 2002
  *
+ * A pool of worker threads per device, so that transfers (decryption in
+ * particular) run on all CPUs. Transfers work on pages and kmap them,
+ * so highmem buffers are no longer bounced first.
+ *
  * Still To Fix:
  * - Advisory locking is ignored here. 
  * - Should use an own CAP_* category instead of CAP_SYS_ADMIN 
@@ -71,6 +75,7 @@
 #include <linux/smp_lock.h>
 #include <linux/swap.h>
 #include <linux/slab.h>
+#include <linux/highmem.h>
 
 #include <asm/uaccess.h>
 
@@ -79,6 +84,7 @@
 #define MAJOR_NR LOOP_MAJOR
 
 static int max_loop = 8;
+static int loop_workers;	/* threads per device, 0: one per CPU */
 static struct loop_device *loop_dev;
 static int *loop_sizes;
 static int *loop_blksizes;
@@ -152,6 +158,29 @@ struct loop_func_table *xfer_funcs[MAX_LO_CRYPT] = {
 	&xor_funcs  
 };
 
+/*
+ * Run the transfer between two (possibly highmem) pages
+ */
+static int loop_transfer(struct loop_device *lo, int cmd,
+			 struct page *raw_page, unsigned raw_off,
+			 struct page *loop_page, unsigned loop_off,
+			 int size, int real_block, unsigned long sector)
+{
+	char *raw_buf, *loop_buf;
+	int ret;
+
+	if (lo->transfer_page)
+		return lo->transfer_page(lo, cmd, raw_page, raw_off,
+					 loop_page, loop_off, size, sector);
+
+	raw_buf = (char *) kmap(raw_page) + raw_off;
+	loop_buf = (char *) kmap(loop_page) + loop_off;
+	ret = lo_do_transfer(lo, cmd, raw_buf, loop_buf, size, real_block);
+	kunmap(loop_page);
+	kunmap(raw_page);
+	return ret;
+}
+
 #define MAX_DISK_SIZE 1024*1024*1024
 
 static int compute_loop_size(struct loop_device *lo, struct dentry * lo_dentry, kdev_t lodev)
@@ -178,16 +207,16 @@ static int lo_send(struct loop_device *lo, struct buffer_head *bh, int bsize,
 	struct address_space *mapping = file->f_dentry->d_inode->i_mapping;
 	struct address_space_operations *aops = mapping->a_ops;
 	struct page *page;
-	char *kaddr, *data;
+	char *kaddr;
 	unsigned long index;
-	unsigned size, offset;
+	unsigned size, offset, data;
 	int len;
 
 	down(&mapping->host->i_sem);
 	index = pos >> PAGE_CACHE_SHIFT;
 	offset = pos & (PAGE_CACHE_SIZE - 1);
 	len = bh->b_size;
-	data = bh->b_data;
+	data = bh_offset(bh);
 	while (len > 0) {
 		int IV = index * (PAGE_CACHE_SIZE/bsize) + offset/bsize;
 		int transfer_result;
@@ -203,7 +232,9 @@ static int lo_send(struct loop_device *lo, struct buffer_head *bh, int bsize,
 		if (aops->prepare_write(file, page, offset, offset+size))
 			goto unlock;
 		flush_dcache_page(page);
-		transfer_result = lo_do_transfer(lo, WRITE, kaddr + offset, data, size, IV);
+		transfer_result = loop_transfer(lo, WRITE, page, offset,
+						bh->b_page, data, size, IV,
+						(pos - lo->lo_offset) >> 9);
 		if (transfer_result) {
 			/*
 			 * The transfer failed, but we still write the data to
@@ -239,32 +270,32 @@ fail:
 
 struct lo_read_data {
 	struct loop_device *lo;
-	char *data;
+	struct page *page;
+	unsigned offset;
 	int bsize;
 };
 
 static int lo_read_actor(read_descriptor_t * desc, struct page *page, unsigned long offset, unsigned long size)
 {
-	char *kaddr;
 	unsigned long count = desc->count;
 	struct lo_read_data *p = (struct lo_read_data*)desc->buf;
 	struct loop_device *lo = p->lo;
 	int IV = page->index * (PAGE_CACHE_SIZE/p->bsize) + offset/p->bsize;
+	loff_t pos = ((loff_t) page->index << PAGE_CACHE_SHIFT) + offset;
 
 	if (size > count)
 		size = count;
 
-	kaddr = kmap(page);
-	if (lo_do_transfer(lo, READ, kaddr + offset, p->data, size, IV)) {
+	if (loop_transfer(lo, READ, page, offset, p->page, p->offset, size,
+			  IV, (pos - lo->lo_offset) >> 9)) {
 		size = 0;
 		printk(KERN_ERR "loop: transfer error block %ld\n",page->index);
 		desc->error = -EINVAL;
 	}
-	kunmap(page);
 	
 	desc->count = count - size;
 	desc->written += size;
-	p->data += size;
+	p->offset += size;
 	return size;
 }
 
@@ -276,7 +307,8 @@ static int lo_receive(struct loop_device *lo, struct buffer_head *bh, int bsize,
 	struct file *file;
 
 	cookie.lo = lo;
-	cookie.data = bh->b_data;
+	cookie.page = bh->b_page;
+	cookie.offset = bh_offset(bh);
 	cookie.bsize = bsize;
 	desc.written = 0;
 	desc.count = bh->b_size;
@@ -487,7 +519,11 @@ static int loop_make_request(request_queue_t *q, int rw, struct buffer_head *rbh
 		goto err;
 	}
 
-	rbh = blk_queue_bounce(q, rw, rbh);
+	/*
+	 * no bouncing: loop_transfer() kmaps both pages, and a remapped
+	 * rbh is bounced, if it needs to be, by the __make_request() of
+	 * the device it ends up on.
+	 */
 
 	/*
 	 * file backed, queue for loop_thread to handle
@@ -510,8 +546,9 @@ static int loop_make_request(request_queue_t *q, int rw, struct buffer_head *rbh
 	IV = loop_get_iv(lo, rbh->b_rsector);
 	if (rw == WRITE) {
 		set_bit(BH_Dirty, &bh->b_state);
-		if (lo_do_transfer(lo, WRITE, bh->b_data, rbh->b_data,
-				   bh->b_size, IV))
+		if (loop_transfer(lo, WRITE, bh->b_page, bh_offset(bh),
+				  rbh->b_page, bh_offset(rbh), bh->b_size, IV,
+				  rbh->b_rsector))
 			goto err;
 	}
 
@@ -546,8 +583,9 @@ static inline void loop_handle_bh(struct loop_device *lo,struct buffer_head *bh)
 		struct buffer_head *rbh = bh->b_private;
 		unsigned long IV = loop_get_iv(lo, rbh->b_rsector);
 
-		ret = lo_do_transfer(lo, READ, bh->b_data, rbh->b_data,
-				     bh->b_size, IV);
+		ret = loop_transfer(lo, READ, bh->b_page, bh_offset(bh),
+				    rbh->b_page, bh_offset(rbh), bh->b_size, IV,
+				    rbh->b_rsector);
 
 		rbh->b_end_io(rbh, !ret);
 		loop_put_buffer(bh);
@@ -555,10 +593,15 @@ static inline void loop_handle_bh(struct loop_device *lo,struct buffer_head *bh)
 }
 
 /*
- * worker thread that handles reads/writes to file backed loop devices,
- * to avoid blocking in our make_request_fn. it also does loop decrypting
+ * worker threads that handle reads/writes to file backed loop devices,
+ * to avoid blocking in our make_request_fn. they also do loop decrypting
  * on reads for block backed loop, as that is too heavy to do from
  * b_end_io context where irqs may be disabled.
+ *
+ * each device has lo_workers of them, all taking buffers off lo_bh;
+ * every buffer queued ups lo_bh_mutex once. at tear-down, lo_pending
+ * drops to zero and lo_bh_mutex is upped once more: each thread that
+ * finds nothing left passes that on to the next and exits.
  */
 static int loop_thread(void *data)
 {
@@ -569,18 +612,17 @@ static int loop_thread(void *data)
 	exit_files(current);
 	reparent_to_init();
 
-	sprintf(current->comm, "loop%d", lo->lo_number);
+	if (lo->lo_workers)
+		sprintf(current->comm, "loop%d/%d", lo->lo_number,
+			lo->lo_workers);
+	else
+		sprintf(current->comm, "loop%d", lo->lo_number);
 
 	spin_lock_irq(&current->sigmask_lock);
 	sigfillset(&current->blocked);
 	flush_signals(current);
 	spin_unlock_irq(&current->sigmask_lock);
 
-	spin_lock_irq(&lo->lo_lock);
-	lo->lo_state = Lo_bound;
-	atomic_inc(&lo->lo_pending);
-	spin_unlock_irq(&lo->lo_lock);
-
 	current->flags |= PF_NOIO;
 
 	/*
@@ -590,15 +632,15 @@ static int loop_thread(void *data)
 
 	for (;;) {
 		down_interruptible(&lo->lo_bh_mutex);
-		/*
-		 * could be upped because of tear-down, not because of
-		 * pending work
-		 */
-		if (!atomic_read(&lo->lo_pending))
-			break;
 
 		bh = loop_get_bh(lo);
 		if (!bh) {
+			/*
+			 * could be upped because of tear-down, not because
+			 * of pending work
+			 */
+			if (!atomic_read(&lo->lo_pending))
+				break;
 			printk("loop: missing bh\n");
 			continue;
 		}
@@ -609,9 +651,11 @@ static int loop_thread(void *data)
 		 * will hit zero then
 		 */
 		if (atomic_dec_and_test(&lo->lo_pending))
-			break;
+			up(&lo->lo_bh_mutex);
 	}
 
+	/* wake the next thread for tear-down */
+	up(&lo->lo_bh_mutex);
 	up(&lo->lo_sem);
 	return 0;
 }
@@ -624,7 +668,7 @@ static int loop_set_fd(struct loop_device *lo, struct file *lo_file, kdev_t dev,
 	kdev_t		lo_device;
 	int		lo_flags = 0;
 	int		error;
-	int		bs;
+	int		bs, workers;
 
 	MOD_INC_USE_COUNT;
 
@@ -679,6 +723,7 @@ static int loop_set_fd(struct loop_device *lo, struct file *lo_file, kdev_t dev,
 	lo->lo_flags = lo_flags;
 	lo->lo_backing_file = file;
 	lo->transfer = NULL;
+	lo->transfer_page = NULL;
 	lo->ioctl = NULL;
 	figure_loop_size(lo);
 	lo->old_gfp_mask = inode->i_mapping->gfp_mask;
@@ -693,8 +738,30 @@ static int loop_set_fd(struct loop_device *lo, struct file *lo_file, kdev_t dev,
 	set_blocksize(dev, bs);
 
 	lo->lo_bh = lo->lo_bhtail = NULL;
-	kernel_thread(loop_thread, lo, CLONE_FS | CLONE_FILES | CLONE_SIGHAND);
-	down(&lo->lo_sem);
+	sema_init(&lo->lo_bh_mutex, 0);
+	atomic_set(&lo->lo_pending, 1);
+	lo->lo_state = Lo_bound;
+
+	workers = loop_workers ? loop_workers : smp_num_cpus;
+	for (lo->lo_workers = 0; lo->lo_workers < workers; lo->lo_workers++) {
+		if (kernel_thread(loop_thread, lo,
+				  CLONE_FS | CLONE_FILES | CLONE_SIGHAND) < 0)
+			break;
+		down(&lo->lo_sem);
+	}
+	if (!lo->lo_workers) {
+		/* no thread to run the tear-down either */
+		lo->lo_state = Lo_unbound;
+		inode->i_mapping->gfp_mask = lo->old_gfp_mask;
+		lo->lo_backing_file = NULL;
+		lo->lo_device = 0;
+		lo->lo_flags = 0;
+		loop_sizes[lo->lo_number] = 0;
+		set_device_ro(dev, 0);
+		fput(file);
+		error = -ENOMEM;
+		goto out_putf;
+	}
 
 	fput(file);
 	return 0;
@@ -754,12 +821,16 @@ static int loop_clr_fd(struct loop_device *lo, struct block_device *bdev)
 		up(&lo->lo_bh_mutex);
 	spin_unlock_irq(&lo->lo_lock);
 
-	down(&lo->lo_sem);
+	while (lo->lo_workers) {
+		down(&lo->lo_sem);
+		lo->lo_workers--;
+	}
 
 	lo->lo_backing_file = NULL;
 
 	loop_release_xfer(lo);
 	lo->transfer = NULL;
+	lo->transfer_page = NULL;
 	lo->ioctl = NULL;
 	lo->lo_device = 0;
 	lo->lo_encrypt_type = 0;
@@ -807,6 +878,7 @@ static int loop_set_status(struct loop_device *lo, struct loop_info *arg)
 	strncpy(lo->lo_name, info.lo_name, LO_NAME_SIZE);
 
 	lo->transfer = xfer_funcs[type]->transfer;
+	lo->transfer_page = xfer_funcs[type]->transfer_page;
 	lo->ioctl = xfer_funcs[type]->ioctl;
 	lo->lo_encrypt_key_size = info.lo_encrypt_key_size;
 	lo->lo_init[0] = info.lo_init[0];
@@ -970,6 +1042,8 @@ static struct block_device_operations lo_fops = {
  */
 MODULE_PARM(max_loop, "i");
 MODULE_PARM_DESC(max_loop, "Maximum number of loop devices (1-256)");
+MODULE_PARM(loop_workers, "i");
+MODULE_PARM_DESC(loop_workers, "Worker threads per device (0: one per CPU)");
 MODULE_LICENSE("GPL");
 
 int loop_register_transfer(struct loop_func_table *funcs)
@@ -991,6 +1065,7 @@ int loop_unregister_transfer(int number)
 		if (type == number) { 
 			xfer_funcs[type]->release(lo);
 			lo->transfer = NULL; 
+			lo->transfer_page = NULL;
 			lo->lo_encrypt_type = 0; 
 		}
 	}
@@ -1010,6 +1085,11 @@ int __init loop_init(void)
 				    " 1 and 256), using default (8)\n");
 		max_loop = 8;
 	}
+	if ((loop_workers < 0) || (loop_workers > 32)) {
+		printk(KERN_WARNING "loop: invalid loop_workers (must be between"
+				    " 0 and 32), using one per CPU\n");
+		loop_workers = 0;
+	}
 
 	if (devfs_register_blkdev(MAJOR_NR, "loop", &lo_fops)) {
 		printk(KERN_WARNING "Unable to get major number %d for loop"
@@ -1089,4 +1169,12 @@ static int __init max_loop_setup(char *str)
 }
 
 __setup("max_loop=", max_loop_setup);
+
+static int __init loop_workers_setup(char *str)
+{
+	loop_workers = simple_strtol(str, NULL, 0);
+	return 1;
+}
+
+__setup("loop_workers=", loop_workers_setup);
 #endif
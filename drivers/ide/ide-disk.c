@@ -697,6 +697,11 @@ static ide_startstop_t lba_48_rw_disk (ide_drive_t *drive, struct request *rq, u
 static ide_startstop_t ide_do_rw_disk (ide_drive_t *drive, struct request *rq, unsigned long block)
 {
 	ide_hwif_t *hwif	= HWIF(drive);
+#ifdef CONFIG_BLK_DEV_IDE_TCQ
+	if (drive->using_tcq && drive->using_dma &&
+	    (rq->cmd == READ || rq->cmd == WRITE))
+		return ide_tcq_do_rw(drive, rq, block);
+#endif /* CONFIG_BLK_DEV_IDE_TCQ */
 	if (hwif->rw_disk)
 		return hwif->rw_disk(drive, rq, block);
 	else 
@@ -1406,11 +1411,47 @@ static int proc_idedisk_read_smart_values
 	PROC_IDE_READ_RETURN(page,start,off,count,eof,len);
 }
 
+#ifdef CONFIG_BLK_DEV_IDE_TCQ
+static int proc_idedisk_read_tcq
+	(char *page, char **start, off_t off, int count, int *eof, void *data)
+{
+	ide_drive_t	*drive = (ide_drive_t *) data;
+	ide_tag_info_t	*tcq = drive->tcq;
+	char		*out = page;
+	int		len, i;
+
+	if (tcq == NULL) {
+		len = sprintf(out, "(none)\n");
+		PROC_IDE_READ_RETURN(page,start,off,count,eof,len);
+	}
+	out += sprintf(out, "using_tcq:   %d\n", drive->using_tcq);
+	out += sprintf(out, "depth:       %d/%d\n", tcq->queue_depth, tcq->max_depth);
+	out += sprintf(out, "active:      %d\n", tcq->active);
+	out += sprintf(out, "issued:      %lu\n", tcq->issued);
+	out += sprintf(out, "avg depth:   %lu\n",
+		tcq->issued ? tcq->depth_sum / tcq->issued : 0);
+	out += sprintf(out, "immediate:   %lu\n", tcq->immediate);
+	out += sprintf(out, "released:    %lu\n", tcq->released);
+	out += sprintf(out, "serviced:    %lu\n", tcq->serviced);
+	out += sprintf(out, "fallbacks:   %lu\n", tcq->fallbacks);
+	out += sprintf(out, "depth histogram:");
+	for (i = 0; i < tcq->max_depth; i++)
+		out += sprintf(out, "%s%lu", (i & 7) ? " " : "\n  ",
+			tcq->depth_hist[i]);
+	out += sprintf(out, "\n");
+	len = out - page;
+	PROC_IDE_READ_RETURN(page,start,off,count,eof,len);
+}
+#endif /* CONFIG_BLK_DEV_IDE_TCQ */
+
 static ide_proc_entry_t idedisk_proc[] = {
 	{ "cache",		S_IFREG|S_IRUGO,	proc_idedisk_read_cache,		NULL },
 	{ "geometry",		S_IFREG|S_IRUGO,	proc_ide_read_geometry,			NULL },
 	{ "smart_values",	S_IFREG|S_IRUSR,	proc_idedisk_read_smart_values,		NULL },
 	{ "smart_thresholds",	S_IFREG|S_IRUSR,	proc_idedisk_read_smart_thresholds,	NULL },
+#ifdef CONFIG_BLK_DEV_IDE_TCQ
+	{ "tcq",		S_IFREG|S_IRUGO,	proc_idedisk_read_tcq,			NULL },
+#endif /* CONFIG_BLK_DEV_IDE_TCQ */
 	{ NULL, 0, NULL, NULL }
 };
 
@@ -1578,6 +1619,23 @@ static int set_lba_addressing (ide_drive_t *drive, int arg)
 	return (probe_lba_addressing(drive, arg));
 }
 
+#ifdef CONFIG_BLK_DEV_IDE_TCQ
+static int set_using_tcq (ide_drive_t *drive, int arg)
+{
+	return ide_tcq_enable(drive, arg) ? -EIO : 0;
+}
+
+static void idedisk_add_tcq_settings(ide_drive_t *drive)
+{
+	ide_tag_info_t *tcq = drive->tcq;
+
+	if (tcq == NULL)
+		return;
+	ide_add_setting(drive,	"using_tcq",		SETTING_RW,					-1,			-1,			TYPE_BYTE,	0,	1,				1,	1,	&drive->using_tcq,		set_using_tcq);
+	ide_add_setting(drive,	"queue_depth",		SETTING_RW,					-1,			-1,			TYPE_INT,	1,	tcq->max_depth,			1,	1,	&tcq->queue_depth,		NULL);
+}
+#endif /* CONFIG_BLK_DEV_IDE_TCQ */
+
 static void idedisk_add_settings(ide_drive_t *drive)
 {
 	struct hd_driveid *id = drive->id;
@@ -1686,6 +1744,11 @@ static void idedisk_setup (ide_drive_t *drive)
 	/* calculate drive capacity, and select LBA if possible */
 	init_idedisk_capacity (drive);
 
+#ifdef CONFIG_BLK_DEV_IDE_TCQ
+	ide_tcq_init(drive);
+	idedisk_add_tcq_settings(drive);
+#endif /* CONFIG_BLK_DEV_IDE_TCQ */
+
 	/*
 	 * if possible, give fdisk access to more of the drive,
 	 * by correcting bios_cyls:
@@ -1722,12 +1785,20 @@ static void idedisk_setup (ide_drive_t *drive)
 	drive->no_io_32bit = id->dword_io ? 1 : 0;
 	if (drive->id->cfs_enable_2 & 0x3000)
 		write_cache(drive, (id->cfs_enable_2 & 0x3000));
+#ifdef CONFIG_BLK_DEV_IDE_TCQ_DEFAULT
+	(void) ide_tcq_enable(drive, 1);
+#endif /* CONFIG_BLK_DEV_IDE_TCQ_DEFAULT */
 }
 
 static int idedisk_cleanup(ide_drive_t *drive)
 {
 	ide_cacheflush_p(drive);
-	return ide_unregister_subdriver(drive);
+	if (ide_unregister_subdriver(drive))
+		return 1;
+#ifdef CONFIG_BLK_DEV_IDE_TCQ
+	ide_tcq_exit(drive);
+#endif /* CONFIG_BLK_DEV_IDE_TCQ */
+	return 0;
 }
 
 int idedisk_init (void);
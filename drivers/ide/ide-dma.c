@@ -670,28 +670,49 @@ int __ide_dma_check (ide_drive_t *drive)
 
 EXPORT_SYMBOL(__ide_dma_check);
 
-int __ide_dma_read (ide_drive_t *drive /*, struct request *rq */)
+/**
+ *	ide_start_dma	-	set up the DMA engine for a request
+ *	@drive: drive the transfer is for
+ *	@rq: request to transfer
+ *	@reading: 1 for a transfer from the drive
+ *
+ *	Maps @rq, loads the PRD table and the direction, and leaves the
+ *	engine for ide_dma_begin() to start once the drive is ready.
+ *	Returns 1 if the request cannot be done by DMA, 0 otherwise.
+ */
+
+int ide_start_dma (ide_drive_t *drive, struct request *rq, int reading)
 {
 	ide_hwif_t *hwif	= HWIF(drive);
-	struct request *rq	= HWGROUP(drive)->rq;
-//	ide_task_t *args	= rq->special;
-	unsigned int reading	= 1 << 3;
-	unsigned int count	= 0;
-	u8 dma_stat = 0, lba48	= (drive->addressing == 1) ? 1 : 0;
-	task_ioreg_t command	= WIN_NOP;
+	u8 dma_stat		= 0;
 
-	if (!(count = ide_build_dmatable(drive, rq, PCI_DMA_FROMDEVICE)))
-		/* try PIO instead of DMA */
+	if (!ide_build_dmatable(drive, rq,
+			reading ? PCI_DMA_FROMDEVICE : PCI_DMA_TODEVICE))
 		return 1;
 	/* PRD table */
 	hwif->OUTL(hwif->dmatable_dma, hwif->dma_prdtable);
 	/* specify r/w */
-	hwif->OUTB(reading, hwif->dma_command);
+	hwif->OUTB(reading ? (1 << 3) : 0, hwif->dma_command);
 	/* read dma_status for INTR & ERROR flags */
 	dma_stat = hwif->INB(hwif->dma_status);
 	/* clear INTR & ERROR flags */
 	hwif->OUTB(dma_stat|6, hwif->dma_status);
 	drive->waiting_for_dma = 1;
+	return 0;
+}
+
+EXPORT_SYMBOL_GPL(ide_start_dma);
+
+int __ide_dma_read (ide_drive_t *drive /*, struct request *rq */)
+{
+	struct request *rq	= HWGROUP(drive)->rq;
+//	ide_task_t *args	= rq->special;
+	u8 lba48		= (drive->addressing == 1) ? 1 : 0;
+	task_ioreg_t command	= WIN_NOP;
+
+	if (ide_start_dma(drive, rq, 1))
+		/* try PIO instead of DMA */
+		return 1;
 	if (drive->media != ide_disk)
 		return 0;
 	/*
@@ -718,26 +739,14 @@ EXPORT_SYMBOL(__ide_dma_read);
 
 int __ide_dma_write (ide_drive_t *drive /*, struct request *rq */)
 {
-	ide_hwif_t *hwif	= HWIF(drive);
 	struct request *rq	= HWGROUP(drive)->rq;
 //	ide_task_t *args	= rq->special;
-	unsigned int reading	= 0;
-	unsigned int count	= 0;
-	u8 dma_stat = 0, lba48	= (drive->addressing == 1) ? 1 : 0;
+	u8 lba48		= (drive->addressing == 1) ? 1 : 0;
 	task_ioreg_t command	= WIN_NOP;
 
-	if (!(count = ide_build_dmatable(drive, rq, PCI_DMA_TODEVICE)))
+	if (ide_start_dma(drive, rq, 0))
 		/* try PIO instead of DMA */
 		return 1;
-	/* PRD table */
-	hwif->OUTL(hwif->dmatable_dma, hwif->dma_prdtable);
-	/* specify r/w */
-	hwif->OUTB(reading, hwif->dma_command);
-	/* read dma_status for INTR & ERROR flags */
-	dma_stat = hwif->INB(hwif->dma_status);
-	/* clear INTR & ERROR flags */
-	hwif->OUTB(dma_stat|6, hwif->dma_status);
-	drive->waiting_for_dma = 1;
 	if (drive->media != ide_disk)
 		return 0;
 	/*
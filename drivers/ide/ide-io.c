@@ -665,7 +665,8 @@ repeat:
 	best = NULL;
 	drive = hwgroup->drive;
 	do {
-		if (!blk_queue_empty(&drive->queue) && (!drive->sleep || time_after_eq(jiffies, drive->sleep))) {
+		if (!blk_queue_empty(&drive->queue) && (!drive->sleep || time_after_eq(jiffies, drive->sleep)) &&
+		    !ide_tcq_blocked(drive)) {
 			if (!best
 			 || (drive->sleep && (!best->sleep || 0 < (signed long)(best->sleep - drive->sleep)))
 			 || (!best->sleep && 0 < (signed long)(WAKEUP(best) - WAKEUP(drive))))
@@ -759,7 +760,8 @@ void ide_do_request (ide_hwgroup_t *hwgroup, int masked_irq)
 				if (drive->sleep && (!sleep || 0 < (signed long)(sleep - drive->sleep)))
 					sleep = drive->sleep;
 			} while ((drive = drive->next) != hwgroup->drive);
-			if (sleep) {
+			/* queued commands out: the timer is theirs */
+			if (sleep && !hwgroup->released) {
 		/*
 		 * Take a short snooze, and then wake up this hwgroup again.
 		 * This gives other hwgroups on the same a chance to
@@ -790,6 +792,13 @@ void ide_do_request (ide_hwgroup_t *hwgroup, int masked_irq)
 			return;
 		}
 		hwif = HWIF(drive);
+		if (hwgroup->released) {
+			/* the drive was waiting to be serviced; whatever
+			 * we start next will look at its status anyway */
+			hwgroup->released = 0;
+			hwgroup->handler = NULL;
+			del_timer(&hwgroup->timer);
+		}
 		if (hwgroup->hwif->sharing_irq &&
 		    hwif != hwgroup->hwif &&
 		    hwif->io_ports[IDE_CONTROL_OFFSET]) {
@@ -825,6 +834,9 @@ void ide_do_request (ide_hwgroup_t *hwgroup, int masked_irq)
 		if (hwif->irq != masked_irq)
 			enable_irq(hwif->irq);
 		if (startstop == ide_stopped)
+			/* queued commands may still be out */
+			ide_tcq_rearm(drive);
+		if (startstop == ide_stopped || startstop == ide_released)
 			hwgroup->busy = 0;
 	}
 }
@@ -953,7 +965,8 @@ void ide_timer_expiry (unsigned long data)
 			ide_startstop_t startstop = ide_stopped;
 			if (!hwgroup->busy) {
 				hwgroup->busy = 1;	/* paranoia */
-				printk(KERN_ERR "%s: ide_timer_expiry: hwgroup->busy was 0 ??\n", drive->name);
+				if (!hwgroup->released)
+					printk(KERN_ERR "%s: ide_timer_expiry: hwgroup->busy was 0 ??\n", drive->name);
 			}
 			if ((expiry = hwgroup->expiry) != NULL) {
 				/* continue */
@@ -966,6 +979,7 @@ void ide_timer_expiry (unsigned long data)
 				}
 			}
 			hwgroup->handler = NULL;
+			hwgroup->released = 0;
 			/*
 			 * We need to simulate a real interrupt when invoking
 			 * the handler() function, which means we need to
@@ -983,7 +997,8 @@ void ide_timer_expiry (unsigned long data)
 			/* local CPU only,
 			 * as if we were handling an interrupt */
 			local_irq_disable();
-			if (hwgroup->poll_timeout != 0) {
+			if (hwgroup->poll_timeout != 0 ||
+			    ide_tcq_timedout(drive)) {
 				startstop = handler(drive);
 			} else if (drive_is_ready(drive)) {
 				if (drive->waiting_for_dma)
@@ -1001,7 +1016,8 @@ void ide_timer_expiry (unsigned long data)
 			drive->service_time = jiffies - drive->service_start;
 			spin_lock_irq(&io_request_lock);
 			enable_irq(hwif->irq);
-			if (startstop == ide_stopped)
+			if (startstop == ide_stopped ||
+			    startstop == ide_released)
 				hwgroup->busy = 0;
 		}
 	}
@@ -1170,9 +1186,12 @@ void ide_intr (int irq, void *dev_id, struct pt_regs *regs)
 	}
 	if (!hwgroup->busy) {
 		hwgroup->busy = 1;	/* paranoia */
-		printk(KERN_ERR "%s: ide_intr: hwgroup->busy was 0 ??\n", drive->name);
+		/* not paranoia when queued commands are out */
+		if (!hwgroup->released)
+			printk(KERN_ERR "%s: ide_intr: hwgroup->busy was 0 ??\n", drive->name);
 	}
 	hwgroup->handler = NULL;
+	hwgroup->released = 0;
 	del_timer(&hwgroup->timer);
 	spin_unlock(&io_request_lock);
 
@@ -1199,6 +1218,10 @@ void ide_intr (int irq, void *dev_id, struct pt_regs *regs)
 			printk(KERN_ERR "%s: ide_intr: huh? expected NULL handler "
 				"on exit\n", drive->name);
 		}
+	} else if (startstop == ide_released) {
+		/* the drive let go of the bus: it can take more commands */
+		hwgroup->busy = 0;
+		ide_do_request(hwgroup, hwif->irq);
 	}
 	spin_unlock_irqrestore(&io_request_lock, flags);
 }
@@ -50,6 +50,7 @@
 #include <linux/spinlock.h>
 #include <linux/pci.h>
 #include <linux/kmod.h>
+#include <linux/sched.h>
 
 #include <asm/byteorder.h>
 #include <asm/irq.h>
@@ -269,6 +270,48 @@ err_misc:
 	return;
 }
 
+/*
+ * The waits below sleep rather than spin, so that the interfaces that
+ * ideprobe_init() probes side by side make progress together.
+ */
+static void probe_sleep (unsigned long ms)
+{
+	__set_current_state(TASK_UNINTERRUPTIBLE);
+	schedule_timeout(1 + ms * HZ / 1000);
+}
+
+/**
+ *	probe_wait_not_busy	-	wait for BUSY_STAT to drop
+ *	@hwif: interface
+ *	@reg: status register to poll
+ *	@timeout: how long to wait, in jiffies
+ *
+ *	Returns the last status read. Most drives answer within a
+ *	millisecond, so the register is polled briefly before falling
+ *	back to sleeping a tick between reads. A status of 0xff means
+ *	there is nothing on the bus to wait for.
+ */
+static u8 probe_wait_not_busy (ide_hwif_t *hwif, ide_ioreg_t reg, unsigned long timeout)
+{
+	unsigned long end = jiffies + timeout;
+	int spin = 100;
+	u8 stat;
+
+	for (;;) {
+		udelay(10);
+		stat = hwif->INB(reg);
+		if (!(stat & BUSY_STAT) || stat == 0xff)
+			break;
+		if (time_after(jiffies, end))
+			break;
+		if (spin)
+			spin--;
+		else
+			probe_sleep(1);
+	}
+	return stat;
+}
+
 /**
  *	actual_try_to_identify	-	send ata/atapi identify
  *	@drive: drive to identify
@@ -294,7 +337,7 @@ static int actual_try_to_identify (ide_drive_t *drive, u8 cmd)
 
 	if (IDE_CONTROL_REG) {
 		/* take a deep breath */
-		ide_delay_50ms();
+		(void) probe_wait_not_busy(hwif, IDE_ALTSTATUS_REG, HZ/20);
 		a = hwif->INB(IDE_ALTSTATUS_REG);
 		s = hwif->INB(IDE_STATUS_REG);
 		if ((a ^ s) & ~INDEX_STAT) {
@@ -307,7 +350,7 @@ static int actual_try_to_identify (ide_drive_t *drive, u8 cmd)
 			hd_status = IDE_ALTSTATUS_REG;
 		}
 	} else {
-		ide_delay_50ms();
+		(void) probe_wait_not_busy(hwif, IDE_STATUS_REG, HZ/20);
 		hd_status = IDE_STATUS_REG;
 	}
 
@@ -326,18 +369,18 @@ static int actual_try_to_identify (ide_drive_t *drive, u8 cmd)
 		hwif->OUTB(cmd, IDE_COMMAND_REG);
 	}
 	timeout = ((cmd == WIN_IDENTIFY) ? WAIT_WORSTCASE : WAIT_PIDENTIFY) / 2;
-	timeout += jiffies;
-	do {
-		if (time_after(jiffies, timeout)) {
-			/* drive timed-out */
-			return 1;
-		}
-		/* give drive a breather */
-		ide_delay_50ms();
-	} while ((hwif->INB(hd_status)) & BUSY_STAT);
+	/* 0xff has BUSY_STAT set too: nobody there to answer */
+	if (probe_wait_not_busy(hwif, hd_status, timeout) & BUSY_STAT) {
+		/* drive timed-out */
+		return 1;
+	}
 
 	/* wait for IRQ and DRQ_STAT */
-	ide_delay_50ms();
+	if (!hwif->irq)
+		/* give IRQ autoprobing time to see it */
+		probe_sleep(50);
+	else
+		udelay(50);
 	if (OK_STAT((hwif->INB(IDE_STATUS_REG)), DRQ_STAT, BAD_R_STAT)) {
 		unsigned long flags;
 
@@ -456,15 +499,15 @@ static int do_probe (ide_drive_t *drive, u8 cmd)
 	/* needed for some systems
 	 * (e.g. crw9624 as drive0 with disk as slave)
 	 */
-	ide_delay_50ms();
+	(void) probe_wait_not_busy(hwif, IDE_STATUS_REG, HZ/20);
 	SELECT_DRIVE(drive);
-	ide_delay_50ms();
+	(void) probe_wait_not_busy(hwif, IDE_STATUS_REG, HZ/20);
 	if (hwif->INB(IDE_SELECT_REG) != drive->select.all && !drive->present) {
 		if (drive->select.b.unit != 0) {
 			/* exit with drive0 selected */
 			SELECT_DRIVE(&hwif->drives[0]);
 			/* allow BUSY_STAT to assert & clear */
-			ide_delay_50ms();
+			(void) probe_wait_not_busy(hwif, IDE_STATUS_REG, HZ/20);
 		}
 		/* no i/f present: mmm.. this should be a 4 -ml */
 		return 3;
@@ -483,18 +526,14 @@ static int do_probe (ide_drive_t *drive, u8 cmd)
 		if ((rc == 1 && cmd == WIN_PIDENTIFY) &&
 			((drive->autotune == IDE_TUNE_DEFAULT) ||
 			(drive->autotune == IDE_TUNE_AUTO))) {
-			unsigned long timeout;
 			printk("%s: no response (status = 0x%02x), "
 				"resetting drive\n", drive->name,
 				hwif->INB(IDE_STATUS_REG));
-			ide_delay_50ms();
+			probe_sleep(50);
 			hwif->OUTB(drive->select.all, IDE_SELECT_REG);
-			ide_delay_50ms();
+			probe_sleep(50);
 			hwif->OUTB(WIN_SRST, IDE_COMMAND_REG);
-			timeout = jiffies;
-			while (((hwif->INB(IDE_STATUS_REG)) & BUSY_STAT) &&
-			       time_before(jiffies, timeout + WAIT_WORSTCASE))
-				ide_delay_50ms();
+			(void) probe_wait_not_busy(hwif, IDE_STATUS_REG, WAIT_WORSTCASE);
 			rc = try_to_identify(drive, cmd);
 		}
 		if (rc == 1)
@@ -509,7 +548,7 @@ static int do_probe (ide_drive_t *drive, u8 cmd)
 	if (drive->select.b.unit != 0) {
 		/* exit with drive0 selected */
 		SELECT_DRIVE(&hwif->drives[0]);
-		ide_delay_50ms();
+		(void) probe_wait_not_busy(hwif, IDE_STATUS_REG, HZ/20);
 		/* ensure drive irq is clear */
 		(void) hwif->INB(IDE_STATUS_REG);
 	}
@@ -526,7 +565,7 @@ static void enable_nest (ide_drive_t *drive)
 
 	printk("%s: enabling %s -- ", hwif->name, drive->id->model);
 	SELECT_DRIVE(drive);
-	ide_delay_50ms();
+	probe_sleep(50);
 	hwif->OUTB(EXABYTE_ENABLE_NEST, IDE_COMMAND_REG);
 	timeout = jiffies + WAIT_WORSTCASE;
 	do {
@@ -534,10 +573,10 @@ static void enable_nest (ide_drive_t *drive)
 			printk("failed (timeout)\n");
 			return;
 		}
-		ide_delay_50ms();
+		probe_sleep(50);
 	} while ((hwif->INB(IDE_STATUS_REG)) & BUSY_STAT);
 
-	ide_delay_50ms();
+	probe_sleep(50);
 
 	if (!OK_STAT((hwif->INB(IDE_STATUS_REG)), 0, BAD_STAT)) {
 		printk("failed (status = 0x%02x)\n", hwif->INB(IDE_STATUS_REG));
@@ -552,6 +591,35 @@ static void enable_nest (ide_drive_t *drive)
 	}
 }
 
+/*
+ * A slot that was empty last time (hdx=empty) only gets a quick look:
+ * if nothing takes the select, or what does is neither busy, ready nor
+ * showing the ATAPI signature, it is taken to be empty still and the
+ * identify timeouts are skipped.
+ */
+static int probe_still_empty (ide_drive_t *drive)
+{
+	ide_hwif_t *hwif = HWIF(drive);
+	int empty = 1;
+	u8 stat;
+
+	SELECT_DRIVE(drive);
+	stat = probe_wait_not_busy(hwif, IDE_STATUS_REG, HZ/20);
+	if (hwif->INB(IDE_SELECT_REG) == drive->select.all && stat != 0xff) {
+		if (stat & (BUSY_STAT|READY_STAT))
+			empty = 0;
+		else if (hwif->INB(IDE_LCYL_REG) == 0x14 &&
+			 hwif->INB(IDE_HCYL_REG) == 0xeb)
+			empty = 0;
+	}
+	if (drive->select.b.unit != 0) {
+		/* exit with drive0 selected */
+		SELECT_DRIVE(&hwif->drives[0]);
+		(void) probe_wait_not_busy(hwif, IDE_STATUS_REG, HZ/20);
+	}
+	return empty;
+}
+
 /**
  *	ide_probe_for_drives	-	upper level drive probe
  *	@drive: drive to probe for
@@ -585,6 +653,11 @@ u8 ide_probe_for_drive (ide_drive_t *drive)
 	memset(drive->id, 0, SECTOR_WORDS * 4);
 	strcpy(drive->id->model, "UNKNOWN");
 	
+	if (drive->probe_empty && !drive->present && probe_still_empty(drive)) {
+		printk(KERN_INFO "%s: empty, as last time\n", drive->name);
+		return 0;
+	}
+
 	/* skip probing? */
 	if (!drive->noprobe)
 	{
@@ -760,7 +833,7 @@ void ide_probe_reset(ide_hwif_t *hwif)
 		udelay(10);
 		hwif->OUTB(8, hwif->io_ports[IDE_CONTROL_OFFSET]);
 		do {
-			ide_delay_50ms();
+			probe_sleep(50);
 			stat = hwif->INB(hwif->io_ports[IDE_STATUS_OFFSET]);
 		} while ((stat & BUSY_STAT) && time_after(timeout, jiffies));
 	}
@@ -813,13 +886,18 @@ void ide_tune_drives(ide_hwif_t *hwif)
 /*
  * This routine only knows how to look for drive units 0 and 1
  * on an interface, so any setting of MAX_DRIVES > 2 won't work here.
+ *
+ * Finds the drives but does not tune them; sets hwif->probed if it
+ * got as far as looking.
  */
-void probe_hwif (ide_hwif_t *hwif)
+static void probe_hwif_drives (ide_hwif_t *hwif)
 {
 	unsigned int unit;
 	unsigned long flags;
 	unsigned int irqd;
+	unsigned long start = jiffies;
 
+	hwif->probed = 0;
 	if (hwif->noprobe)
 		return;
 #ifdef CONFIG_BLK_DEV_IDE
@@ -910,13 +988,98 @@ void probe_hwif (ide_hwif_t *hwif)
 	 */
 	if (irqd)
 		enable_irq(irqd);
-		
-	ide_tune_drives(hwif);
 
+	hwif->probe_time = jiffies - start;
+	hwif->probed = 1;
+	printk(KERN_INFO "%s: probed in %lu ms\n", hwif->name,
+		hwif->probe_time * 1000 / HZ);
+}
+
+void probe_hwif (ide_hwif_t *hwif)
+{
+	probe_hwif_drives(hwif);
+	if (hwif->probed)
+		ide_tune_drives(hwif);
 }
 
 EXPORT_SYMBOL(probe_hwif);
 
+#ifdef HWIF_PROBE_CLASSIC_METHOD
+/*
+ * Interfaces are probed side by side, one thread each, when nothing
+ * they do can get in each other's way: IRQ autoprobing must see only
+ * its own interrupt, and serialized or shared-port chipsets must not
+ * be talked to on both channels at once. ide=serialprobe turns it off.
+ */
+static int probe_can_overlap (ide_hwif_t *hwif)
+{
+	if (ide_serial_probe || hwif->noprobe || !hwif->irq)
+		return 0;
+	if (hwif->serialized || (hwif->mate && hwif->mate->serialized))
+		return 0;
+	switch (hwif->chipset) {
+		case ide_4drives:
+		case ide_pdc4030:
+		case ide_cmd640:
+			return 0;
+		default:
+			return 1;
+	}
+}
+
+static atomic_t probes_running;
+static DECLARE_WAIT_QUEUE_HEAD(probes_done);
+
+static int probe_thread (void *data)
+{
+	ide_hwif_t *hwif = (ide_hwif_t *) data;
+
+	daemonize();
+	sprintf(current->comm, "probe-%s", hwif->name);
+	probe_hwif_drives(hwif);
+	if (atomic_dec_and_test(&probes_running))
+		wake_up(&probes_done);
+	return 0;
+}
+
+static void probe_hwifs (int *probe)
+{
+	unsigned int index;
+	int overlap[MAX_HWIFS];
+
+	/* those that must be alone, one after the other */
+	for (index = 0; index < MAX_HWIFS; ++index) {
+		overlap[index] = probe[index] &&
+				 probe_can_overlap(&ide_hwifs[index]);
+		if (probe[index] && !overlap[index])
+			probe_hwif(&ide_hwifs[index]);
+	}
+
+	/* then the rest all at once */
+	atomic_set(&probes_running, 1);
+	for (index = 0; index < MAX_HWIFS; ++index) {
+		if (!overlap[index])
+			continue;
+		atomic_inc(&probes_running);
+		if (kernel_thread(probe_thread, &ide_hwifs[index],
+				  CLONE_FS | CLONE_FILES | CLONE_SIGHAND) < 0) {
+			atomic_dec(&probes_running);
+			probe_hwif_drives(&ide_hwifs[index]);
+		}
+	}
+	if (!atomic_dec_and_test(&probes_running))
+		wait_event(probes_done, atomic_read(&probes_running) == 0);
+
+	/*
+	 * Tuning does read-modify-write on chipset registers that are
+	 * often shared between channels, so it stays serial.
+	 */
+	for (index = 0; index < MAX_HWIFS; ++index)
+		if (overlap[index] && ide_hwifs[index].probed)
+			ide_tune_drives(&ide_hwifs[index]);
+}
+#endif /* HWIF_PROBE_CLASSIC_METHOD */
+
 #if 0
 int hwif_init (ide_hwif_t *hwif);
 int probe_hwif_init (ide_hwif_t *hwif)
@@ -1394,9 +1557,7 @@ int ideprobe_init (void)
 	 * Probe for drives in the usual way.. CMOS/BIOS, then poke at ports
 	 */
 #ifdef HWIF_PROBE_CLASSIC_METHOD
-	for (index = 0; index < MAX_HWIFS; ++index)
-		if (probe[index])
-			probe_hwif(&ide_hwifs[index]);
+	probe_hwifs(probe);
 
 	for (index = 0; index < MAX_HWIFS; ++index)
 		if (probe[index])
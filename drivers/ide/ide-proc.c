@@ -943,6 +943,43 @@ EXPORT_SYMBOL(ide_pci_register_host_proc);
 
 #endif /* CONFIG_BLK_DEV_IDEPCI */
 
+/*
+ * How long each interface took to probe, and the slots found empty in
+ * a form that can go on the next boot's command line.
+ */
+static int proc_ide_read_probe
+	(char *page, char **start, off_t off, int count, int *eof, void *data)
+{
+	char *out = page;
+	int len, index, unit, empty = 0;
+
+	for (index = 0; index < MAX_HWIFS; ++index) {
+		ide_hwif_t *hwif = &ide_hwifs[index];
+
+		if (hwif->probed)
+			out += sprintf(out, "%-5s %6lu ms\n", hwif->name,
+				       hwif->probe_time * 1000 / HZ);
+	}
+	for (index = 0; index < MAX_HWIFS; ++index) {
+		ide_hwif_t *hwif = &ide_hwifs[index];
+
+		if (!hwif->probed)
+			continue;
+		for (unit = 0; unit < MAX_DRIVES; ++unit) {
+			ide_drive_t *drive = &hwif->drives[unit];
+
+			if (drive->present || drive->noprobe)
+				continue;
+			out += sprintf(out, "%s%s=empty", empty++ ? " " : "",
+				       drive->name);
+		}
+	}
+	if (empty)
+		out += sprintf(out, "\n");
+	len = out - page;
+	PROC_IDE_READ_RETURN(page,start,off,count,eof,len);
+}
+
 void proc_ide_create(void)
 {
 #ifdef CONFIG_BLK_DEV_IDEPCI
@@ -956,6 +993,8 @@ void proc_ide_create(void)
 
 	create_proc_read_entry("drivers", 0, proc_ide_root,
 				proc_ide_read_drivers, NULL);
+	create_proc_read_entry("probe", 0, proc_ide_root,
+				proc_ide_read_probe, NULL);
 
 #ifdef CONFIG_BLK_DEV_IDEPCI
 	while (p != NULL)
@@ -983,6 +1022,7 @@ void proc_ide_destroy(void)
 			remove_proc_entry(p->name, p->parent);
 	}
 #endif /* CONFIG_BLK_DEV_IDEPCI */
+	remove_proc_entry("ide/probe", proc_ide_root);
 	remove_proc_entry("ide/drivers", proc_ide_root);
 	destroy_proc_ide_interfaces();
 	remove_proc_entry("ide", 0);
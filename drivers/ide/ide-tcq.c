@@ -0,0 +1,456 @@
+/*
+ *	IDE tagged command queueing
+ *
+ *	READ/WRITE DMA QUEUED support for disks that have it. Up to
+ *	queue_depth commands are handed to the drive, each under its own
+ *	tag; the drive releases the bus while it seeks and asks to be
+ *	serviced when it is ready to move the data for one of them.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ */
+
+/*
+ *	How it fits the hwgroup model: a queued command is taken off the
+ *	request queue as it is issued and parked in drive->tcq->tags[].
+ *	When the drive releases the bus, the handler returns ide_released:
+ *	hwgroup->busy is dropped so that ide_do_request() can issue more
+ *	commands, while the handler stays armed (hwgroup->released) for the
+ *	service interrupt. Only one tag moves data at a time, through the
+ *	interface's single PRD table, and it owns the bus while it does.
+ *
+ *	A drive aborts all its queued commands on any error, so on error
+ *	they all go back to the head of the queue, queueing is turned off
+ *	for the drive and it is reset; the plain command path then retries
+ *	them with its usual error handling. hdparm or /proc can turn
+ *	queueing back on.
+ *
+ *	Only a drive alone on its hwgroup is queued, and only on interfaces
+ *	with a generic bus-master DMA engine.
+ */
+
+#include <linux/config.h>
+#include <linux/module.h>
+#include <linux/types.h>
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/delay.h>
+#include <linux/blkdev.h>
+#include <linux/ide.h>
+
+#include <asm/io.h>
+#include <asm/bitops.h>
+
+#ifndef CONFIG_BLK_DEV_IDE_TCQ_DEPTH
+#define CONFIG_BLK_DEV_IDE_TCQ_DEPTH	8
+#endif
+
+/* 10us polls: the drive usually answers a command within this */
+#define TCQ_POLL	100
+
+static ide_startstop_t tcq_intr(ide_drive_t *drive);
+
+/*
+ * The timer only marks the timeout; ide_timer_expiry() then runs the
+ * handler, which decides from the drive's status.
+ */
+static int tcq_expiry (ide_drive_t *drive)
+{
+	drive->tcq->timedout = 1;
+	return 0;
+}
+
+static u8 tcq_poll_status (ide_drive_t *drive)
+{
+	ide_hwif_t *hwif = HWIF(drive);
+	int i;
+
+	for (i = 0; i < TCQ_POLL; i++) {
+		if (!(hwif->INB(IDE_ALTSTATUS_REG) & BUSY_STAT))
+			break;
+		udelay(10);
+	}
+	/* this read also acks the interrupt */
+	return hwif->INB(IDE_STATUS_REG);
+}
+
+/*
+ * The drive dropped all queued commands: put them back on the queue
+ * for the plain command path, and reset the drive.
+ */
+static ide_startstop_t tcq_error (ide_drive_t *drive, const char *msg, u8 stat)
+{
+	ide_tag_info_t *tcq = drive->tcq;
+	request_queue_t *q = &drive->queue;
+	unsigned long flags;
+	int tag, count = 0;
+
+	if (drive->waiting_for_dma)
+		(void) HWIF(drive)->ide_dma_end(drive);
+	(void) ide_dump_status(drive, msg, stat);
+
+	spin_lock_irqsave(&io_request_lock, flags);
+	for (tag = 0; tag < IDE_MAX_TAGS; tag++) {
+		struct request *rq = tcq->tags[tag];
+
+		if (rq == NULL)
+			continue;
+		tcq->tags[tag] = NULL;
+		rq->errors++;
+		list_add(&rq->queue, &q->queue_head);
+		count++;
+	}
+	tcq->tag_map = 0;
+	tcq->active = 0;
+	tcq->tag = -1;
+	tcq->timedout = 0;
+	tcq->fallbacks++;
+	drive->using_tcq = 0;
+	HWGROUP(drive)->rq = NULL;
+	spin_unlock_irqrestore(&io_request_lock, flags);
+
+	printk(KERN_ERR "%s: queueing turned off, retrying %d command%s\n",
+		drive->name, count, count == 1 ? "" : "s");
+	return ide_do_reset(drive);
+}
+
+static void tcq_end_request (ide_drive_t *drive, struct request *rq)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&io_request_lock, flags);
+	while (end_that_request_first(rq, 1, drive->name))
+		;
+	add_blkdev_randomness(MAJOR(rq->rq_dev));
+	end_that_request_last(rq);
+	spin_unlock_irqrestore(&io_request_lock, flags);
+}
+
+/*
+ * The drive has DRQ up for the tag in the sector count register.
+ */
+static ide_startstop_t tcq_start_dma (ide_drive_t *drive)
+{
+	ide_hwif_t *hwif = HWIF(drive);
+	ide_tag_info_t *tcq = drive->tcq;
+	int tag = hwif->INB(IDE_NSECTOR_REG) >> 3;
+	struct request *rq = tcq->tags[tag];
+
+	if (rq == NULL)
+		return tcq_error(drive, "tcq: bad tag", hwif->INB(IDE_STATUS_REG));
+	if (ide_start_dma(drive, rq, rq->cmd == READ))
+		return tcq_error(drive, "tcq: no DMA table", hwif->INB(IDE_STATUS_REG));
+
+	tcq->tag = tag;
+	HWGROUP(drive)->rq = rq;
+	ide_set_handler(drive, &tcq_intr, WAIT_CMD, &tcq_expiry);
+	(void) hwif->ide_dma_begin(drive);
+	return ide_started;
+}
+
+/*
+ * After a command, a transfer or a SERVICE: the drive either wants to
+ * move data now, wants to be serviced, or has released the bus.
+ */
+static ide_startstop_t tcq_next (ide_drive_t *drive)
+{
+	ide_hwif_t *hwif = HWIF(drive);
+	ide_hwgroup_t *hwgroup = HWGROUP(drive);
+	ide_tag_info_t *tcq = drive->tcq;
+	unsigned long flags;
+	u8 stat = tcq_poll_status(drive);
+
+	if (stat & BUSY_STAT) {
+		/* the release or completion interrupt will tell */
+		ide_set_handler(drive, &tcq_intr, WAIT_CMD, &tcq_expiry);
+		return ide_started;
+	}
+	if (stat & ERR_STAT)
+		return tcq_error(drive, "tcq", stat);
+	if (stat & DRQ_STAT)
+		return tcq_start_dma(drive);
+	if (stat & SRV_STAT) {
+		tcq->serviced++;
+		hwif->OUTB(WIN_QUEUED_SERVICE, IDE_COMMAND_REG);
+		stat = tcq_poll_status(drive);
+		if (stat & BUSY_STAT) {
+			ide_set_handler(drive, &tcq_intr, WAIT_CMD, &tcq_expiry);
+			return ide_started;
+		}
+		if ((stat & ERR_STAT) || !(stat & DRQ_STAT))
+			return tcq_error(drive, "tcq: service", stat);
+		return tcq_start_dma(drive);
+	}
+	if (!tcq->active)
+		return ide_stopped;
+
+	/* released: wait for the service interrupt */
+	tcq->released++;
+	spin_lock_irqsave(&io_request_lock, flags);
+	__ide_set_handler(drive, &tcq_intr, WAIT_WORSTCASE, &tcq_expiry);
+	hwgroup->released = 1;
+	spin_unlock_irqrestore(&io_request_lock, flags);
+	return ide_released;
+}
+
+static ide_startstop_t tcq_dma_done (ide_drive_t *drive)
+{
+	ide_hwif_t *hwif = HWIF(drive);
+	ide_tag_info_t *tcq = drive->tcq;
+	struct request *rq = tcq->tags[tcq->tag];
+	unsigned long flags;
+	u8 dma_stat, stat;
+
+	dma_stat = hwif->ide_dma_end(drive);
+	stat = hwif->INB(IDE_ALTSTATUS_REG);
+	if (dma_stat || (stat & (ERR_STAT|DRQ_STAT)))
+		return tcq_error(drive, "tcq: dma_intr", stat);
+
+	spin_lock_irqsave(&io_request_lock, flags);
+	tcq->tags[tcq->tag] = NULL;
+	clear_bit(tcq->tag, &tcq->tag_map);
+	tcq->active--;
+	tcq->tag = -1;
+	HWGROUP(drive)->rq = NULL;
+	spin_unlock_irqrestore(&io_request_lock, flags);
+
+	tcq_end_request(drive, rq);
+	return tcq_next(drive);
+}
+
+static ide_startstop_t tcq_intr (ide_drive_t *drive)
+{
+	ide_hwif_t *hwif = HWIF(drive);
+	ide_tag_info_t *tcq = drive->tcq;
+
+	if (tcq->timedout) {
+		tcq->timedout = 0;
+		if (drive->waiting_for_dma) {
+			if (!(hwif->INB(hwif->dma_status) & 4))
+				return tcq_error(drive, "tcq: DMA timeout",
+					hwif->INB(IDE_ALTSTATUS_REG));
+		} else {
+			u8 stat = hwif->INB(IDE_ALTSTATUS_REG);
+
+			if ((stat & BUSY_STAT) || !(stat & (SRV_STAT|DRQ_STAT)))
+				return tcq_error(drive, "tcq: timeout", stat);
+		}
+		printk(KERN_ERR "%s: lost interrupt\n", drive->name);
+	}
+	if (drive->waiting_for_dma)
+		return tcq_dma_done(drive);
+	return tcq_next(drive);
+}
+
+/**
+ *	ide_tcq_do_rw	-	issue a queued read or write
+ *	@drive: drive to issue on
+ *	@rq: READ or WRITE request at the head of the queue
+ *	@block: first sector
+ *
+ *	Takes @rq off the queue under a free tag and sends it. Only called
+ *	when ide_tcq_blocked() said a tag is free and the drive's bus is
+ *	ours.
+ */
+
+ide_startstop_t ide_tcq_do_rw (ide_drive_t *drive, struct request *rq, unsigned long block)
+{
+	ide_hwif_t *hwif = HWIF(drive);
+	ide_tag_info_t *tcq = drive->tcq;
+	unsigned long flags;
+	ide_startstop_t startstop;
+	u8 command;
+	int tag;
+
+	spin_lock_irqsave(&io_request_lock, flags);
+	tag = ffz(tcq->tag_map);
+	__set_bit(tag, &tcq->tag_map);
+	tcq->tags[tag] = rq;
+	tcq->active++;
+	tcq->issued++;
+	tcq->depth_sum += tcq->active;
+	tcq->depth_hist[tcq->active - 1]++;
+	blkdev_dequeue_request(rq);
+	HWGROUP(drive)->rq = NULL;
+	spin_unlock_irqrestore(&io_request_lock, flags);
+
+	hwif->OUTB(drive->ctl, IDE_CONTROL_REG);
+	if (drive->addressing == 1) {
+		hwif->OUTB(rq->nr_sectors >> 8, IDE_FEATURE_REG);
+		hwif->OUTB(0, IDE_NSECTOR_REG);
+		hwif->OUTB(block >> 24, IDE_SECTOR_REG);
+		hwif->OUTB(0, IDE_LCYL_REG);
+		hwif->OUTB(0, IDE_HCYL_REG);
+
+		hwif->OUTB(rq->nr_sectors, IDE_FEATURE_REG);
+		hwif->OUTB(tag << 3, IDE_NSECTOR_REG);
+		hwif->OUTB(block, IDE_SECTOR_REG);
+		hwif->OUTB(block >> 8, IDE_LCYL_REG);
+		hwif->OUTB(block >> 16, IDE_HCYL_REG);
+		hwif->OUTB(drive->select.all, IDE_SELECT_REG);
+		command = (rq->cmd == READ) ?
+			WIN_READDMA_QUEUED_EXT : WIN_WRITEDMA_QUEUED_EXT;
+	} else {
+		hwif->OUTB(rq->nr_sectors, IDE_FEATURE_REG);
+		hwif->OUTB(tag << 3, IDE_NSECTOR_REG);
+		hwif->OUTB(block, IDE_SECTOR_REG);
+		hwif->OUTB(block >> 8, IDE_LCYL_REG);
+		hwif->OUTB(block >> 16, IDE_HCYL_REG);
+		hwif->OUTB(((block >> 24) & 0x0f) | drive->select.all, IDE_SELECT_REG);
+		command = (rq->cmd == READ) ?
+			WIN_READDMA_QUEUED : WIN_WRITEDMA_QUEUED;
+	}
+	hwif->OUTB(command, IDE_COMMAND_REG);
+
+	startstop = tcq_next(drive);
+	if (startstop == ide_started && tcq->tag == tag)
+		tcq->immediate++;
+	return startstop;
+}
+
+EXPORT_SYMBOL(ide_tcq_do_rw);
+
+/**
+ *	ide_tcq_blocked	-	can the drive take its next request now
+ *	@drive: drive with a non-empty queue
+ *
+ *	With queued commands out, the drive can only be given more queued
+ *	commands, and only while tags are free: anything else would abort
+ *	the ones it holds. Called with io_request_lock held.
+ */
+
+int ide_tcq_blocked (ide_drive_t *drive)
+{
+	ide_tag_info_t *tcq = drive->tcq;
+	struct request *rq;
+
+	if (tcq == NULL || !tcq->active)
+		return 0;
+	if (!drive->using_tcq || !drive->using_dma || drive->special.all)
+		return 1;
+	if (tcq->active >= tcq->queue_depth)
+		return 1;
+	rq = blkdev_entry_next_request(&drive->queue.queue_head);
+	return rq->cmd != READ && rq->cmd != WRITE;
+}
+
+/**
+ *	ide_tcq_rearm	-	wait for service again
+ *	@drive: drive whose request start just stopped
+ *
+ *	ide_do_request() takes the service handler down to start a request;
+ *	if that request ended without reaching the drive, the queued
+ *	commands still need a handler. Called with io_request_lock held.
+ */
+
+void ide_tcq_rearm (ide_drive_t *drive)
+{
+	ide_hwgroup_t *hwgroup = HWGROUP(drive);
+
+	if (drive->tcq == NULL || !drive->tcq->active || hwgroup->handler != NULL)
+		return;
+	__ide_set_handler(drive, &tcq_intr, WAIT_CMD, &tcq_expiry);
+	hwgroup->released = 1;
+}
+
+/**
+ *	ide_tcq_enable	-	turn queueing on or off
+ *	@drive: drive set up by ide_tcq_init()
+ *	@on: 1 to queue
+ *
+ *	Turning it on enables the release and service interrupts on the
+ *	drive. Turning it off lets the commands already out finish.
+ *	Returns 0 on success, 1 if the drive cannot queue now.
+ */
+
+int ide_tcq_enable (ide_drive_t *drive, int on)
+{
+	u8 features[2] = { SETFEATURES_EN_RI, SETFEATURES_EN_SI };
+	ide_task_t args;
+	int i;
+
+	if (!on) {
+		drive->using_tcq = 0;
+		return 0;
+	}
+	if (drive->tcq == NULL || !drive->using_dma)
+		return 1;
+
+	for (i = 0; i < 2; i++) {
+		memset(&args, 0, sizeof(ide_task_t));
+		args.tfRegister[IDE_FEATURE_OFFSET]	= features[i];
+		args.tfRegister[IDE_COMMAND_OFFSET]	= WIN_SETFEATURES;
+		args.command_type			= ide_cmd_type_parser(&args);
+		if (ide_raw_taskfile(drive, &args, NULL)) {
+			printk(KERN_ERR "%s: drive refused queueing interrupts\n",
+				drive->name);
+			return 1;
+		}
+	}
+	drive->using_tcq = 1;
+	return 0;
+}
+
+EXPORT_SYMBOL(ide_tcq_enable);
+
+/**
+ *	ide_tcq_init	-	set up queueing for a disk
+ *	@drive: disk being attached
+ *
+ *	Allocates drive->tcq if the drive and its interface can queue.
+ *	Queueing itself is turned on by ide_tcq_enable().
+ */
+
+void ide_tcq_init (ide_drive_t *drive)
+{
+	ide_hwif_t *hwif = HWIF(drive);
+	struct hd_driveid *id = drive->id;
+	ide_tag_info_t *tcq;
+
+	if (drive->tcq != NULL || id == NULL || !drive->id_read)
+		return;
+	if ((id->command_set_2 & 0xc002) != 0x4002 ||
+	    (id->command_set_1 & 0x0180) != 0x0180)
+		return;
+	if (!hwif->dma_base || !IDE_CONTROL_REG || hwif->rw_disk != NULL ||
+	    !drive->select.b.lba)
+		return;
+	if (drive->next != drive) {
+		printk(KERN_INFO "%s: not queueing, %s is shared\n",
+			drive->name, hwif->name);
+		return;
+	}
+
+	tcq = kmalloc(sizeof(ide_tag_info_t), GFP_KERNEL);
+	if (tcq == NULL)
+		return;
+	memset(tcq, 0, sizeof(ide_tag_info_t));
+	tcq->max_depth = (id->queue_depth & 0x1f) + 1;
+	tcq->queue_depth = IDE_MIN(tcq->max_depth, CONFIG_BLK_DEV_IDE_TCQ_DEPTH);
+	if (tcq->queue_depth < 1)
+		tcq->queue_depth = 1;
+	tcq->tag = -1;
+	drive->tcq = tcq;
+	printk(KERN_INFO "%s: tagged command queueing, depth %d/%d\n",
+		drive->name, tcq->queue_depth, tcq->max_depth);
+}
+
+EXPORT_SYMBOL(ide_tcq_init);
+
+void ide_tcq_exit (ide_drive_t *drive)
+{
+	drive->using_tcq = 0;
+	if (drive->tcq != NULL) {
+		kfree(drive->tcq);
+		drive->tcq = NULL;
+	}
+}
+
+EXPORT_SYMBOL(ide_tcq_exit);
@@ -182,6 +182,10 @@ int noautodma = 1;
 
 EXPORT_SYMBOL(noautodma);
 
+int ide_serial_probe;		/* "ide=serialprobe": one interface at a time */
+
+EXPORT_SYMBOL(ide_serial_probe);
+
 
 /*
  * ide_modules keeps track of the available IDE chipset/probe/driver modules.
@@ -2089,6 +2093,9 @@ static int __init match_parm (char *s, const char *keywords[], int vals[], int m
  * "hdx=scsi"		: the return of the ide-scsi flag, this is useful for
  *				allowwing ide-floppy, ide-tape, and ide-cdrom|writers
  *				to use ide-scsi emulation on a device specific option.
+ * "hdx=empty"		: the slot was empty last time: unless a quick look
+ *				finds a drive there now, skip the full probe.
+ *				/proc/ide/probe lists these for the current boot.
  * "idebus=xx"		: inform IDE driver of VESA/PCI bus speed in MHz,
  *				where "xx" is between 20 and 66 inclusive,
  *				used when tuning chipset PIO modes.
@@ -2122,6 +2129,7 @@ static int __init match_parm (char *s, const char *keywords[], int vals[], int m
  *				the ablity to bit test for detection is
  *				currently unknown.
  * "ide=reverse"	: Formerly called to pci sub-system, but now local.
+ * "ide=serialprobe"	: probe one interface at a time, not all at once
  *
  * The following are valid ONLY on ide0, (except dc4030)
  * and the defaults for the base,ctl ports must not be altered.
@@ -2173,6 +2181,12 @@ int __init ide_setup (char *s)
 		return 1;
 	}
 
+	if (!strcmp(s, "ide=serialprobe")) {
+		printk(" : Probing interfaces one at a time\n");
+		ide_serial_probe = 1;
+		return 1;
+	}
+
 #ifdef CONFIG_BLK_DEV_IDEPCI
 	if (!strcmp(s, "ide=reverse")) {
 		ide_scan_direction = 1;
@@ -2188,7 +2202,7 @@ int __init ide_setup (char *s)
 		const char *hd_words[] = {"none", "noprobe", "nowerr", "cdrom",
 				"serialize", "autotune", "noautotune",
 				"slow", "swapdata", "bswap", "flash",
-				"remap", "noremap", "scsi", NULL};
+				"remap", "noremap", "scsi", "empty", NULL};
 		unit = s[2] - 'a';
 		hw   = unit / MAX_DRIVES;
 		unit = unit % MAX_DRIVES;
@@ -2254,6 +2268,9 @@ int __init ide_setup (char *s)
 			case -14: /* "scsi" */
 				drive->scsi = 1;
 				goto done;
+			case -15: /* "empty" */
+				drive->probe_empty = 1;
+				goto done;
 			case 3: /* cyl,head,sect */
 				drive->media	= ide_disk;
 				drive->cyl	= drive->bios_cyl  = vals[0];
@@ -403,6 +403,23 @@ static void raid1_end_bh_io (struct raid1_bh *r1_bh, int uptodate)
 	bh->b_end_io(bh, uptodate);
 	raid1_free_r1bh(r1_bh);
 }
+/*
+ * Drop the in-flight count charged by raid1_read_balance().  The count
+ * belongs to the slot index recorded at submit time; raid1_diskop()
+ * leaves nr_pending with the slot when it swaps or adds disks, so the
+ * charge can always be dropped here.
+ */
+static inline void raid1_read_done (struct raid1_bh *r1_bh)
+{
+	raid1_conf_t *conf = mddev_to_conf(r1_bh->mddev);
+	int disk = r1_bh->read_disk;
+
+	if (disk < 0)
+		return;
+	r1_bh->read_disk = -1;
+	atomic_dec(&conf->mirrors[disk].nr_pending);
+}
+
 void raid1_end_request (struct buffer_head *bh, int uptodate)
 {
 	struct raid1_bh * r1_bh = (struct raid1_bh *)(bh->b_private);
@@ -433,7 +450,8 @@ void raid1_end_request (struct buffer_head *bh, int uptodate)
 		/*
 		 * we have only one buffer_head on the read side
 		 */
-		
+		raid1_read_done(r1_bh);
+
 		if (uptodate) {
 			raid1_end_bh_io(r1_bh, uptodate);
 			return;
@@ -460,114 +478,101 @@ void raid1_end_request (struct buffer_head *bh, int uptodate)
 
 /*
  * This routine returns the disk from which the requested read should
- * be done. It bookkeeps the last read position for every disk
- * in array and when new read requests come, the disk which last
- * position is nearest to the request, is chosen.
+ * be done, and charges the read to that disk's in-flight count.
  *
- * TODO: now if there are 2 mirrors in the same 2 devices, performance
- * degrades dramatically because position is mirror, not device based.
- * This should be changed to be device based. Also atomic sequential
- * reads should be somehow balanced.
+ * A read that continues where a mirror's head was left is kept on that
+ * mirror (stream affinity) until the run has covered sect_limit sectors;
+ * the next chunk of the stream is then handed to the least busy other
+ * mirror, so large sequential readers end up spread across the mirrors.
+ * Everything else goes to the mirror with the fewest reads in flight,
+ * ties being broken by the nearest head position.
  */
 
+static inline int raid1_readable (struct mirror_info *mirror)
+{
+	return mirror->operational && !mirror->write_only;
+}
+
 static int raid1_read_balance (raid1_conf_t *conf, struct buffer_head *bh)
 {
-	int new_disk = conf->last_used;
 	const int sectors = bh->b_size >> 9;
 	const unsigned long this_sector = bh->b_rsector;
-	int disk = new_disk;
-	unsigned long new_distance;
-	unsigned long current_distance;
-	
+	struct mirror_info *mirror;
+	int disk, new_disk = -1, seq_disk = -1;
+	int pending, best_pending = 0;
+	unsigned long distance, best_distance = 0;
+	unsigned long flags;
+
+	md_spin_lock_irqsave(&conf->device_lock, flags);
+
 	/*
 	 * Check if it is sane at all to balance
 	 */
-	
-	if (conf->resync_mirrors)
+	if (conf->resync_mirrors) {
+		new_disk = conf->last_used;
 		goto rb_out;
-	
-
-	/* make sure that disk is operational */
-	while( !conf->mirrors[new_disk].operational) {
-		if (new_disk <= 0) new_disk = conf->raid_disks;
-		new_disk--;
-		if (new_disk == disk) {
-			/*
-			 * This means no working disk was found
-			 * Nothing much to do, lets not change anything
-			 * and hope for the best...
-			 */
-			
-			new_disk = conf->last_used;
+	}
 
-			goto rb_out;
+	for (disk = 0; disk < conf->raid_disks; disk++) {
+		mirror = conf->mirrors + disk;
+		if (raid1_readable(mirror) &&
+		    this_sector == mirror->head_position) {
+			seq_disk = disk;
+			break;
 		}
 	}
-	disk = new_disk;
-	/* now disk == new_disk == starting point for search */
-	
-	/*
-	 * Don't touch anything for sequential reads.
-	 */
-
-	if (this_sector == conf->mirrors[new_disk].head_position)
-		goto rb_out;
-	
-	/*
-	 * If reads have been done only on a single disk
-	 * for a time, lets give another disk a change.
-	 * This is for kicking those idling disks so that
-	 * they would find work near some hotspot.
-	 */
-	
-	if (conf->sect_count >= conf->mirrors[new_disk].sect_limit) {
-		conf->sect_count = 0;
-
-#if defined(CONFIG_SPARC64) && (__GNUC__ == 2) && (__GNUC_MINOR__ == 92)
-		/* Work around a compiler bug in egcs-2.92.11 19980921 */
-		new_disk = *(volatile int *)&new_disk;
-#endif
-		do {
-			if (new_disk<=0)
-				new_disk = conf->raid_disks;
-			new_disk--;
-			if (new_disk == disk)
-				break;
-		} while ((conf->mirrors[new_disk].write_only) ||
-			 (!conf->mirrors[new_disk].operational));
 
+	if (seq_disk >= 0 && conf->mirrors[seq_disk].seq_count <
+				conf->mirrors[seq_disk].sect_limit) {
+		new_disk = seq_disk;
 		goto rb_out;
 	}
-	
-	current_distance = abs(this_sector -
-				conf->mirrors[disk].head_position);
-	
-	/* Find the disk which is closest */
-	
-	do {
-		if (disk <= 0)
-			disk = conf->raid_disks;
-		disk--;
-		
-		if ((conf->mirrors[disk].write_only) ||
-				(!conf->mirrors[disk].operational))
+
+	for (disk = 0; disk < conf->raid_disks; disk++) {
+		mirror = conf->mirrors + disk;
+		if (!raid1_readable(mirror) || disk == seq_disk)
 			continue;
-		
-		new_distance = abs(this_sector -
-					conf->mirrors[disk].head_position);
-		
-		if (new_distance < current_distance) {
-			conf->sect_count = 0;
-			current_distance = new_distance;
+		pending = atomic_read(&mirror->nr_pending);
+		distance = abs(this_sector - mirror->head_position);
+		if (new_disk < 0 || pending < best_pending ||
+		    (pending == best_pending && distance < best_distance)) {
 			new_disk = disk;
+			best_pending = pending;
+			best_distance = distance;
 		}
-	} while (disk != conf->last_used);
+	}
+
+	/*
+	 * Nobody to hand the stream over to, keep it where it is.
+	 */
+	if (new_disk < 0)
+		new_disk = seq_disk;
+
+	if (new_disk < 0) {
+		/*
+		 * This means no working disk was found
+		 * Nothing much to do, lets not change anything
+		 * and hope for the best...
+		 */
+		new_disk = conf->last_used;
+	}
 
 rb_out:
-	conf->mirrors[new_disk].head_position = this_sector + sectors;
+	mirror = conf->mirrors + new_disk;
+	if (new_disk == seq_disk)
+		mirror->seq_count += sectors;
+	else {
+		if (seq_disk >= 0)
+			conf->mirrors[seq_disk].seq_count = 0;
+		mirror->seq_count = sectors;
+	}
+	mirror->head_position = this_sector + sectors;
+	mirror->reads++;
+	mirror->read_sectors += sectors;
+	atomic_inc(&mirror->nr_pending);
 
 	conf->last_used = new_disk;
-	conf->sect_count += sectors;
+	md_spin_unlock_irqrestore(&conf->device_lock, flags);
 
 	return new_disk;
 }
@@ -619,12 +624,14 @@ static int raid1_make_request (mddev_t *mddev, int rw,
 	r1_bh->master_bh = bh;
 	r1_bh->mddev = mddev;
 	r1_bh->cmd = rw;
+	r1_bh->read_disk = -1;
 
 	if (rw == READ) {
 		/*
 		 * read balancing logic:
 		 */
-		mirror = conf->mirrors + raid1_read_balance(conf, bh);
+		r1_bh->read_disk = raid1_read_balance(conf, bh);
+		mirror = conf->mirrors + r1_bh->read_disk;
 
 		bh_req = &r1_bh->bh_req;
 		memcpy(bh_req, bh, sizeof(*bh));
@@ -730,6 +737,21 @@ static void raid1_status(struct seq_file *seq, mddev_t *mddev)
 		seq_printf(seq, "%s",
 			conf->mirrors[i].operational ? "U" : "_");
 	seq_printf(seq, "]");
+
+	/*
+	 * per-mirror read counters: requests/sectors(in flight)
+	 */
+	seq_printf(seq, "\n      reads:");
+	for (i = 0; i < conf->raid_disks; i++) {
+		struct mirror_info *mirror = conf->mirrors + i;
+
+		if (!mirror->used_slot || mirror->dev == MKDEV(0,0))
+			continue;
+		seq_printf(seq, " %s=%lu/%lu(%d)",
+			partition_name(mirror->dev), mirror->reads,
+			mirror->read_sectors,
+			atomic_read(&mirror->nr_pending));
+	}
 }
 
 #define LAST_DISK KERN_ALERT \
@@ -1062,6 +1084,11 @@ static int raid1_diskop(mddev_t *mddev, mdp_disk_t **d, int state)
 		xchg_values(sdisk->raid_disk, fdisk->raid_disk);
 		xchg_values(spare_desc->number, failed_desc->number);
 		xchg_values(sdisk->number, fdisk->number);
+		/*
+		 * reads still in flight were charged to the slot index,
+		 * so the pending counts stay with the slots.
+		 */
+		xchg_values(sdisk->nr_pending, fdisk->nr_pending);
 
 		*d = failed_desc;
 
@@ -1115,6 +1142,12 @@ static int raid1_diskop(mddev_t *mddev, mdp_disk_t **d, int state)
 		adisk->spare = 1;
 		adisk->used_slot = 1;
 		adisk->head_position = 0;
+		adisk->seq_count = 0;
+		adisk->reads = adisk->read_sectors = 0;
+		/*
+		 * nr_pending is left alone: reads issued before the slot
+		 * was emptied may still be completing against it.
+		 */
 		conf->nr_disks++;
 
 		break;
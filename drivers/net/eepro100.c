@@ -44,10 +44,10 @@ static int rxdmacount /* = 0 */;
 #if defined(__ia64__) || defined(__alpha__) || defined(__sparc__) || \
 	defined(__mips__) || defined(__arm__) || defined(__hppa__)
   /* align rx buffers to 2 bytes so that IP header is aligned */
-# define rx_align(skb)		skb_reserve((skb), 2)
+# define RX_ALIGN		2
 # define RxFD_ALIGNMENT		__attribute__ ((aligned (2), packed))
 #else
-# define rx_align(skb)
+# define RX_ALIGN		0
 # define RxFD_ALIGNMENT
 #endif
 
@@ -55,9 +55,6 @@ static int rxdmacount /* = 0 */;
    Lower values use more memory, but are faster. */
 static int rx_copybreak = 200;
 
-/* Maximum events (Rx packets, etc.) to handle at each interrupt. */
-static int max_interrupt_work = 20;
-
 /* Maximum number of multicast addresses to filter (vs. rx-all-multicast) */
 static int multicast_filter_limit = 64;
 
@@ -119,12 +116,22 @@ static int options[] = {-1, -1, -1, -1, -1, -1, -1, -1};
 #include <linux/skbuff.h>
 #include <linux/ethtool.h>
 #include <linux/mii.h>
+#include <linux/rxpool.h>
 
 /* enable PIO instead of MMIO, if CONFIG_EEPRO100_PIO is selected */
 #ifdef CONFIG_EEPRO100_PIO
 #define USE_IO 1
 #endif
 
+#ifdef CONFIG_EEPRO100_NAPI
+/* Rx polling weight (packets per poll round), per board and default. */
+static int rx_weight[] = {-1, -1, -1, -1, -1, -1, -1, -1};
+#define SPEEDO_NAPI_WEIGHT	16
+#else
+/* Maximum events (Rx packets, etc.) to handle at each interrupt. */
+static int max_interrupt_work = 20;
+#endif
+
 static int debug = -1;
 #define DEBUG_DEFAULT		(NETIF_MSG_DRV		| \
 				 NETIF_MSG_HW		| \
@@ -145,7 +152,11 @@ MODULE_PARM(rxfifo, "i");
 MODULE_PARM(txdmacount, "i");
 MODULE_PARM(rxdmacount, "i");
 MODULE_PARM(rx_copybreak, "i");
+#ifdef CONFIG_EEPRO100_NAPI
+MODULE_PARM(rx_weight, "1-" __MODULE_STRING(8) "i");
+#else
 MODULE_PARM(max_interrupt_work, "i");
+#endif
 MODULE_PARM(multicast_filter_limit, "i");
 MODULE_PARM_DESC(debug, "debug level (0-6)");
 MODULE_PARM_DESC(options, "Bits 0-3: tranceiver type, bit 4: full duplex, bit 5: 100Mbps");
@@ -156,7 +167,11 @@ MODULE_PARM_DESC(rxfifo, "Rx FIFO threshold in 4 byte units, (0-15)");
 MODULE_PARM_DESC(txdmaccount, "Tx DMA burst length; 128 - disable (0-128)");
 MODULE_PARM_DESC(rxdmaccount, "Rx DMA burst length; 128 - disable (0-128)");
 MODULE_PARM_DESC(rx_copybreak, "copy breakpoint for copy-only-tiny-frames");
+#ifdef CONFIG_EEPRO100_NAPI
+MODULE_PARM_DESC(rx_weight, "Rx packets handled per poll round");
+#else
 MODULE_PARM_DESC(max_interrupt_work, "maximum events handled per interrupt");
+#endif
 MODULE_PARM_DESC(multicast_filter_limit, "maximum number of filtered multicast addresses");
 
 #define RUN_AT(x) (jiffies + (x))
@@ -233,6 +248,14 @@ speedo_private data structure for each adapter instance.
 The newer i82558 explicitly supports this structure, and can read the two
 TxBDs in the same PCI burst as the TxCB.
 
+The device advertises scatter-gather, so the TxBDs appended to each TxCB are
+really an array of MAX_SKB_FRAGS+1 entries: the linear part of the skbuff
+goes in the first one and every page fragment in one of its own.  Both chip
+generations are run with the standard (not extended) TxCB, so the whole
+array is fetched through tx_desc_addr.  None of the chips supported here
+can checksum on transmit, so no checksum offload is advertised: TCP still
+builds paged skbuffs for us, checksumming the data as it copies it.
+
 This ring structure is used for all normal transmit packets, but the
 transmit packet descriptors aren't long enough for most non-Tx commands such
 as CmdConfigure.  This is complicated by the possibility that the chip has
@@ -287,6 +310,17 @@ allocate a new, minimally-sized skbuff.  For large frames the copying cost
 is non-trivial, and the larger copy might flush the cache of useful data, so
 we pass up the skbuff the packet was received into.
 
+Receive buffers come from a per-device skb_rx_pool (see linux/rxpool.h).
+They stay DMA mapped while the stack holds them, and kfree_skb() hands
+them back to the pool, so a refill normally costs neither an allocation
+nor a new mapping.  /proc/net/rx_pool shows the recycle hit rate.
+
+With CONFIG_EEPRO100_NAPI the interrupt handler only masks the chip and
+schedules speedo_poll().  The poll routine reaps at most dev->quota frames
+per round, refills the ring as it goes, scavenges the Tx ring and unmasks
+interrupts once the Rx ring is drained.  A receive storm thus degrades into
+polling from softirq context instead of livelocking in the interrupt handler.
+
 IV. Notes
 
 Thanks to Steve Williams of Intel for arranging the non-disclosure agreement
@@ -404,17 +438,19 @@ enum RxFD_bits {
 };
 
 #define CONFIG_DATA_SIZE 22
+struct TxBD {					/* Transmit buffer descriptor. */
+	u32 addr;					/* void *, frame data to be transmitted. */
+	s32 size;					/* Length of this piece. */
+};
+
 struct TxFD {					/* Transmit frame descriptor set. */
 	s32 status;
 	u32 link;					/* void * */
-	u32 tx_desc_addr;			/* Always points to the tx_buf_addr element. */
-	s32 count;					/* # of TBD (=1), Tx start thresh., etc. */
-	/* This constitutes two "TBD" entries -- we only use one. */
+	u32 tx_desc_addr;			/* Always points to the tbd[] array. */
+	s32 count;					/* # of TBD, Tx start thresh., etc. */
+	/* One TBD for the linear data, one per page fragment. */
 #define TX_DESCR_BUF_OFFSET 16
-	u32 tx_buf_addr0;			/* void *, frame to be transmitted.  */
-	s32 tx_buf_size0;			/* Length of Tx frame. */
-	u32 tx_buf_addr1;			/* void *, frame to be transmitted.  */
-	s32 tx_buf_size1;			/* Length of Tx frame. */
+	struct TxBD tbd[MAX_SKB_FRAGS + 1];
 	/* the structure must have space for at least CONFIG_DATA_SIZE starting
 	 * from tx_desc_addr field */
 };
@@ -464,6 +500,7 @@ struct speedo_private {
 	/* The addresses of a Tx/Rx-in-place packets/buffers. */
 	struct sk_buff *tx_skbuff[TX_RING_SIZE];
 	struct sk_buff *rx_skbuff[RX_RING_SIZE];
+	struct skb_rx_pool *rx_pool;		/* Pre-mapped Rx buffers. */
 	/* Mapped addresses of the rings. */
 	dma_addr_t tx_ring_dma;
 #define TX_RING_ELEM_DMA(sp, n) ((sp)->tx_ring_dma + (n)*sizeof(struct TxFD))
@@ -496,6 +533,9 @@ struct speedo_private {
 	unsigned short partner;			/* Link partner caps. */
 	struct mii_if_info mii_if;		/* MII API hooks, info */
 	u32 msg_enable;				/* debug message level */
+#ifdef CONFIG_EEPRO100_NAPI
+	struct tq_struct reset_task;		/* Tx timeout recovery. */
+#endif
 #ifdef CONFIG_PM
 	u32 pm_state[16];
 #endif
@@ -510,7 +550,7 @@ static const char i82557_config_cmd[CONFIG_DATA_SIZE] = {
 	0xf2, 0x48,   0, 0x40, 0xf2, 0x80, 		/* 0x40=Force full-duplex */
 	0x3f, 0x05, };
 static const char i82558_config_cmd[CONFIG_DATA_SIZE] = {
-	22, 0x08, 0, 1,  0, 0, 0x22, 0x03,  1, /* 1=Use MII  0=Use AUI */
+	22, 0x08, 0, 1,  0, 0, 0x32, 0x03,  1, /* 1=Use MII  0=Use AUI */
 	0, 0x2E, 0,  0x60, 0x08, 0x88,
 	0x68, 0, 0x40, 0xf2, 0x84,		/* Disable FC */
 	0x31, 0x05, };
@@ -540,9 +580,13 @@ static void speedo_init_rx_ring(struct net_device *dev);
 static void speedo_tx_timeout(struct net_device *dev);
 static int speedo_start_xmit(struct sk_buff *skb, struct net_device *dev);
 static void speedo_refill_rx_buffers(struct net_device *dev, int force);
-static int speedo_rx(struct net_device *dev);
+static int speedo_rx(struct net_device *dev, int limit);
 static void speedo_tx_buffer_gc(struct net_device *dev);
 static void speedo_interrupt(int irq, void *dev_instance, struct pt_regs *regs);
+#ifdef CONFIG_EEPRO100_NAPI
+static int speedo_poll(struct net_device *dev, int *budget);
+static void speedo_reset_task(void *data);
+#endif
 static int speedo_close(struct net_device *dev);
 static struct net_device_stats *speedo_get_stats(struct net_device *dev);
 static int speedo_ioctl(struct net_device *dev, struct ifreq *rq, int cmd);
@@ -875,10 +919,19 @@ static int __devinit speedo_found1(struct pci_dev *pdev,
 	dev->open = &speedo_open;
 	dev->hard_start_xmit = &speedo_start_xmit;
 	netif_set_tx_timeout(dev, &speedo_tx_timeout, TX_TIMEOUT);
+	dev->features |= NETIF_F_SG;
 	dev->stop = &speedo_close;
 	dev->get_stats = &speedo_get_stats;
 	dev->set_multicast_list = &set_rx_mode;
 	dev->do_ioctl = &speedo_ioctl;
+#ifdef CONFIG_EEPRO100_NAPI
+	dev->poll = &speedo_poll;
+	if (card_idx >= 0 && card_idx < 8 && rx_weight[card_idx] > 0)
+		dev->weight = rx_weight[card_idx];
+	else
+		dev->weight = SPEEDO_NAPI_WEIGHT;
+	INIT_TQUEUE(&sp->reset_task, speedo_reset_task, dev);
+#endif
 
 	return 0;
 }
@@ -996,9 +1049,19 @@ speedo_open(struct net_device *dev)
 	sp->tx_full = 0;
 	sp->in_interrupt = 0;
 
+	/* Rx buffers are the RxFD followed by the frame, mapped as one.  The
+	   RxFD is written by us as well as by the chip. */
+	sp->rx_pool = skb_rx_pool_create(dev, sp->pdev,
+			PKT_BUF_SZ + sizeof(struct RxFD), RX_ALIGN,
+			RX_RING_SIZE, rx_copybreak, PCI_DMA_BIDIRECTIONAL);
+	if (sp->rx_pool == NULL)
+		return -ENOMEM;
+
 	/* .. we can safely take handler calls during init. */
 	retval = request_irq(dev->irq, &speedo_interrupt, SA_SHIRQ, dev->name, dev);
 	if (retval) {
+		skb_rx_pool_destroy(sp->rx_pool);
+		sp->rx_pool = NULL;
 		return retval;
 	}
 
@@ -1279,18 +1342,14 @@ speedo_init_rx_ring(struct net_device *dev)
 
 	for (i = 0; i < RX_RING_SIZE; i++) {
 		struct sk_buff *skb;
-		skb = dev_alloc_skb(PKT_BUF_SZ + sizeof(struct RxFD));
-		/* XXX: do we really want to call this before the NULL check? --hch */
-		rx_align(skb);			/* Align IP on 16 byte boundary */
+		skb = skb_rx_pool_alloc(sp->rx_pool, GFP_KERNEL);
 		sp->rx_skbuff[i] = skb;
 		if (skb == NULL)
 			break;			/* OK.  Just initially short of Rx bufs. */
 		skb->dev = dev;			/* Mark as being used by this device. */
 		rxf = (struct RxFD *)skb->tail;
 		sp->rx_ringp[i] = rxf;
-		sp->rx_ring_dma[i] =
-			pci_map_single(sp->pdev, rxf,
-					PKT_BUF_SZ + sizeof(struct RxFD), PCI_DMA_BIDIRECTIONAL);
+		sp->rx_ring_dma[i] = skb->rx_dma;
 		skb_reserve(skb, sizeof(struct RxFD));
 		if (last_rxf) {
 			last_rxf->link = cpu_to_le32(sp->rx_ring_dma[i]);
@@ -1316,6 +1375,20 @@ speedo_init_rx_ring(struct net_device *dev)
 	sp->last_rxf_dma = last_rxf_dma;
 }
 
+/* Release the DMA mappings of the frame queued in Tx ring slot entry. */
+static void speedo_unmap_tx(struct speedo_private *sp, int entry)
+{
+	struct sk_buff *skb = sp->tx_skbuff[entry];
+	struct TxBD *tbd = sp->tx_ring[entry].tbd;
+	int i;
+
+	pci_unmap_single(sp->pdev, le32_to_cpu(tbd[0].addr),
+			skb_headlen(skb), PCI_DMA_TODEVICE);
+	for (i = 0; i < skb_shinfo(skb)->nr_frags; i++)
+		pci_unmap_page(sp->pdev, le32_to_cpu(tbd[i + 1].addr),
+				skb_shinfo(skb)->frags[i].size, PCI_DMA_TODEVICE);
+}
+
 static void speedo_purge_tx(struct net_device *dev)
 {
 	struct speedo_private *sp = (struct speedo_private *)dev->priv;
@@ -1325,9 +1398,7 @@ static void speedo_purge_tx(struct net_device *dev)
 		entry = sp->dirty_tx % TX_RING_SIZE;
 		if (sp->tx_skbuff[entry]) {
 			sp->stats.tx_errors++;
-			pci_unmap_single(sp->pdev,
-					le32_to_cpu(sp->tx_ring[entry].tx_buf_addr0),
-					sp->tx_skbuff[entry]->len, PCI_DMA_TODEVICE);
+			speedo_unmap_tx(sp, entry);
 			dev_kfree_skb_irq(sp->tx_skbuff[entry]);
 			sp->tx_skbuff[entry] = 0;
 		}
@@ -1371,12 +1442,73 @@ static void reset_mii(struct net_device *dev)
 	}
 }
 
+/* Reset the Tx and Rx units and restart the chip. */
+static void speedo_reset(struct net_device *dev)
+{
+	struct speedo_private *sp = (struct speedo_private *)dev->priv;
+	long ioaddr = dev->base_addr;
+	unsigned long flags;
+
+	del_timer_sync(&sp->timer);
+	/* Reset the Tx and Rx units. */
+	outl(PortReset, ioaddr + SCBPort);
+	/* We may get spurious interrupts here.  But I don't think that they
+	   may do much harm.  1999/12/09 SAW */
+	udelay(10);
+	/* Disable interrupts. */
+	outw(SCBMaskAll, ioaddr + SCBCmd);
+	synchronize_irq();
+	speedo_tx_buffer_gc(dev);
+	/* Free as much as possible.
+	   It helps to recover from a hang because of out-of-memory.
+	   It also simplifies speedo_resume() in case TX ring is full or
+	   close-to-be full. */
+	speedo_purge_tx(dev);
+	speedo_refill_rx_buffers(dev, 1);
+	spin_lock_irqsave(&sp->lock, flags);
+	speedo_resume(dev);
+	sp->rx_mode = -1;
+	dev->trans_start = jiffies;
+	spin_unlock_irqrestore(&sp->lock, flags);
+	set_rx_mode(dev); /* it takes the spinlock itself --SAW */
+	/* Reset MII transceiver.  Do it before starting the timer to serialize
+	   mdio_xxx operations.  Yes, it's a paranoya :-)  2000/05/09 SAW */
+	reset_mii(dev);
+	sp->timer.expires = RUN_AT(2*HZ);
+	add_timer(&sp->timer);
+}
+
+#ifdef CONFIG_EEPRO100_NAPI
+/* The Rx ring belongs to speedo_poll(), so the reset is done from process
+   context with polling disabled rather than from the watchdog timer.
+   xmit_lock keeps speedo_start_xmit() off the Tx ring meanwhile, as the
+   watchdog did. */
+static void speedo_reset_task(void *data)
+{
+	struct net_device *dev = (struct net_device *)data;
+
+	if (!netif_running(dev))
+		return;
+	netif_poll_disable(dev);
+	netif_tx_disable(dev);
+	spin_lock_bh(&dev->xmit_lock);
+	speedo_reset(dev);
+	spin_unlock_bh(&dev->xmit_lock);
+	netif_wake_queue(dev);
+	netif_poll_enable(dev);
+	/* Interrupts that came in meanwhile were masked, not acknowledged;
+	   the poll acknowledges them and unmasks the chip. */
+	local_bh_disable();
+	netif_rx_schedule(dev);
+	local_bh_enable();
+}
+#endif
+
 static void speedo_tx_timeout(struct net_device *dev)
 {
 	struct speedo_private *sp = (struct speedo_private *)dev->priv;
 	long ioaddr = dev->base_addr;
 	int status = inw(ioaddr + SCBStatus);
-	unsigned long flags;
 
 	if (netif_msg_tx_err(sp)) {
 		printk(KERN_WARNING "%s: Transmit timed out: status %4.4x "
@@ -1401,33 +1533,11 @@ static void speedo_tx_timeout(struct net_device *dev)
 #else
 	{
 #endif
-		del_timer_sync(&sp->timer);
-		/* Reset the Tx and Rx units. */
-		outl(PortReset, ioaddr + SCBPort);
-		/* We may get spurious interrupts here.  But I don't think that they
-		   may do much harm.  1999/12/09 SAW */
-		udelay(10);
-		/* Disable interrupts. */
-		outw(SCBMaskAll, ioaddr + SCBCmd);
-		synchronize_irq();
-		speedo_tx_buffer_gc(dev);
-		/* Free as much as possible.
-		   It helps to recover from a hang because of out-of-memory.
-		   It also simplifies speedo_resume() in case TX ring is full or
-		   close-to-be full. */
-		speedo_purge_tx(dev);
-		speedo_refill_rx_buffers(dev, 1);
-		spin_lock_irqsave(&sp->lock, flags);
-		speedo_resume(dev);
-		sp->rx_mode = -1;
-		dev->trans_start = jiffies;
-		spin_unlock_irqrestore(&sp->lock, flags);
-		set_rx_mode(dev); /* it takes the spinlock itself --SAW */
-		/* Reset MII transceiver.  Do it before starting the timer to serialize
-		   mdio_xxx operations.  Yes, it's a paranoya :-)  2000/05/09 SAW */
-		reset_mii(dev);
-		sp->timer.expires = RUN_AT(2*HZ);
-		add_timer(&sp->timer);
+#ifdef CONFIG_EEPRO100_NAPI
+		schedule_task(&sp->reset_task);
+#else
+		speedo_reset(dev);
+#endif
 	}
 	return;
 }
@@ -1437,7 +1547,9 @@ speedo_start_xmit(struct sk_buff *skb, struct net_device *dev)
 {
 	struct speedo_private *sp = (struct speedo_private *)dev->priv;
 	long ioaddr = dev->base_addr;
-	int entry;
+	int nr_frags = skb_shinfo(skb)->nr_frags;
+	struct TxBD *tbd;
+	int entry, i;
 
 	/* Prevent interrupts from changing the Tx ring from underneath us. */
 	unsigned long flags;
@@ -1465,12 +1577,22 @@ speedo_start_xmit(struct sk_buff *skb, struct net_device *dev)
 		cpu_to_le32(TX_RING_ELEM_DMA(sp, sp->cur_tx % TX_RING_SIZE));
 	sp->tx_ring[entry].tx_desc_addr =
 		cpu_to_le32(TX_RING_ELEM_DMA(sp, entry) + TX_DESCR_BUF_OFFSET);
-	/* The data region is always in one buffer descriptor. */
-	sp->tx_ring[entry].count = cpu_to_le32(sp->tx_threshold);
-	sp->tx_ring[entry].tx_buf_addr0 =
-		cpu_to_le32(pci_map_single(sp->pdev, skb->data,
-					   skb->len, PCI_DMA_TODEVICE));
-	sp->tx_ring[entry].tx_buf_size0 = cpu_to_le32(skb->len);
+	/* One buffer descriptor for the linear data and one per fragment;
+	   the TBD count lives in the top byte of the count word. */
+	sp->tx_ring[entry].count = cpu_to_le32((sp->tx_threshold & 0x00ffffff)
+					       | ((nr_frags + 1) << 24));
+	tbd = sp->tx_ring[entry].tbd;
+	tbd[0].addr = cpu_to_le32(pci_map_single(sp->pdev, skb->data,
+					skb_headlen(skb), PCI_DMA_TODEVICE));
+	tbd[0].size = cpu_to_le32(skb_headlen(skb));
+	for (i = 0; i < nr_frags; i++) {
+		skb_frag_t *frag = &skb_shinfo(skb)->frags[i];
+
+		tbd[i + 1].addr = cpu_to_le32(pci_map_page(sp->pdev,
+				frag->page, frag->page_offset, frag->size,
+				PCI_DMA_TODEVICE));
+		tbd[i + 1].size = cpu_to_le32(frag->size);
+	}
 
 	/* workaround for hardware bug on 10 mbit half duplex */
 
@@ -1529,9 +1651,7 @@ static void speedo_tx_buffer_gc(struct net_device *dev)
 		if (sp->tx_skbuff[entry]) {
 			sp->stats.tx_packets++;	/* Count only user packets. */
 			sp->stats.tx_bytes += sp->tx_skbuff[entry]->len;
-			pci_unmap_single(sp->pdev,
-					le32_to_cpu(sp->tx_ring[entry].tx_buf_addr0),
-					sp->tx_skbuff[entry]->len, PCI_DMA_TODEVICE);
+			speedo_unmap_tx(sp, entry);
 			dev_kfree_skb_irq(sp->tx_skbuff[entry]);
 			sp->tx_skbuff[entry] = 0;
 		}
@@ -1562,6 +1682,114 @@ static void speedo_tx_buffer_gc(struct net_device *dev)
 	sp->dirty_tx = dirty_tx;
 }
 
+/*
+ * The chip may have suspended reception for various reasons.
+ * Check for that, and re-prime it should this be the case.
+ * Called with sp->lock held.
+ */
+static void speedo_check_rx_state(struct net_device *dev, unsigned short status)
+{
+	switch ((status >> 2) & 0xf) {
+	case 0: /* Idle */
+		break;
+	case 1:	/* Suspended */
+	case 2:	/* No resources (RxFDs) */
+	case 9:	/* Suspended with no more RBDs */
+	case 10: /* No resources due to no RBDs */
+	case 12: /* Ready with no RBDs */
+		speedo_rx_soft_reset(dev);
+		break;
+	case 3:  case 5:  case 6:  case 7:  case 8:
+	case 11:  case 13:  case 14:  case 15:
+		/* these are all reserved values */
+		break;
+	}
+}
+
+/* Scavenge the Tx ring and restart the queue if it has drained enough.
+   Called with sp->lock held. */
+static void speedo_tx_done(struct net_device *dev)
+{
+	struct speedo_private *sp = (struct speedo_private *)dev->priv;
+
+	speedo_tx_buffer_gc(dev);
+	if (sp->tx_full
+		&& (int)(sp->cur_tx - sp->dirty_tx) < TX_QUEUE_UNFULL) {
+		/* The ring is no longer full. */
+		sp->tx_full = 0;
+		netif_wake_queue(dev); /* Attention: under a spinlock.  --SAW */
+	}
+}
+
+#ifdef CONFIG_EEPRO100_NAPI
+
+/* Interrupt sources we normally leave unmasked: all but FCP and ER. */
+#define SPEEDO_INTR_UNMASK	((SCBMaskEarlyRx | SCBMaskFlowCtl) >> 8)
+
+/* The interrupt handler only masks the chip and schedules the poll
+   routine, which does the Rx thread work and cleans up after the
+   Tx thread. */
+static void speedo_interrupt(int irq, void *dev_instance, struct pt_regs *regs)
+{
+	struct net_device *dev = (struct net_device *)dev_instance;
+	struct speedo_private *sp = (struct speedo_private *)dev->priv;
+	long ioaddr = dev->base_addr;
+	unsigned short status;
+
+	status = inw(ioaddr + SCBStatus);
+	if (netif_msg_intr(sp))
+		printk(KERN_DEBUG "%s: interrupt  status=%#4.4x.\n",
+			   dev->name, status);
+
+	if ((status & 0xfc00) == 0)
+		return;
+
+	/* Mask everything; speedo_poll() acknowledges the sources.  If a
+	   poll is already pending the chip is masked already, and the
+	   sources must be left for the poll to see.  If polling is disabled
+	   for a reset, speedo_reset_task() schedules a poll afterwards. */
+	outb(SCBMaskAll >> 8, ioaddr + SCBIntmask);
+	if (netif_rx_schedule_prep(dev))
+		__netif_rx_schedule(dev);
+}
+
+static int speedo_poll(struct net_device *dev, int *budget)
+{
+	struct speedo_private *sp = (struct speedo_private *)dev->priv;
+	long ioaddr = dev->base_addr;
+	int work_to_do = min(*budget, dev->quota);
+	int work_done;
+	unsigned short status;
+	unsigned long flags;
+
+	/* Acknowledge all of the current interrupt sources.  Anything that
+	   arrives after this will raise an interrupt once we unmask. */
+	status = inw(ioaddr + SCBStatus);
+	outw(status & 0xfc00, ioaddr + SCBStatus);
+
+	work_done = speedo_rx(dev, work_to_do);
+
+	/* Always check if all rx buffers are allocated.  --SAW */
+	speedo_refill_rx_buffers(dev, 0);
+
+	spin_lock_irqsave(&sp->lock, flags);
+	speedo_check_rx_state(dev, inw(ioaddr + SCBStatus));
+	speedo_tx_done(dev);
+	spin_unlock_irqrestore(&sp->lock, flags);
+
+	*budget -= work_done;
+	dev->quota -= work_done;
+
+	if (work_done >= work_to_do)
+		return 1;	/* More Rx work pending, stay on the poll list. */
+
+	netif_rx_complete(dev);
+	outb(SPEEDO_INTR_UNMASK, ioaddr + SCBIntmask);
+	return 0;
+}
+
+#else /* !CONFIG_EEPRO100_NAPI */
+
 /* The interrupt handler does all of the Rx thread work and cleans up
    after the Tx thread. */
 static void speedo_interrupt(int irq, void *dev_instance, struct pt_regs *regs)
@@ -1602,43 +1830,17 @@ static void speedo_interrupt(int irq, void *dev_instance, struct pt_regs *regs)
 		if ((status & 0x5000) ||	/* Packet received, or Rx error. */
 			(sp->rx_ring_state&(RrNoMem|RrPostponed)) == RrPostponed)
 									/* Need to gather the postponed packet. */
-			speedo_rx(dev);
+			speedo_rx(dev, RX_RING_SIZE);
 
 		/* Always check if all rx buffers are allocated.  --SAW */
 		speedo_refill_rx_buffers(dev, 0);
 		
 		spin_lock(&sp->lock);
-		/*
-		 * The chip may have suspended reception for various reasons.
-		 * Check for that, and re-prime it should this be the case.
-		 */
-		switch ((status >> 2) & 0xf) {
-		case 0: /* Idle */
-			break;
-		case 1:	/* Suspended */
-		case 2:	/* No resources (RxFDs) */
-		case 9:	/* Suspended with no more RBDs */
-		case 10: /* No resources due to no RBDs */
-		case 12: /* Ready with no RBDs */
-			speedo_rx_soft_reset(dev);
-			break;
-		case 3:  case 5:  case 6:  case 7:  case 8:
-		case 11:  case 13:  case 14:  case 15:
-			/* these are all reserved values */
-			break;
-		}
-		
-		
+		speedo_check_rx_state(dev, status);
+
 		/* User interrupt, Command/Tx unit interrupt or CU not active. */
-		if (status & 0xA400) {
-			speedo_tx_buffer_gc(dev);
-			if (sp->tx_full
-				&& (int)(sp->cur_tx - sp->dirty_tx) < TX_QUEUE_UNFULL) {
-				/* The ring is no longer full. */
-				sp->tx_full = 0;
-				netif_wake_queue(dev); /* Attention: under a spinlock.  --SAW */
-			}
-		}
+		if (status & 0xA400)
+			speedo_tx_done(dev);
 		
 		spin_unlock(&sp->lock);
 
@@ -1661,24 +1863,22 @@ static void speedo_interrupt(int irq, void *dev_instance, struct pt_regs *regs)
 	return;
 }
 
+#endif /* CONFIG_EEPRO100_NAPI */
+
 static inline struct RxFD *speedo_rx_alloc(struct net_device *dev, int entry)
 {
 	struct speedo_private *sp = (struct speedo_private *)dev->priv;
 	struct RxFD *rxf;
 	struct sk_buff *skb;
-	/* Get a fresh skbuff to replace the consumed one. */
-	skb = dev_alloc_skb(PKT_BUF_SZ + sizeof(struct RxFD));
-	/* XXX: do we really want to call this before the NULL check? --hch */
-	rx_align(skb);				/* Align IP on 16 byte boundary */
+	/* Get a mapped skbuff, usually a recycled one, for the consumed one. */
+	skb = skb_rx_pool_alloc(sp->rx_pool, GFP_ATOMIC);
 	sp->rx_skbuff[entry] = skb;
 	if (skb == NULL) {
 		sp->rx_ringp[entry] = NULL;
 		return NULL;
 	}
 	rxf = sp->rx_ringp[entry] = (struct RxFD *)skb->tail;
-	sp->rx_ring_dma[entry] =
-		pci_map_single(sp->pdev, rxf,
-					   PKT_BUF_SZ + sizeof(struct RxFD), PCI_DMA_FROMDEVICE);
+	sp->rx_ring_dma[entry] = skb->rx_dma;
 	skb->dev = dev;
 	skb_reserve(skb, sizeof(struct RxFD));
 	rxf->rx_buf_addr = 0xffffffff;
@@ -1753,14 +1953,19 @@ static void speedo_refill_rx_buffers(struct net_device *dev, int force)
 			speedo_refill_rx_buf(dev, force) != -1);
 }
 
+/* Reap at most 'limit' Rx descriptors, returning the number reaped. */
 static int
-speedo_rx(struct net_device *dev)
+speedo_rx(struct net_device *dev, int limit)
 {
 	struct speedo_private *sp = (struct speedo_private *)dev->priv;
 	int entry = sp->cur_rx % RX_RING_SIZE;
 	int rx_work_limit = sp->dirty_rx + RX_RING_SIZE - sp->cur_rx;
 	int alloc_ok = 1;
 	int npkts = 0;
+	int work_done = 0;
+
+	if (rx_work_limit > limit)
+		rx_work_limit = limit;
 
 	if (netif_msg_intr(sp))
 		printk(KERN_DEBUG " In speedo_rx().\n");
@@ -1807,48 +2012,34 @@ speedo_rx(struct net_device *dev)
 					   dev->name, status);
 			}
 		} else {
-			struct sk_buff *skb;
-
-			/* Check if the packet is long enough to just accept without
-			   copying to a properly sized skbuff. */
-			if (pkt_len < rx_copybreak
-				&& (skb = dev_alloc_skb(pkt_len + 2)) != 0) {
-				skb->dev = dev;
-				skb_reserve(skb, 2);	/* Align IP on 16 byte boundaries */
-				/* 'skb_put()' points to the start of sk_buff data area. */
-				pci_dma_sync_single(sp->pdev, sp->rx_ring_dma[entry],
-					sizeof(struct RxFD) + pkt_len, PCI_DMA_FROMDEVICE);
-
-#if 1 || USE_IP_CSUM
-				/* Packet is in one chunk -- we can copy + cksum. */
-				eth_copy_and_sum(skb, sp->rx_skbuff[entry]->tail, pkt_len, 0);
-				skb_put(skb, pkt_len);
-#else
-				memcpy(skb_put(skb, pkt_len), sp->rx_skbuff[entry]->tail,
-					   pkt_len);
-#endif
-				npkts++;
-			} else {
-				/* Pass up the already-filled skbuff. */
-				skb = sp->rx_skbuff[entry];
-				if (skb == NULL) {
-					printk(KERN_ERR "%s: Inconsistent Rx descriptor chain.\n",
-						   dev->name);
-					break;
-				}
+			struct sk_buff *skb = sp->rx_skbuff[entry];
+
+			if (skb == NULL) {
+				printk(KERN_ERR "%s: Inconsistent Rx descriptor chain.\n",
+					   dev->name);
+				break;
+			}
+			/* Frames below rx_copybreak are copied to a properly sized
+			   skbuff and the buffer stays on the ring.  Larger ones go
+			   up in place; the buffer returns to the pool, still mapped,
+			   once the stack is done with it. */
+			skb = skb_rx_pool_receive(sp->rx_pool, skb, pkt_len);
+			if (skb == sp->rx_skbuff[entry]) {
 				sp->rx_skbuff[entry] = NULL;
-				skb_put(skb, pkt_len);
-				npkts++;
 				sp->rx_ringp[entry] = NULL;
-				pci_unmap_single(sp->pdev, sp->rx_ring_dma[entry],
-						PKT_BUF_SZ + sizeof(struct RxFD), PCI_DMA_FROMDEVICE);
 			}
+			npkts++;
 			skb->protocol = eth_type_trans(skb, dev);
+#ifdef CONFIG_EEPRO100_NAPI
+			netif_receive_skb(skb);
+#else
 			netif_rx(skb);
+#endif
 			sp->stats.rx_packets++;
 			sp->stats.rx_bytes += pkt_len;
 		}
 		entry = (++sp->cur_rx) % RX_RING_SIZE;
+		work_done++;
 		sp->rx_ring_state &= ~RrPostponed;
 		/* Refill the recently taken buffers.
 		   Do it one-by-one to handle traffic bursts better. */
@@ -1862,7 +2053,7 @@ speedo_rx(struct net_device *dev)
 	if (npkts)
 		sp->last_rx_time = jiffies;
 
-	return 0;
+	return work_done;
 }
 
 static int
@@ -1881,6 +2072,10 @@ speedo_close(struct net_device *dev)
 
 	/* Shut off the media monitoring timer. */
 	del_timer_sync(&sp->timer);
+#ifdef CONFIG_EEPRO100_NAPI
+	/* A Tx timeout reset may still be queued; let it see !netif_running. */
+	flush_scheduled_tasks();
+#endif
 
 	outw(SCBMaskAll, ioaddr + SCBCmd);
 
@@ -1900,24 +2095,21 @@ speedo_close(struct net_device *dev)
 		struct sk_buff *skb = sp->rx_skbuff[i];
 		sp->rx_skbuff[i] = 0;
 		/* Clear the Rx descriptors. */
-		if (skb) {
-			pci_unmap_single(sp->pdev,
-					 sp->rx_ring_dma[i],
-					 PKT_BUF_SZ + sizeof(struct RxFD), PCI_DMA_FROMDEVICE);
+		if (skb)
 			dev_kfree_skb(skb);
-		}
 	}
+	/* Buffers still in the stack are unmapped when they are freed. */
+	skb_rx_pool_destroy(sp->rx_pool);
+	sp->rx_pool = NULL;
 
 	for (i = 0; i < TX_RING_SIZE; i++) {
 		struct sk_buff *skb = sp->tx_skbuff[i];
-		sp->tx_skbuff[i] = 0;
 		/* Clear the Tx descriptors. */
 		if (skb) {
-			pci_unmap_single(sp->pdev,
-					 le32_to_cpu(sp->tx_ring[i].tx_buf_addr0),
-					 skb->len, PCI_DMA_TODEVICE);
+			speedo_unmap_tx(sp, i);
 			dev_kfree_skb(skb);
 		}
+		sp->tx_skbuff[i] = 0;
 	}
 
 	/* Free multicast setting blocks. */
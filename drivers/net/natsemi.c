@@ -133,10 +133,13 @@
 		* comments update (Manfred)
 		* do the right thing on a phy-reset (Manfred and Tim)
 
+	version 1.0.18:
+		* optional NAPI receive (CONFIG_NATSEMI_NAPI), with the
+		  poll weight settable per unit through rx_weight[]
+
 	TODO:
 	* big endian support with CFG:BEM instead of cpu_to_le32
 	* support for an external PHY
-	* NAPI
 */
 
 #if !defined(__OPTIMIZE__)
@@ -172,7 +175,7 @@
 #include <asm/uaccess.h>
 
 #define DRV_NAME	"natsemi"
-#define DRV_VERSION	"1.07+LK1.0.17"
+#define DRV_VERSION	"1.07+LK1.0.18"
 #define DRV_RELDATE	"Sep 27, 2002"
 
 /* Updated to recommendations in pci-skeleton v2.03. */
@@ -208,6 +211,12 @@ static int rx_copybreak;
 static int options[MAX_UNITS];
 static int full_duplex[MAX_UNITS];
 
+#ifdef CONFIG_NATSEMI_NAPI
+/* Rx packets handled per poll round, 0 selects NATSEMI_NAPI_WEIGHT. */
+static int rx_weight[MAX_UNITS];
+#define NATSEMI_NAPI_WEIGHT	16
+#endif
+
 /* Operational parameters that are set at compile time. */
 
 /* Keep the ring sizes a power of two for compile efficiency.
@@ -215,8 +224,10 @@ static int full_duplex[MAX_UNITS];
    Making the Tx ring too large decreases the effectiveness of channel
    bonding and packet priority.
    There are no ill effects from too-large receive rings. */
-#define TX_RING_SIZE	16
-#define TX_QUEUE_LEN	10 /* Limit ring entries actually used, min 4. */
+#define TX_RING_SIZE	32
+#define TX_QUEUE_LEN	24 /* Limit ring entries actually used, min TX_MAX_DESC+4. */
+/* A scatter-gather frame takes one descriptor per buffer. */
+#define TX_MAX_DESC	(MAX_SKB_FRAGS + 1)
 #define RX_RING_SIZE	32
 
 /* Operational parameters that usually are not changed. */
@@ -254,6 +265,9 @@ MODULE_PARM(debug, "i");
 MODULE_PARM(rx_copybreak, "i");
 MODULE_PARM(options, "1-" __MODULE_STRING(MAX_UNITS) "i");
 MODULE_PARM(full_duplex, "1-" __MODULE_STRING(MAX_UNITS) "i");
+#ifdef CONFIG_NATSEMI_NAPI
+MODULE_PARM(rx_weight, "1-" __MODULE_STRING(MAX_UNITS) "i");
+#endif
 MODULE_PARM_DESC(max_interrupt_work, 
 	"DP8381x maximum events handled per interrupt");
 MODULE_PARM_DESC(mtu, "DP8381x MTU (all boards)");
@@ -263,6 +277,9 @@ MODULE_PARM_DESC(rx_copybreak,
 MODULE_PARM_DESC(options, 
 	"DP8381x: Bits 0-3: media type, bit 17: full duplex");
 MODULE_PARM_DESC(full_duplex, "DP8381x full duplex setting(s) (1)");
+#ifdef CONFIG_NATSEMI_NAPI
+MODULE_PARM_DESC(rx_weight, "DP8381x Rx packets per poll round");
+#endif
 
 /*
 				Theory of Operation
@@ -307,6 +324,13 @@ copying packets.  When copying is done, the cost is usually mitigated by using
 a combined copy/checksum routine.  Copying also preloads the cache, which is
 most useful with small frames.
 
+On transmit the driver advertises scatter-gather: the linear part and
+each page fragment of an skb get their own descriptor, chained with
+DescMore.  The skb is kept with the last descriptor of the frame, whose
+status word is the one checked on completion.  The chip cannot checksum
+on transmit, so no checksum offload is advertised: TCP still builds paged
+skbs for us, checksumming the data as it copies it.
+
 A subtle aspect of the operation is that unaligned buffers are not permitted
 by the hardware.  Thus the IP header at offset 14 in an ethernet frame isn't
 longword aligned for further processing.  On copies frames are put into the
@@ -320,6 +344,11 @@ performance critical codepaths:
 The rx process only runs in the interrupt handler. Access from outside
 the interrupt handler is only permitted after disable_irq().
 
+With CONFIG_NATSEMI_NAPI the rx process runs in natsemi_poll() instead:
+the interrupt handler saves the (self-clearing) IntrStatus in
+np->intr_status, masks the chip and schedules the poll.  Code outside
+the poll routine must additionally own the poll, see natsemi_poll_trylock().
+
 The rx process usually runs under the dev->xmit_lock. If np->intr_tx_reap
 is set, then access is permitted under spin_lock_irq(&np->lock).
 
@@ -640,6 +669,7 @@ struct netdev_private {
 	/* address of a sent-in-place packet/buffer, for later free() */
 	struct sk_buff *tx_skbuff[TX_RING_SIZE];
 	dma_addr_t tx_dma[TX_RING_SIZE];
+	unsigned int tx_len[TX_RING_SIZE];
 	struct net_device_stats stats;
 	/* Media monitoring timer */
 	struct timer_list timer;
@@ -672,6 +702,10 @@ struct netdev_private {
 	unsigned int iosize;
 	spinlock_t lock;
 	u32 msg_enable;
+#ifdef CONFIG_NATSEMI_NAPI
+	/* IntrStatus bits seen by the irq handler, consumed by the poll */
+	u32 intr_status;
+#endif
 };
 
 static int eeprom_read(long ioaddr, int location);
@@ -698,7 +732,12 @@ static void init_registers(struct net_device *dev);
 static int start_tx(struct sk_buff *skb, struct net_device *dev);
 static irqreturn_t intr_handler(int irq, void *dev_instance, struct pt_regs *regs);
 static void netdev_error(struct net_device *dev, int intr_status);
+#ifdef CONFIG_NATSEMI_NAPI
+static int natsemi_poll(struct net_device *dev, int *budget);
+static int netdev_rx(struct net_device *dev, int work_to_do);
+#else
 static void netdev_rx(struct net_device *dev);
+#endif
 static void netdev_tx_done(struct net_device *dev);
 static void __set_rx_mode(struct net_device *dev);
 static void set_rx_mode(struct net_device *dev);
@@ -823,6 +862,14 @@ static int __devinit natsemi_probe1 (struct pci_dev *pdev,
 	dev->do_ioctl = &netdev_ioctl;
 	dev->tx_timeout = &tx_timeout;
 	dev->watchdog_timeo = TX_TIMEOUT;
+	dev->features |= NETIF_F_SG;
+#ifdef CONFIG_NATSEMI_NAPI
+	dev->poll = &natsemi_poll;
+	if (find_cnt < MAX_UNITS && rx_weight[find_cnt] > 0)
+		dev->weight = rx_weight[find_cnt];
+	else
+		dev->weight = NATSEMI_NAPI_WEIGHT;
+#endif
 
 	if (mtu)
 		dev->mtu = mtu;
@@ -1319,6 +1366,34 @@ static void init_registers(struct net_device *dev)
 	writel(StatsClear, ioaddr + StatsCtrl); /* Clear Stats */
 }
 
+#ifdef CONFIG_NATSEMI_NAPI
+/*
+ * The rx ring is owned by natsemi_poll().  Timer and watchdog code that
+ * must reinitialize it takes ownership of the poll the same way
+ * netif_poll_disable() does, but without sleeping: if a poll is pending
+ * the caller backs off and retries later.  An interrupt that comes in
+ * meanwhile cannot schedule the poll, so it leaves its status in
+ * np->intr_status with the chip masked, and ownership is handed back by
+ * scheduling the poll rather than by just releasing it.
+ */
+static inline int natsemi_poll_trylock(struct net_device *dev)
+{
+	return !test_and_set_bit(__LINK_STATE_RX_SCHED, &dev->state);
+}
+
+static inline void natsemi_poll_unlock(struct net_device *dev)
+{
+	if (netif_running(dev)) {
+		writel(0, dev->base_addr + IntrEnable);
+		__netif_rx_schedule(dev);
+	} else
+		netif_poll_enable(dev);
+}
+#else
+#define natsemi_poll_trylock(dev)	1
+#define natsemi_poll_unlock(dev)	do { } while (0)
+#endif
+
 /*
  * netdev_timer:
  * Purpose:
@@ -1354,7 +1429,7 @@ static void netdev_timer(unsigned long data)
 	dspcfg = readw(ioaddr+DSPCFG);
 	writew(0, ioaddr+PGSEL);
 	if (dspcfg != np->dspcfg) {
-		if (!netif_queue_stopped(dev)) {
+		if (!netif_queue_stopped(dev) && natsemi_poll_trylock(dev)) {
 			spin_unlock_irq(&np->lock);
 			if (netif_msg_hw(np))
 				printk(KERN_NOTICE "%s: possible phy reset: "
@@ -1367,6 +1442,7 @@ static void netdev_timer(unsigned long data)
 			init_registers(dev);
 			spin_unlock_irq(&np->lock);
 			enable_irq(dev->irq);
+			natsemi_poll_unlock(dev);
 		} else {
 			/* hurry back */
 			next_tick = HZ;
@@ -1378,10 +1454,13 @@ static void netdev_timer(unsigned long data)
 		spin_unlock_irq(&np->lock);
 	}
 	if (np->oom) {
-		disable_irq(dev->irq);
-		np->oom = 0;
-		refill_rx(dev);
-		enable_irq(dev->irq);
+		if (natsemi_poll_trylock(dev)) {
+			disable_irq(dev->irq);
+			np->oom = 0;
+			refill_rx(dev);
+			enable_irq(dev->irq);
+			natsemi_poll_unlock(dev);
+		}
 		if (!np->oom) {
 			writel(RxOn, dev->base_addr + ChipCmd);
 		} else {
@@ -1419,6 +1498,10 @@ static void tx_timeout(struct net_device *dev)
 	struct netdev_private *np = dev->priv;
 	long ioaddr = dev->base_addr;
 
+	/* A poll is in flight; the watchdog will call us again. */
+	if (!natsemi_poll_trylock(dev))
+		return;
+
 	disable_irq(dev->irq);
 	spin_lock_irq(&np->lock);
 	if (!np->hands_off) {
@@ -1439,6 +1522,7 @@ static void tx_timeout(struct net_device *dev)
 	}
 	spin_unlock_irq(&np->lock);
 	enable_irq(dev->irq);
+	natsemi_poll_unlock(dev);
 
 	dev->trans_start = jiffies;
 	np->stats.tx_errors++;
@@ -1494,6 +1578,7 @@ static void init_ring(struct net_device *dev)
 	np->dirty_tx = np->cur_tx = 0;
 	for (i = 0; i < TX_RING_SIZE; i++) {
 		np->tx_skbuff[i] = NULL;
+		np->tx_len[i] = 0;
 		np->tx_ring[i].next_desc = cpu_to_le32(np->ring_dma
 			+sizeof(struct netdev_desc)
 			*((i+1)%TX_RING_SIZE+RX_RING_SIZE));
@@ -1522,20 +1607,36 @@ static void init_ring(struct net_device *dev)
 	dump_ring(dev);
 }
 
+/* Unmap the descriptor buffer of one tx ring entry. The first
+   descriptor of a frame maps skb->data, the others map page fragments. */
+static void tx_unmap_entry(struct netdev_private *np, int entry, int first)
+{
+	if (!np->tx_len[entry])
+		return;
+	if (first)
+		pci_unmap_single(np->pci_dev, np->tx_dma[entry],
+			np->tx_len[entry], PCI_DMA_TODEVICE);
+	else
+		pci_unmap_page(np->pci_dev, np->tx_dma[entry],
+			np->tx_len[entry], PCI_DMA_TODEVICE);
+	np->tx_len[entry] = 0;
+}
+
 static void drain_tx(struct net_device *dev)
 {
 	struct netdev_private *np = dev->priv;
-	int i;
+	int first = 1;
 
-	for (i = 0; i < TX_RING_SIZE; i++) {
-		if (np->tx_skbuff[i]) {
-			pci_unmap_single(np->pci_dev,
-				np->tx_dma[i], np->tx_skbuff[i]->len,
-				PCI_DMA_TODEVICE);
-			dev_kfree_skb(np->tx_skbuff[i]);
+	for (; np->cur_tx - np->dirty_tx > 0; np->dirty_tx++) {
+		int entry = np->dirty_tx % TX_RING_SIZE;
+		tx_unmap_entry(np, entry, first);
+		first = 0;
+		if (np->tx_skbuff[entry]) {
+			dev_kfree_skb(np->tx_skbuff[entry]);
 			np->stats.tx_dropped++;
+			np->tx_skbuff[entry] = NULL;
+			first = 1;
 		}
-		np->tx_skbuff[i] = NULL;
 	}
 }
 
@@ -1592,36 +1693,65 @@ static void reinit_ring(struct net_device *dev)
 static int start_tx(struct sk_buff *skb, struct net_device *dev)
 {
 	struct netdev_private *np = dev->priv;
-	unsigned entry;
+	int nr_frags = skb_shinfo(skb)->nr_frags;
+	unsigned entry, first;
+	int i;
 
 	/* Note: Ordering is important here, set the field with the
 	   "ownership" bit last, and only then increment cur_tx. */
 
 	/* Calculate the next Tx descriptor entry. */
-	entry = np->cur_tx % TX_RING_SIZE;
+	first = entry = np->cur_tx % TX_RING_SIZE;
 
-	np->tx_skbuff[entry] = skb;
+	np->tx_len[entry] = skb_headlen(skb);
 	np->tx_dma[entry] = pci_map_single(np->pci_dev,
-				skb->data,skb->len, PCI_DMA_TODEVICE);
-
+				skb->data, skb_headlen(skb), PCI_DMA_TODEVICE);
 	np->tx_ring[entry].addr = cpu_to_le32(np->tx_dma[entry]);
 
+	for (i = 0; i < nr_frags; i++) {
+		skb_frag_t *frag = &skb_shinfo(skb)->frags[i];
+
+		/* Every descriptor but the last carries DescMore; all but
+		   the first may be handed to the chip right away. */
+		np->tx_ring[entry].cmd_status = cpu_to_le32(DescMore |
+			(entry == first ? 0 : DescOwn) | np->tx_len[entry]);
+
+		entry = (entry + 1) % TX_RING_SIZE;
+		np->tx_len[entry] = frag->size;
+		np->tx_dma[entry] = pci_map_page(np->pci_dev, frag->page,
+				frag->page_offset, frag->size,
+				PCI_DMA_TODEVICE);
+		np->tx_ring[entry].addr = cpu_to_le32(np->tx_dma[entry]);
+	}
+	np->tx_skbuff[entry] = skb;
+	if (nr_frags)
+		np->tx_ring[entry].cmd_status =
+			cpu_to_le32(DescOwn | np->tx_len[entry]);
+
 	spin_lock_irq(&np->lock);
 
 	if (!np->hands_off) {
-		np->tx_ring[entry].cmd_status = cpu_to_le32(DescOwn | skb->len);
+		np->tx_ring[first].cmd_status = cpu_to_le32(DescOwn |
+			(nr_frags ? DescMore : 0) | np->tx_len[first]);
 		/* StrongARM: Explicitly cache flush np->tx_ring and
 		 * skb->data,skb->len. */
 		wmb();
-		np->cur_tx++;
-		if (np->cur_tx - np->dirty_tx >= TX_QUEUE_LEN - 1) {
+		np->cur_tx += nr_frags + 1;
+		if (np->cur_tx - np->dirty_tx > TX_QUEUE_LEN - TX_MAX_DESC - 1) {
 			netdev_tx_done(dev);
-			if (np->cur_tx - np->dirty_tx >= TX_QUEUE_LEN - 1)
+			if (np->cur_tx - np->dirty_tx
+					> TX_QUEUE_LEN - TX_MAX_DESC - 1)
 				netif_stop_queue(dev);
 		}
 		/* Wake the potentially-idle transmit channel. */
 		writel(TxOn, dev->base_addr + ChipCmd);
 	} else {
+		for (i = 0; i <= nr_frags; i++) {
+			entry = (first + i) % TX_RING_SIZE;
+			np->tx_ring[entry].cmd_status = 0;
+			tx_unmap_entry(np, entry, i == 0);
+		}
+		np->tx_skbuff[entry] = NULL;
 		dev_kfree_skb_irq(skb);
 		np->stats.tx_dropped++;
 	}
@@ -1631,7 +1761,7 @@ static int start_tx(struct sk_buff *skb, struct net_device *dev)
 
 	if (netif_msg_tx_queued(np)) {
 		printk(KERN_DEBUG "%s: Transmit frame #%d queued in slot %d.\n",
-			dev->name, np->cur_tx, entry);
+			dev->name, np->cur_tx, first);
 	}
 	return 0;
 }
@@ -1640,21 +1770,28 @@ static void netdev_tx_done(struct net_device *dev)
 {
 	struct netdev_private *np = dev->priv;
 
-	for (; np->cur_tx - np->dirty_tx > 0; np->dirty_tx++) {
-		int entry = np->dirty_tx % TX_RING_SIZE;
-		if (np->tx_ring[entry].cmd_status & cpu_to_le32(DescOwn))
+	while (np->cur_tx - np->dirty_tx > 0) {
+		unsigned int last = np->dirty_tx;
+		int entry = last % TX_RING_SIZE;
+		int tx_status;
+
+		/* Find the descriptor that ends this frame. */
+		while (!np->tx_skbuff[entry]) {
+			if (++last == np->cur_tx)
+				goto out;
+			entry = last % TX_RING_SIZE;
+		}
+		tx_status = le32_to_cpu(np->tx_ring[entry].cmd_status);
+		if (tx_status & DescOwn)
 			break;
 		if (netif_msg_tx_done(np))
 			printk(KERN_DEBUG
 				"%s: tx frame #%d finished, status %#08x.\n",
-					dev->name, np->dirty_tx,
-					le32_to_cpu(np->tx_ring[entry].cmd_status));
-		if (np->tx_ring[entry].cmd_status & cpu_to_le32(DescPktOK)) {
+					dev->name, np->dirty_tx, tx_status);
+		if (tx_status & DescPktOK) {
 			np->stats.tx_packets++;
 			np->stats.tx_bytes += np->tx_skbuff[entry]->len;
 		} else { /* Various Tx errors */
-			int tx_status =
-				le32_to_cpu(np->tx_ring[entry].cmd_status);
 			if (tx_status & (DescTxAbort|DescTxExcColl))
 				np->stats.tx_aborted_errors++;
 			if (tx_status & DescTxFIFO)
@@ -1665,20 +1802,113 @@ static void netdev_tx_done(struct net_device *dev)
 				np->stats.tx_window_errors++;
 			np->stats.tx_errors++;
 		}
-		pci_unmap_single(np->pci_dev,np->tx_dma[entry],
-					np->tx_skbuff[entry]->len,
-					PCI_DMA_TODEVICE);
+		tx_unmap_entry(np, np->dirty_tx % TX_RING_SIZE, 1);
+		while (np->dirty_tx++ != last)
+			tx_unmap_entry(np, np->dirty_tx % TX_RING_SIZE, 0);
 		/* Free the original skb. */
 		dev_kfree_skb_irq(np->tx_skbuff[entry]);
 		np->tx_skbuff[entry] = NULL;
 	}
+out:
 	if (netif_queue_stopped(dev)
-		&& np->cur_tx - np->dirty_tx < TX_QUEUE_LEN - 4) {
+		&& np->cur_tx - np->dirty_tx < TX_QUEUE_LEN - TX_MAX_DESC - 4) {
 		/* The ring is no longer full, wake queue. */
 		netif_wake_queue(dev);
 	}
 }
 
+#ifdef CONFIG_NATSEMI_NAPI
+
+#define NATSEMI_RX_INTR	(IntrRxDone | IntrRxIntr | RxStatusFIFOOver | \
+			 IntrRxErr | IntrRxOverrun)
+#define NATSEMI_TX_INTR	(IntrTxDone | IntrTxIntr | IntrTxIdle | IntrTxErr)
+
+/* The interrupt handler only latches the status, masks the chip and
+   schedules natsemi_poll(), which does all of the Rx thread work and
+   cleans up after the Tx thread. */
+static irqreturn_t intr_handler(int irq, void *dev_instance, struct pt_regs *rgs)
+{
+	struct net_device *dev = dev_instance;
+	struct netdev_private *np = dev->priv;
+	long ioaddr = dev->base_addr;
+	u32 intr_status;
+
+	/* While a poll is pending the chip is masked, so a shared irq must
+	   not read (and thereby acknowledge) IntrStatus behind its back. */
+	if (np->hands_off || !readl(ioaddr + IntrEnable))
+		return IRQ_NONE;
+
+	/* Reading automatically acknowledges all int sources. */
+	intr_status = readl(ioaddr + IntrStatus);
+
+	if (netif_msg_intr(np))
+		printk(KERN_DEBUG
+			"%s: Interrupt, status %#08x, mask %#08x.\n",
+			dev->name, intr_status,
+			readl(ioaddr + IntrMask));
+
+	if (!intr_status)
+		return IRQ_NONE;
+
+	/* Disable interrupts and register for poll.  If the timer or the
+	   watchdog owns the poll, natsemi_poll_unlock() schedules it. */
+	np->intr_status |= intr_status;
+	writel(0, ioaddr + IntrEnable);
+	if (netif_rx_schedule_prep(dev))
+		__netif_rx_schedule(dev);
+	return IRQ_HANDLED;
+}
+
+static int natsemi_poll(struct net_device *dev, int *budget)
+{
+	struct netdev_private *np = dev->priv;
+	long ioaddr = dev->base_addr;
+	int work_to_do = min(*budget, dev->quota);
+	int work_done = 0;
+
+	do {
+		if (np->intr_status & NATSEMI_TX_INTR) {
+			spin_lock_irq(&np->lock);
+			netdev_tx_done(dev);
+			spin_unlock_irq(&np->lock);
+		}
+
+		/* Abnormal error summary/uncommon events handlers. */
+		if (np->intr_status & IntrAbnormalSummary)
+			netdev_error(dev, np->intr_status);
+
+		/* The ring is always scanned: the timer may have scheduled
+		   us to refill it without any status bit set. */
+		work_done += netdev_rx(dev, work_to_do - work_done);
+
+		if (work_done >= work_to_do) {
+			/* Keep the Rx bits for the next round. */
+			np->intr_status &= NATSEMI_RX_INTR;
+			*budget -= work_done;
+			dev->quota -= work_done;
+			return 1;
+		}
+
+		np->intr_status = readl(ioaddr + IntrStatus);
+	} while (np->intr_status);
+
+	*budget -= work_done;
+	dev->quota -= work_done;
+
+	netif_rx_complete(dev);
+
+	/* Reenable interrupts providing nothing is trying to shut
+	   the chip down. */
+	spin_lock_irq(&np->lock);
+	if (!np->hands_off && netif_running(dev))
+		writel(1, ioaddr + IntrEnable);
+	spin_unlock_irq(&np->lock);
+
+	return 0;
+}
+
+#else /* !CONFIG_NATSEMI_NAPI */
+
 /* The interrupt handler does all of the Rx thread work and cleans up
    after the Tx thread. */
 static irqreturn_t intr_handler(int irq, void *dev_instance, struct pt_regs *rgs)
@@ -1738,14 +1968,27 @@ static irqreturn_t intr_handler(int irq, void *dev_instance, struct pt_regs *rgs
 	return IRQ_RETVAL(handled);
 }
 
+#endif /* CONFIG_NATSEMI_NAPI */
+
 /* This routine is logically part of the interrupt handler, but separated
-   for clarity and better register allocation. */
+   for clarity and better register allocation.  With NAPI it reaps at most
+   work_to_do frames and returns the number reaped. */
+#ifdef CONFIG_NATSEMI_NAPI
+static int netdev_rx(struct net_device *dev, int work_to_do)
+#else
 static void netdev_rx(struct net_device *dev)
+#endif
 {
 	struct netdev_private *np = dev->priv;
 	int entry = np->cur_rx % RX_RING_SIZE;
 	int boguscnt = np->dirty_rx + RX_RING_SIZE - np->cur_rx;
 	s32 desc_status = le32_to_cpu(np->rx_head_desc->cmd_status);
+#ifdef CONFIG_NATSEMI_NAPI
+	int work_done = 0;
+
+	if (boguscnt > work_to_do)
+		boguscnt = work_to_do;
+#endif
 
 	/* If the driver owns the next entry it's a new packet. Send it up. */
 	while (desc_status < 0) { /* e.g. & DescOwn */
@@ -1755,6 +1998,9 @@ static void netdev_rx(struct net_device *dev)
 				entry, desc_status);
 		if (--boguscnt < 0)
 			break;
+#ifdef CONFIG_NATSEMI_NAPI
+		work_done++;
+#endif
 		if ((desc_status&(DescMore|DescPktOK|DescRxLong)) != DescPktOK){
 			if (desc_status & DescMore) {
 				if (netif_msg_rx_err(np))
@@ -1808,7 +2054,11 @@ static void netdev_rx(struct net_device *dev)
 				np->rx_skbuff[entry] = NULL;
 			}
 			skb->protocol = eth_type_trans(skb, dev);
+#ifdef CONFIG_NATSEMI_NAPI
+			netif_receive_skb(skb);
+#else
 			netif_rx(skb);
+#endif
 			dev->last_rx = jiffies;
 			np->stats.rx_packets++;
 			np->stats.rx_bytes += pkt_len;
@@ -1824,6 +2074,9 @@ static void netdev_rx(struct net_device *dev)
 		mod_timer(&np->timer, jiffies + 1);
 	else
 		writel(RxOn, dev->base_addr + ChipCmd);
+#ifdef CONFIG_NATSEMI_NAPI
+	return work_done;
+#endif
 }
 
 static void netdev_error(struct net_device *dev, int intr_status)
@@ -2590,6 +2843,11 @@ static int natsemi_suspend (struct pci_dev *pdev, u32 state)
 	rtnl_lock();
 	if (netif_running (dev)) {
 		del_timer_sync(&np->timer);
+#ifdef CONFIG_NATSEMI_NAPI
+		/* Wait for a pending poll; none is scheduled once hands_off
+		   is set. */
+		netif_poll_disable(dev);
+#endif
 
 		disable_irq(dev->irq);
 		spin_lock_irq(&np->lock);
@@ -2601,6 +2859,9 @@ static int natsemi_suspend (struct pci_dev *pdev, u32 state)
 
 		spin_unlock_irq(&np->lock);
 		enable_irq(dev->irq);
+#ifdef CONFIG_NATSEMI_NAPI
+		netif_poll_enable(dev);
+#endif
 
 		/* Update the error counts. */
 		__get_stats(dev);
@@ -177,6 +177,9 @@ nlm_bind_host(struct nlm_host *host)
 	/* If we've already created an RPC client, check whether
 	 * RPC rebind is required
 	 * Note: why keep rebinding if we're on a tcp connection?
+	 * Only the head transport is looked at: a UDP client has no
+	 * other, and the port is the client's, so the next call_bind()
+	 * sets it on every connection through xprt_set_port().
 	 */
 	if ((clnt = host->h_rpcclnt) != NULL) {
 		xprt = clnt->cl_xprt;
@@ -580,7 +580,8 @@ nfs3svc_encode_readres(struct svc_rqst *rqstp, u32 *p,
 		*p++ = htonl(resp->count);
 		*p++ = htonl(resp->eof);
 		*p++ = htonl(resp->count);	/* xdr opaque count */
-		p += XDR_QUADLEN(resp->count);
+		if (!rqstp->rq_nrpages)		/* else sent from the pages */
+			p += XDR_QUADLEN(resp->count);
 	}
 	return xdr_ressize_check(rqstp, p);
 }
@@ -4,6 +4,12 @@
  * Request reply cache. This is currently a global cache, but this may
  * change in the future and be a per-client cache.
  *
+ * Entries live on hash chains keyed by xid and client address, each
+ * chain with its own lock and kept in LRU order, so threads working on
+ * different requests do not serialise on the cache.  The cache is sized
+ * from the amount of memory at startup and entries are allocated as
+ * chains fill up.
+ *
  * This code is heavily inspired by the 44BSD implementation, although
  * it does things a bit differently.
  *
@@ -14,6 +20,9 @@
 #include <linux/sched.h>
 #include <linux/slab.h>
 #include <linux/string.h>
+#include <linux/spinlock.h>
+#include <linux/jhash.h>
+#include <net/checksum.h>
 
 #include <linux/sunrpc/svc.h>
 #include <linux/nfsd/nfsd.h>
@@ -24,68 +33,75 @@
  * 4.4BSD:	256
  * Solaris2:	1024
  * DEC Unix:	512-4096
+ * We use one entry per 32 pages of memory, within these bounds.
  */
-#define CACHESIZE		1024
-#define HASHSIZE		64
-#define REQHASH(xid)		((((xid) >> 24) ^ (xid)) & (HASHSIZE-1))
+#define CACHESIZE_MIN		1024
+#define CACHESIZE_MAX		65536
+#define CHAINLEN		8	/* entries per hash chain */
+#define RC_EXPIRE		(120*HZ)
+#define RC_CSUMLEN		256	/* bytes of arguments checksummed */
 
 struct nfscache_head {
 	struct svc_cacherep *	next;
 	struct svc_cacherep *	prev;
+	spinlock_t		lock;
+	unsigned int		count;
 };
 
 static struct nfscache_head *	hash_list;
-static struct svc_cacherep *	lru_head;
-static struct svc_cacherep *	lru_tail;
-static struct svc_cacherep *	nfscache;
+static unsigned int		hash_mask;
+static unsigned long		hash_order;
+static kmem_cache_t *		nfscache_slab;
 static int			cache_disabled = 1;
 
+#define REQHASH(xid, addr)	(hash_list + (jhash_3words((xid), \
+					(addr)->sin_addr.s_addr, \
+					(addr)->sin_port, 0) & hash_mask))
+
 static int	nfsd_cache_append(struct svc_rqst *rqstp, struct svc_buf *data);
 
 void
 nfsd_cache_init(void)
 {
-	struct svc_cacherep	*rp;
 	struct nfscache_head	*rh;
-	size_t			i;
-	unsigned long		order;
-
-
-	i = CACHESIZE * sizeof (struct svc_cacherep);
-	for (order = 0; (PAGE_SIZE << order) < i; order++)
+	unsigned int		size, hsize, i;
+
+	size = num_physpages >> 5;
+	if (size < CACHESIZE_MIN)
+		size = CACHESIZE_MIN;
+	if (size > CACHESIZE_MAX)
+		size = CACHESIZE_MAX;
+	for (hsize = 1; hsize * CHAINLEN < size; hsize <<= 1)
 		;
-	nfscache = (struct svc_cacherep *)
-		__get_free_pages(GFP_KERNEL, order);
-	if (!nfscache) {
-		printk (KERN_ERR "nfsd: cannot allocate %Zd bytes for reply cache\n", i);
+
+	nfscache_slab = kmem_cache_create("nfsd_repcache",
+					  sizeof(struct svc_cacherep), 0,
+					  SLAB_HWCACHE_ALIGN, NULL, NULL);
+	if (!nfscache_slab) {
+		printk (KERN_ERR "nfsd: cannot create reply cache slab\n");
 		return;
 	}
-	memset(nfscache, 0, i);
 
-	i = HASHSIZE * sizeof (struct nfscache_head);
-	hash_list = kmalloc (i, GFP_KERNEL);
+	i = hsize * sizeof (struct nfscache_head);
+	for (hash_order = 0; (PAGE_SIZE << hash_order) < i; hash_order++)
+		;
+	hash_list = (struct nfscache_head *)
+		__get_free_pages(GFP_KERNEL, hash_order);
 	if (!hash_list) {
-		free_pages ((unsigned long)nfscache, order);
-		nfscache = NULL;
-		printk (KERN_ERR "nfsd: cannot allocate %Zd bytes for hash list\n", i);
+		kmem_cache_destroy(nfscache_slab);
+		nfscache_slab = NULL;
+		printk (KERN_ERR "nfsd: cannot allocate %u bytes for hash list\n", i);
 		return;
 	}
 
-	for (i = 0, rh = hash_list; i < HASHSIZE; i++, rh++)
+	for (i = 0, rh = hash_list; i < hsize; i++, rh++) {
 		rh->next = rh->prev = (struct svc_cacherep *) rh;
-
-	for (i = 0, rp = nfscache; i < CACHESIZE; i++, rp++) {
-		rp->c_state = RC_UNUSED;
-		rp->c_type = RC_NOCACHE;
-		rp->c_hash_next =
-		rp->c_hash_prev = rp;
-		rp->c_lru_next = rp + 1;
-		rp->c_lru_prev = rp - 1;
+		spin_lock_init(&rh->lock);
+		rh->count = 0;
 	}
-	lru_head = nfscache;
-	lru_tail = nfscache + CACHESIZE - 1;
-	lru_head->c_lru_prev = NULL;
-	lru_tail->c_lru_next = NULL;
+	hash_mask = hsize - 1;
+	nfsdstats.rcsize = hsize * CHAINLEN;
+	nfsdstats.rcentries = 0;
 
 	cache_disabled = 0;
 }
@@ -93,84 +109,102 @@ nfsd_cache_init(void)
 void
 nfsd_cache_shutdown(void)
 {
+	struct nfscache_head	*rh;
 	struct svc_cacherep	*rp;
-	size_t			i;
-	unsigned long		order;
-
-	for (rp = lru_head; rp; rp = rp->c_lru_next) {
-		if (rp->c_state == RC_DONE && rp->c_type == RC_REPLBUFF)
-			kfree(rp->c_replbuf.buf);
-	}
+	unsigned int		i;
 
+	if (cache_disabled)
+		return;
 	cache_disabled = 1;
 
-	i = CACHESIZE * sizeof (struct svc_cacherep);
-	for (order = 0; (PAGE_SIZE << order) < i; order++)
-		;
-	free_pages ((unsigned long)nfscache, order);
-	nfscache = NULL;
-	kfree (hash_list);
+	for (i = 0, rh = hash_list; i <= hash_mask; i++, rh++) {
+		while ((rp = rh->next) != (struct svc_cacherep *) rh) {
+			rh->next = rp->c_hash_next;
+			if (rp->c_type == RC_REPLBUFF)
+				kfree(rp->c_replbuf.buf);
+			kmem_cache_free(nfscache_slab, rp);
+		}
+	}
+	nfsdstats.rcentries = 0;
+
+	free_pages ((unsigned long)hash_list, hash_order);
 	hash_list = NULL;
+	kmem_cache_destroy(nfscache_slab);
+	nfscache_slab = NULL;
 }
 
 /*
- * Move cache entry to front of LRU list
+ * Move a cache entry to the front (most recently used end) or the
+ * back of its hash chain.  The chain lock must be held.
  */
+static inline void
+hash_unlink(struct svc_cacherep *rp)
+{
+	rp->c_hash_prev->c_hash_next = rp->c_hash_next;
+	rp->c_hash_next->c_hash_prev = rp->c_hash_prev;
+}
+
 static void
-lru_put_front(struct svc_cacherep *rp)
+hash_put_front(struct nfscache_head *rh, struct svc_cacherep *rp)
 {
-	struct svc_cacherep	*prev = rp->c_lru_prev,
-				*next = rp->c_lru_next;
-
-	if (prev)
-		prev->c_lru_next = next;
-	else
-		lru_head = next;
-	if (next)
-		next->c_lru_prev = prev;
-	else
-		lru_tail = prev;
-
-	rp->c_lru_next = lru_head;
-	rp->c_lru_prev = NULL;
-	if (lru_head)
-		lru_head->c_lru_prev = rp;
-	lru_head = rp;
+	hash_unlink(rp);
+	rp->c_hash_next = rh->next;
+	rp->c_hash_prev = (struct svc_cacherep *) rh;
+	rh->next->c_hash_prev = rp;
+	rh->next = rp;
 }
 
-/*
- * Move a cache entry from one hash list to another
- */
 static void
-hash_refile(struct svc_cacherep *rp)
+hash_put_back(struct nfscache_head *rh, struct svc_cacherep *rp)
 {
-	struct svc_cacherep	*prev = rp->c_hash_prev,
-				*next = rp->c_hash_next;
-	struct nfscache_head	*head = hash_list + REQHASH(rp->c_xid);
+	hash_unlink(rp);
+	rp->c_hash_next = (struct svc_cacherep *) rh;
+	rp->c_hash_prev = rh->prev;
+	rh->prev->c_hash_next = rp;
+	rh->prev = rp;
+}
 
-	prev->c_hash_next = next;
-	next->c_hash_prev = prev;
+static inline int
+nfsd_cache_expired(struct svc_cacherep *rp)
+{
+	return rp->c_state == RC_UNUSED ||
+		!time_before(jiffies, rp->c_timestamp + RC_EXPIRE);
+}
 
-	rp->c_hash_next = head->next;
-	rp->c_hash_prev = (struct svc_cacherep *) head;
-	head->next->c_hash_prev = rp;
-	head->next = rp;
+/*
+ * Checksum the start of the call arguments, so that a client reusing
+ * an xid for a different call (e.g. after a reboot) does not get
+ * another call's reply.
+ */
+static inline u32
+nfsd_cache_csum(struct svc_rqst *rqstp)
+{
+	struct svc_buf	*argp = &rqstp->rq_argbuf;
+	int		len = argp->len << 2;
+
+	if (len > RC_CSUMLEN)
+		len = RC_CSUMLEN;
+	return csum_partial((unsigned char *) argp->buf, len, 0);
 }
 
 /*
  * Try to find an entry matching the current call in the cache. When none
- * is found, we grab the oldest unlocked entry off the LRU list.
- * Note that no operation within the loop may sleep.
+ * is found, we take the oldest idle entry of the hash chain if the chain
+ * is full or that entry has expired, and allocate a new one otherwise.
+ * Note that no operation under the chain lock may sleep.
  */
 int
 nfsd_cache_lookup(struct svc_rqst *rqstp, int type)
 {
-	struct svc_cacherep	*rh, *rp;
+	struct nfscache_head	*rh;
+	struct svc_cacherep	*rp;
 	u32			xid = rqstp->rq_xid,
 				proto =  rqstp->rq_prot,
 				vers = rqstp->rq_vers,
-				proc = rqstp->rq_proc;
+				proc = rqstp->rq_proc,
+				csum;
 	unsigned long		age;
+	int			rtn;
 
 	rqstp->rq_cacherep = NULL;
 	if (cache_disabled || type == RC_NOCACHE) {
@@ -178,12 +212,16 @@ nfsd_cache_lookup(struct svc_rqst *rqstp, int type)
 		return RC_DOIT;
 	}
 
-	rp = rh = (struct svc_cacherep *) &hash_list[REQHASH(xid)];
-	while ((rp = rp->c_hash_next) != rh) {
+	csum = nfsd_cache_csum(rqstp);
+	rh = REQHASH(xid, &rqstp->rq_addr);
+	spin_lock(&rh->lock);
+
+	for (rp = rh->next; rp != (struct svc_cacherep *) rh; rp = rp->c_hash_next) {
 		if (rp->c_state != RC_UNUSED &&
 		    xid == rp->c_xid && proc == rp->c_proc &&
 		    proto == rp->c_prot && vers == rp->c_vers &&
-		    time_before(jiffies, rp->c_timestamp + 120*HZ) &&
+		    csum == rp->c_csum &&
+		    time_before(jiffies, rp->c_timestamp + RC_EXPIRE) &&
 		    memcmp((char*)&rqstp->rq_addr, (char*)&rp->c_addr, sizeof(rp->c_addr))==0) {
 			nfsdstats.rchits++;
 			goto found_entry;
@@ -191,85 +229,85 @@ nfsd_cache_lookup(struct svc_rqst *rqstp, int type)
 	}
 	nfsdstats.rcmisses++;
 
-	/* This loop shouldn't take more than a few iterations normally */
-	{
-	int	safe = 0;
-	for (rp = lru_tail; rp; rp = rp->c_lru_prev) {
+	for (rp = rh->prev; rp != (struct svc_cacherep *) rh; rp = rp->c_hash_prev) {
 		if (rp->c_state != RC_INPROG)
 			break;
-		if (safe++ > CACHESIZE) {
-			printk("nfsd: loop in repcache LRU list\n");
-			cache_disabled = 1;
-			return RC_DOIT;
-		}
-	}
 	}
 
-	/* This should not happen */
-	if (rp == NULL) {
-		static int	complaints;
-
-		printk(KERN_WARNING "nfsd: all repcache entries locked!\n");
-		if (++complaints > 5) {
-			printk(KERN_WARNING "nfsd: disabling repcache.\n");
-			cache_disabled = 1;
+	if (rp != (struct svc_cacherep *) rh &&
+	    (rh->count >= CHAINLEN || nfsd_cache_expired(rp))) {
+		if (!nfsd_cache_expired(rp))
+			nfsdstats.rcevictions++;
+		/* release any buffer */
+		if (rp->c_type == RC_REPLBUFF) {
+			kfree(rp->c_replbuf.buf);
+			rp->c_replbuf.buf = NULL;
 		}
-		return RC_DOIT;
+	} else {
+		/* Chain full of calls in progress: don't cache this one */
+		if (rh->count >= CHAINLEN ||
+		    !(rp = kmem_cache_alloc(nfscache_slab, SLAB_ATOMIC))) {
+			spin_unlock(&rh->lock);
+			return RC_DOIT;
+		}
+		rp->c_hash_next = rp->c_hash_prev = rp;
+		rh->count++;
+		nfsdstats.rcentries++;
 	}
 
 	rqstp->rq_cacherep = rp;
 	rp->c_state = RC_INPROG;
+	rp->c_type = RC_NOCACHE;
 	rp->c_xid = xid;
 	rp->c_proc = proc;
 	rp->c_addr = rqstp->rq_addr;
 	rp->c_prot = proto;
 	rp->c_vers = vers;
+	rp->c_csum = csum;
 	rp->c_timestamp = jiffies;
+	hash_put_front(rh, rp);
 
-	hash_refile(rp);
-
-	/* release any buffer */
-	if (rp->c_type == RC_REPLBUFF) {
-		kfree(rp->c_replbuf.buf);
-		rp->c_replbuf.buf = NULL;
-	}
-	rp->c_type = RC_NOCACHE;
-
+	spin_unlock(&rh->lock);
 	return RC_DOIT;
 
 found_entry:
 	/* We found a matching entry which is either in progress or done. */
 	age = jiffies - rp->c_timestamp;
 	rp->c_timestamp = jiffies;
-	lru_put_front(rp);
+	hash_put_front(rh, rp);
 
 	/* Request being processed or excessive rexmits */
+	rtn = RC_DROPIT;
 	if (rp->c_state == RC_INPROG || age < RC_DELAY)
-		return RC_DROPIT;
+		goto out;
 
 	/* From the hall of fame of impractical attacks:
 	 * Is this a user who tries to snoop on the cache? */
+	rtn = RC_DOIT;
 	if (!rqstp->rq_secure && rp->c_secure)
-		return RC_DOIT;
+		goto out;
 
 	/* Compose RPC reply header */
 	switch (rp->c_type) {
 	case RC_NOCACHE:
-		return RC_DOIT;
+		break;
 	case RC_REPLSTAT:
 		svc_putlong(&rqstp->rq_resbuf, rp->c_replstat);
+		rtn = RC_REPLY;
 		break;
 	case RC_REPLBUFF:
-		if (!nfsd_cache_append(rqstp, &rp->c_replbuf))
-			return RC_DOIT;	/* should not happen */
+		if (nfsd_cache_append(rqstp, &rp->c_replbuf))
+			rtn = RC_REPLY;	/* else should not happen */
 		break;
 	default:
 		printk(KERN_WARNING "nfsd: bad repcache type %d\n", rp->c_type);
 		rp->c_state = RC_UNUSED;
-		return RC_DOIT;
+		break;
 	}
 
-	return RC_REPLY;
+out:
+	spin_unlock(&rh->lock);
+	return rtn;
 }
 
 /*
@@ -292,20 +330,29 @@ void
 nfsd_cache_update(struct svc_rqst *rqstp, int cachetype, u32 *statp)
 {
 	struct svc_cacherep *rp;
-	struct svc_buf	*resp = &rqstp->rq_resbuf, *cachp;
+	struct nfscache_head *rh;
+	struct svc_buf	*resp = &rqstp->rq_resbuf;
+	u32		*buf = NULL;
 	int		len;
 
 	if (!(rp = rqstp->rq_cacherep) || cache_disabled)
 		return;
+	rh = REQHASH(rp->c_xid, &rp->c_addr);
 
 	len = resp->len - (statp - resp->base);
 	
 	/* Don't cache excessive amounts of data and XDR failures */
-	if (!statp || len > (256 >> 2)) {
-		rp->c_state = RC_UNUSED;
-		return;
+	if (!statp || len > (256 >> 2))
+		goto unused;
+
+	if (cachetype == RC_REPLBUFF) {
+		buf = (u32 *) kmalloc(len << 2, GFP_KERNEL);
+		if (!buf)
+			goto unused;
+		memcpy(buf, statp, len << 2);
 	}
 
+	spin_lock(&rh->lock);
 	switch (cachetype) {
 	case RC_REPLSTAT:
 		if (len != 1)
@@ -313,24 +360,25 @@ nfsd_cache_update(struct svc_rqst *rqstp, int cachetype, u32 *statp)
 		rp->c_replstat = *statp;
 		break;
 	case RC_REPLBUFF:
-		cachp = &rp->c_replbuf;
-		cachp->buf = (u32 *) kmalloc(len << 2, GFP_KERNEL);
-		if (!cachp->buf) {
-			rp->c_state = RC_UNUSED;
-			return;
-		}
-		cachp->len = len;
-		memcpy(cachp->buf, statp, len << 2);
+		rp->c_replbuf.buf = buf;
+		rp->c_replbuf.len = len;
 		break;
 	}
 
-	lru_put_front(rp);
+	hash_put_front(rh, rp);
 	rp->c_secure = rqstp->rq_secure;
 	rp->c_type = cachetype;
 	rp->c_state = RC_DONE;
 	rp->c_timestamp = jiffies;
-
+	spin_unlock(&rh->lock);
 	return;
+
+unused:
+	/* Make the entry the first to be reused */
+	spin_lock(&rh->lock);
+	rp->c_state = RC_UNUSED;
+	hash_put_back(rh, rp);
+	spin_unlock(&rh->lock);
 }
 
 /*
@@ -377,7 +377,8 @@ nfssvc_encode_readres(struct svc_rqst *rqstp, u32 *p,
 {
 	p = encode_fattr(rqstp, p, &resp->fh);
 	*p++ = htonl(resp->count);
-	p += XDR_QUADLEN(resp->count);
+	if (!rqstp->rq_nrpages)		/* else sent from the pages */
+		p += XDR_QUADLEN(resp->count);
 
 	return xdr_ressize_check(rqstp, p);
 }
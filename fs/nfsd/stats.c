@@ -8,6 +8,9 @@
  * Format:
  *	rc <hits> <misses> <nocache>
  *			Statistsics for the reply cache
+ *	rcx <evictions> <entries> <max-entries>
+ *			reply cache entries reused before they expired,
+ *			entries allocated and the size limit
  *	fh <stale> <total-lookups> <anonlookups> <dir-not-in-dcache> <nondir-not-in-dcache>
  *			statistics for filehandle lookup
  *	io <bytes-read> <bytes-writtten>
@@ -45,10 +48,14 @@ nfsd_proc_read(char *buffer, char **start, off_t offset, int count,
 	int	len;
 	int	i;
 
-	len = sprintf(buffer, "rc %u %u %u\nfh %u %u %u %u %u\nio %u %u\n",
+	len = sprintf(buffer, "rc %u %u %u\nrcx %u %u %u\n"
+		      "fh %u %u %u %u %u\nio %u %u\n",
 		      nfsdstats.rchits,
 		      nfsdstats.rcmisses,
 		      nfsdstats.rcnocache,
+		      nfsdstats.rcevictions,
+		      nfsdstats.rcentries,
+		      nfsdstats.rcsize,
 		      nfsdstats.fh_stale,
 		      nfsdstats.fh_lookup,
 		      nfsdstats.fh_anon,
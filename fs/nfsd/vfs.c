@@ -35,6 +35,8 @@
 #include <linux/module.h>
 
 #include <linux/sunrpc/svc.h>
+#include <linux/sunrpc/svcsock.h>
+#include <linux/pagemap.h>
 #include <linux/nfsd/nfsd.h>
 #ifdef CONFIG_NFSD_V3
 #include <linux/nfs3.h>
@@ -586,9 +588,40 @@ found:
 	return ra;
 }
 
+/*
+ * Read actor for nfsd_read(): rather than copying the data, take a
+ * reference on the page cache page and hang it off the reply.
+ */
+static int
+nfsd_read_actor(read_descriptor_t *desc, struct page *page,
+		unsigned long offset, unsigned long size)
+{
+	struct svc_rqst	*rqstp = (struct svc_rqst *) desc->buf;
+	struct svc_page	*p;
+
+	if (rqstp->rq_nrpages == RPCSVC_MAXPAGES)
+		return 0;
+	if (size > desc->count)
+		size = desc->count;
+
+	page_cache_get(page);
+	p = &rqstp->rq_respages[rqstp->rq_nrpages++];
+	p->page = page;
+	p->offset = offset;
+	p->len = size;
+	rqstp->rq_pagelen += size;
+
+	desc->count -= size;
+	desc->written += size;
+	return size;
+}
+
 /*
  * Read data from a file. count must contain the requested read count
  * on entry. On return, *count contains the number of bytes actually read.
+ * If the transport takes pages and the file lives in the page cache, the
+ * data is not copied to buf but referenced from rqstp->rq_respages, and
+ * the XDR encoder must leave it out of rq_resbuf.
  * N.B. After this call fhp needs an fh_put
  */
 int
@@ -623,9 +656,25 @@ nfsd_read(struct svc_rqst *rqstp, struct svc_fh *fhp, loff_t offset,
 	}
 	file.f_pos = offset;
 
-	oldfs = get_fs(); set_fs(KERNEL_DS);
-	err = file.f_op->read(&file, buf, *count, &file.f_pos);
-	set_fs(oldfs);
+	if (rqstp->rq_sock->sk_pages && file.f_op->read == generic_file_read
+	    && !(file.f_flags & O_DIRECT)) {
+		read_descriptor_t desc;
+
+		desc.written = 0;
+		desc.count = *count;
+		desc.buf = (char *) rqstp;
+		desc.error = 0;
+		if (*count)
+			do_generic_file_read(&file, &file.f_pos, &desc,
+					     nfsd_read_actor);
+		err = desc.written;
+		if (!err)
+			err = desc.error;
+	} else {
+		oldfs = get_fs(); set_fs(KERNEL_DS);
+		err = file.f_op->read(&file, buf, *count, &file.f_pos);
+		set_fs(oldfs);
+	}
 
 	/* Write back readahead params */
 	if (ra != NULL) {
@@ -52,6 +52,12 @@ static inline cycles_t get_cycles (void)
 
 extern unsigned long cpu_khz;
 
+#ifdef CONFIG_DYNAMIC_TICK
+extern int dyntick_skipping;
+extern void dyntick_idle(void);
+extern void dyntick_wakeup(int irq);
+#endif
+
 #define vxtime_lock()		do {} while (0)
 #define vxtime_unlock()		do {} while (0)
 
@@ -34,6 +34,9 @@
 enum brlock_indices {
 	BR_GLOBALIRQ_LOCK,
 	BR_NETPROTO_LOCK,
+	BR_CONNTRACK_LOCK,
+	BR_RT_CACHE_LOCK,
+	BR_TCP_EHASH_LOCK,
 
 	__BR_END
 };
@@ -98,6 +98,15 @@ struct crypto_alg {
 	unsigned int cra_ctxsize;
 	const char cra_name[CRYPTO_MAX_ALG_NAME];
 
+	/*
+	 * Several implementations of one algorithm may be registered under
+	 * the same cra_name; a lookup by that name gets the one with the
+	 * highest cra_priority.  cra_driver_name names one implementation
+	 * and can be looked up too; it defaults to cra_name.
+	 */
+	const char cra_driver_name[CRYPTO_MAX_ALG_NAME];
+	int cra_priority;
+
 	union {
 		struct cipher_alg cipher;
 		struct digest_alg digest;
@@ -212,6 +221,13 @@ static inline const char *crypto_tfm_alg_name(struct crypto_tfm *tfm)
 	return tfm->__crt_alg->cra_name;
 }
 
+static inline const char *crypto_tfm_alg_driver_name(struct crypto_tfm *tfm)
+{
+	struct crypto_alg *alg = tfm->__crt_alg;
+
+	return alg->cra_driver_name[0] ? alg->cra_driver_name : alg->cra_name;
+}
+
 static inline const char *crypto_tfm_alg_modname(struct crypto_tfm *tfm)
 {
 	struct crypto_alg *alg = tfm->__crt_alg;
@@ -0,0 +1,63 @@
+#ifndef _LINUX_HRTIMER_H
+#define _LINUX_HRTIMER_H
+
+#include <linux/config.h>
+#include <linux/types.h>
+#include <linux/time.h>
+#include <linux/rbtree.h>
+
+/*
+ * High-resolution timers: one-shot timers on the nanosecond clock of
+ * hrtimer_now(), next to the jiffy timer wheel. They only run at better
+ * than jiffy resolution while hrtimer_active is set, which is up to the
+ * architecture; without it callers use the wheel as before.
+ *
+ * The function is called from the timer interrupt, with interrupts
+ * disabled. It may start the timer again.
+ */
+struct hrtimer {
+	rb_node_t node;
+	u64 expires;			/* hrtimer_now() time, in ns */
+	unsigned long data;
+	void (*function)(unsigned long);
+	int pending;
+};
+
+#define HRTIMER_NEVER	(~0ULL)
+
+extern int hrtimer_active;
+
+extern void hrtimer_start(struct hrtimer *timer, u64 expires);
+extern int hrtimer_cancel(struct hrtimer *timer);
+extern u64 hrtimer_run_queue(void);
+extern u64 hrtimer_next_expiry(void);
+extern long hrtimer_nanosleep(struct timespec *t, struct timespec *rmtp);
+
+/* Provided by the architecture */
+extern u64 hrtimer_now(void);
+extern void hrtimer_program(u64 expires);
+
+static inline void init_hrtimer(struct hrtimer *timer)
+{
+	timer->pending = 0;
+}
+
+static inline int hrtimer_pending(const struct hrtimer *timer)
+{
+	return timer->pending;
+}
+
+static inline u64 timespec_to_ns(const struct timespec *ts)
+{
+	return (u64)ts->tv_sec * 1000000000 + ts->tv_nsec;
+}
+
+static inline u64 timeval_to_ns(const struct timeval *tv)
+{
+	return (u64)tv->tv_sec * 1000000000 + tv->tv_usec * 1000;
+}
+
+extern void ns_to_timespec(u64 ns, struct timespec *ts);
+extern void ns_to_timeval(u64 ns, struct timeval *tv);
+
+#endif
@@ -684,9 +684,33 @@ struct ide_settings_s;
  */
 typedef enum {
 	ide_stopped,	/* no drive operation was started */
-	ide_started	/* a drive operation was started, handler was set */
+	ide_started,	/* a drive operation was started, handler was set */
+	ide_released	/* queued commands are out, the bus is free again */
 } ide_startstop_t;
 
+#define IDE_MAX_TAGS	32
+
+/*
+ * Tagged command queueing state of a drive (ide-tcq.c)
+ */
+typedef struct ide_tag_info_s {
+	struct request	*tags[IDE_MAX_TAGS];	/* outstanding commands */
+	unsigned long	tag_map;		/* tags in use */
+	int		queue_depth;		/* tags we may use */
+	int		max_depth;		/* tags the drive has */
+	int		active;			/* commands out now */
+	int		tag;			/* tag moving data, -1 if none */
+	int		timedout;		/* set by the timer for the handler */
+
+	unsigned long	issued;			/* queued commands sent */
+	unsigned long	depth_sum;		/* sum of queue depths at issue */
+	unsigned long	depth_hist[IDE_MAX_TAGS];/* issues by queue depth */
+	unsigned long	immediate;		/* data moved without a release */
+	unsigned long	released;		/* drive let go of the bus */
+	unsigned long	serviced;		/* SERVICE commands issued */
+	unsigned long	fallbacks;		/* errors that turned queueing off */
+} ide_tag_info_t;
+
 
 typedef struct ide_drive_s {
 	char		name[4];	/* drive name, such as "hda" */
@@ -699,6 +723,7 @@ typedef struct ide_drive_s {
 	struct ide_drive_s 	*next;	/* circular list of hwgroup drives */
 	struct ide_driver_s	*driver;/* (ide_driver_t *) */
 	void		*driver_data;	/* extra driver data */
+	ide_tag_info_t	*tcq;		/* queueing state, if capable */
 	struct hd_driveid	*id;	/* drive model identification info */
 	struct hd_struct	*part;	/* drive partition table */
 	struct proc_dir_entry *proc;	/* /proc/ide/ directory entry */
@@ -730,6 +755,7 @@ typedef struct ide_drive_s {
 
 	unsigned present	: 1;	/* drive is physically present */
 	unsigned noprobe 	: 1;	/* from:  hdx=noprobe */
+	unsigned probe_empty	: 1;	/* from:  hdx=empty, found empty last time */
 	unsigned busy		: 1;	/* currently doing revalidate_disk() */
 	unsigned removable	: 1;	/* 1 if need to do check_media_change */
 	unsigned is_flash	: 1;	/* 1 if probed as flash */
@@ -1004,6 +1030,9 @@ typedef struct hwif_s {
 	unsigned	highmem    : 1;	/* can do full 32-bit dma */
 	unsigned	no_dsc     : 1;	/* 0 default, 1 dsc_overlap disabled */
 	unsigned	sata	   : 1; /* 0 PATA, 1 SATA */
+	unsigned	probed	   : 1;	/* probe_hwif() has looked at it */
+
+	unsigned long	probe_time;	/* jiffies probe_hwif() took */
 
 	void		*hwif_data;	/* extra hwif data */
 } ide_hwif_t;
@@ -1025,6 +1054,8 @@ typedef struct hwgroup_s {
 	volatile int busy;
 		/* BOOL: wake us up on timer expiry */
 	int sleeping;
+		/* BOOL: handler waits for queued commands, bus is free */
+	int released;
 		/* current drive */
 	ide_drive_t *drive;
 		/* ptr to current hwif in linked-list */
@@ -1255,6 +1286,7 @@ extern	ide_devices_t	*idescsi;
 
 #endif
 extern int noautodma;
+extern int ide_serial_probe;
 
 /*
  * We need blk.h, but we replace its end_request by our own version.
@@ -1271,6 +1303,7 @@ extern int ide_end_request(ide_drive_t *, int /* uptodate */);
  * and also to start the safety timer.
  */
 extern void ide_set_handler(ide_drive_t *, ide_handler_t *, unsigned int, ide_expiry_t *);
+extern void __ide_set_handler(ide_drive_t *, ide_handler_t *, unsigned int, ide_expiry_t *);
 
 /*
  * This is used on exit from the driver to designate the next irq handler
@@ -1689,6 +1722,7 @@ extern void ide_setup_pci_devices(struct pci_dev *, struct pci_dev *, ide_pci_de
 #ifdef CONFIG_BLK_DEV_IDEDMA_PCI
 extern int ide_build_dmatable(ide_drive_t *, struct request *, int);
 extern void ide_destroy_dmatable(ide_drive_t *);
+extern int ide_start_dma(ide_drive_t *, struct request *, int);
 extern ide_startstop_t ide_dma_intr(ide_drive_t *);
 extern int ide_release_dma(ide_hwif_t *);
 extern void ide_setup_dma(ide_hwif_t *, unsigned long, unsigned int);
@@ -1716,6 +1750,20 @@ static inline void ide_setup_dma(ide_hwif_t *x, unsigned long y, unsigned int z)
 static inline void ide_release_dma(ide_hwif_t *x) {;}
 #endif
 
+#ifdef CONFIG_BLK_DEV_IDE_TCQ
+extern void ide_tcq_init(ide_drive_t *);
+extern void ide_tcq_exit(ide_drive_t *);
+extern int ide_tcq_enable(ide_drive_t *, int);
+extern int ide_tcq_blocked(ide_drive_t *);
+extern void ide_tcq_rearm(ide_drive_t *);
+extern ide_startstop_t ide_tcq_do_rw(ide_drive_t *, struct request *, unsigned long);
+#define ide_tcq_timedout(drive)	((drive)->tcq != NULL && (drive)->tcq->timedout)
+#else
+#define ide_tcq_blocked(drive)	0
+#define ide_tcq_rearm(drive)	do { } while (0)
+#define ide_tcq_timedout(drive)	0
+#endif /* CONFIG_BLK_DEV_IDE_TCQ */
+
 extern void hwif_unregister(ide_hwif_t *);
 
 extern void ide_probe_reset(ide_hwif_t *);
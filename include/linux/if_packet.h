@@ -39,6 +39,9 @@ struct sockaddr_ll
 #define PACKET_RX_RING			5
 #define PACKET_STATISTICS		6
 #define PACKET_COPY_THRESH		7
+#define PACKET_TX_RING			8
+#define PACKET_TX_STATISTICS		9
+#define PACKET_RING_FILL		10
 
 struct tpacket_stats
 {
@@ -46,6 +49,23 @@ struct tpacket_stats
 	unsigned int	tp_drops;
 };
 
+/* Counts since the TX ring was set up */
+struct tpacket_tx_stats
+{
+	unsigned int	tp_packets;	/* Frames handed to the device */
+	unsigned int	tp_completed;	/* ... and given back to the user */
+	unsigned int	tp_drops;	/* Of those, dropped by the queue */
+	unsigned int	tp_wrong_format;
+};
+
+struct tpacket_fill
+{
+	unsigned int	tp_rx_frames;
+	unsigned int	tp_rx_user;	/* RX frames not yet given back */
+	unsigned int	tp_tx_frames;
+	unsigned int	tp_tx_sending;	/* TX frames not yet completed */
+};
+
 struct tpacket_hdr
 {
 	unsigned long	tp_status;
@@ -54,6 +74,11 @@ struct tpacket_hdr
 #define TP_STATUS_COPY		2
 #define TP_STATUS_LOSING	4
 #define TP_STATUS_CSUMNOTREADY	8
+/* TX ring */
+#define TP_STATUS_AVAILABLE	0
+#define TP_STATUS_SEND_REQUEST	1
+#define TP_STATUS_SENDING	2
+#define TP_STATUS_WRONG_FORMAT	4
 	unsigned int	tp_len;
 	unsigned int	tp_snaplen;
 	unsigned short	tp_mac;
@@ -65,6 +90,7 @@ struct tpacket_hdr
 #define TPACKET_ALIGNMENT	16
 #define TPACKET_ALIGN(x)	(((x)+TPACKET_ALIGNMENT-1)&~(TPACKET_ALIGNMENT-1))
 #define TPACKET_HDRLEN		(TPACKET_ALIGN(sizeof(struct tpacket_hdr)) + sizeof(struct sockaddr_ll))
+#define TPACKET_TX_HDRLEN	TPACKET_ALIGN(sizeof(struct tpacket_hdr))
 
 /*
    Frame structure:
@@ -77,6 +103,21 @@ struct tpacket_hdr
    - Start+tp_mac: [ Optional MAC header ]
    - Start+tp_net: Packet data, aligned to TPACKET_ALIGNMENT=16.
    - Pad to align to TPACKET_ALIGNMENT=16
+
+   TX frame structure:
+
+   - Start. Frame must be aligned to TPACKET_ALIGNMENT=16
+   - struct tpacket_hdr, only tp_status and tp_len are used
+   - Start+TPACKET_TX_HDRLEN: tp_len bytes of packet data, with the
+     MAC header for SOCK_RAW sockets
+
+   The user fills a frame and sets it to TP_STATUS_SEND_REQUEST; send()
+   then hands all the requested frames from the kernel's position on to
+   the device. Frames the kernel copies are TP_STATUS_AVAILABLE again at
+   once; large frames sent straight out of the ring are TP_STATUS_SENDING
+   until the device is done with them. Frames that could not be sent at
+   all become TP_STATUS_WRONG_FORMAT. The TX ring is mapped after the RX
+   ring.
  */
 
 struct tpacket_req
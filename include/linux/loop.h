@@ -17,6 +17,8 @@
 
 #ifdef __KERNEL__
 
+struct page;
+
 /* Possible states of device */
 enum {
 	Lo_unbound,
@@ -35,6 +37,10 @@ struct loop_device {
 	int		(*transfer)(struct loop_device *, int cmd,
 				    char *raw_buf, char *loop_buf, int size,
 				    int real_block);
+	int		(*transfer_page)(struct loop_device *, int cmd,
+				    struct page *raw_page, unsigned raw_off,
+				    struct page *loop_page, unsigned loop_off,
+				    int size, unsigned long sector);
 	char		lo_name[LO_NAME_SIZE];
 	char		lo_encrypt_key[LO_KEY_SIZE];
 	__u32           lo_init[2];
@@ -56,6 +62,7 @@ struct loop_device {
 	struct semaphore	lo_ctl_mutex;
 	struct semaphore	lo_bh_mutex;
 	atomic_t		lo_pending;
+	int			lo_workers;	/* threads serving lo_bh */
 };
 
 typedef	int (* transfer_proc_t)(struct loop_device *, int cmd,
@@ -122,6 +129,7 @@ struct loop_info {
 #define LO_CRYPT_IDEA     6
 #define LO_CRYPT_DUMMY    9
 #define LO_CRYPT_SKIPJACK 10
+#define LO_CRYPT_CRYPTOAPI 18	/* lo_name is "cipher" or "cipher-mode" */
 #define MAX_LO_CRYPT	20
 
 #ifdef __KERNEL__
@@ -137,6 +145,16 @@ struct loop_func_table {
 	/* lock and unlock manage the module use counts */ 
 	void (*lock)(struct loop_device *);
 	void (*unlock)(struct loop_device *);
+	/*
+	 * optional: transfer between pages, for filters that can work
+	 * on highmem pages without having them kmapped. Used instead of
+	 * transfer when set; sector is the 512-byte sector of the loop
+	 * device the data starts at.
+	 */
+	int (*transfer_page)(struct loop_device *lo, int cmd,
+			     struct page *raw_page, unsigned raw_off,
+			     struct page *loop_page, unsigned loop_off,
+			     int size, unsigned long sector);
 }; 
 
 int  loop_register_transfer(struct loop_func_table *funcs);
@@ -2,6 +2,8 @@
 #define _IP_CONNTRACK_CORE_H
 #include <linux/netfilter.h>
 #include <linux/netfilter_ipv4/lockhelp.h>
+#include <linux/smp.h>
+#include <linux/cache.h>
 
 /* This header is used to share core functionality between the
    standalone connection tracking module, and the compatibility layer's use
@@ -45,8 +47,41 @@ static inline int ip_conntrack_confirm(struct sk_buff *skb)
 	return NF_ACCEPT;
 }
 
-extern struct list_head *ip_conntrack_hash;
+/* A hash chain and the lock for it.  Hold BR_CONNTRACK_LOCK for
+   reading while using any bucket: ip_conntrack_resize() replaces the
+   whole array under the write side. */
+struct ip_conntrack_bucket
+{
+	struct list_head chain;
+	rwlock_t lock;
+};
+
+extern struct ip_conntrack_bucket *ip_conntrack_hash;
+/* Most buckets ip_conntrack_resize() will allocate. */
+#define IP_CONNTRACK_MAX_BUCKETS	(1 << 18)
+extern int ip_conntrack_resize(unsigned int size);
+extern atomic_t ip_conntrack_count;
 extern struct list_head ip_conntrack_expect_list;
+
+/* Per-CPU event counters, shown in /proc/net/ip_conntrack_stat. */
+struct ip_conntrack_stat
+{
+	unsigned int searched;		/* Hash entries looked at */
+	unsigned int found;		/* Successful lookups */
+	unsigned int new;		/* Conntracks allocated */
+	unsigned int insert;		/* Confirmed into the hash */
+	unsigned int insert_failed;	/* Lost the race to confirm */
+	unsigned int drop;		/* Table full, nothing to evict */
+	unsigned int early_drop;	/* Unreplied entry evicted */
+	unsigned int delete;		/* Removed from the hash */
+} ____cacheline_aligned;
+
+extern struct ip_conntrack_stat ip_conntrack_stat[NR_CPUS];
+
+#define CONNTRACK_STAT_ADD(field, n) \
+	(ip_conntrack_stat[smp_processor_id()].field += (n))
+#define CONNTRACK_STAT_INC(field)	CONNTRACK_STAT_ADD(field, 1)
+
 DECLARE_RWLOCK_EXTERN(ip_conntrack_lock);
 #endif /* _IP_CONNTRACK_CORE_H */
 
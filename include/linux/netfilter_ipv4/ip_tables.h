@@ -431,6 +431,9 @@ struct ipt_table
 
 	/* Set this to THIS_MODULE if you are a module, otherwise NULL */
 	struct module *me;
+
+	/* Nonzero: never use the rule index (the benchmark table) */
+	int noindex;
 };
 
 extern int ipt_register_table(struct ipt_table *table);
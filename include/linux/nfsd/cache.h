@@ -15,13 +15,11 @@
 
 /*
  * Representation of a reply cache entry. The first two members *must*
- * be hash_next and hash_prev.
+ * be hash_next and hash_prev.  Hash chains are kept in LRU order.
  */
 struct svc_cacherep {
 	struct svc_cacherep *	c_hash_next;
 	struct svc_cacherep *	c_hash_prev;
-	struct svc_cacherep *	c_lru_next;
-	struct svc_cacherep *	c_lru_prev;
 	unsigned char		c_state,	/* unused, inprog, done */
 				c_type,		/* status, buffer */
 				c_secure : 1;	/* req came from port < 1024 */
@@ -30,6 +28,7 @@ struct svc_cacherep {
 	u32			c_prot;
 	u32			c_proc;
 	u32			c_vers;
+	u32			c_csum;		/* of the call arguments */
 	unsigned long		c_timestamp;
 	union {
 		struct svc_buf	u_buffer;
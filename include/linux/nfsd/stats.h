@@ -13,6 +13,9 @@ struct nfsd_stats {
 	unsigned int	rchits;		/* repcache hits */
 	unsigned int	rcmisses;	/* repcache hits */
 	unsigned int	rcnocache;	/* uncached reqs */
+	unsigned int	rcevictions;	/* live entries reused */
+	unsigned int	rcentries;	/* entries allocated */
+	unsigned int	rcsize;		/* max entries */
 	unsigned int	fh_stale;	/* FH stale error */
 	unsigned int	fh_lookup;	/* dentry cached */
 	unsigned int	fh_anon;	/* anon file dentry returned */
@@ -175,6 +175,26 @@ struct tc_sfq_qopt
  *	to change these parameters in compile time.
  */
 
+/* FQ section */
+
+struct tc_fq_qopt
+{
+	unsigned	quantum;	/* Bytes per round allocated to flow */
+	__u32		limit;		/* Maximal packets in queue */
+	__u32		flow_limit;	/* Maximal memory per flow, bytes */
+	__u32		buckets;	/* Initial hash buckets, power of 2 */
+};
+
+struct tc_fq_xstats
+{
+	__u32		flows;		/* Flows with packets queued */
+	__u32		buckets;	/* Current hash buckets */
+	__u32		resizes;	/* Hash table grown or shrunk */
+	__u32		flow_drops;	/* Drops due to flow_limit */
+	__u32		fat_drops;	/* Drops from the fattest flow */
+	__u32		alloc_fails;	/* Drops for lack of a flow */
+};
+
 /* RED section */
 
 enum
@@ -10,6 +10,15 @@ struct mirror_info {
 	int		sect_limit;
 	int		head_position;
 
+	/*
+	 * Read balancing state, protected by device_lock
+	 * (nr_pending is also dropped from the completion handler):
+	 */
+	atomic_t	nr_pending;	/* reads in flight on this mirror */
+	int		seq_count;	/* sectors in the current sequential run */
+	unsigned long	reads;		/* read requests sent to this mirror */
+	unsigned long	read_sectors;
+
 	/*
 	 * State bits:
 	 */
@@ -28,7 +37,6 @@ struct raid1_private_data {
 	int			working_disks;
 	int			last_used;
 	unsigned long		next_sect;
-	int			sect_count;
 	mdk_thread_t		*thread, *resync_thread;
 	int			resync_mirrors;
 	struct mirror_info	*spare;
@@ -84,6 +92,7 @@ struct raid1_bh {
 	mddev_t			*mddev;
 	struct buffer_head	*master_bh;
 	struct buffer_head	*mirror_bh_list;
+	int			read_disk;	/* mirror charged for a READ, or -1 */
 	struct buffer_head	bh_req;
 	struct raid1_bh		*next_r1;	/* next for retry or in free list */
 };
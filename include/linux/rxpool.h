@@ -0,0 +1,68 @@
+/*
+ * linux/rxpool.h: per-device pool of pre-mapped receive buffers.
+ *
+ * A PCI network driver allocates its Rx ring buffers from a pool instead
+ * of dev_alloc_skb().  Pool buffers keep their streaming DMA mapping for
+ * their whole life: when the stack frees a frame that came from the pool
+ * and nobody else holds its data, kfree_skbmem() hands the sk_buff and
+ * its data back to the pool rather than to the allocators, and the next
+ * refill reuses it without kmalloc() or pci_map_single().
+ */
+
+#ifndef _LINUX_RXPOOL_H
+#define _LINUX_RXPOOL_H
+
+#include <linux/skbuff.h>
+#include <linux/spinlock.h>
+#include <asm/atomic.h>
+
+struct pci_dev;
+struct net_device;
+
+struct skb_rx_pool_stats {
+	unsigned long	allocs;		/* Buffers handed to the driver	*/
+	unsigned long	hits;		/* ... of which were recycled	*/
+	unsigned long	recycled;	/* Buffers returned by the stack */
+	unsigned long	lost;		/* Freed: shared, reshaped or pool full */
+	unsigned long	copybreak;	/* Small frames copied out	*/
+};
+
+struct skb_rx_pool {
+	struct skb_rx_pool	*next;
+	spinlock_t		lock;
+	struct sk_buff_head	free;		/* Recycled, still mapped */
+	struct pci_dev		*pdev;
+	struct net_device	*dev;
+	unsigned int		size;		/* Bytes mapped per buffer */
+	unsigned int		headroom;	/* Reserved before the mapping */
+	unsigned int		data_off;	/* skb->data - skb->head when fresh */
+	unsigned int		truesize;
+	unsigned int		max_free;	/* Cap on the free list */
+	unsigned int		copybreak;	/* Copy frames shorter than this */
+	int			direction;	/* PCI_DMA_* of the mappings */
+	atomic_t		refcnt;		/* Owner + every mapped buffer */
+	int			dead;
+	struct skb_rx_pool_stats stats;
+};
+
+extern struct skb_rx_pool *skb_rx_pool_create(struct net_device *dev,
+					      struct pci_dev *pdev,
+					      unsigned int size,
+					      unsigned int headroom,
+					      unsigned int max_free,
+					      unsigned int copybreak,
+					      int direction);
+extern void skb_rx_pool_destroy(struct skb_rx_pool *pool);
+extern struct sk_buff *skb_rx_pool_alloc(struct skb_rx_pool *pool,
+					 int gfp_mask);
+extern struct sk_buff *skb_rx_pool_receive(struct skb_rx_pool *pool,
+					   struct sk_buff *skb,
+					   unsigned int len);
+
+/* Called by kfree_skbmem() and by code that replaces skb->head. */
+extern int skb_rx_pool_recycle(struct sk_buff *skb);
+extern void skb_rx_pool_release(struct sk_buff *skb);
+
+extern void skb_rx_pool_init(void);
+
+#endif /* _LINUX_RXPOOL_H */
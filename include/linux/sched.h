@@ -82,6 +82,7 @@ extern int last_pid;
 #include <linux/resource.h>
 #ifdef __KERNEL__
 #include <linux/timer.h>
+#include <linux/hrtimer.h>
 #endif
 
 #include <asm/processor.h>
@@ -361,6 +362,10 @@ struct task_struct {
 	unsigned long it_real_value, it_prof_value, it_virt_value;
 	unsigned long it_real_incr, it_prof_incr, it_virt_incr;
 	struct timer_list real_timer;
+#ifdef CONFIG_HIGH_RES_TIMERS
+	struct hrtimer real_hrtimer;	/* ITIMER_REAL while hrtimer_active */
+	u64 it_real_hr_incr;		/* ns */
+#endif
 	struct tms times;
 	unsigned long start_time;
 	long per_cpu_utime[NR_CPUS], per_cpu_stime[NR_CPUS];
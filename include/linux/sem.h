@@ -78,10 +78,13 @@ struct  seminfo {
 
 #ifdef __KERNEL__
 
+#include <linux/list.h>
+
 /* One semaphore structure for each semaphore in the system. */
 struct sem {
 	int	semval;		/* current value */
 	int	sempid;		/* pid of last operation */
+	struct list_head sem_pending;	/* waiters for this semaphore alone */
 };
 
 /* One sem_array data structure for each set of semaphores in the system. */
@@ -90,16 +93,20 @@ struct sem_array {
 	time_t			sem_otime;	/* last semop time */
 	time_t			sem_ctime;	/* last change time */
 	struct sem		*sem_base;	/* ptr to first semaphore in array */
-	struct sem_queue	*sem_pending;	/* pending operations to be processed */
-	struct sem_queue	**sem_pending_last; /* last pending operation */
+	struct list_head	sem_pending;	/* waiters for several semaphores */
 	struct sem_undo		*undo;		/* undo requests on this array */
 	unsigned long		sem_nsems;	/* no. of semaphores in array */
+	/* statistics, for /proc/sysvipc/sem_stat */
+	unsigned long		sem_nwait;	/* tasks waiting now */
+	unsigned long		sem_maxwait;	/* most tasks ever waiting */
+	unsigned long		sem_sleeps;	/* semops that had to wait */
+	unsigned long		sem_wakeups;	/* waiters woken */
+	unsigned long		sem_scans;	/* waiters retried on an update */
 };
 
 /* One queue for each sleeping process in the system. */
 struct sem_queue {
-	struct sem_queue *	next;	 /* next entry in the queue */
-	struct sem_queue **	prev;	 /* previous entry in the queue, *(q->prev) == q */
+	struct list_head	list;	 /* on a sem_pending list, empty once off it */
 	struct task_struct*	sleeper; /* this process */
 	struct sem_undo *	undo;	 /* undo structure */
 	int    			pid;	 /* process id of requesting process */
@@ -94,6 +94,8 @@ struct nf_ct_info {
 };
 #endif
 
+struct skb_rx_pool;
+
 struct sk_buff_head {
 	/* These two members must be first. */
 	struct sk_buff	* next;
@@ -118,10 +120,17 @@ struct skb_frag_struct
 
 /* This data is invariant across clones and lives at
  * the end of the header data, ie. at skb->end.
+ *
+ * A non-zero gso_size marks a TCP super-packet: gso_segs segments of
+ * gso_size payload bytes each (the last may be shorter) sharing one
+ * set of headers, which the device layer cuts into wire-sized frames
+ * unless the device does it itself (NETIF_F_TSO).
  */
 struct skb_shared_info {
 	atomic_t	dataref;
 	unsigned int	nr_frags;
+	unsigned short	gso_size;
+	unsigned short	gso_segs;
 	struct sk_buff	*frag_list;
 	skb_frag_t	frags[MAX_SKB_FRAGS];
 };
@@ -198,6 +207,8 @@ struct sk_buff {
 	unsigned char 	*end;			/* End pointer					*/
 
 	void 		(*destructor)(struct sk_buff *);	/* Destruct function		*/
+	struct skb_rx_pool *rx_pool;		/* Driver pool owning the data, if any	*/
+	dma_addr_t	rx_dma;			/* Bus address of the pooled data	*/
 #ifdef CONFIG_NETFILTER
 	/* Can be used for communication between hooks. */
         unsigned long	nfmark;
@@ -1152,6 +1163,7 @@ extern unsigned int		skb_checksum(const struct sk_buff *skb, int offset, int len
 extern int			skb_copy_bits(const struct sk_buff *skb, int offset, void *to, int len);
 extern unsigned int		skb_copy_and_csum_bits(const struct sk_buff *skb, int offset, u8 *to, int len, unsigned int csum);
 extern void			skb_copy_and_csum_dev(const struct sk_buff *skb, u8 *to);
+extern struct sk_buff *		skb_segment(struct sk_buff *skb, unsigned int hlen, unsigned int mss, int sw_csum);
 
 extern void skb_init(void);
 extern void skb_add_mtu(int mtu);
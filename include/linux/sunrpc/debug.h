@@ -68,12 +68,10 @@ extern unsigned int		nlm_debug;
 #endif
 
 /*
- * Sysctl interface for RPC debugging
+ * Sysctl interface for RPC debugging and transport tuning
  */
-#ifdef RPC_DEBUG
 void		rpc_register_sysctl(void);
 void		rpc_unregister_sysctl(void);
-#endif
 
 #endif /* __KERNEL__ */
 
@@ -90,6 +88,8 @@ enum {
 	CTL_NFSDEBUG,
 	CTL_NFSDDEBUG,
 	CTL_NLMDEBUG,
+	CTL_TCP_CONNECTIONS,
+	CTL_SLOTTABLE_TCP,
 };
 
 #endif /* _LINUX_SUNRPC_DEBUG_H_ */
@@ -84,6 +84,20 @@ struct svc_buf {
 #define svc_getlong(argp, val)	{ (val) = *(argp)->buf++; (argp)->len--; }
 #define svc_putlong(resp, val)	{ *(resp)->buf++ = (val); (resp)->len++; }
 
+/*
+ * Page cache data that a reply references instead of carrying it in
+ * rq_resbuf, see nfsd_read().  It goes out after the buffer, so it must
+ * be the last item of the reply; the transport pads it to a whole XDR
+ * word.  The references are dropped once the reply has been sent or
+ * the request dropped.
+ */
+#define RPCSVC_MAXPAGES		RPCSVC_MAXIOV
+struct svc_page {
+	struct page *		page;
+	unsigned int		offset;
+	unsigned int		len;
+};
+
 /*
  * The context of a single thread, including the request currently being
  * processed.
@@ -102,6 +116,9 @@ struct svc_rqst {
 	struct svc_buf		rq_defbuf;	/* default buffer */
 	struct svc_buf		rq_argbuf;	/* argument buffer */
 	struct svc_buf		rq_resbuf;	/* result buffer */
+	struct svc_page		rq_respages[RPCSVC_MAXPAGES];
+	int			rq_nrpages;	/* pages following rq_resbuf */
+	unsigned int		rq_pagelen;	/* bytes in rq_respages */
 	u32			rq_xid;		/* transmission id */
 	u32			rq_prog;	/* program number */
 	u32			rq_vers;	/* program version */
@@ -132,6 +149,13 @@ struct svc_rqst {
 	wait_queue_head_t	rq_wait;	/* synchronozation */
 };
 
+/* Bytes the pages of a reply take on the wire */
+static inline unsigned int
+svc_pagelen(struct svc_rqst *rqstp)
+{
+	return (rqstp->rq_pagelen + 3) & ~3;
+}
+
 /*
  * RPC program
  */
@@ -10,6 +10,7 @@
 #define SUNRPC_SVCSOCK_H
 
 #include <linux/sunrpc/svc.h>
+#include <asm/semaphore.h>
 
 /*
  * RPC server socket.
@@ -33,6 +34,8 @@ struct svc_sock {
 #define	SK_CHNGBUF	7			/* need to change snd/rcv buffer sizes */
 
 	int			sk_reserved;	/* space on outq that is reserved */
+	int			sk_pages;	/* can send rq_respages */
+	struct semaphore	sk_sem;		/* one reply at a time (TCP) */
 
 	int			(*sk_recvfrom)(struct svc_rqst *rqstp);
 	int			(*sk_sendto)(struct svc_rqst *rqstp);
@@ -56,6 +59,7 @@ void		svc_delete_socket(struct svc_sock *);
 int		svc_recv(struct svc_serv *, struct svc_rqst *, long);
 int		svc_send(struct svc_rqst *);
 void		svc_drop(struct svc_rqst *);
+void		svc_release_pages(struct svc_rqst *);
 void		svc_sock_update_bufs(struct svc_serv *serv);
 
 #endif /* SUNRPC_SVCSOCK_H */
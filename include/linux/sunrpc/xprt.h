@@ -40,6 +40,16 @@
 #define RPC_INITCWND		RPC_CWNDSCALE
 #define RPCXPRT_CONGESTED(xprt) ((xprt)->cong >= (xprt)->cwnd)
 
+/*
+ * TCP transports are not congestion controlled and grow their slot
+ * table beyond RPC_MAXREQS on demand, up to xprt_tcp_slot_table_entries.
+ * They may also spread requests over up to RPC_MAXCONNS connections to
+ * the server, see xprt_tcp_connections.
+ */
+#define RPC_MAXSLOTS		(256)
+#define RPC_DEF_TCP_SLOTS	(64)
+#define RPC_MAXCONNS		(16)
+
 /* Default timeout values */
 #define RPC_MAX_UDP_TIMEOUT	(60*HZ)
 #define RPC_MAX_TCP_TIMEOUT	(600*HZ)
@@ -147,6 +157,11 @@ struct rpc_xprt {
 	struct rpc_wait_queue	backlog;	/* waiting for slot */
 	struct rpc_rqst *	free;		/* free slots */
 	struct rpc_rqst		slot[RPC_MAXREQS];
+	unsigned int		nslots,		/* slots allocated */
+				max_slots,	/* ... at most */
+				nreqs;		/* slots in use */
+	struct rpc_xprt *	next_conn;	/* more connections, see
+						 * xprt_pick */
 	unsigned long		sockstate;	/* Socket state */
 	unsigned char		shutdown   : 1,	/* being shut down */
 				nocong	   : 1,	/* no congestion control */
@@ -178,6 +193,20 @@ struct rpc_xprt {
 	void			(*old_write_space)(struct sock *);
 
 	wait_queue_head_t	cong_wait;
+
+	/*
+	 * Statistics, see /proc/net/rpc/xprt
+	 */
+	struct list_head	all;		/* all transports */
+	struct {
+		unsigned long	sends,		/* requests transmitted */
+				replies,	/* replies matched */
+				rtt,		/* jiffies, first transmits */
+				rttcnt,		/* replies counted in rtt */
+				reqs,		/* sum of nreqs at send */
+				backlog,	/* waits for a slot */
+				connects;	/* connection attempts */
+	}			stat;
 };
 
 #ifdef __KERNEL__
@@ -198,6 +227,12 @@ void			xprt_release(struct rpc_task *);
 void			xprt_connect(struct rpc_task *);
 int			xprt_clear_backlog(struct rpc_xprt *);
 void			xprt_sock_setbufsize(struct rpc_xprt *);
+void			xprt_set_port(struct rpc_xprt *, unsigned short);
+int			xprt_proc_read(char *, char **, off_t, int,
+					int *, void *);
+
+extern unsigned int	xprt_tcp_connections;
+extern unsigned int	xprt_tcp_slot_table_entries;
 
 #define XPRT_CONNECT	0
 
@@ -312,6 +312,8 @@ enum
 	NET_TCP_FRTO=92,
 	NET_TCP_LOW_LATENCY=93,
 	NET_IPV4_IPFRAG_SECRET_INTERVAL=94,
+	NET_TCP_GSO_SEGS=95,
+	NET_TCP_EHASH_BUCKETS=96,
 };
 
 enum {
@@ -333,6 +335,8 @@ enum {
 	NET_IPV4_ROUTE_MIN_PMTU=16,
 	NET_IPV4_ROUTE_MIN_ADVMSS=17,
 	NET_IPV4_ROUTE_SECRET_INTERVAL=18,
+	NET_IPV4_ROUTE_GC_BUDGET=19,
+	NET_IPV4_ROUTE_HASH_BUCKETS=20,
 };
 
 enum
@@ -563,7 +567,13 @@ enum {
 	NET_KHTTPD_DYNAMICSTRING= 10,
 	NET_KHTTPD_SLOPPYMIME   = 11,
 	NET_KHTTPD_THREADS	= 12,
-	NET_KHTTPD_MAXCONNECT	= 13
+	NET_KHTTPD_MAXCONNECT	= 13,
+	NET_KHTTPD_ACCEPTBATCH	= 14,
+	NET_KHTTPD_LATENCY_P50	= 15,
+	NET_KHTTPD_LATENCY_P90	= 16,
+	NET_KHTTPD_LATENCY_P99	= 17,
+	NET_KHTTPD_CACHESIZE	= 18,
+	NET_KHTTPD_CACHESTATS	= 19
 };
 
 /* /proc/sys/net/decnet/conf/<dev> */
@@ -42,6 +42,10 @@ int mod_timer(struct timer_list *timer, unsigned long expires);
 
 extern void it_real_fn(unsigned long);
 
+#ifdef CONFIG_DYNAMIC_TICK
+extern unsigned long next_timer_interrupt(void);
+#endif
+
 static inline void init_timer(struct timer_list * timer)
 {
 	timer->list.next = timer->list.prev = NULL;
@@ -202,6 +202,19 @@ static inline void ip_select_ident(struct iphdr *iph, struct dst_entry *dst, str
 		__ip_select_ident(iph, dst);
 }
 
+/* As above, reserving @more further IDs for the segments of a super-packet. */
+static inline void ip_select_ident_more(struct iphdr *iph, struct dst_entry *dst, struct sock *sk, int more)
+{
+	if (iph->frag_off&__constant_htons(IP_DF)) {
+		if (sk && sk->daddr) {
+			iph->id = htons(sk->protinfo.af_inet.id);
+			sk->protinfo.af_inet.id += 1 + more;
+		} else
+			iph->id = 0;
+	} else
+		__ip_select_ident(iph, dst);
+}
+
 /*
  *	Map a multicast IP onto multicast MAC for type ethernet.
  */
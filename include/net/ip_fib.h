@@ -227,6 +227,15 @@ extern u32  __fib_res_prefsrc(struct fib_result *res);
 /* Exported by fib_hash.c */
 extern struct fib_table *fib_hash_init(int id);
 
+/* Exported by fib_trie.c */
+extern struct fib_table *fib_trie_init(int id);
+
+#ifdef CONFIG_IP_FIB_TRIE
+#define fib_table_init(id)	fib_trie_init(id)
+#else
+#define fib_table_init(id)	fib_hash_init(id)
+#endif
+
 #ifdef CONFIG_IP_MULTIPLE_TABLES
 /* Exported by fib_rules.c */
 
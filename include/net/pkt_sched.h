@@ -71,6 +71,13 @@ struct Qdisc_ops
 
 extern rwlock_t qdisc_tree_lock;
 
+/* Counts of the packets that went past the queue, kept per CPU */
+struct qdisc_cpu_stats
+{
+	__u64			bytes;
+	__u32			packets;
+} ____cacheline_aligned;
+
 struct Qdisc
 {
 	int 			(*enqueue)(struct sk_buff *skb, struct Qdisc *dev);
@@ -79,6 +86,8 @@ struct Qdisc
 #define TCQ_F_BUILTIN	1
 #define TCQ_F_THROTTLED	2
 #define TCQ_F_INGRES	4
+#define TCQ_F_CAN_BYPASS 8	/* FIFO: an empty queue may be bypassed, and
+				   requeue restores the dequeue order */
 	struct Qdisc_ops	*ops;
 	struct Qdisc		*next;
 	u32			handle;
@@ -94,6 +103,9 @@ struct Qdisc
 	 */
 	struct Qdisc		*__parent;
 
+	/* Set up by TCQ_F_CAN_BYPASS qdiscs */
+	struct qdisc_cpu_stats	*cpu_stats;
+
 	char			data[0];
 };
 
@@ -404,6 +416,7 @@ struct tcf_police
 };
 
 extern int qdisc_copy_stats(struct sk_buff *skb, struct tc_stats *st);
+extern void qdisc_fold_stats(struct Qdisc *q, struct tc_stats *st);
 extern void tcf_police_destroy(struct tcf_police *p);
 extern struct tcf_police * tcf_police_locate(struct rtattr *rta, struct rtattr *est);
 extern int tcf_police_dump(struct sk_buff *skb, struct tcf_police *p);
@@ -441,6 +454,14 @@ int pktsched_init(void);
 
 extern int qdisc_restart(struct net_device *dev);
 
+static inline void qdisc_bypass_count(struct Qdisc *q, struct sk_buff *skb)
+{
+	struct qdisc_cpu_stats *st = &q->cpu_stats[smp_processor_id()];
+
+	st->bytes += skb->len;
+	st->packets++;
+}
+
 static inline void qdisc_run(struct net_device *dev)
 {
 	while (!netif_queue_stopped(dev) &&
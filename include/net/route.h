@@ -116,6 +116,7 @@ struct rt_cache_stat
         unsigned int gc_dst_overflow;
 	unsigned int in_hlist_search;
 	unsigned int out_hlist_search;
+	unsigned int gc_time;		/* usecs spent collecting */
 } ____cacheline_aligned_in_smp;
 
 extern struct ip_rt_acct *ip_rt_acct;
@@ -28,6 +28,7 @@
 #include <linux/tcp.h>
 #include <linux/slab.h>
 #include <linux/cache.h>
+#include <linux/brlock.h>
 #include <net/checksum.h>
 #include <net/sock.h>
 #include <net/snmp.h>
@@ -96,6 +97,10 @@ extern struct tcp_hashinfo {
 	 *
 	 * First half of the table is for sockets not in TIME_WAIT, second half
 	 * is for TIME_WAIT sockets only.
+	 *
+	 * The table can be resized at run time, so the pointer and size are
+	 * only stable under br_read_lock(BR_TCP_EHASH_LOCK), which is taken
+	 * outside the bucket locks.
 	 */
 	struct tcp_ehash_bucket *__tcp_ehash;
 
@@ -148,6 +153,21 @@ static __inline__ int tcp_bhashfn(__u16 lport)
 	return (lport & (tcp_bhash_size - 1));
 }
 
+/* sk->hashent and tw->hashent keep the unmasked hash value, so that
+ * tcp_ehash_resize() can move entries without knowing their family.
+ * Call with BR_TCP_EHASH_LOCK held.
+ */
+static __inline__ struct tcp_ehash_bucket *tcp_ehash_head(int hash)
+{
+	return &tcp_ehash[hash & (tcp_ehash_size - 1)];
+}
+
+/* Most buckets per half that one MAX_ORDER-1 block can hold. */
+#define TCP_EHASH_MAX_SIZE \
+	((PAGE_SIZE << (MAX_ORDER - 1)) / (2 * sizeof(struct tcp_ehash_bucket)))
+
+extern int tcp_ehash_resize(int size);
+
 /* This is a TIME_WAIT bucket.  It works around the memory consumption
  * problems of sockets in such a state on heavily loaded servers, but
  * without violating the protocol specification.
@@ -352,6 +372,7 @@ static __inline__ int tcp_sk_listen_hashfn(struct sock *sk)
 /* TIME_WAIT reaping mechanism. */
 #define TCP_TWKILL_SLOTS	8	/* Please keep this a power of 2. */
 #define TCP_TWKILL_PERIOD	(TCP_TIMEWAIT_LEN/TCP_TWKILL_SLOTS)
+#define TCP_TWKILL_QUOTA	100	/* Buckets reaped per tick at most. */
 
 #define TCP_SYNQ_INTERVAL	(HZ/5)	/* Period of SYNACK timer */
 #define TCP_SYNQ_HSIZE		512	/* Size of SYNACK hash table */
@@ -463,6 +484,7 @@ extern int sysctl_tcp_adv_win_scale;
 extern int sysctl_tcp_tw_reuse;
 extern int sysctl_tcp_frto;
 extern int sysctl_tcp_low_latency;
+extern int sysctl_tcp_gso_segs;
 
 extern atomic_t tcp_memory_allocated;
 extern atomic_t tcp_sockets_allocated;
@@ -623,6 +645,7 @@ extern struct proto tcp_prot;
 
 extern struct tcp_mib tcp_statistics[NR_CPUS*2];
 #define TCP_INC_STATS(field)		SNMP_INC_STATS(tcp_statistics, field)
+#define TCP_ADD_STATS(field, val)	SNMP_ADD_STATS(tcp_statistics, field, val)
 #define TCP_INC_STATS_BH(field)		SNMP_INC_STATS_BH(tcp_statistics, field)
 #define TCP_INC_STATS_USER(field) 	SNMP_INC_STATS_USER(tcp_statistics, field)
 #define TCP_ADD_STATS_BH(field, val)	SNMP_ADD_STATS_BH(tcp_statistics, field, val)
@@ -758,6 +781,9 @@ extern void		       	tcp_v4_send_check(struct sock *sk,
 						  struct tcphdr *th, int len, 
 						  struct sk_buff *skb);
 
+extern struct sk_buff *		tcp_v4_gso_segment(struct sk_buff *skb,
+							   int sw_csum);
+
 extern int			tcp_v4_conn_request(struct sock *sk,
 						    struct sk_buff *skb);
 
@@ -55,6 +55,13 @@
  * (c) 1999 Manfred Spraul <manfreds@colorfullife.com>
  * Enforced range limit on SEM_UNDO
  * (c) 2001 Red Hat Inc <alan@redhat.com>
+ *
+ * Per-semaphore wait queues:
+ * - A task that waits for a single semaphore is queued on that
+ *   semaphore, only tasks that wait for several at once are queued on
+ *   the array. A semop on one semaphore then only retries the waiters of
+ *   that semaphore, and those on the array, instead of every waiter of
+ *   the array. /proc/sysvipc/sem_stat counts the waiters and the work.
  */
 
 #include <linux/config.h>
@@ -80,6 +87,7 @@ static int newary (key_t, int, int);
 static void freeary (int id);
 #ifdef CONFIG_PROC_FS
 static int sysvipc_sem_read_proc(char *buffer, char **start, off_t offset, int length, int *eof, void *data);
+static int sysvipc_sem_stat_read_proc(char *buffer, char **start, off_t offset, int length, int *eof, void *data);
 #endif
 
 #define SEMMSL_FAST	256 /* 512 bytes on stack */
@@ -88,7 +96,7 @@ static int sysvipc_sem_read_proc(char *buffer, char **start, off_t offset, int l
 /*
  * linked list protection:
  *	sem_undo.id_next,
- *	sem_array.sem_pending{,last},
+ *	sem_array.sem_pending, sem.sem_pending,
  *	sem_array.sem_undo: sem_lock() for read/write
  *	sem_undo.proc_next: only "current" is allowed to read/write that field.
  *	
@@ -109,12 +117,13 @@ void __init sem_init (void)
 
 #ifdef CONFIG_PROC_FS
 	create_proc_read_entry("sysvipc/sem", 0, 0, sysvipc_sem_read_proc, NULL);
+	create_proc_read_entry("sysvipc/sem_stat", 0, 0, sysvipc_sem_stat_read_proc, NULL);
 #endif
 }
 
 static int newary (key_t key, int nsems, int semflg)
 {
-	int id;
+	int id, i;
 	struct sem_array *sma;
 	int size;
 
@@ -140,8 +149,9 @@ static int newary (key_t key, int nsems, int semflg)
 	sma->sem_perm.key = key;
 
 	sma->sem_base = (struct sem *) &sma[1];
-	/* sma->sem_pending = NULL; */
-	sma->sem_pending_last = &sma->sem_pending;
+	for (i = 0; i < nsems; i++)
+		INIT_LIST_HEAD(&sma->sem_base[i].sem_pending);
+	INIT_LIST_HEAD(&sma->sem_pending);
 	/* sma->undo = NULL; */
 	sma->sem_nsems = nsems;
 	sma->sem_ctime = CURRENT_TIME;
@@ -204,36 +214,43 @@ static int sem_revalidate(int semid, struct sem_array* sma, int nsems, short flg
 	}
 	return 0;
 }
-/* Manage the doubly linked list sma->sem_pending as a FIFO:
- * insert new queue elements at the tail sma->sem_pending_last.
+/* The pending lists are FIFOs: a task waiting for one semaphore is
+ * queued on that semaphore's list, any other on the array's.
  */
+static inline struct list_head *queue_head (struct sem_array * sma,
+					    struct sem_queue * q)
+{
+	if (q->nsops == 1)
+		return &sma->sem_base[q->sops[0].sem_num].sem_pending;
+	return &sma->sem_pending;
+}
+
+static inline void count_waiter (struct sem_array * sma)
+{
+	if (++sma->sem_nwait > sma->sem_maxwait)
+		sma->sem_maxwait = sma->sem_nwait;
+	sma->sem_sleeps++;
+}
+
 static inline void append_to_queue (struct sem_array * sma,
 				    struct sem_queue * q)
 {
-	*(q->prev = sma->sem_pending_last) = q;
-	*(sma->sem_pending_last = &q->next) = NULL;
+	list_add_tail(&q->list, queue_head(sma, q));
+	count_waiter(sma);
 }
 
 static inline void prepend_to_queue (struct sem_array * sma,
 				     struct sem_queue * q)
 {
-	q->next = sma->sem_pending;
-	*(q->prev = &sma->sem_pending) = q;
-	if (q->next)
-		q->next->prev = &q->next;
-	else /* sma->sem_pending_last == &sma->sem_pending */
-		sma->sem_pending_last = &q->next;
+	list_add(&q->list, queue_head(sma, q));
+	count_waiter(sma);
 }
 
 static inline void remove_from_queue (struct sem_array * sma,
 				      struct sem_queue * q)
 {
-	*(q->prev) = q->next;
-	if (q->next)
-		q->next->prev = q->prev;
-	else /* sma->sem_pending_last == &q->next */
-		sma->sem_pending_last = q->prev;
-	q->prev = NULL; /* mark as removed */
+	list_del_init(&q->list);	/* empty marks it as removed */
+	sma->sem_nwait--;
 }
 
 /*
@@ -307,19 +324,23 @@ undo:
 	return result;
 }
 
-/* Go through the pending queue for the indicated semaphore
- * looking for tasks that can be completed.
+/* Go through one pending queue looking for tasks that can be completed.
+ * Returns 1 once a task was woken up to retry an altering operation:
+ * it will look at the queues again itself when done.
  */
-static void update_queue (struct sem_array * sma)
+static int update_list (struct sem_array * sma, struct list_head * head)
 {
 	int error;
+	struct list_head * p, * n;
 	struct sem_queue * q;
 
-	for (q = sma->sem_pending; q; q = q->next) {
+	list_for_each_safe(p, n, head) {
+		q = list_entry(p, struct sem_queue, list);
 			
 		if (q->status == 1)
 			continue;	/* this one was woken up before */
 
+		sma->sem_scans++;
 		error = try_atomic_semop(sma, q->sops, q->nsops,
 					 q->undo, q->pid, q->alter);
 
@@ -327,15 +348,37 @@ static void update_queue (struct sem_array * sma)
 		if (error <= 0) {
 				/* Found one, wake it up */
 			wake_up_process(q->sleeper);
+			sma->sem_wakeups++;
 			if (error == 0 && q->alter) {
 				/* if q-> alter let it self try */
 				q->status = 1;
-				return;
+				return 1;
 			}
 			q->status = error;
 			remove_from_queue(sma,q);
 		}
 	}
+	return 0;
+}
+
+/* Look for tasks that can be completed after semaphore semnum changed,
+ * or any number of them if semnum is -1.  A task woken to retry only
+ * rescans the lists of what it changed itself, so when several
+ * semaphores changed every list is scanned here, each up to its first
+ * such task.
+ */
+static void update_queue (struct sem_array * sma, int semnum)
+{
+	int i;
+
+	if (semnum >= 0) {
+		if (update_list(sma, &sma->sem_base[semnum].sem_pending))
+			return;
+	} else {
+		for (i = 0; i < sma->sem_nsems; i++)
+			update_list(sma, &sma->sem_base[i].sem_pending);
+	}
+	update_list(sma, &sma->sem_pending);
 }
 
 /* The following counts are associated to each semaphore:
@@ -347,41 +390,34 @@ static void update_queue (struct sem_array * sma)
  * The counts we return here are a rough approximation, but still
  * warrant that semncnt+semzcnt>0 if the task is on the pending queue.
  */
-static int count_semncnt (struct sem_array * sma, ushort semnum)
+static int count_list (struct list_head * head, ushort semnum, int zero)
 {
-	int semncnt;
-	struct sem_queue * q;
+	int cnt;
+	struct list_head * p;
 
-	semncnt = 0;
-	for (q = sma->sem_pending; q; q = q->next) {
+	cnt = 0;
+	list_for_each(p, head) {
+		struct sem_queue * q = list_entry(p, struct sem_queue, list);
 		struct sembuf * sops = q->sops;
 		int nsops = q->nsops;
 		int i;
 		for (i = 0; i < nsops; i++)
 			if (sops[i].sem_num == semnum
-			    && (sops[i].sem_op < 0)
+			    && (zero ? sops[i].sem_op == 0 : sops[i].sem_op < 0)
 			    && !(sops[i].sem_flg & IPC_NOWAIT))
-				semncnt++;
+				cnt++;
 	}
-	return semncnt;
+	return cnt;
+}
+static int count_semncnt (struct sem_array * sma, ushort semnum)
+{
+	return count_list(&sma->sem_base[semnum].sem_pending, semnum, 0) +
+	       count_list(&sma->sem_pending, semnum, 0);
 }
 static int count_semzcnt (struct sem_array * sma, ushort semnum)
 {
-	int semzcnt;
-	struct sem_queue * q;
-
-	semzcnt = 0;
-	for (q = sma->sem_pending; q; q = q->next) {
-		struct sembuf * sops = q->sops;
-		int nsops = q->nsops;
-		int i;
-		for (i = 0; i < nsops; i++)
-			if (sops[i].sem_num == semnum
-			    && (sops[i].sem_op == 0)
-			    && !(sops[i].sem_flg & IPC_NOWAIT))
-				semzcnt++;
-	}
-	return semzcnt;
+	return count_list(&sma->sem_base[semnum].sem_pending, semnum, 1) +
+	       count_list(&sma->sem_pending, semnum, 1);
 }
 
 /* Free a semaphore set. */
@@ -389,8 +425,8 @@ static void freeary (int id)
 {
 	struct sem_array *sma;
 	struct sem_undo *un;
-	struct sem_queue *q;
-	int size;
+	struct list_head *p, *n;
+	int size, i;
 
 	sma = sem_rmid(id);
 
@@ -402,10 +438,17 @@ static void freeary (int id)
 		un->semid = -1;
 
 	/* Wake up all pending processes and let them fail with EIDRM. */
-	for (q = sma->sem_pending; q; q = q->next) {
-		q->status = -EIDRM;
-		q->prev = NULL;
-		wake_up_process(q->sleeper); /* doesn't sleep */
+	for (i = -1; i < (int) sma->sem_nsems; i++) {
+		struct list_head *head = i < 0 ? &sma->sem_pending :
+					 &sma->sem_base[i].sem_pending;
+
+		list_for_each_safe(p, n, head) {
+			struct sem_queue *q = list_entry(p, struct sem_queue, list);
+
+			q->status = -EIDRM;
+			INIT_LIST_HEAD(&q->list);
+			wake_up_process(q->sleeper); /* doesn't sleep */
+		}
 	}
 	sem_unlock(id);
 
@@ -590,7 +633,7 @@ static int semctl_main(int semid, int semnum, int cmd, int version, union semun
 				un->semadj[i] = 0;
 		sma->sem_ctime = CURRENT_TIME;
 		/* maybe some queued-up processes were waiting for this */
-		update_queue(sma);
+		update_queue(sma, -1);
 		err = 0;
 		goto out_unlock;
 	}
@@ -642,7 +685,7 @@ static int semctl_main(int semid, int semnum, int cmd, int version, union semun
 		curr->sempid = current->pid;
 		sma->sem_ctime = CURRENT_TIME;
 		/* maybe some queued-up processes were waiting for this */
-		update_queue(sma);
+		update_queue(sma, semnum);
 		err = 0;
 		goto out_unlock;
 	}
@@ -955,7 +998,7 @@ asmlinkage long sys_semtimedop (int semid, struct sembuf *tsops,
 
 		tmp = sem_lock(semid);
 		if(tmp==NULL) {
-			if(queue.prev != NULL)
+			if(!list_empty(&queue.list))
 				BUG();
 			current->semsleeping = NULL;
 			error = -EIDRM;
@@ -978,7 +1021,7 @@ asmlinkage long sys_semtimedop (int semid, struct sembuf *tsops,
 			error = queue.status;
 			if (error == -EINTR && timeout && jiffies_left == 0)
 				error = -EAGAIN;
-			if (queue.prev) /* got Interrupt */
+			if (!list_empty(&queue.list)) /* got Interrupt */
 				break;
 			/* Everything done by update_queue */
 			current->semsleeping = NULL;
@@ -989,7 +1032,7 @@ asmlinkage long sys_semtimedop (int semid, struct sembuf *tsops,
 	remove_from_queue(sma,&queue);
 update:
 	if (alter)
-		update_queue (sma);
+		update_queue (sma, nsops == 1 ? sops->sem_num : -1);
 out_unlock_free:
 	sem_unlock(semid);
 out_free:
@@ -1025,7 +1068,7 @@ void sem_exit (void)
 		sma = sem_lock(semid);
 		current->semsleeping = NULL;
 
-		if (q->prev) {
+		if (!list_empty(&q->list)) {
 			if(sma==NULL)
 				BUG();
 			remove_from_queue(q->sma,q);
@@ -1068,7 +1111,7 @@ found:
 		}
 		sma->sem_otime = CURRENT_TIME;
 		/* maybe some queued-up processes were waiting for this */
-		update_queue(sma);
+		update_queue(sma, -1);
 next_entry:
 		sem_unlock(semid);
 	}
@@ -1122,4 +1165,51 @@ done:
 		len = 0;
 	return len;
 }
+
+/* Queue lengths and wakeup work per array: "scans" counts the waiters
+ * looked at by update_queue, "wakeups" those of them that were woken.
+ */
+static int sysvipc_sem_stat_read_proc(char *buffer, char **start, off_t offset, int length, int *eof, void *data)
+{
+	off_t pos = 0;
+	off_t begin = 0;
+	int i, len = 0;
+
+	len += sprintf(buffer, "     semid      nsems    waiting    maxwait     sleeps    wakeups      scans\n");
+	down(&sem_ids.sem);
+
+	for(i = 0; i <= sem_ids.max_id; i++) {
+		struct sem_array *sma;
+		sma = sem_lock(i);
+		if(sma) {
+			len += sprintf(buffer + len, "%10d %10lu %10lu %10lu %10lu %10lu %10lu\n",
+				sem_buildid(i,sma->sem_perm.seq),
+				sma->sem_nsems,
+				sma->sem_nwait,
+				sma->sem_maxwait,
+				sma->sem_sleeps,
+				sma->sem_wakeups,
+				sma->sem_scans);
+			sem_unlock(i);
+
+			pos += len;
+			if(pos < offset) {
+				len = 0;
+	    			begin = pos;
+			}
+			if(pos > offset + length)
+				goto done;
+		}
+	}
+	*eof = 1;
+done:
+	up(&sem_ids.sem);
+	*start = buffer + (offset - begin);
+	len -= (offset - begin);
+	if(len > length)
+		len = length;
+	if(len < 0)
+		len = 0;
+	return len;
+}
 #endif
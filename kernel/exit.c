@@ -434,6 +434,9 @@ NORET_TYPE void do_exit(long code)
 		panic("Attempted to kill init!");
 	tsk->flags |= PF_EXITING;
 	del_timer_sync(&tsk->real_timer);
+#ifdef CONFIG_HIGH_RES_TIMERS
+	hrtimer_cancel(&tsk->real_hrtimer);
+#endif
 
 fake_volatile:
 #ifdef CONFIG_BSD_PROCESS_ACCT
@@ -719,6 +719,10 @@ int do_fork(unsigned long clone_flags, unsigned long stack_start,
 	p->it_real_incr = p->it_virt_incr = p->it_prof_incr = 0;
 	init_timer(&p->real_timer);
 	p->real_timer.data = (unsigned long) p;
+#ifdef CONFIG_HIGH_RES_TIMERS
+	p->it_real_hr_incr = 0;
+	init_hrtimer(&p->real_hrtimer);
+#endif
 
 	p->leader = 0;		/* session leadership doesn't inherit */
 	p->tty_old_pgrp = 0;
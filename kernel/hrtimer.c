@@ -0,0 +1,316 @@
+/*
+ *  linux/kernel/hrtimer.c
+ *
+ *  High-resolution timers
+ *
+ *  The pending timers are kept in an rbtree ordered by expiry, with the
+ *  first one cached. Whenever a timer becomes the first, the architecture
+ *  is asked to have its one-shot timer interrupt by then; the interrupt
+ *  calls hrtimer_run_queue() and programs the next expiry it returns.
+ *
+ *  /proc/hrtimers tells how late the timers ran: the time from their
+ *  expiry to the call of their function.
+ */
+
+#include <linux/config.h>
+#include <linux/module.h>
+#include <linux/sched.h>
+#include <linux/init.h>
+#include <linux/proc_fs.h>
+#include <linux/hrtimer.h>
+
+#include <asm/uaccess.h>
+#include <asm/div64.h>
+
+int hrtimer_active;
+
+static spinlock_t hrtimer_lock = SPIN_LOCK_UNLOCKED;
+static rb_root_t hrtimer_root = RB_ROOT;
+static struct hrtimer *hrtimer_first;
+
+#ifdef CONFIG_SMP
+static struct hrtimer * volatile hrtimer_running;
+#define hrtimer_enter(t)	do { hrtimer_running = t; mb(); } while (0)
+#define hrtimer_exit()		do { hrtimer_running = NULL; } while (0)
+#define hrtimer_is_running(t)	(hrtimer_running == t)
+#else
+#define hrtimer_enter(t)	do { } while (0)
+#define hrtimer_exit()		do { } while (0)
+#define hrtimer_is_running(t)	0
+#endif
+
+/* Latency buckets: below 1us, below 2us, ... below 16ms, and later */
+#define HRTIMER_HIST	16
+
+static struct {
+	unsigned long started;
+	unsigned long cancelled;
+	unsigned long interrupts;
+	unsigned long expired;
+	u64 total;			/* ns */
+	unsigned long max;		/* ns */
+	unsigned long hist[HRTIMER_HIST];
+} hrtimer_stats;
+
+void ns_to_timespec(u64 ns, struct timespec *ts)
+{
+	ts->tv_nsec = do_div(ns, 1000000000);
+	ts->tv_sec = (time_t)ns;
+}
+
+void ns_to_timeval(u64 ns, struct timeval *tv)
+{
+	tv->tv_usec = do_div(ns, 1000000000) / 1000;
+	tv->tv_sec = (time_t)ns;
+}
+
+static int hrtimer_enqueue(struct hrtimer *timer)
+{
+	rb_node_t **link = &hrtimer_root.rb_node, *parent = NULL;
+	int leftmost = 1;
+
+	while (*link) {
+		struct hrtimer *entry;
+
+		parent = *link;
+		entry = rb_entry(parent, struct hrtimer, node);
+		/* equal expiries stay in the order they were started */
+		if (timer->expires < entry->expires)
+			link = &parent->rb_left;
+		else {
+			link = &parent->rb_right;
+			leftmost = 0;
+		}
+	}
+	rb_link_node(&timer->node, parent, link);
+	rb_insert_color(&timer->node, &hrtimer_root);
+	timer->pending = 1;
+	if (leftmost)
+		hrtimer_first = timer;
+	return leftmost;
+}
+
+static rb_node_t *hrtimer_rb_next(rb_node_t *node)
+{
+	rb_node_t *parent;
+
+	if (node->rb_right) {
+		node = node->rb_right;
+		while (node->rb_left)
+			node = node->rb_left;
+		return node;
+	}
+	while ((parent = node->rb_parent) != NULL && node == parent->rb_right)
+		node = parent;
+	return parent;
+}
+
+static void hrtimer_dequeue(struct hrtimer *timer)
+{
+	if (hrtimer_first == timer) {
+		rb_node_t *next = hrtimer_rb_next(&timer->node);
+
+		hrtimer_first = next ? rb_entry(next, struct hrtimer, node) : NULL;
+	}
+	rb_erase(&timer->node, &hrtimer_root);
+	timer->pending = 0;
+}
+
+/*
+ * (Re)start the timer to expire at the absolute time "expires". A time
+ * in the past has the function called from the next timer interrupt.
+ */
+void hrtimer_start(struct hrtimer *timer, u64 expires)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&hrtimer_lock, flags);
+	if (timer->pending)
+		hrtimer_dequeue(timer);
+	timer->expires = expires;
+	hrtimer_stats.started++;
+	if (hrtimer_enqueue(timer) && hrtimer_active)
+		hrtimer_program(expires);
+	spin_unlock_irqrestore(&hrtimer_lock, flags);
+}
+
+/*
+ * Stop the timer. On return it is not pending and its function is not
+ * running on any CPU. Returns 1 if the timer was pending.
+ */
+int hrtimer_cancel(struct hrtimer *timer)
+{
+	unsigned long flags;
+	int ret = 0;
+
+	for (;;) {
+		spin_lock_irqsave(&hrtimer_lock, flags);
+		if (timer->pending) {
+			hrtimer_dequeue(timer);
+			hrtimer_stats.cancelled++;
+			ret = 1;
+		}
+		if (!hrtimer_is_running(timer))
+			break;
+		spin_unlock_irqrestore(&hrtimer_lock, flags);
+		while (hrtimer_is_running(timer))
+			barrier();
+	}
+	spin_unlock_irqrestore(&hrtimer_lock, flags);
+	return ret;
+}
+
+static inline void hrtimer_account(u64 late)
+{
+	unsigned long ns = late > ~0UL ? ~0UL : (unsigned long)late;
+	unsigned long us = ns / 1000;
+	int bucket = 0;
+
+	hrtimer_stats.expired++;
+	hrtimer_stats.total += late;
+	if (ns > hrtimer_stats.max)
+		hrtimer_stats.max = ns;
+	while (us && bucket < HRTIMER_HIST - 1) {
+		us >>= 1;
+		bucket++;
+	}
+	hrtimer_stats.hist[bucket]++;
+}
+
+/*
+ * Run the expired timers. Called from the timer interrupt; returns when
+ * the next one expires, or HRTIMER_NEVER.
+ */
+u64 hrtimer_run_queue(void)
+{
+	struct hrtimer *timer;
+	u64 now, next;
+
+	spin_lock(&hrtimer_lock);
+	hrtimer_stats.interrupts++;
+	now = hrtimer_now();
+	while ((timer = hrtimer_first) != NULL && timer->expires <= now) {
+		void (*fn)(unsigned long) = timer->function;
+		unsigned long data = timer->data;
+
+		hrtimer_dequeue(timer);
+		hrtimer_account(now - timer->expires);
+		hrtimer_enter(timer);
+		spin_unlock(&hrtimer_lock);
+		fn(data);
+		spin_lock(&hrtimer_lock);
+		hrtimer_exit();
+		now = hrtimer_now();
+	}
+	next = timer ? timer->expires : HRTIMER_NEVER;
+	spin_unlock(&hrtimer_lock);
+	return next;
+}
+
+/* When the first timer expires, or HRTIMER_NEVER */
+u64 hrtimer_next_expiry(void)
+{
+	unsigned long flags;
+	u64 next;
+
+	spin_lock_irqsave(&hrtimer_lock, flags);
+	next = hrtimer_first ? hrtimer_first->expires : HRTIMER_NEVER;
+	spin_unlock_irqrestore(&hrtimer_lock, flags);
+	return next;
+}
+
+static void hrtimer_wakeup(unsigned long data)
+{
+	wake_up_process((struct task_struct *) data);
+}
+
+/* nanosleep() for when hrtimer_active is set */
+long hrtimer_nanosleep(struct timespec *t, struct timespec *rmtp)
+{
+	struct hrtimer timer;
+	u64 expires, now;
+	struct timespec left;
+
+	init_hrtimer(&timer);
+	timer.function = hrtimer_wakeup;
+	timer.data = (unsigned long) current;
+	expires = hrtimer_now() + timespec_to_ns(t);
+
+	set_current_state(TASK_INTERRUPTIBLE);
+	hrtimer_start(&timer, expires);
+	while (hrtimer_pending(&timer) && !signal_pending(current)) {
+		schedule();
+		set_current_state(TASK_INTERRUPTIBLE);
+	}
+	current->state = TASK_RUNNING;
+
+	if (!hrtimer_cancel(&timer))
+		return 0;
+
+	if (rmtp) {
+		now = hrtimer_now();
+		ns_to_timespec(expires > now ? expires - now : 0, &left);
+		if (copy_to_user(rmtp, &left, sizeof(left)))
+			return -EFAULT;
+	}
+	return -EINTR;
+}
+
+#ifdef CONFIG_PROC_FS
+static int hrtimer_read_proc(char *page, char **start, off_t off,
+			     int count, int *eof, void *data)
+{
+	unsigned long hist[HRTIMER_HIST], expired, max, flags;
+	u64 avg;
+	int i, len;
+
+	spin_lock_irqsave(&hrtimer_lock, flags);
+	memcpy(hist, hrtimer_stats.hist, sizeof(hist));
+	expired = hrtimer_stats.expired;
+	max = hrtimer_stats.max;
+	avg = hrtimer_stats.total;
+	len = sprintf(page, "active:     %d\n"
+		      "started:    %lu\n"
+		      "cancelled:  %lu\n"
+		      "interrupts: %lu\n"
+		      "expired:    %lu\n",
+		      hrtimer_active, hrtimer_stats.started,
+		      hrtimer_stats.cancelled, hrtimer_stats.interrupts,
+		      expired);
+	spin_unlock_irqrestore(&hrtimer_lock, flags);
+
+	if (expired)
+		do_div(avg, expired);
+	len += sprintf(page + len, "latency:    avg %lu ns, max %lu ns\n",
+		       (unsigned long)avg, max);
+	for (i = 0; i < HRTIMER_HIST; i++) {
+		if (i == HRTIMER_HIST - 1)
+			len += sprintf(page + len, "   >= %5lu us", 1UL << (i - 1));
+		else
+			len += sprintf(page + len, "    < %5lu us", 1UL << i);
+		len += sprintf(page + len, " %10lu\n", hist[i]);
+	}
+
+	if (len <= off + count)
+		*eof = 1;
+	*start = page + off;
+	len -= off;
+	if (len > count)
+		len = count;
+	if (len < 0)
+		len = 0;
+	return len;
+}
+
+static int __init hrtimer_proc_init(void)
+{
+	create_proc_read_entry("hrtimers", 0, 0, hrtimer_read_proc, NULL);
+	return 0;
+}
+
+__initcall(hrtimer_proc_init);
+#endif
+
+EXPORT_SYMBOL(hrtimer_start);
+EXPORT_SYMBOL(hrtimer_cancel);
+EXPORT_SYMBOL(hrtimer_active);
@@ -40,12 +40,80 @@ static void jiffiestotv(unsigned long jiffies, struct timeval *value)
 	value->tv_sec = jiffies / HZ;
 }
 
+#ifdef CONFIG_HIGH_RES_TIMERS
+/*
+ * While hrtimer_active is set ITIMER_REAL runs on real_hrtimer, to the
+ * nanosecond, instead of real_timer. A period below IT_REAL_HR_MIN is
+ * rounded up, so that a periodic itimer cannot swamp the machine with
+ * interrupts.
+ */
+#define IT_REAL_HR_MIN	10000	/* ns */
+
+static u64 tvtons(struct timeval *value)
+{
+	return (u64)(unsigned) value->tv_sec * 1000000000 +
+	       (u64)(unsigned) value->tv_usec * 1000;
+}
+
+static void it_real_hr_fn(unsigned long __data)
+{
+	struct task_struct * p = (struct task_struct *) __data;
+	u64 next, now;
+
+	send_sig(SIGALRM, p, 1);
+	if (p->it_real_hr_incr) {
+		next = p->real_hrtimer.expires + p->it_real_hr_incr;
+		now = hrtimer_now();
+		/* don't replay the periods we were late for */
+		if (next <= now)
+			next = now + p->it_real_hr_incr;
+		hrtimer_start(&p->real_hrtimer, next);
+	}
+}
+
+static void it_real_hr_get(struct itimerval *value)
+{
+	struct hrtimer *timer = &current->real_hrtimer;
+	u64 left = 0, now;
+
+	if (hrtimer_pending(timer)) {
+		now = hrtimer_now();
+		left = timer->expires;
+		/* look out for negative/zero itimer.. */
+		left = left > now + 1000 ? left - now : 1000;
+	}
+	ns_to_timeval(left, &value->it_value);
+	ns_to_timeval(current->it_real_hr_incr, &value->it_interval);
+}
+
+static void it_real_hr_set(struct itimerval *value)
+{
+	u64 val = tvtons(&value->it_value);
+	u64 interval = tvtons(&value->it_interval);
+
+	if (interval && interval < IT_REAL_HR_MIN)
+		interval = IT_REAL_HR_MIN;
+	current->it_real_hr_incr = interval;
+	if (!val)
+		return;
+	current->real_hrtimer.function = it_real_hr_fn;
+	current->real_hrtimer.data = (unsigned long) current;
+	hrtimer_start(&current->real_hrtimer, hrtimer_now() + val);
+}
+#endif
+
 int do_getitimer(int which, struct itimerval *value)
 {
 	register unsigned long val, interval;
 
 	switch (which) {
 	case ITIMER_REAL:
+#ifdef CONFIG_HIGH_RES_TIMERS
+		if (hrtimer_active) {
+			it_real_hr_get(value);
+			return 0;
+		}
+#endif
 		interval = current->it_real_incr;
 		val = 0;
 		/* 
@@ -117,6 +185,13 @@ int do_setitimer(int which, struct itimerval *value, struct itimerval *ovalue)
 	switch (which) {
 		case ITIMER_REAL:
 			del_timer_sync(&current->real_timer);
+#ifdef CONFIG_HIGH_RES_TIMERS
+			hrtimer_cancel(&current->real_hrtimer);
+			if (hrtimer_active) {
+				it_real_hr_set(value);
+				break;
+			}
+#endif
 			current->it_real_value = j;
 			current->it_real_incr = i;
 			if (!j)
@@ -339,6 +339,52 @@ repeat:
 	spin_unlock_irq(&timerlist_lock);
 }
 
+#ifdef CONFIG_DYNAMIC_TICK
+/*
+ * The jiffy by which the next timer is due, for the idle loop to let the
+ * tick sleep until then. A timer in one of the outer vectors is only
+ * looked for in the first non-empty slot of each.
+ */
+unsigned long next_timer_interrupt(void)
+{
+	struct list_head *head, *curr;
+	unsigned long next, flags;
+	int i, n;
+
+	spin_lock_irqsave(&timerlist_lock, flags);
+	next = jiffies;
+	if ((long)(jiffies - timer_jiffies) >= 0)
+		goto out;		/* timer_bh has not caught up yet */
+
+	for (i = 0; i < TVR_SIZE; i++) {
+		if (!list_empty(tv1.vec + ((tv1.index + i) & TVR_MASK))) {
+			next = timer_jiffies + i;
+			goto out;
+		}
+	}
+
+	next = jiffies + MAX_JIFFY_OFFSET;
+	for (n = 1; n < NOOF_TVECS; n++) {
+		for (i = 0; i < TVN_SIZE; i++) {
+			head = tvecs[n]->vec + ((tvecs[n]->index + i) & TVN_MASK);
+			if (list_empty(head))
+				continue;
+			for (curr = head->next; curr != head; curr = curr->next) {
+				struct timer_list *timer;
+
+				timer = list_entry(curr, struct timer_list, list);
+				if (time_before(timer->expires, next))
+					next = timer->expires;
+			}
+			break;
+		}
+	}
+out:
+	spin_unlock_irqrestore(&timerlist_lock, flags);
+	return next;
+}
+#endif
+
 spinlock_t tqueue_lock = SPIN_LOCK_UNLOCKED;
 
 void tqueue_bh(void)
@@ -844,6 +890,10 @@ asmlinkage long sys_nanosleep(struct timespec *rqtp, struct timespec *rmtp)
 	if (t.tv_nsec >= 1000000000L || t.tv_nsec < 0 || t.tv_sec < 0)
 		return -EINVAL;
 
+#ifdef CONFIG_HIGH_RES_TIMERS
+	if (hrtimer_active)
+		return hrtimer_nanosleep(&t, rmtp);
+#endif
 
 	if (t.tv_sec == 0 && t.tv_nsec <= 2000000L &&
 	    current->policy != SCHED_OTHER)
@@ -100,6 +100,8 @@
 #include <linux/init.h>
 #include <linux/kmod.h>
 #include <linux/module.h>
+#include <linux/rxpool.h>
+#include <net/tcp.h>
 #if defined(CONFIG_NET_RADIO) || defined(CONFIG_NET_PCMCIA_RADIO)
 #include <linux/wireless.h>		/* Note : will define WIRELESS_EXT */
 #include <net/iw_handler.h>
@@ -1032,11 +1034,56 @@ illegal_highdma(struct net_device *dev, struct sk_buff *skb)
  *	to congestion or traffic shaping.
  */
 
+#ifdef CONFIG_INET
+/*
+ * Cut a TCP super-packet into wire-sized frames and queue each of them.
+ * This happens before the qdisc, which polices and shapes by packet
+ * size.  Once the first segment is queued the rest are as good as sent
+ * to the caller: later drops are reported as congestion and left to
+ * TCP to repair.
+ */
+static int dev_gso_xmit(struct sk_buff *skb)
+{
+	struct net_device *dev = skb->dev;
+	struct sk_buff *segs = NULL, *next;
+	int ret = NET_XMIT_SUCCESS;
+	int first = 1;
+
+	if (skb->protocol == htons(ETH_P_IP) &&
+	    skb->nh.iph->protocol == IPPROTO_TCP)
+		segs = tcp_v4_gso_segment(skb,
+			!(dev->features&(NETIF_F_HW_CSUM|NETIF_F_NO_CSUM|
+					 NETIF_F_IP_CSUM)));
+	kfree_skb(skb);
+	if (segs == NULL)
+		return -ENOMEM;
+
+	for (; segs; segs = next) {
+		int rc;
+
+		next = segs->next;
+		segs->next = NULL;
+		rc = dev_queue_xmit(segs);
+		if (first)
+			ret = rc;
+		else if (rc != NET_XMIT_SUCCESS && ret == NET_XMIT_SUCCESS)
+			ret = NET_XMIT_CN;
+		first = 0;
+	}
+	return ret;
+}
+#endif
+
 int dev_queue_xmit(struct sk_buff *skb)
 {
 	struct net_device *dev = skb->dev;
 	struct Qdisc  *q;
 
+#ifdef CONFIG_INET
+	if (skb_shinfo(skb)->gso_size && !(dev->features&NETIF_F_TSO))
+		return dev_gso_xmit(skb);
+#endif
+
 	if (skb_shinfo(skb)->frag_list &&
 	    !(dev->features&NETIF_F_FRAGLIST) &&
 	    skb_linearize(skb, GFP_ATOMIC) != 0) {
@@ -1070,7 +1117,40 @@ int dev_queue_xmit(struct sk_buff *skb)
 	spin_lock_bh(&dev->queue_lock);
 	q = dev->qdisc;
 	if (q->enqueue) {
-		int ret = q->enqueue(skb, q);
+		int ret;
+
+		/* Nothing is queued and the driver is free: skip the queue.
+		   The driver is grabbed before the queue is released, as in
+		   qdisc_restart(), so nothing can get in front of us.
+		 */
+		if ((q->flags & TCQ_F_CAN_BYPASS) && q->q.qlen == 0 &&
+		    !netif_queue_stopped(dev) &&
+		    spin_trylock(&dev->xmit_lock)) {
+			dev->xmit_lock_owner = smp_processor_id();
+			spin_unlock(&dev->queue_lock);
+
+			qdisc_bypass_count(q, skb);
+			if (netdev_nit)
+				dev_queue_xmit_nit(skb, dev);
+
+			if (dev->hard_start_xmit(skb, dev) == 0) {
+				dev->xmit_lock_owner = -1;
+				spin_unlock_bh(&dev->xmit_lock);
+				return NET_XMIT_SUCCESS;
+			}
+			dev->xmit_lock_owner = -1;
+			spin_unlock(&dev->xmit_lock);
+
+			/* Driver is busy after all, leave it to the queue */
+			spin_lock(&dev->queue_lock);
+			q = dev->qdisc;
+			q->ops->requeue(skb, q);
+			netif_schedule(dev);
+			spin_unlock_bh(&dev->queue_lock);
+			return NET_XMIT_SUCCESS;
+		}
+
+		ret = q->enqueue(skb, q);
 
 		qdisc_run(dev);
 
@@ -2863,6 +2943,7 @@ int __init net_dev_init(void)
 
 	dst_init();
 	dev_mcast_init();
+	skb_rx_pool_init();
 
 #ifdef CONFIG_NET_SCHED
 	pktsched_init();
@@ -0,0 +1,322 @@
+/*
+ *	Pre-mapped receive buffer pools for PCI network drivers.
+ *
+ *	A driver refills its Rx ring with skb_rx_pool_alloc() and passes
+ *	frames up with skb_rx_pool_receive().  Buffers stay DMA mapped
+ *	while they travel through the stack; kfree_skbmem() offers them
+ *	back through skb_rx_pool_recycle() and only those whose data is
+ *	private and untouched in shape are kept, everything else is
+ *	unmapped and freed the normal way.
+ *
+ *	Each mapped buffer holds a reference on its pool, so a pool that
+ *	the driver has destroyed lives on until the last of its frames
+ *	has been freed by whoever held it.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version
+ *	2 of the License, or (at your option) any later version.
+ */
+
+#include <linux/config.h>
+#include <linux/types.h>
+#include <linux/kernel.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/init.h>
+#include <linux/pci.h>
+#include <linux/netdevice.h>
+#include <linux/etherdevice.h>
+#include <linux/skbuff.h>
+#include <linux/proc_fs.h>
+#include <linux/rxpool.h>
+
+static struct skb_rx_pool *rx_pool_list;
+static spinlock_t rx_pool_list_lock = SPIN_LOCK_UNLOCKED;
+
+static inline void rx_pool_put(struct skb_rx_pool *pool)
+{
+	if (atomic_dec_and_test(&pool->refcnt))
+		kfree(pool);
+}
+
+/* Unmap a buffer and cut it loose from its pool. */
+static void rx_pool_unmap(struct skb_rx_pool *pool, struct sk_buff *skb)
+{
+	pci_unmap_single(pool->pdev, skb->rx_dma, pool->size,
+			 pool->direction);
+	skb->rx_pool = NULL;
+	rx_pool_put(pool);
+}
+
+/**
+ *	skb_rx_pool_create - set up a receive buffer pool
+ *	@dev: device the pool feeds, used for /proc/net/rx_pool
+ *	@pdev: PCI device the buffers are mapped for
+ *	@size: bytes of each buffer the device may write
+ *	@headroom: bytes to reserve in front of the mapped area
+ *	@max_free: recycled buffers kept ready, beyond that they are freed
+ *	@copybreak: frames shorter than this are copied by skb_rx_pool_receive
+ *	@direction: DMA direction of the mappings; %PCI_DMA_BIDIRECTIONAL if
+ *	the driver writes descriptors the device reads into the buffers
+ *
+ *	Returns the new pool or %NULL when out of memory.
+ */
+struct skb_rx_pool *skb_rx_pool_create(struct net_device *dev,
+				       struct pci_dev *pdev,
+				       unsigned int size,
+				       unsigned int headroom,
+				       unsigned int max_free,
+				       unsigned int copybreak,
+				       int direction)
+{
+	struct skb_rx_pool *pool;
+
+	pool = kmalloc(sizeof(*pool), GFP_KERNEL);
+	if (pool == NULL)
+		return NULL;
+	memset(pool, 0, sizeof(*pool));
+
+	spin_lock_init(&pool->lock);
+	skb_queue_head_init(&pool->free);
+	pool->pdev = pdev;
+	pool->dev = dev;
+	pool->size = size;
+	pool->headroom = headroom;
+	pool->max_free = max_free;
+	pool->copybreak = copybreak;
+	pool->direction = direction;
+	atomic_set(&pool->refcnt, 1);
+
+	spin_lock_bh(&rx_pool_list_lock);
+	pool->next = rx_pool_list;
+	rx_pool_list = pool;
+	spin_unlock_bh(&rx_pool_list_lock);
+	return pool;
+}
+
+/**
+ *	skb_rx_pool_destroy - release a receive buffer pool
+ *	@pool: pool to release
+ *
+ *	Frees the recycled buffers and drops the owner's reference.
+ *	Buffers still held by the stack are unmapped and freed as they
+ *	come back.  The driver must not use @pool afterwards.
+ */
+void skb_rx_pool_destroy(struct skb_rx_pool *pool)
+{
+	struct skb_rx_pool **pp;
+	struct sk_buff *skb;
+	unsigned long flags;
+
+	spin_lock_bh(&rx_pool_list_lock);
+	for (pp = &rx_pool_list; *pp; pp = &(*pp)->next) {
+		if (*pp == pool) {
+			*pp = pool->next;
+			break;
+		}
+	}
+	spin_unlock_bh(&rx_pool_list_lock);
+
+	spin_lock_irqsave(&pool->lock, flags);
+	pool->dead = 1;
+	spin_unlock_irqrestore(&pool->lock, flags);
+
+	while ((skb = skb_dequeue(&pool->free)) != NULL) {
+		rx_pool_unmap(pool, skb);
+		kfree_skb(skb);
+	}
+	rx_pool_put(pool);
+}
+
+/**
+ *	skb_rx_pool_alloc - get a mapped receive buffer
+ *	@pool: pool to allocate from
+ *	@gfp_mask: allocation priority if the pool is empty
+ *
+ *	Returns an empty &sk_buff whose data area is mapped for @pool->size
+ *	bytes from skb->data, with the bus address in skb->rx_dma, or
+ *	%NULL on failure.
+ */
+struct sk_buff *skb_rx_pool_alloc(struct skb_rx_pool *pool, int gfp_mask)
+{
+	struct sk_buff *skb;
+	unsigned long flags;
+
+	spin_lock_irqsave(&pool->lock, flags);
+	skb = __skb_dequeue(&pool->free);
+	if (skb != NULL) {
+		pool->stats.allocs++;
+		pool->stats.hits++;
+		spin_unlock_irqrestore(&pool->lock, flags);
+		/* The stack may have written to the buffer. */
+		pci_dma_sync_single(pool->pdev, skb->rx_dma, pool->size,
+				    pool->direction);
+		return skb;
+	}
+	spin_unlock_irqrestore(&pool->lock, flags);
+
+	skb = __dev_alloc_skb(pool->size + pool->headroom, gfp_mask);
+	if (skb == NULL)
+		return NULL;
+	skb_reserve(skb, pool->headroom);
+	pool->data_off = skb->data - skb->head;
+	pool->truesize = skb->truesize;
+	skb->rx_dma = pci_map_single(pool->pdev, skb->data, pool->size,
+				     pool->direction);
+	skb->rx_pool = pool;
+	atomic_inc(&pool->refcnt);
+
+	spin_lock_irqsave(&pool->lock, flags);
+	pool->stats.allocs++;
+	spin_unlock_irqrestore(&pool->lock, flags);
+	return skb;
+}
+
+/**
+ *	skb_rx_pool_receive - prepare a received frame for the stack
+ *	@pool: pool @skb was allocated from
+ *	@skb: ring buffer holding the frame at skb->data
+ *	@len: frame length
+ *
+ *	Frames shorter than the pool's copybreak are copied into a fresh,
+ *	right-sized &sk_buff and @skb stays on the ring.  Otherwise @skb
+ *	itself is returned with @len bytes put; it keeps its mapping and
+ *	finds its way back to the pool when the stack frees it.  The
+ *	caller passes up whatever is returned and reuses @skb if that is
+ *	not @skb.
+ */
+struct sk_buff *skb_rx_pool_receive(struct skb_rx_pool *pool,
+				    struct sk_buff *skb, unsigned int len)
+{
+	unsigned int off = skb->data - (skb->head + pool->data_off);
+	struct sk_buff *copy;
+
+	pci_dma_sync_single(pool->pdev, skb->rx_dma, off + len,
+			    pool->direction);
+
+	if (len < pool->copybreak &&
+	    (copy = dev_alloc_skb(len + 2)) != NULL) {
+		copy->dev = skb->dev;
+		skb_reserve(copy, 2);	/* Align IP on 16 byte boundaries */
+		eth_copy_and_sum(copy, skb->data, len, 0);
+		skb_put(copy, len);
+		pool->stats.copybreak++;
+		return copy;
+	}
+
+	skb_put(skb, len);
+	return skb;
+}
+
+/**
+ *	skb_rx_pool_recycle - offer a freed buffer back to its pool
+ *	@skb: buffer being freed, with skb->rx_pool set
+ *
+ *	Returns 1 if the pool took @skb, including its data.  Otherwise
+ *	the buffer is unmapped and detached, and the caller frees it.
+ */
+int skb_rx_pool_recycle(struct sk_buff *skb)
+{
+	struct skb_rx_pool *pool = skb->rx_pool;
+	unsigned long flags;
+
+	if ((skb->cloned && atomic_read(&skb_shinfo(skb)->dataref) != 1) ||
+	    skb_shinfo(skb)->nr_frags || skb_shinfo(skb)->frag_list)
+		goto lost;
+
+	spin_lock_irqsave(&pool->lock, flags);
+	if (pool->dead || skb_queue_len(&pool->free) >= pool->max_free) {
+		spin_unlock_irqrestore(&pool->lock, flags);
+		goto lost;
+	}
+
+	skb->data = skb->tail = skb->head + pool->data_off;
+	skb->len = 0;
+	skb->data_len = 0;
+	skb->cloned = 0;
+	skb->truesize = pool->truesize;
+	/* __kfree_skb() has cleaned the header; the rest is what
+	   alloc_skb() would set up for new data. */
+	skb->ip_summed = CHECKSUM_NONE;
+	skb->csum = 0;
+	atomic_set(&skb->users, 1);
+	atomic_set(&skb_shinfo(skb)->dataref, 1);
+	skb_shinfo(skb)->gso_size = 0;
+	skb_shinfo(skb)->gso_segs = 0;
+
+	__skb_queue_head(&pool->free, skb);
+	pool->stats.recycled++;
+	spin_unlock_irqrestore(&pool->lock, flags);
+	return 1;
+
+lost:
+	skb_rx_pool_release(skb);
+	return 0;
+}
+
+/**
+ *	skb_rx_pool_release - detach a buffer from its pool
+ *	@skb: buffer with skb->rx_pool set
+ *
+ *	Used when the data of @skb is about to be replaced or freed
+ *	without going back to the pool.
+ */
+void skb_rx_pool_release(struct sk_buff *skb)
+{
+	struct skb_rx_pool *pool = skb->rx_pool;
+	unsigned long flags;
+
+	spin_lock_irqsave(&pool->lock, flags);
+	pool->stats.lost++;
+	spin_unlock_irqrestore(&pool->lock, flags);
+	rx_pool_unmap(pool, skb);
+}
+
+#ifdef CONFIG_PROC_FS
+static int rx_pool_read_proc(char *buffer, char **start, off_t offset,
+			     int length, int *eof, void *data)
+{
+	off_t pos = 0, begin = 0;
+	struct skb_rx_pool *pool;
+	int len;
+
+	len = sprintf(buffer, "Iface       allocs       hits   recycled"
+		      "       lost  copybreak  free\n");
+	spin_lock_bh(&rx_pool_list_lock);
+	for (pool = rx_pool_list; pool; pool = pool->next) {
+		len += sprintf(buffer+len, "%-8s %9lu %10lu %10lu %10lu %10lu %5u\n",
+			       pool->dev->name, pool->stats.allocs,
+			       pool->stats.hits, pool->stats.recycled,
+			       pool->stats.lost, pool->stats.copybreak,
+			       skb_queue_len(&pool->free));
+
+		pos = begin + len;
+		if (pos < offset) {
+			len = 0;
+			begin = pos;
+		}
+		if (pos > offset + length)
+			goto done;
+	}
+	*eof = 1;
+
+done:
+	spin_unlock_bh(&rx_pool_list_lock);
+	*start = buffer + (offset - begin);
+	len -= (offset - begin);
+	if (len > length)
+		len = length;
+	if (len < 0)
+		len = 0;
+	return len;
+}
+#endif
+
+void __init skb_rx_pool_init(void)
+{
+#ifdef CONFIG_PROC_FS
+	create_proc_read_entry("net/rx_pool", 0, 0, rx_pool_read_proc, NULL);
+#endif
+}
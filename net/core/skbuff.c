@@ -52,6 +52,7 @@
 #include <linux/rtnetlink.h>
 #include <linux/init.h>
 #include <linux/highmem.h>
+#include <linux/rxpool.h>
 
 #include <net/protocol.h>
 #include <net/dst.h>
@@ -203,10 +204,13 @@ struct sk_buff *alloc_skb(unsigned int size,int gfp_mask)
 	skb->len = 0;
 	skb->cloned = 0;
 	skb->data_len = 0;
+	skb->rx_pool = NULL;
 
 	atomic_set(&skb->users, 1); 
 	atomic_set(&(skb_shinfo(skb)->dataref), 1);
 	skb_shinfo(skb)->nr_frags = 0;
+	skb_shinfo(skb)->gso_size = 0;
+	skb_shinfo(skb)->gso_segs = 0;
 	skb_shinfo(skb)->frag_list = NULL;
 	return skb;
 
@@ -295,6 +299,9 @@ static void skb_release_data(struct sk_buff *skb)
  */
 void kfree_skbmem(struct sk_buff *skb)
 {
+	/* Pooled receive buffers go back to their driver still mapped. */
+	if (skb->rx_pool && skb_rx_pool_recycle(skb))
+		return;
 	skb_release_data(skb);
 	skb_head_to_pool(skb);
 }
@@ -386,6 +393,7 @@ struct sk_buff *skb_clone(struct sk_buff *skb, int gfp_mask)
 	C(tail);
 	C(end);
 	n->destructor = NULL;
+	n->rx_pool = NULL;
 #ifdef CONFIG_NETFILTER
 	C(nfmark);
 	C(nfcache);
@@ -446,6 +454,16 @@ static void copy_skb_header(struct sk_buff *new, const struct sk_buff *old)
 #endif
 }
 
+/* A full copy of a super-packet is still one; the segments that
+ * skb_segment() cuts from it are not, so this is not part of
+ * copy_skb_header().
+ */
+static inline void copy_skb_gso(struct sk_buff *new, const struct sk_buff *old)
+{
+	skb_shinfo(new)->gso_size = skb_shinfo(old)->gso_size;
+	skb_shinfo(new)->gso_segs = skb_shinfo(old)->gso_segs;
+}
+
 /**
  *	skb_copy	-	create private copy of an sk_buff
  *	@skb: buffer to copy
@@ -486,6 +504,7 @@ struct sk_buff *skb_copy(const struct sk_buff *skb, int gfp_mask)
 		BUG();
 
 	copy_skb_header(n, skb);
+	copy_skb_gso(n, skb);
 
 	return n;
 }
@@ -493,6 +512,8 @@ struct sk_buff *skb_copy(const struct sk_buff *skb, int gfp_mask)
 /* Keep head the same: replace data */
 int skb_linearize(struct sk_buff *skb, int gfp_mask)
 {
+	unsigned short gso_size = skb_shinfo(skb)->gso_size;
+	unsigned short gso_segs = skb_shinfo(skb)->gso_segs;
 	unsigned int size;
 	u8 *data;
 	long offset;
@@ -519,6 +540,8 @@ int skb_linearize(struct sk_buff *skb, int gfp_mask)
 	offset = data - skb->head;
 
 	/* Free old data. */
+	if (skb->rx_pool)
+		skb_rx_pool_release(skb);
 	skb_release_data(skb);
 
 	skb->head = data;
@@ -534,6 +557,8 @@ int skb_linearize(struct sk_buff *skb, int gfp_mask)
 	/* Set up shinfo */
 	atomic_set(&(skb_shinfo(skb)->dataref), 1);
 	skb_shinfo(skb)->nr_frags = 0;
+	skb_shinfo(skb)->gso_size = gso_size;
+	skb_shinfo(skb)->gso_segs = gso_segs;
 	skb_shinfo(skb)->frag_list = NULL;
 
 	/* We are no longer a clone, even if we were. */
@@ -597,6 +622,7 @@ struct sk_buff *pskb_copy(struct sk_buff *skb, int gfp_mask)
 	}
 
 	copy_skb_header(n, skb);
+	copy_skb_gso(n, skb);
 
 	return n;
 }
@@ -644,6 +670,8 @@ int pskb_expand_head(struct sk_buff *skb, int nhead, int ntail, int gfp_mask)
 	if (skb_shinfo(skb)->frag_list)
 		skb_clone_fraglist(skb);
 
+	if (skb->rx_pool)
+		skb_rx_pool_release(skb);
 	skb_release_data(skb);
 
 	off = (data+nhead) - skb->head;
@@ -731,6 +759,7 @@ struct sk_buff *skb_copy_expand(const struct sk_buff *skb,
 		BUG();
 
 	copy_skb_header(n, skb);
+	copy_skb_gso(n, skb);
 	return n;
 }
 
@@ -1208,6 +1237,116 @@ void skb_copy_and_csum_dev(const struct sk_buff *skb, u8 *to)
 	}
 }
 
+/* Can the frag_list of @skb be sent as the segments themselves? */
+static int skb_segment_fraglist_ok(struct sk_buff *skb, unsigned int hlen,
+				   unsigned int mss)
+{
+	struct sk_buff *list;
+
+	if (skb_headlen(skb) != hlen || skb_shinfo(skb)->nr_frags ||
+	    skb_cloned(skb))
+		return 0;
+
+	for (list = skb_shinfo(skb)->frag_list; list; list = list->next) {
+		if (list->len > mss || (list->next && list->len != mss) ||
+		    skb_shared(list) || skb_headroom(list) < hlen ||
+		    skb_shinfo(list)->frag_list)
+			return 0;
+	}
+	return 1;
+}
+
+/**
+ *	skb_segment	-	cut a super-packet into wire-sized frames
+ *	@skb: buffer to segment
+ *	@hlen: bytes of headers at skb->data, repeated in every segment
+ *	@mss: payload bytes per segment
+ *	@sw_csum: the device cannot checksum the segments
+ *
+ *	Returns a list, linked through ->next, of buffers each carrying a
+ *	copy of the @hlen header bytes followed by up to @mss bytes of the
+ *	payload, or %NULL when out of memory.  Header fields are left for
+ *	the protocol to fix up.  A segment's ip_summed is %CHECKSUM_HW if
+ *	its payload checksum is still to be computed, otherwise skb->csum
+ *	holds the payload checksum.  Payload that has to be copied is
+ *	checksummed in the same pass when @sw_csum is set, so that
+ *	skb_checksum_help() need not read it again.
+ *
+ *	When the payload of @skb is a frag_list of @mss sized buffers with
+ *	room for the headers, those buffers are reused and nothing but the
+ *	headers is copied; @skb is left holding the headers alone.  The
+ *	caller frees @skb in either case.  Those buffers may be clones
+ *	sharing skb_shared_info with the caller's own copies, so nothing
+ *	but their headroom is written, and no segment carries gso state.
+ */
+struct sk_buff *skb_segment(struct sk_buff *skb, unsigned int hlen,
+			    unsigned int mss, int sw_csum)
+{
+	struct sk_buff *segs = NULL, **tail = &segs;
+	struct sk_buff *nskb, *list;
+	unsigned int offset, len;
+
+	if (skb_headlen(skb) < hlen || mss == 0)
+		return NULL;
+
+	if (skb_segment_fraglist_ok(skb, hlen, mss)) {
+		list = skb_shinfo(skb)->frag_list;
+		skb_shinfo(skb)->frag_list = NULL;
+		skb->len = hlen;
+		skb->data_len = 0;
+
+		while ((nskb = list) != NULL) {
+			list = nskb->next;
+			nskb->next = NULL;
+			memcpy(skb_push(nskb, hlen), skb->data, hlen);
+			copy_skb_header(nskb, skb);
+			if (skb->sk)
+				skb_set_owner_w(nskb, skb->sk);
+			*tail = nskb;
+			tail = &nskb->next;
+		}
+		return segs;
+	}
+
+	for (offset = hlen; offset < skb->len; offset += len) {
+		len = skb->len - offset;
+		if (len > mss)
+			len = mss;
+
+		nskb = alloc_skb(skb_headroom(skb) + hlen + len, GFP_ATOMIC);
+		if (nskb == NULL)
+			goto nomem;
+		skb_reserve(nskb, skb_headroom(skb));
+		skb_put(nskb, hlen + len);
+		memcpy(nskb->data, skb->data, hlen);
+
+		if (skb->ip_summed == CHECKSUM_HW && !sw_csum) {
+			nskb->ip_summed = CHECKSUM_HW;
+			if (skb_copy_bits(skb, offset, nskb->data + hlen, len))
+				BUG();
+		} else {
+			nskb->ip_summed = CHECKSUM_NONE;
+			nskb->csum = skb_copy_and_csum_bits(skb, offset,
+							    nskb->data + hlen,
+							    len, 0);
+		}
+
+		copy_skb_header(nskb, skb);
+		if (skb->sk)
+			skb_set_owner_w(nskb, skb->sk);
+		*tail = nskb;
+		tail = &nskb->next;
+	}
+	return segs;
+
+nomem:
+	while ((nskb = segs) != NULL) {
+		segs = nskb->next;
+		kfree_skb(nskb);
+	}
+	return NULL;
+}
+
 #if 0
 /* 
  * 	Tune the memory allocator for a new MTU size.
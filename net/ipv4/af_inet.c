@@ -128,6 +128,7 @@ extern int snmp_get_info(char *, char **, off_t, int);
 extern int netstat_get_info(char *, char **, off_t, int);
 extern int afinet_get_info(char *, char **, off_t, int);
 extern int tcp_get_info(char *, char **, off_t, int);
+extern int tcp_hash_get_info(char *, char **, off_t, int);
 extern int udp_get_info(char *, char **, off_t, int);
 extern void ip_mc_drop_socket(struct sock *sk);
 
@@ -1195,6 +1196,7 @@ static int __init inet_init(void)
 	proc_net_create ("snmp", 0, snmp_get_info);
 	proc_net_create ("sockstat", 0, afinet_get_info);
 	proc_net_create ("tcp", 0, tcp_get_info);
+	proc_net_create ("tcp_hash", 0, tcp_hash_get_info);
 	proc_net_create ("udp", 0, udp_get_info);
 #endif		/* CONFIG_PROC_FS */
 
@@ -0,0 +1,147 @@
+/*
+ * INET		An implementation of the TCP/IP protocol suite for the LINUX
+ *		operating system.  INET is implemented using the  BSD Socket
+ *		interface as the means of communication with the user level.
+ *
+ *		IPv4 FIB: lookup benchmark.
+ *
+ *		Each read of /proc/net/fib_bench runs `lookups' fib_lookup()
+ *		calls against the tables as they are loaded, for the same
+ *		pseudo-random destinations every time, and reports the rate.
+ *		Destinations are drawn from the low `bits' bits below `net';
+ *		write "lookups net bits" (e.g. "1000000 10.0.0.0 16") to set
+ *		them.  Load a realistic table first: an empty one measures
+ *		little more than the default route.
+ *
+ *		This program is free software; you can redistribute it and/or
+ *		modify it under the terms of the GNU General Public License
+ *		as published by the Free Software Foundation; either version
+ *		2 of the License, or (at your option) any later version.
+ */
+
+#include <linux/config.h>
+#include <linux/types.h>
+#include <linux/kernel.h>
+#include <linux/sched.h>
+#include <linux/string.h>
+#include <linux/ctype.h>
+#include <linux/inet.h>
+#include <linux/proc_fs.h>
+#include <linux/init.h>
+#include <asm/uaccess.h>
+#include <asm/div64.h>
+
+#include <net/ip.h>
+#include <net/route.h>
+#include <net/ip_fib.h>
+
+#ifdef CONFIG_IP_FIB_TRIE
+#define FIB_BENCH_ENGINE	"trie"
+#else
+#define FIB_BENCH_ENGINE	"hash"
+#endif
+
+static int fib_bench_lookups = 100000;
+static u32 fib_bench_net;			/* Host order */
+static int fib_bench_bits = 32;
+
+static int fib_bench_read(char *buffer, char **start, off_t offset,
+			  int length, int *eof, void *data)
+{
+	u32 mask = fib_bench_bits >= 32 ? ~0U : (1U << fib_bench_bits) - 1;
+	u32 seed = 1, net = htonl(fib_bench_net);
+	unsigned int found = 0;
+	struct timeval tv_start, tv_end;
+	struct rt_key key;
+	u64 rate;
+	long usec;
+	int i, len;
+
+	/* One shot: every read reruns the measurement. */
+	if (offset > 0) {
+		*eof = 1;
+		return 0;
+	}
+
+	memset(&key, 0, sizeof(key));
+	key.scope = RT_SCOPE_UNIVERSE;
+
+	do_gettimeofday(&tv_start);
+	for (i = 0; i < fib_bench_lookups; i++) {
+		struct fib_result res;
+
+		seed = seed * 1103515245 + 12345;
+		key.dst = htonl(fib_bench_net | (seed & mask));
+		if (fib_lookup(&key, &res) == 0) {
+			fib_res_put(&res);
+			found++;
+		}
+
+		if ((i & 1023) == 0 && current->need_resched)
+			schedule();
+	}
+	do_gettimeofday(&tv_end);
+
+	usec = (tv_end.tv_sec - tv_start.tv_sec) * 1000000L
+		+ (tv_end.tv_usec - tv_start.tv_usec);
+	if (usec <= 0)
+		usec = 1;
+	rate = (u64)fib_bench_lookups * 1000000;
+	do_div(rate, usec);
+
+	len = sprintf(buffer, "%s %u.%u.%u.%u/%d %9d lookups %9ld usec"
+		      " %9lu lookups/s %9u routed\n", FIB_BENCH_ENGINE,
+		      NIPQUAD(net),
+		      32 - fib_bench_bits, fib_bench_lookups, usec,
+		      (unsigned long)rate, found);
+	*eof = 1;
+	*start = buffer;
+	return len > length ? length : len;
+}
+
+static int fib_bench_write(struct file *file, const char *buffer,
+			   unsigned long count, void *data)
+{
+	char buf[64], *p, *q;
+	unsigned long lookups, bits;
+	u32 net;
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+	if (copy_from_user(buf, buffer, count))
+		return -EFAULT;
+	buf[count] = '\0';
+
+	lookups = simple_strtoul(buf, &p, 0);
+	while (isspace(*p))
+		p++;
+	for (q = p; *q && !isspace(*q); q++)
+		;
+	if (*q == '\0')
+		return -EINVAL;
+	*q++ = '\0';
+	net = ntohl(in_aton(p));
+	bits = simple_strtoul(q, NULL, 0);
+
+	if (lookups == 0 || lookups > INT_MAX || bits > 32)
+		return -EINVAL;
+
+	fib_bench_lookups = lookups;
+	fib_bench_bits = bits;
+	fib_bench_net = bits >= 32 ? 0 : net & ~((1U << bits) - 1);
+	return count;
+}
+
+static int __init fib_bench_init(void)
+{
+	struct proc_dir_entry *ent;
+
+	ent = create_proc_entry("net/fib_bench", S_IFREG|S_IRUSR|S_IWUSR, 0);
+	if (ent) {
+		ent->read_proc = fib_bench_read;
+		ent->write_proc = fib_bench_write;
+	}
+	return 0;
+}
+
+__initcall(fib_bench_init);
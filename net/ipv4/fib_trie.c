@@ -0,0 +1,936 @@
+/*
+ * INET		An implementation of the TCP/IP protocol suite for the LINUX
+ *		operating system.  INET is implemented using the  BSD Socket
+ *		interface as the means of communication with the user level.
+ *
+ *		IPv4 FIB: multibit trie lookup engine.
+ *
+ *		A drop-in replacement for fib_hash.c.  Prefixes hang off a
+ *		fixed stride trie: 8 bits at the root, 4 bits per level
+ *		below, so a /32 is at most seven nodes deep.  A prefix is
+ *		stored in the node whose stride contains its last bit and is
+ *		expanded over every slot it covers there; each slot keeps
+ *		the longest such prefix, and each prefix points to the next
+ *		shorter one in the same node, so a lookup walks down once
+ *		and then tries at most a few candidates on its way back up
+ *		instead of probing all 33 hash zones.
+ *
+ *		Routes of one prefix are kept on a list in the same order as
+ *		a fib_hash chain (tos descending, then priority), and the
+ *		insert, delete, zombie and flush rules are those of
+ *		fib_hash.c, so the two engines behave the same.
+ *
+ *		This program is free software; you can redistribute it and/or
+ *		modify it under the terms of the GNU General Public License
+ *		as published by the Free Software Foundation; either version
+ *		2 of the License, or (at your option) any later version.
+ */
+
+#include <linux/config.h>
+#include <asm/uaccess.h>
+#include <asm/system.h>
+#include <linux/types.h>
+#include <linux/kernel.h>
+#include <linux/sched.h>
+#include <linux/mm.h>
+#include <linux/string.h>
+#include <linux/socket.h>
+#include <linux/sockios.h>
+#include <linux/errno.h>
+#include <linux/in.h>
+#include <linux/inet.h>
+#include <linux/netdevice.h>
+#include <linux/if_arp.h>
+#include <linux/proc_fs.h>
+#include <linux/skbuff.h>
+#include <linux/netlink.h>
+#include <linux/init.h>
+#include <linux/list.h>
+
+#include <net/ip.h>
+#include <net/protocol.h>
+#include <net/route.h>
+#include <net/tcp.h>
+#include <net/sock.h>
+#include <net/ip_fib.h>
+
+static kmem_cache_t * fn_trie_kmem;
+static kmem_cache_t * fn_leaf_kmem;
+static kmem_cache_t * fn_tnode_kmem;
+
+struct fib_node
+{
+	struct fib_node		*fn_next;
+	struct fib_info		*fn_info;
+#define FIB_INFO(f)	((f)->fn_info)
+	u32			fn_key;		/* Prefix, network order */
+	u8			fn_tos;
+	u8			fn_type;
+	u8			fn_scope;
+	u8			fn_state;
+};
+
+#define FN_S_ZOMBIE	1
+#define FN_S_ACCESSED	2
+
+static int fib_trie_zombies;
+
+/* One prefix and its routes. */
+struct fn_leaf
+{
+	struct fn_leaf		*up;		/* Next shorter prefix in this node */
+	struct fib_node		*nodes;
+	struct list_head	list;		/* All prefixes of the table */
+	u32			key;		/* Host order */
+	int			len;
+};
+
+struct fn_slot
+{
+	struct fn_tnode		*child;
+	struct fn_leaf		*best;		/* Longest prefix covering the slot */
+};
+
+struct fn_tnode
+{
+	struct fn_tnode		*parent;
+	int			count;		/* Children + prefixes stored here */
+	u8			level;
+	u8			shift;
+	u8			bits;
+	u8			pindex;		/* Our slot in the parent */
+	struct fn_slot		slot[0];
+};
+
+#define FN_ROOT_BITS	8
+#define FN_BITS		4
+#define FN_LEVELS	7
+
+struct fn_trie
+{
+	struct fn_tnode		*root;
+	struct fn_leaf		*dflt;		/* 0/0 lives outside the trie */
+	struct list_head	leaves;
+};
+
+/* Level of the node holding a prefix of length len (1..32). */
+static __inline__ int fn_level(int len)
+{
+	return len <= FN_ROOT_BITS ? 0 : (len - FN_ROOT_BITS - 1) / FN_BITS + 1;
+}
+
+/* Prefix length consumed above a node of the given level. */
+static __inline__ int fn_level_base(int level)
+{
+	return level ? FN_ROOT_BITS + (level - 1) * FN_BITS : 0;
+}
+
+static __inline__ unsigned int fn_index(struct fn_tnode *tn, u32 key)
+{
+	return (key >> tn->shift) & ((1 << tn->bits) - 1);
+}
+
+static rwlock_t fib_trie_lock = RW_LOCK_UNLOCKED;
+
+static struct fn_tnode *fn_new_tnode(int level)
+{
+	struct fn_tnode *tn;
+	int bits = level ? FN_BITS : FN_ROOT_BITS;
+	int size = sizeof(struct fn_tnode) + (sizeof(struct fn_slot) << bits);
+
+	if (level)
+		tn = kmem_cache_alloc(fn_tnode_kmem, SLAB_KERNEL);
+	else
+		tn = kmalloc(size, GFP_KERNEL);
+	if (tn == NULL)
+		return NULL;
+
+	memset(tn, 0, size);
+	tn->level = level;
+	tn->bits = bits;
+	tn->shift = 32 - fn_level_base(level) - bits;
+	return tn;
+}
+
+static void fn_free_node(struct fib_node * f)
+{
+	fib_release_info(FIB_INFO(f));
+	kmem_cache_free(fn_trie_kmem, f);
+}
+
+/* Find the node a prefix belongs in, or NULL if the path is missing. */
+static struct fn_tnode *fn_find_tnode(struct fn_trie *t, u32 key, int len)
+{
+	struct fn_tnode *tn = t->root;
+	int level = fn_level(len);
+
+	while (tn && tn->level < level)
+		tn = tn->slot[fn_index(tn, key)].child;
+	return tn;
+}
+
+static struct fn_leaf *fn_find_leaf(struct fn_trie *t, u32 key, int len)
+{
+	struct fn_tnode *tn;
+	struct fn_leaf *l;
+
+	if (len == 0)
+		return t->dflt;
+
+	tn = fn_find_tnode(t, key, len);
+	if (tn == NULL)
+		return NULL;
+
+	/* The chain is ordered by decreasing length. */
+	for (l = tn->slot[fn_index(tn, key)].best; l; l = l->up) {
+		if (l->len <= len)
+			return (l->len == len && l->key == key) ? l : NULL;
+	}
+	return NULL;
+}
+
+/* Free empty nodes from tn upwards.  The fib trie lock must be held. */
+static void fn_prune(struct fn_tnode *tn)
+{
+	struct fn_tnode *parent;
+
+	while ((parent = tn->parent) != NULL && tn->count == 0) {
+		parent->slot[tn->pindex].child = NULL;
+		parent->count--;
+		kmem_cache_free(fn_tnode_kmem, tn);
+		tn = parent;
+	}
+}
+
+/* Hook l into the slots of tn it covers.  The fib trie lock must be held. */
+static void fn_link_leaf(struct fn_tnode *tn, struct fn_leaf *l)
+{
+	unsigned int first = fn_index(tn, l->key);
+	unsigned int n = 1 << (tn->bits - (l->len - fn_level_base(tn->level)));
+	struct fn_leaf *p;
+	unsigned int i;
+
+	/* Whatever is shorter than l at one of its slots covers all of them. */
+	for (p = tn->slot[first].best; p && p->len > l->len; p = p->up)
+		;
+	l->up = p;
+
+	for (i = first; i < first + n; i++) {
+		struct fn_leaf **lp = &tn->slot[i].best;
+
+		while (*lp && (*lp)->len > l->len)
+			lp = &(*lp)->up;
+		*lp = l;
+	}
+	tn->count++;
+}
+
+/* The fib trie lock must be held. */
+static void fn_unlink_leaf(struct fn_tnode *tn, struct fn_leaf *l)
+{
+	unsigned int first = fn_index(tn, l->key);
+	unsigned int n = 1 << (tn->bits - (l->len - fn_level_base(tn->level)));
+	unsigned int i;
+
+	for (i = first; i < first + n; i++) {
+		struct fn_leaf **lp = &tn->slot[i].best;
+
+		while (*lp && *lp != l)
+			lp = &(*lp)->up;
+		if (*lp)
+			*lp = l->up;
+	}
+	tn->count--;
+	fn_prune(tn);
+}
+
+/*
+ * Create the prefix key/len holding the single route f and make it
+ * visible to lookups.  Missing trie nodes are created on the way.
+ */
+static struct fn_leaf *
+fn_new_leaf(struct fn_trie *t, u32 key, int len, struct fib_node *f)
+{
+	struct fn_tnode *tn, *child;
+	struct fn_leaf *l;
+	int level;
+
+	l = kmem_cache_alloc(fn_leaf_kmem, SLAB_KERNEL);
+	if (l == NULL)
+		return NULL;
+	l->up = NULL;
+	l->nodes = f;
+	l->key = key;
+	l->len = len;
+
+	if (len == 0) {
+		write_lock_bh(&fib_trie_lock);
+		t->dflt = l;
+		list_add_tail(&l->list, &t->leaves);
+		write_unlock_bh(&fib_trie_lock);
+		return l;
+	}
+
+	level = fn_level(len);
+	for (tn = t->root; tn->level < level; tn = child) {
+		unsigned int i = fn_index(tn, key);
+
+		child = tn->slot[i].child;
+		if (child)
+			continue;
+
+		/* Writers are serialized by the RTNL, lookups may run. */
+		child = fn_new_tnode(tn->level + 1);
+		if (child == NULL) {
+			write_lock_bh(&fib_trie_lock);
+			fn_prune(tn);
+			write_unlock_bh(&fib_trie_lock);
+			kmem_cache_free(fn_leaf_kmem, l);
+			return NULL;
+		}
+		child->parent = tn;
+		child->pindex = i;
+		write_lock_bh(&fib_trie_lock);
+		tn->slot[i].child = child;
+		tn->count++;
+		write_unlock_bh(&fib_trie_lock);
+	}
+
+	write_lock_bh(&fib_trie_lock);
+	fn_link_leaf(tn, l);
+	list_add_tail(&l->list, &t->leaves);
+	write_unlock_bh(&fib_trie_lock);
+	return l;
+}
+
+/* Drop an empty prefix.  The fib trie lock must be held. */
+static void fn_del_leaf(struct fn_trie *t, struct fn_leaf *l)
+{
+	list_del(&l->list);
+	if (l->len == 0)
+		t->dflt = NULL;
+	else
+		fn_unlink_leaf(fn_find_tnode(t, l->key, l->len), l);
+	kmem_cache_free(fn_leaf_kmem, l);
+}
+
+/* Try the routes of one prefix in the order fn_hash_lookup would. */
+static __inline__ int
+fn_leaf_match(struct fn_leaf *l, const struct rt_key *key, struct fib_result *res)
+{
+	struct fib_node *f;
+	int err;
+
+	for (f = l->nodes; f; f = f->fn_next) {
+#ifdef CONFIG_IP_ROUTE_TOS
+		if (f->fn_tos && f->fn_tos != key->tos)
+			continue;
+#endif
+		f->fn_state |= FN_S_ACCESSED;
+
+		if (f->fn_state&FN_S_ZOMBIE)
+			continue;
+		if (f->fn_scope < key->scope)
+			continue;
+
+		err = fib_semantic_match(f->fn_type, FIB_INFO(f), key, res);
+		if (err == 0) {
+			res->type = f->fn_type;
+			res->scope = f->fn_scope;
+			res->prefixlen = l->len;
+			return 0;
+		}
+		if (err < 0)
+			return err;
+	}
+	return 1;
+}
+
+static int
+fn_trie_lookup(struct fib_table *tb, const struct rt_key *key, struct fib_result *res)
+{
+	int err;
+	struct fn_trie *t = (struct fn_trie*)tb->tb_data;
+	struct fn_tnode *path[FN_LEVELS];
+	struct fn_tnode *tn;
+	struct fn_leaf *l;
+	u32 dst = ntohl(key->dst);
+	int depth = 0;
+
+	read_lock(&fib_trie_lock);
+	for (tn = t->root; tn; tn = tn->slot[fn_index(tn, dst)].child)
+		path[depth++] = tn;
+
+	/* Deepest node first: its prefixes are the longest. */
+	while (--depth >= 0) {
+		tn = path[depth];
+		for (l = tn->slot[fn_index(tn, dst)].best; l; l = l->up) {
+			if ((err = fn_leaf_match(l, key, res)) <= 0)
+				goto out;
+		}
+	}
+	err = 1;
+	if (t->dflt)
+		err = fn_leaf_match(t->dflt, key, res);
+out:
+	read_unlock(&fib_trie_lock);
+	return err;
+}
+
+static int fn_trie_last_dflt=-1;
+
+static int fib_detect_death(struct fib_info *fi, int order,
+			    struct fib_info **last_resort, int *last_idx)
+{
+	struct neighbour *n;
+	int state = NUD_NONE;
+
+	n = neigh_lookup(&arp_tbl, &fi->fib_nh[0].nh_gw, fi->fib_dev);
+	if (n) {
+		state = n->nud_state;
+		neigh_release(n);
+	}
+	if (state==NUD_REACHABLE)
+		return 0;
+	if ((state&NUD_VALID) && order != fn_trie_last_dflt)
+		return 0;
+	if ((state&NUD_VALID) ||
+	    (*last_idx<0 && order > fn_trie_last_dflt)) {
+		*last_resort = fi;
+		*last_idx = order;
+	}
+	return 1;
+}
+
+static void
+fn_trie_select_default(struct fib_table *tb, const struct rt_key *key, struct fib_result *res)
+{
+	int order, last_idx;
+	struct fib_node *f;
+	struct fib_info *fi = NULL;
+	struct fib_info *last_resort;
+	struct fn_trie *t = (struct fn_trie*)tb->tb_data;
+
+	last_idx = -1;
+	last_resort = NULL;
+	order = -1;
+
+	read_lock(&fib_trie_lock);
+	if (t->dflt == NULL)
+		goto out;
+
+	for (f = t->dflt->nodes; f; f = f->fn_next) {
+		struct fib_info *next_fi = FIB_INFO(f);
+
+		if ((f->fn_state&FN_S_ZOMBIE) ||
+		    f->fn_scope != res->scope ||
+		    f->fn_type != RTN_UNICAST)
+			continue;
+
+		if (next_fi->fib_priority > res->fi->fib_priority)
+			break;
+		if (!next_fi->fib_nh[0].nh_gw || next_fi->fib_nh[0].nh_scope != RT_SCOPE_LINK)
+			continue;
+		f->fn_state |= FN_S_ACCESSED;
+
+		if (fi == NULL) {
+			if (next_fi != res->fi)
+				break;
+		} else if (!fib_detect_death(fi, order, &last_resort, &last_idx)) {
+			if (res->fi)
+				fib_info_put(res->fi);
+			res->fi = fi;
+			atomic_inc(&fi->fib_clntref);
+			fn_trie_last_dflt = order;
+			goto out;
+		}
+		fi = next_fi;
+		order++;
+	}
+
+	if (order<=0 || fi==NULL) {
+		fn_trie_last_dflt = -1;
+		goto out;
+	}
+
+	if (!fib_detect_death(fi, order, &last_resort, &last_idx)) {
+		if (res->fi)
+			fib_info_put(res->fi);
+		res->fi = fi;
+		atomic_inc(&fi->fib_clntref);
+		fn_trie_last_dflt = order;
+		goto out;
+	}
+
+	if (last_idx >= 0) {
+		if (res->fi)
+			fib_info_put(res->fi);
+		res->fi = last_resort;
+		if (last_resort)
+			atomic_inc(&last_resort->fib_clntref);
+	}
+	fn_trie_last_dflt = last_idx;
+out:
+	read_unlock(&fib_trie_lock);
+}
+
+/* Every node of a prefix list has the same key, so only tos separates them. */
+#define FIB_SCAN(f, fp) \
+for ( ; ((f) = *(fp)) != NULL; (fp) = &(f)->fn_next)
+
+#ifndef CONFIG_IP_ROUTE_TOS
+#define FIB_SCAN_TOS(f, fp, tos) FIB_SCAN(f, fp)
+#else
+#define FIB_SCAN_TOS(f, fp, tos) \
+for ( ; ((f) = *(fp)) != NULL && (f)->fn_tos == (tos) ; (fp) = &(f)->fn_next)
+#endif
+
+
+static void rtmsg_fib(int, struct fib_node*, int, int,
+		      struct nlmsghdr *n,
+		      struct netlink_skb_parms *);
+
+static int
+fn_trie_insert(struct fib_table *tb, struct rtmsg *r, struct kern_rta *rta,
+		struct nlmsghdr *n, struct netlink_skb_parms *req)
+{
+	struct fn_trie *table = (struct fn_trie*)tb->tb_data;
+	struct fib_node *new_f, *f, **fp, **del_fp, *head;
+	struct fn_leaf *l;
+	struct fib_info *fi;
+
+	int z = r->rtm_dst_len;
+	int type = r->rtm_type;
+#ifdef CONFIG_IP_ROUTE_TOS
+	u8 tos = r->rtm_tos;
+#endif
+	u32 key;
+	int err;
+
+	if (z > 32)
+		return -EINVAL;
+
+	key = 0;
+	if (rta->rta_dst) {
+		u32 dst;
+		memcpy(&dst, rta->rta_dst, 4);
+		if (dst & ~inet_make_mask(z))
+			return -EINVAL;
+		key = ntohl(dst);
+	}
+
+	if  ((fi = fib_create_info(r, rta, n, &err)) == NULL)
+		return err;
+
+	l = fn_find_leaf(table, key, z);
+	head = NULL;
+	fp = l ? &l->nodes : &head;
+
+#ifdef CONFIG_IP_ROUTE_TOS
+	/*
+	 * Find route with the same tos.
+	 */
+	FIB_SCAN(f, fp) {
+		if (f->fn_tos <= tos)
+			break;
+	}
+#else
+	f = *fp;
+#endif
+
+	del_fp = NULL;
+
+	if (f && (f->fn_state&FN_S_ZOMBIE)
+#ifdef CONFIG_IP_ROUTE_TOS
+	    && f->fn_tos == tos
+#endif
+	    ) {
+		del_fp = fp;
+		fp = &f->fn_next;
+		f = *fp;
+		goto create;
+	}
+
+	FIB_SCAN_TOS(f, fp, tos) {
+		if (fi->fib_priority <= FIB_INFO(f)->fib_priority)
+			break;
+	}
+
+	/* Now f==*fp points to the first node with the same
+	   keys [tos,priority], if such key already exists or
+	   to the node, before which we will insert new one.
+	 */
+
+	if (f &&
+#ifdef CONFIG_IP_ROUTE_TOS
+	    f->fn_tos == tos &&
+#endif
+	    fi->fib_priority == FIB_INFO(f)->fib_priority) {
+		struct fib_node **ins_fp;
+
+		err = -EEXIST;
+		if (n->nlmsg_flags&NLM_F_EXCL)
+			goto out;
+
+		if (n->nlmsg_flags&NLM_F_REPLACE) {
+			del_fp = fp;
+			fp = &f->fn_next;
+			f = *fp;
+			goto replace;
+		}
+
+		ins_fp = fp;
+		err = -EEXIST;
+
+		FIB_SCAN_TOS(f, fp, tos) {
+			if (fi->fib_priority != FIB_INFO(f)->fib_priority)
+				break;
+			if (f->fn_type == type && f->fn_scope == r->rtm_scope
+			    && FIB_INFO(f) == fi)
+				goto out;
+		}
+
+		if (!(n->nlmsg_flags&NLM_F_APPEND)) {
+			fp = ins_fp;
+			f = *fp;
+		}
+	}
+
+create:
+	err = -ENOENT;
+	if (!(n->nlmsg_flags&NLM_F_CREATE))
+		goto out;
+
+replace:
+	err = -ENOBUFS;
+	new_f = kmem_cache_alloc(fn_trie_kmem, SLAB_KERNEL);
+	if (new_f == NULL)
+		goto out;
+
+	memset(new_f, 0, sizeof(struct fib_node));
+
+	new_f->fn_key = htonl(key);
+#ifdef CONFIG_IP_ROUTE_TOS
+	new_f->fn_tos = tos;
+#endif
+	new_f->fn_type = type;
+	new_f->fn_scope = r->rtm_scope;
+	FIB_INFO(new_f) = fi;
+
+	/*
+	 * Insert new entry to the list.
+	 */
+
+	new_f->fn_next = f;
+	if (l == NULL) {
+		if (fn_new_leaf(table, key, z, new_f) == NULL) {
+			kmem_cache_free(fn_trie_kmem, new_f);
+			goto out;
+		}
+	} else {
+		write_lock_bh(&fib_trie_lock);
+		*fp = new_f;
+		write_unlock_bh(&fib_trie_lock);
+	}
+
+	if (del_fp) {
+		f = *del_fp;
+		/* Unlink replaced node */
+		write_lock_bh(&fib_trie_lock);
+		*del_fp = f->fn_next;
+		write_unlock_bh(&fib_trie_lock);
+
+		if (!(f->fn_state&FN_S_ZOMBIE))
+			rtmsg_fib(RTM_DELROUTE, f, z, tb->tb_id, n, req);
+		if (f->fn_state&FN_S_ACCESSED)
+			rt_cache_flush(-1);
+		fn_free_node(f);
+	} else {
+		rt_cache_flush(-1);
+	}
+	rtmsg_fib(RTM_NEWROUTE, new_f, z, tb->tb_id, n, req);
+	return 0;
+
+out:
+	fib_release_info(fi);
+	return err;
+}
+
+
+static int
+fn_trie_delete(struct fib_table *tb, struct rtmsg *r, struct kern_rta *rta,
+		struct nlmsghdr *n, struct netlink_skb_parms *req)
+{
+	struct fn_trie *table = (struct fn_trie*)tb->tb_data;
+	struct fib_node **fp, **del_fp, *f;
+	int z = r->rtm_dst_len;
+	struct fn_leaf *l;
+	u32 key;
+	int matched;
+#ifdef CONFIG_IP_ROUTE_TOS
+	u8 tos = r->rtm_tos;
+#endif
+
+	if (z > 32)
+		return -EINVAL;
+
+	key = 0;
+	if (rta->rta_dst) {
+		u32 dst;
+		memcpy(&dst, rta->rta_dst, 4);
+		if (dst & ~inet_make_mask(z))
+			return -EINVAL;
+		key = ntohl(dst);
+	}
+
+	if ((l = fn_find_leaf(table, key, z)) == NULL)
+		return -ESRCH;
+
+	fp = &l->nodes;
+#ifdef CONFIG_IP_ROUTE_TOS
+	FIB_SCAN(f, fp) {
+		if (f->fn_tos == tos)
+			break;
+	}
+#endif
+
+	matched = 0;
+	del_fp = NULL;
+	FIB_SCAN_TOS(f, fp, tos) {
+		struct fib_info * fi = FIB_INFO(f);
+
+		if (f->fn_state&FN_S_ZOMBIE) {
+			return -ESRCH;
+		}
+		matched++;
+
+		if (del_fp == NULL &&
+		    (!r->rtm_type || f->fn_type == r->rtm_type) &&
+		    (r->rtm_scope == RT_SCOPE_NOWHERE || f->fn_scope == r->rtm_scope) &&
+		    (!r->rtm_protocol || fi->fib_protocol == r->rtm_protocol) &&
+		    fib_nh_match(r, n, rta, fi) == 0)
+			del_fp = fp;
+	}
+
+	if (del_fp) {
+		f = *del_fp;
+		rtmsg_fib(RTM_DELROUTE, f, z, tb->tb_id, n, req);
+
+		if (matched != 1) {
+			write_lock_bh(&fib_trie_lock);
+			*del_fp = f->fn_next;
+			write_unlock_bh(&fib_trie_lock);
+
+			if (f->fn_state&FN_S_ACCESSED)
+				rt_cache_flush(-1);
+			fn_free_node(f);
+		} else {
+			f->fn_state |= FN_S_ZOMBIE;
+			if (f->fn_state&FN_S_ACCESSED) {
+				f->fn_state &= ~FN_S_ACCESSED;
+				rt_cache_flush(-1);
+			}
+			if (++fib_trie_zombies > 128)
+				fib_flush();
+		}
+
+		return 0;
+	}
+	return -ESRCH;
+}
+
+static __inline__ int fn_flush_list(struct fib_node ** fp)
+{
+	int found = 0;
+	struct fib_node *f;
+
+	while ((f = *fp) != NULL) {
+		struct fib_info *fi = FIB_INFO(f);
+
+		if (fi && ((f->fn_state&FN_S_ZOMBIE) || (fi->fib_flags&RTNH_F_DEAD))) {
+			write_lock_bh(&fib_trie_lock);
+			*fp = f->fn_next;
+			write_unlock_bh(&fib_trie_lock);
+
+			fn_free_node(f);
+			found++;
+			continue;
+		}
+		fp = &f->fn_next;
+	}
+	return found;
+}
+
+static int fn_trie_flush(struct fib_table *tb)
+{
+	struct fn_trie *table = (struct fn_trie*)tb->tb_data;
+	struct list_head *p, *next;
+	int found = 0;
+
+	fib_trie_zombies = 0;
+	list_for_each_safe(p, next, &table->leaves) {
+		struct fn_leaf *l = list_entry(p, struct fn_leaf, list);
+
+		found += fn_flush_list(&l->nodes);
+		if (l->nodes == NULL) {
+			write_lock_bh(&fib_trie_lock);
+			fn_del_leaf(table, l);
+			write_unlock_bh(&fib_trie_lock);
+		}
+	}
+	return found;
+}
+
+
+#ifdef CONFIG_PROC_FS
+
+static int fn_trie_get_info(struct fib_table *tb, char *buffer, int first, int count)
+{
+	struct fn_trie *table = (struct fn_trie*)tb->tb_data;
+	struct list_head *p;
+	int pos = 0;
+	int n = 0;
+
+	read_lock(&fib_trie_lock);
+	list_for_each(p, &table->leaves) {
+		struct fn_leaf *l = list_entry(p, struct fn_leaf, list);
+		struct fib_node *f;
+
+		for (f = l->nodes; f; f = f->fn_next) {
+			if (++pos <= first)
+				continue;
+			fib_node_get_info(f->fn_type,
+					  f->fn_state&FN_S_ZOMBIE,
+					  FIB_INFO(f), f->fn_key,
+					  inet_make_mask(l->len), buffer);
+			buffer += 128;
+			if (++n >= count)
+				goto out;
+		}
+	}
+out:
+	read_unlock(&fib_trie_lock);
+  	return n;
+}
+#endif
+
+
+/*
+ * Dump prefixes in the order they were added; cb->args[1] is the
+ * prefix to resume at and cb->args[2] the route within it, as the
+ * zone and bucket indices are for fib_hash.
+ */
+static int fn_trie_dump(struct fib_table *tb, struct sk_buff *skb, struct netlink_callback *cb)
+{
+	int m, s_m, i, s_i;
+	struct list_head *p;
+	struct fn_trie *table = (struct fn_trie*)tb->tb_data;
+
+	s_m = cb->args[1];
+	m = 0;
+	read_lock(&fib_trie_lock);
+	list_for_each(p, &table->leaves) {
+		struct fn_leaf *l = list_entry(p, struct fn_leaf, list);
+		struct fib_node *f;
+
+		if (m < s_m) {
+			m++;
+			continue;
+		}
+		s_i = (m == s_m) ? cb->args[2] : 0;
+		for (f = l->nodes, i = 0; f; f = f->fn_next, i++) {
+			if (i < s_i) continue;
+			if (f->fn_state&FN_S_ZOMBIE) continue;
+			if (fib_dump_info(skb, NETLINK_CB(cb->skb).pid,
+					  cb->nlh->nlmsg_seq, RTM_NEWROUTE,
+					  tb->tb_id, f->fn_type, f->fn_scope,
+					  &f->fn_key, l->len, f->fn_tos,
+					  f->fn_info) < 0) {
+				cb->args[1] = m;
+				cb->args[2] = i;
+				read_unlock(&fib_trie_lock);
+				return -1;
+			}
+		}
+		m++;
+	}
+	read_unlock(&fib_trie_lock);
+	cb->args[1] = m;
+	cb->args[2] = 0;
+	return skb->len;
+}
+
+static void rtmsg_fib(int event, struct fib_node* f, int z, int tb_id,
+		      struct nlmsghdr *n, struct netlink_skb_parms *req)
+{
+	struct sk_buff *skb;
+	u32 pid = req ? req->pid : 0;
+	int size = NLMSG_SPACE(sizeof(struct rtmsg)+256);
+
+	skb = alloc_skb(size, GFP_KERNEL);
+	if (!skb)
+		return;
+
+	if (fib_dump_info(skb, pid, n->nlmsg_seq, event, tb_id,
+			  f->fn_type, f->fn_scope, &f->fn_key, z, f->fn_tos,
+			  FIB_INFO(f)) < 0) {
+		kfree_skb(skb);
+		return;
+	}
+	NETLINK_CB(skb).dst_groups = RTMGRP_IPV4_ROUTE;
+	if (n->nlmsg_flags&NLM_F_ECHO)
+		atomic_inc(&skb->users);
+	netlink_broadcast(rtnl, skb, pid, RTMGRP_IPV4_ROUTE, GFP_KERNEL);
+	if (n->nlmsg_flags&NLM_F_ECHO)
+		netlink_unicast(rtnl, skb, pid, MSG_DONTWAIT);
+}
+
+#ifdef CONFIG_IP_MULTIPLE_TABLES
+struct fib_table * fib_trie_init(int id)
+#else
+struct fib_table * __init fib_trie_init(int id)
+#endif
+{
+	struct fib_table *tb;
+	struct fn_trie *t;
+
+	if (fn_trie_kmem == NULL) {
+		fn_trie_kmem = kmem_cache_create("ip_fib_trie",
+						 sizeof(struct fib_node),
+						 0, SLAB_HWCACHE_ALIGN,
+						 NULL, NULL);
+		fn_leaf_kmem = kmem_cache_create("ip_fib_leaf",
+						 sizeof(struct fn_leaf),
+						 0, SLAB_HWCACHE_ALIGN,
+						 NULL, NULL);
+		fn_tnode_kmem = kmem_cache_create("ip_fib_tnode",
+						  sizeof(struct fn_tnode) +
+						  (sizeof(struct fn_slot) << FN_BITS),
+						  0, SLAB_HWCACHE_ALIGN,
+						  NULL, NULL);
+	}
+
+	tb = kmalloc(sizeof(struct fib_table) + sizeof(struct fn_trie), GFP_KERNEL);
+	if (tb == NULL)
+		return NULL;
+
+	tb->tb_id = id;
+	tb->tb_lookup = fn_trie_lookup;
+	tb->tb_insert = fn_trie_insert;
+	tb->tb_delete = fn_trie_delete;
+	tb->tb_flush = fn_trie_flush;
+	tb->tb_select_default = fn_trie_select_default;
+	tb->tb_dump = fn_trie_dump;
+#ifdef CONFIG_PROC_FS
+	tb->tb_get_info = fn_trie_get_info;
+#endif
+	t = (struct fn_trie*)tb->tb_data;
+	memset(t, 0, sizeof(struct fn_trie));
+	INIT_LIST_HEAD(&t->leaves);
+	t->root = fn_new_tnode(0);
+	if (t->root == NULL) {
+		kfree(tb);
+		return NULL;
+	}
+	return tb;
+}
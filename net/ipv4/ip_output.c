@@ -308,10 +308,21 @@ static inline int ip_queue_xmit2(struct sk_buff *skb)
 		iph = skb->nh.iph;
 	}
 
-	if (skb->len > rt->u.dst.pmtu)
-		goto fragment;
+	if (skb->len > rt->u.dst.pmtu) {
+		/* A TCP super-packet is cut up by the device layer; it
+		 * only has to fit the path once it is.
+		 */
+		if (!skb_shinfo(skb)->gso_size ||
+		    skb->h.raw + (skb->h.th->doff << 2) - skb->data +
+		    skb_shinfo(skb)->gso_size > rt->u.dst.pmtu)
+			goto fragment;
+	}
 
-	ip_select_ident(iph, &rt->u.dst, sk);
+	if (skb_shinfo(skb)->gso_segs)
+		ip_select_ident_more(iph, &rt->u.dst, sk,
+				     skb_shinfo(skb)->gso_segs - 1);
+	else
+		ip_select_ident(iph, &rt->u.dst, sk);
 
 	/* Add an IP checksum. */
 	ip_send_check(iph);
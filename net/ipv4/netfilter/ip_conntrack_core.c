@@ -11,6 +11,8 @@
  * 16 Jul 2002: Harald Welte <laforge@gnumonks.org>
  * 	- add usage/reference counts to ip_conntrack_expect
  *	- export ip_conntrack[_expect]_{find_get,put} functions
+ *	- per-bucket hash locks under a big-reader lock, online resize,
+ *	  per-CPU statistics
  * */
 
 #include <linux/version.h>
@@ -33,8 +35,16 @@
 /* For ERR_PTR().  Yeah, I know... --RR */
 #include <linux/fs.h>
 
-/* This rwlock protects the main hash table, protocol/helper/expected
-   registrations, conntrack timers*/
+/* This rwlock protects protocol/helper/expected registrations.  It
+   does not cover conntrack timers: once a conntrack is confirmed, its
+   timer is only changed by whoever wins del_timer() on it, which then
+   re-adds it or lets the conntrack die; before that only the packet
+   that created it touches the timer.  The hash table has its own
+   locking: each bucket has an rwlock for its chain, and
+   BR_CONNTRACK_LOCK, taken for reading around every bucket access,
+   keeps the table itself (size, bucket array) stable against
+   ip_conntrack_resize().  Lock order is ip_conntrack_lock,
+   BR_CONNTRACK_LOCK, bucket locks in index order. */
 #define ASSERT_READ_LOCK(x) MUST_BE_READ_LOCKED(&ip_conntrack_lock)
 #define ASSERT_WRITE_LOCK(x) MUST_BE_WRITE_LOCKED(&ip_conntrack_lock)
 
@@ -61,8 +71,9 @@ LIST_HEAD(protocol_list);
 static LIST_HEAD(helpers);
 unsigned int ip_conntrack_htable_size = 0;
 int ip_conntrack_max = 0;
-static atomic_t ip_conntrack_count = ATOMIC_INIT(0);
-struct list_head *ip_conntrack_hash;
+atomic_t ip_conntrack_count = ATOMIC_INIT(0);
+struct ip_conntrack_bucket *ip_conntrack_hash;
+struct ip_conntrack_stat ip_conntrack_stat[NR_CPUS];
 static kmem_cache_t *ip_conntrack_cachep;
 
 extern struct ip_conntrack_protocol ip_conntrack_generic_protocol;
@@ -288,6 +299,26 @@ static void remove_expectations(struct ip_conntrack *ct, int drop_refcount)
 	}
 }
 
+/* Write-lock the two buckets of a conntrack, lower index first. */
+static inline void
+lock_bucket_pair(unsigned int a, unsigned int b)
+{
+	if (a > b) {
+		unsigned int t = a; a = b; b = t;
+	}
+	write_lock(&ip_conntrack_hash[a].lock);
+	if (b != a)
+		write_lock(&ip_conntrack_hash[b].lock);
+}
+
+static inline void
+unlock_bucket_pair(unsigned int a, unsigned int b)
+{
+	if (b != a)
+		write_unlock(&ip_conntrack_hash[b].lock);
+	write_unlock(&ip_conntrack_hash[a].lock);
+}
+
 static void
 clean_from_lists(struct ip_conntrack *ct)
 {
@@ -296,10 +327,15 @@ clean_from_lists(struct ip_conntrack *ct)
 	DEBUGP("clean_from_lists(%p)\n", ct);
 	MUST_BE_WRITE_LOCKED(&ip_conntrack_lock);
 
+	br_read_lock_bh(BR_CONNTRACK_LOCK);
 	ho = hash_conntrack(&ct->tuplehash[IP_CT_DIR_ORIGINAL].tuple);
 	hr = hash_conntrack(&ct->tuplehash[IP_CT_DIR_REPLY].tuple);
-	LIST_DELETE(&ip_conntrack_hash[ho], &ct->tuplehash[IP_CT_DIR_ORIGINAL]);
-	LIST_DELETE(&ip_conntrack_hash[hr], &ct->tuplehash[IP_CT_DIR_REPLY]);
+	lock_bucket_pair(ho, hr);
+	list_del(&ct->tuplehash[IP_CT_DIR_ORIGINAL].list);
+	list_del(&ct->tuplehash[IP_CT_DIR_REPLY].list);
+	unlock_bucket_pair(ho, hr);
+	br_read_unlock_bh(BR_CONNTRACK_LOCK);
+	CONNTRACK_STAT_INC(delete);
 
 	/* Destroy all un-established, pending expectations */
 	remove_expectations(ct, 1);
@@ -364,24 +400,32 @@ conntrack_tuple_cmp(const struct ip_conntrack_tuple_hash *i,
 		    const struct ip_conntrack_tuple *tuple,
 		    const struct ip_conntrack *ignored_conntrack)
 {
-	MUST_BE_READ_LOCKED(&ip_conntrack_lock);
 	return i->ctrack != ignored_conntrack
 		&& ip_ct_tuple_equal(tuple, &i->tuple);
 }
 
+/* Search one chain.  Caller holds BR_CONNTRACK_LOCK and the bucket lock. */
 static struct ip_conntrack_tuple_hash *
-__ip_conntrack_find(const struct ip_conntrack_tuple *tuple,
+__ip_conntrack_find(unsigned int hash,
+		    const struct ip_conntrack_tuple *tuple,
 		    const struct ip_conntrack *ignored_conntrack)
 {
-	struct ip_conntrack_tuple_hash *h;
-	unsigned int hash = hash_conntrack(tuple);
-
-	MUST_BE_READ_LOCKED(&ip_conntrack_lock);
-	h = LIST_FIND(&ip_conntrack_hash[hash],
-		      conntrack_tuple_cmp,
-		      struct ip_conntrack_tuple_hash *,
-		      tuple, ignored_conntrack);
-	return h;
+	struct list_head *i;
+	unsigned int searched = 0;
+
+	list_for_each(i, &ip_conntrack_hash[hash].chain) {
+		struct ip_conntrack_tuple_hash *h
+			= (struct ip_conntrack_tuple_hash *)i;
+
+		searched++;
+		if (conntrack_tuple_cmp(h, tuple, ignored_conntrack)) {
+			CONNTRACK_STAT_ADD(searched, searched);
+			CONNTRACK_STAT_INC(found);
+			return h;
+		}
+	}
+	CONNTRACK_STAT_ADD(searched, searched);
+	return NULL;
 }
 
 /* Find a connection corresponding to a tuple. */
@@ -390,12 +434,16 @@ ip_conntrack_find_get(const struct ip_conntrack_tuple *tuple,
 		      const struct ip_conntrack *ignored_conntrack)
 {
 	struct ip_conntrack_tuple_hash *h;
+	unsigned int hash;
 
-	READ_LOCK(&ip_conntrack_lock);
-	h = __ip_conntrack_find(tuple, ignored_conntrack);
+	br_read_lock_bh(BR_CONNTRACK_LOCK);
+	hash = hash_conntrack(tuple);
+	read_lock(&ip_conntrack_hash[hash].lock);
+	h = __ip_conntrack_find(hash, tuple, ignored_conntrack);
 	if (h)
 		atomic_inc(&h->ctrack->ct_general.use);
-	READ_UNLOCK(&ip_conntrack_lock);
+	read_unlock(&ip_conntrack_hash[hash].lock);
+	br_read_unlock_bh(BR_CONNTRACK_LOCK);
 
 	return h;
 }
@@ -438,9 +486,6 @@ __ip_conntrack_confirm(struct nf_ct_info *nfct)
 	if (CTINFO2DIR(ctinfo) != IP_CT_DIR_ORIGINAL)
 		return NF_ACCEPT;
 
-	hash = hash_conntrack(&ct->tuplehash[IP_CT_DIR_ORIGINAL].tuple);
-	repl_hash = hash_conntrack(&ct->tuplehash[IP_CT_DIR_REPLY].tuple);
-
 	/* We're not in hash table, and we refuse to set up related
 	   connections for unconfirmed conns.  But packet copies and
 	   REJECT will give spurious warnings here. */
@@ -452,21 +497,23 @@ __ip_conntrack_confirm(struct nf_ct_info *nfct)
 	DEBUGP("Confirming conntrack %p\n", ct);
 
 	WRITE_LOCK(&ip_conntrack_lock);
+	br_read_lock_bh(BR_CONNTRACK_LOCK);
+	hash = hash_conntrack(&ct->tuplehash[IP_CT_DIR_ORIGINAL].tuple);
+	repl_hash = hash_conntrack(&ct->tuplehash[IP_CT_DIR_REPLY].tuple);
+	lock_bucket_pair(hash, repl_hash);
 	/* See if there's one in the list already, including reverse:
            NAT could have grabbed it without realizing, since we're
            not in the hash.  If there is, we lost race. */
-	if (!LIST_FIND(&ip_conntrack_hash[hash],
-		       conntrack_tuple_cmp,
-		       struct ip_conntrack_tuple_hash *,
-		       &ct->tuplehash[IP_CT_DIR_ORIGINAL].tuple, NULL)
-	    && !LIST_FIND(&ip_conntrack_hash[repl_hash],
-			  conntrack_tuple_cmp,
-			  struct ip_conntrack_tuple_hash *,
-			  &ct->tuplehash[IP_CT_DIR_REPLY].tuple, NULL)) {
-		list_prepend(&ip_conntrack_hash[hash],
-			     &ct->tuplehash[IP_CT_DIR_ORIGINAL]);
-		list_prepend(&ip_conntrack_hash[repl_hash],
-			     &ct->tuplehash[IP_CT_DIR_REPLY]);
+	if (!__ip_conntrack_find(hash,
+				 &ct->tuplehash[IP_CT_DIR_ORIGINAL].tuple, NULL)
+	    && !__ip_conntrack_find(repl_hash,
+				    &ct->tuplehash[IP_CT_DIR_REPLY].tuple, NULL)) {
+		list_add(&ct->tuplehash[IP_CT_DIR_ORIGINAL].list,
+			 &ip_conntrack_hash[hash].chain);
+		list_add(&ct->tuplehash[IP_CT_DIR_REPLY].list,
+			 &ip_conntrack_hash[repl_hash].chain);
+		unlock_bucket_pair(hash, repl_hash);
+		br_read_unlock_bh(BR_CONNTRACK_LOCK);
 		/* Timer relative to confirmation time, not original
 		   setting time, otherwise we'd get timer wrap in
 		   weird delay cases. */
@@ -475,10 +522,14 @@ __ip_conntrack_confirm(struct nf_ct_info *nfct)
 		atomic_inc(&ct->ct_general.use);
 		set_bit(IPS_CONFIRMED_BIT, &ct->status);
 		WRITE_UNLOCK(&ip_conntrack_lock);
+		CONNTRACK_STAT_INC(insert);
 		return NF_ACCEPT;
 	}
 
+	unlock_bucket_pair(hash, repl_hash);
+	br_read_unlock_bh(BR_CONNTRACK_LOCK);
 	WRITE_UNLOCK(&ip_conntrack_lock);
+	CONNTRACK_STAT_INC(insert_failed);
 	return NF_DROP;
 }
 
@@ -489,10 +540,14 @@ ip_conntrack_tuple_taken(const struct ip_conntrack_tuple *tuple,
 			 const struct ip_conntrack *ignored_conntrack)
 {
 	struct ip_conntrack_tuple_hash *h;
+	unsigned int hash;
 
-	READ_LOCK(&ip_conntrack_lock);
-	h = __ip_conntrack_find(tuple, ignored_conntrack);
-	READ_UNLOCK(&ip_conntrack_lock);
+	br_read_lock_bh(BR_CONNTRACK_LOCK);
+	hash = hash_conntrack(tuple);
+	read_lock(&ip_conntrack_hash[hash].lock);
+	h = __ip_conntrack_find(hash, tuple, ignored_conntrack);
+	read_unlock(&ip_conntrack_hash[hash].lock);
+	br_read_unlock_bh(BR_CONNTRACK_LOCK);
 
 	return h != NULL;
 }
@@ -595,17 +650,26 @@ static inline int unreplied(const struct ip_conntrack_tuple_hash *i)
 	return !(test_bit(IPS_ASSURED_BIT, &i->ctrack->status));
 }
 
-static int early_drop(struct list_head *chain)
+static int early_drop(unsigned int hash)
 {
 	/* Traverse backwards: gives us oldest, which is roughly LRU */
-	struct ip_conntrack_tuple_hash *h;
+	struct ip_conntrack_tuple_hash *h = NULL;
+	struct list_head *i;
 	int dropped = 0;
 
-	READ_LOCK(&ip_conntrack_lock);
-	h = LIST_FIND_B(chain, unreplied, struct ip_conntrack_tuple_hash *);
-	if (h)
-		atomic_inc(&h->ctrack->ct_general.use);
-	READ_UNLOCK(&ip_conntrack_lock);
+	br_read_lock_bh(BR_CONNTRACK_LOCK);
+	/* The table may have been resized since the caller hashed. */
+	hash %= ip_conntrack_htable_size;
+	read_lock(&ip_conntrack_hash[hash].lock);
+	list_for_each_prev(i, &ip_conntrack_hash[hash].chain) {
+		if (unreplied((struct ip_conntrack_tuple_hash *)i)) {
+			h = (struct ip_conntrack_tuple_hash *)i;
+			atomic_inc(&h->ctrack->ct_general.use);
+			break;
+		}
+	}
+	read_unlock(&ip_conntrack_hash[hash].lock);
+	br_read_unlock_bh(BR_CONNTRACK_LOCK);
 
 	if (!h)
 		return dropped;
@@ -613,6 +677,7 @@ static int early_drop(struct list_head *chain)
 	if (del_timer(&h->ctrack->timeout)) {
 		death_by_timeout((unsigned long)h->ctrack);
 		dropped = 1;
+		CONNTRACK_STAT_INC(early_drop);
 	}
 	ip_conntrack_put(h->ctrack);
 	return dropped;
@@ -650,17 +715,20 @@ init_conntrack(const struct ip_conntrack_tuple *tuple,
 		ip_conntrack_hash_rnd_initted = 1;
 	}
 
-	hash = hash_conntrack(tuple);
-
 	if (ip_conntrack_max &&
 	    atomic_read(&ip_conntrack_count) >= ip_conntrack_max) {
 		/* Try dropping from random chain, or else from the
                    chain about to put into (in case they're trying to
                    bomb one hash chain). */
-		unsigned int next = (drop_next++)%ip_conntrack_htable_size;
+		unsigned int next;
+
+		br_read_lock_bh(BR_CONNTRACK_LOCK);
+		hash = hash_conntrack(tuple);
+		next = (drop_next++)%ip_conntrack_htable_size;
+		br_read_unlock_bh(BR_CONNTRACK_LOCK);
 
-		if (!early_drop(&ip_conntrack_hash[next])
-		    && !early_drop(&ip_conntrack_hash[hash])) {
+		if (!early_drop(next) && !early_drop(hash)) {
+			CONNTRACK_STAT_INC(drop);
 			if (net_ratelimit())
 				printk(KERN_WARNING
 				       "ip_conntrack: table full, dropping"
@@ -740,6 +808,7 @@ init_conntrack(const struct ip_conntrack_tuple *tuple,
 	}
 	atomic_inc(&ip_conntrack_count);
 	WRITE_UNLOCK(&ip_conntrack_lock);
+	CONNTRACK_STAT_INC(new);
 
 	if (expected && expected->expectfn)
 		expected->expectfn(conntrack);
@@ -1103,8 +1172,17 @@ int ip_conntrack_change_expect(struct ip_conntrack_expect *expect,
 int ip_conntrack_alter_reply(struct ip_conntrack *conntrack,
 			     const struct ip_conntrack_tuple *newreply)
 {
+	struct ip_conntrack_tuple_hash *h;
+	unsigned int hash;
+
 	WRITE_LOCK(&ip_conntrack_lock);
-	if (__ip_conntrack_find(newreply, conntrack)) {
+	br_read_lock_bh(BR_CONNTRACK_LOCK);
+	hash = hash_conntrack(newreply);
+	read_lock(&ip_conntrack_hash[hash].lock);
+	h = __ip_conntrack_find(hash, newreply, conntrack);
+	read_unlock(&ip_conntrack_hash[hash].lock);
+	br_read_unlock_bh(BR_CONNTRACK_LOCK);
+	if (h) {
 		WRITE_UNLOCK(&ip_conntrack_lock);
 		return 0;
 	}
@@ -1156,9 +1234,14 @@ void ip_conntrack_helper_unregister(struct ip_conntrack_helper *me)
 	LIST_DELETE(&helpers, me);
 
 	/* Get rid of expecteds, set helpers to NULL. */
-	for (i = 0; i < ip_conntrack_htable_size; i++)
-		LIST_FIND_W(&ip_conntrack_hash[i], unhelp,
+	br_read_lock_bh(BR_CONNTRACK_LOCK);
+	for (i = 0; i < ip_conntrack_htable_size; i++) {
+		read_lock(&ip_conntrack_hash[i].lock);
+		LIST_FIND_W(&ip_conntrack_hash[i].chain, unhelp,
 			    struct ip_conntrack_tuple_hash *, me);
+		read_unlock(&ip_conntrack_hash[i].lock);
+	}
+	br_read_unlock_bh(BR_CONNTRACK_LOCK);
 	WRITE_UNLOCK(&ip_conntrack_lock);
 
 	/* Someone could be still looking at the helper in a bh. */
@@ -1173,7 +1256,9 @@ void ip_ct_refresh(struct ip_conntrack *ct, unsigned long extra_jiffies)
 {
 	IP_NF_ASSERT(ct->timeout.data == (unsigned long)ct);
 
-	WRITE_LOCK(&ip_conntrack_lock);
+	/* No ip_conntrack_lock: this runs for every packet.  The timer
+	   code serializes us against death_by_timeout and other
+	   refreshers, whoever loses the del_timer race just skips. */
 	/* If not in hash table, timer will not be active yet */
 	if (!is_confirmed(ct))
 		ct->timeout.expires = extra_jiffies;
@@ -1184,7 +1269,6 @@ void ip_ct_refresh(struct ip_conntrack *ct, unsigned long extra_jiffies)
 			add_timer(&ct->timeout);
 		}
 	}
-	WRITE_UNLOCK(&ip_conntrack_lock);
 }
 
 /* Returns new sk_buff, or NULL */
@@ -1263,12 +1347,16 @@ get_next_corpse(int (*kill)(const struct ip_conntrack *i, void *data),
 	struct ip_conntrack_tuple_hash *h = NULL;
 
 	READ_LOCK(&ip_conntrack_lock);
+	br_read_lock_bh(BR_CONNTRACK_LOCK);
 	for (; !h && *bucket < ip_conntrack_htable_size; (*bucket)++) {
-		h = LIST_FIND(&ip_conntrack_hash[*bucket], do_kill,
+		read_lock(&ip_conntrack_hash[*bucket].lock);
+		h = LIST_FIND(&ip_conntrack_hash[*bucket].chain, do_kill,
 			      struct ip_conntrack_tuple_hash *, kill, data);
+		if (h)
+			atomic_inc(&h->ctrack->ct_general.use);
+		read_unlock(&ip_conntrack_hash[*bucket].lock);
 	}
-	if (h)
-		atomic_inc(&h->ctrack->ct_general.use);
+	br_read_unlock_bh(BR_CONNTRACK_LOCK);
 	READ_UNLOCK(&ip_conntrack_lock);
 
 	return h;
@@ -1355,6 +1443,69 @@ static int kill_all(const struct ip_conntrack *i, void *data)
 	return 1;
 }
 
+static struct ip_conntrack_bucket *alloc_hashtable(unsigned int size)
+{
+	struct ip_conntrack_bucket *hash;
+	unsigned int i;
+
+	hash = vmalloc(sizeof(struct ip_conntrack_bucket) * size);
+	if (!hash)
+		return NULL;
+	for (i = 0; i < size; i++) {
+		INIT_LIST_HEAD(&hash[i].chain);
+		hash[i].lock = RW_LOCK_UNLOCKED;
+	}
+	return hash;
+}
+
+/**
+ * ip_conntrack_resize - change the number of hash buckets
+ * @size: new number of buckets
+ *
+ * Rehashes every conntrack into a freshly allocated table.  Lookups
+ * and insertions stall on BR_CONNTRACK_LOCK while the entries are
+ * moved, nothing else is disturbed.  More buckets than conntracks
+ * allowed buy nothing, so @size is limited to ip_conntrack_max (if
+ * set) and to IP_CONNTRACK_MAX_BUCKETS.  Returns 0 or -errno.
+ */
+int ip_conntrack_resize(unsigned int size)
+{
+	struct ip_conntrack_bucket *new, *old;
+	unsigned int i, old_size;
+
+	if (size < 16 || size > IP_CONNTRACK_MAX_BUCKETS)
+		return -EINVAL;
+	if (ip_conntrack_max > 0 && size > (unsigned int)ip_conntrack_max)
+		return -EINVAL;
+
+	new = alloc_hashtable(size);
+	if (!new)
+		return -ENOMEM;
+
+	br_write_lock_bh(BR_CONNTRACK_LOCK);
+	old = ip_conntrack_hash;
+	old_size = ip_conntrack_htable_size;
+	ip_conntrack_hash = new;
+	ip_conntrack_htable_size = size;
+	for (i = 0; i < old_size; i++) {
+		while (!list_empty(&old[i].chain)) {
+			struct ip_conntrack_tuple_hash *h
+				= (struct ip_conntrack_tuple_hash *)
+					old[i].chain.next;
+
+			list_del(&h->list);
+			list_add_tail(&h->list,
+				      &new[hash_conntrack(&h->tuple)].chain);
+		}
+	}
+	br_write_unlock_bh(BR_CONNTRACK_LOCK);
+
+	vfree(old);
+	printk(KERN_INFO "ip_conntrack: hash table resized from %u to %u "
+	       "buckets\n", old_size, size);
+	return 0;
+}
+
 /* Mishearing the voices in his head, our hero wonders how he's
    supposed to kill the mall. */
 void ip_conntrack_cleanup(void)
@@ -1383,7 +1534,6 @@ MODULE_PARM(hashsize, "i");
 
 int __init ip_conntrack_init(void)
 {
-	unsigned int i;
 	int ret;
 
 	/* Idea from tcp.c: use 1/16384 of memory.  On i386: 32MB
@@ -1393,7 +1543,7 @@ int __init ip_conntrack_init(void)
  	} else {
 		ip_conntrack_htable_size
 			= (((num_physpages << PAGE_SHIFT) / 16384)
-			   / sizeof(struct list_head));
+			   / sizeof(struct ip_conntrack_bucket));
 		if (num_physpages > (1024 * 1024 * 1024 / PAGE_SIZE))
 			ip_conntrack_htable_size = 8192;
 		if (ip_conntrack_htable_size < 16)
@@ -1412,8 +1562,7 @@ int __init ip_conntrack_init(void)
 		return ret;
 	}
 
-	ip_conntrack_hash = vmalloc(sizeof(struct list_head)
-				    * ip_conntrack_htable_size);
+	ip_conntrack_hash = alloc_hashtable(ip_conntrack_htable_size);
 	if (!ip_conntrack_hash) {
 		printk(KERN_ERR "Unable to create ip_conntrack_hash\n");
 		goto err_unreg_sockopt;
@@ -1434,9 +1583,6 @@ int __init ip_conntrack_init(void)
 	list_append(&protocol_list, &ip_conntrack_protocol_icmp);
 	WRITE_UNLOCK(&ip_conntrack_lock);
 
-	for (i = 0; i < ip_conntrack_htable_size; i++)
-		INIT_LIST_HEAD(&ip_conntrack_hash[i]);
-
 	/* For use by ipt_REJECT */
 	ip_ct_attach = ip_conntrack_attach;
 	return ret;
@@ -147,13 +147,22 @@ list_conntracks(char *buffer, char **start, off_t offset, int length)
 	struct list_head *e;
 
 	READ_LOCK(&ip_conntrack_lock);
+	br_read_lock_bh(BR_CONNTRACK_LOCK);
 	/* Traverse hash; print originals then reply. */
 	for (i = 0; i < ip_conntrack_htable_size; i++) {
-		if (LIST_FIND(&ip_conntrack_hash[i], conntrack_iterate,
+		struct ip_conntrack_tuple_hash *h;
+
+		read_lock(&ip_conntrack_hash[i].lock);
+		h = LIST_FIND(&ip_conntrack_hash[i].chain, conntrack_iterate,
 			      struct ip_conntrack_tuple_hash *,
-			      buffer, offset, &upto, &len, length))
+			      buffer, offset, &upto, &len, length);
+		read_unlock(&ip_conntrack_hash[i].lock);
+		if (h) {
+			br_read_unlock_bh(BR_CONNTRACK_LOCK);
 			goto finished;
+		}
 	}
+	br_read_unlock_bh(BR_CONNTRACK_LOCK);
 
 	/* Now iterate through expecteds. */
 	for (e = ip_conntrack_expect_list.next; 
@@ -179,6 +188,44 @@ list_conntracks(char *buffer, char **start, off_t offset, int length)
 	return len;
 }
 
+static int
+conntrack_stats(char *buffer, char **start, off_t offset, int length)
+{
+	off_t pos = 0, begin = 0;
+	int len, cpu;
+
+	len = sprintf(buffer, "entries %u buckets %u\n"
+		      "cpu   searched      found        new     insert"
+		      "  ins_fail       drop early_drop     delete\n",
+		      atomic_read(&ip_conntrack_count),
+		      ip_conntrack_htable_size);
+	for (cpu = 0; cpu < smp_num_cpus; cpu++) {
+		struct ip_conntrack_stat *st
+			= &ip_conntrack_stat[cpu_logical_map(cpu)];
+
+		len += sprintf(buffer + len,
+			       "%3d %10u %10u %10u %10u %9u %10u %10u %10u\n",
+			       cpu_logical_map(cpu), st->searched, st->found,
+			       st->new, st->insert, st->insert_failed,
+			       st->drop, st->early_drop, st->delete);
+		pos = begin + len;
+		if (pos < offset) {
+			len = 0;
+			begin = pos;
+		}
+		if (pos > offset + length)
+			break;
+	}
+
+	*start = buffer + (offset - begin);
+	len -= (offset - begin);
+	if (len > length)
+		len = length;
+	if (len < 0)
+		len = 0;
+	return len;
+}
+
 static unsigned int ip_confirm(unsigned int hooknum,
 			       struct sk_buff **pskb,
 			       const struct net_device *in,
@@ -203,8 +250,10 @@ static unsigned int ip_refrag(unsigned int hooknum,
 
 	/* Local packets are never produced too large for their
 	   interface.  We degfragment them at LOCAL_OUT, however,
-	   so we have to refragment them here. */
-	if ((*pskb)->len > rt->u.dst.pmtu) {
+	   so we have to refragment them here.  TCP super-packets
+	   are cut up by the device layer instead. */
+	if ((*pskb)->len > rt->u.dst.pmtu &&
+	    !skb_shinfo(*pskb)->gso_size) {
 		/* No hook can be after us, so this should be OK. */
 		ip_fragment(*pskb, okfn);
 		return NF_STOLEN;
@@ -272,13 +321,36 @@ extern unsigned long ip_ct_generic_timeout;
 
 static struct ctl_table_header *ip_ct_sysctl_header;
 
+/* Writing ip_conntrack_buckets rehashes the table. */
+static DECLARE_MUTEX(ip_ct_resize_sem);
+
+static int ip_conntrack_proc_buckets(ctl_table *table, int write,
+				     struct file *filp, void *buffer,
+				     size_t *lenp)
+{
+	ctl_table tmp = *table;
+	int size, ret;
+
+	if (!write)
+		return proc_dointvec(table, write, filp, buffer, lenp);
+
+	down(&ip_ct_resize_sem);
+	size = ip_conntrack_htable_size;
+	tmp.data = &size;
+	ret = proc_dointvec(&tmp, write, filp, buffer, lenp);
+	if (ret == 0 && size != ip_conntrack_htable_size)
+		ret = ip_conntrack_resize(size);
+	up(&ip_ct_resize_sem);
+	return ret;
+}
+
 static ctl_table ip_ct_sysctl_table[] = {
 	{NET_IPV4_NF_CONNTRACK_MAX, "ip_conntrack_max",
 	 &ip_conntrack_max, sizeof(int), 0644, NULL,
 	 &proc_dointvec},
 	{NET_IPV4_NF_CONNTRACK_BUCKETS, "ip_conntrack_buckets",
-	 &ip_conntrack_htable_size, sizeof(unsigned int), 0444, NULL,
-	 &proc_dointvec},
+	 &ip_conntrack_htable_size, sizeof(unsigned int), 0644, NULL,
+	 &ip_conntrack_proc_buckets},
 	{NET_IPV4_NF_CONNTRACK_TCP_TIMEOUT_SYN_SENT, "ip_conntrack_tcp_timeout_syn_sent",
 	 &ip_ct_tcp_timeout_syn_sent, sizeof(unsigned int), 0644, NULL,
 	 &proc_dointvec_jiffies},
@@ -353,10 +425,14 @@ static int init_or_cleanup(int init)
 	if (!proc) goto cleanup_init;
 	proc->owner = THIS_MODULE;
 
+	proc = proc_net_create("ip_conntrack_stat",0,conntrack_stats);
+	if (!proc) goto cleanup_proc;
+	proc->owner = THIS_MODULE;
+
 	ret = nf_register_hook(&ip_conntrack_in_ops);
 	if (ret < 0) {
 		printk("ip_conntrack: can't register pre-routing hook.\n");
-		goto cleanup_proc;
+		goto cleanup_proc_stat;
 	}
 	ret = nf_register_hook(&ip_conntrack_local_out_ops);
 	if (ret < 0) {
@@ -394,6 +470,8 @@ static int init_or_cleanup(int init)
 	nf_unregister_hook(&ip_conntrack_local_out_ops);
  cleanup_inops:
 	nf_unregister_hook(&ip_conntrack_in_ops);
+ cleanup_proc_stat:
+	proc_net_remove("ip_conntrack_stat");
  cleanup_proc:
 	proc_net_remove("ip_conntrack");
  cleanup_init:
@@ -482,5 +560,6 @@ EXPORT_SYMBOL(ip_conntrack_htable_size);
 EXPORT_SYMBOL(ip_conntrack_expect_list);
 EXPORT_SYMBOL(ip_conntrack_lock);
 EXPORT_SYMBOL(ip_conntrack_hash);
+EXPORT_SYMBOL(ip_conntrack_resize);
 EXPORT_SYMBOL_GPL(ip_conntrack_find_get);
 EXPORT_SYMBOL_GPL(ip_conntrack_put);
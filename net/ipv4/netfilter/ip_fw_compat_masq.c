@@ -15,6 +15,7 @@
 #include <linux/proc_fs.h>
 #include <linux/version.h>
 #include <linux/module.h>
+#include <linux/brlock.h>
 #include <net/route.h>
 
 #define ASSERT_READ_LOCK(x) MUST_BE_READ_LOCKED(&ip_conntrack_lock)
@@ -283,13 +284,20 @@ masq_procinfo(char *buffer, char **start, off_t offset, int length)
 	}
 
 	READ_LOCK(&ip_conntrack_lock);
+	br_read_lock_bh(BR_CONNTRACK_LOCK);
 	/* Traverse hash; print originals then reply. */
 	for (i = 0; i < ip_conntrack_htable_size; i++) {
-		if (LIST_FIND(&ip_conntrack_hash[i], masq_iterate,
+		struct ip_conntrack_tuple_hash *h;
+
+		read_lock(&ip_conntrack_hash[i].lock);
+		h = LIST_FIND(&ip_conntrack_hash[i].chain, masq_iterate,
 			      struct ip_conntrack_tuple_hash *,
-			      buffer, offset, &upto, &len, length))
+			      buffer, offset, &upto, &len, length);
+		read_unlock(&ip_conntrack_hash[i].lock);
+		if (h)
 			break;
 	}
+	br_read_unlock_bh(BR_CONNTRACK_LOCK);
 	READ_UNLOCK(&ip_conntrack_lock);
 
 	/* `start' hack - see fs/proc/generic.c line ~165 */
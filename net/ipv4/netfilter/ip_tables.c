@@ -7,6 +7,8 @@
  * 19 Jan 2002 Harald Welte <laforge@gnumonks.org>
  * 	- increase module usage count as soon as we have rules inside
  * 	  a table
+ *
+ *	- rule index: skip entries that cannot match without walking them
  */
 #include <linux/config.h>
 #include <linux/cache.h>
@@ -96,6 +98,9 @@ struct ipt_table_info
 	unsigned int hook_entry[NF_IP_NUMHOOKS];
 	unsigned int underflow[NF_IP_NUMHOOKS];
 
+	/* Rule index, shared by all CPUs' copies; may be NULL */
+	struct ipt_index *index;
+
 	/* ipt_entry tables: one per CPU */
 	char entries[0] ____cacheline_aligned;
 };
@@ -250,6 +255,187 @@ get_entry(void *base, unsigned int offset)
 	return (struct ipt_entry *)(base + offset);
 }
 
+#ifdef CONFIG_IP_NF_IPTABLES_INDEX
+/*
+ * Rule index.
+ *
+ * Big rulesets are mostly long lists of address and port rules, and
+ * nearly all of them fail for any one packet.  The index cuts the
+ * table into runs of IPT_RUN_MAX consecutive entries.  For each run it
+ * keeps, per field (source, destination, protocol, source port and
+ * destination port), the sorted boundaries of the value intervals the
+ * run's rules distinguish, each with a bitmap of the entries that can
+ * match a value in that interval.  ANDing the five bitmaps for a packet
+ * gives the run's candidates; ipt_do_table() moves straight to the next
+ * candidate and checks it in full, exactly as before.
+ *
+ * Whatever the index cannot express (inverted or non-prefix masks,
+ * interfaces, flags, other matches) leaves an entry a candidate, so
+ * verdicts, counters and evaluation order are those of the linear walk.
+ * Ports are taken only from a tcp or udp match that comes first in the
+ * entry, since only then is nothing else evaluated before them.
+ * Fragments and truncated TCP/UDP headers, which the tcp and udp
+ * matches may hotdrop, always take the linear walk.
+ */
+#define IPT_RUN_MAX	128
+#define IPT_RUN_WORDS	(IPT_RUN_MAX / 32)
+#define IPT_INDEX_MIN	32		/* Smaller tables are just walked */
+
+enum {
+	IPT_DIM_SRC,
+	IPT_DIM_DST,
+	IPT_DIM_PROTO,
+	IPT_DIM_SPT,
+	IPT_DIM_DPT,
+	IPT_DIMS
+};
+
+struct ipt_index_dim
+{
+	/* Number of intervals */
+	unsigned int n;
+	/* Lower bound of each interval; start[0] == 0 */
+	u_int32_t *start;
+	/* IPT_RUN_WORDS of candidate bits per interval */
+	u_int32_t *bits;
+};
+
+struct ipt_index_run
+{
+	/* Rule number of the first entry, and number of entries */
+	unsigned int first, count;
+	/* All the entries' nfcache bits, for the ones skipped */
+	unsigned int nfcache;
+	struct ipt_index_dim dim[IPT_DIMS];
+};
+
+struct ipt_index
+{
+	/* Rules covered: all but the final one */
+	unsigned int number;
+	/* Offset of each rule, number + 1 of them */
+	unsigned int *offset;
+	unsigned int nruns;
+	struct ipt_index_run *run;
+};
+
+/* A packet's fields in host byte order, and the candidates of the
+   run last looked at. */
+struct ipt_index_key
+{
+	u_int32_t val[IPT_DIMS];
+	int run;
+	u_int32_t bits[IPT_RUN_WORDS];
+};
+
+/* Returns 0 if the packet must take the linear walk. */
+static inline int
+index_key(struct ipt_index_key *key, const struct iphdr *ip,
+	  const void *protohdr, u_int16_t datalen, u_int16_t offset)
+{
+	if (offset)
+		return 0;
+
+	key->val[IPT_DIM_SRC] = ntohl(ip->saddr);
+	key->val[IPT_DIM_DST] = ntohl(ip->daddr);
+	key->val[IPT_DIM_PROTO] = ip->protocol;
+	key->val[IPT_DIM_SPT] = key->val[IPT_DIM_DPT] = 0;
+	key->run = -1;
+
+	if (ip->protocol == IPPROTO_TCP) {
+		const struct tcphdr *tcp = protohdr;
+
+		if (datalen < sizeof(struct tcphdr))
+			return 0;
+		key->val[IPT_DIM_SPT] = ntohs(tcp->source);
+		key->val[IPT_DIM_DPT] = ntohs(tcp->dest);
+	} else if (ip->protocol == IPPROTO_UDP) {
+		const struct udphdr *udp = protohdr;
+
+		if (datalen < sizeof(struct udphdr))
+			return 0;
+		key->val[IPT_DIM_SPT] = ntohs(udp->source);
+		key->val[IPT_DIM_DPT] = ntohs(udp->dest);
+	}
+	return 1;
+}
+
+/* Interval of @d holding @v. */
+static inline unsigned int
+index_dim_find(const struct ipt_index_dim *d, u_int32_t v)
+{
+	unsigned int lo = 0, hi = d->n - 1;
+
+	while (lo < hi) {
+		unsigned int mid = (lo + hi + 1) / 2;
+
+		if (d->start[mid] <= v)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+	return lo;
+}
+
+/* Returns the first entry from @e on that may match the packet. */
+static inline struct ipt_entry *
+index_next(const struct ipt_index *idx, void *table_base,
+	   struct ipt_entry *e, struct ipt_index_key *key,
+	   struct sk_buff *skb)
+{
+	const struct ipt_index_run *run;
+	unsigned int off = (void *)e - table_base;
+	unsigned int lo = 0, hi = idx->number;
+	unsigned int bit, w, i;
+
+	/* Rule number of e */
+	while (lo < hi) {
+		unsigned int mid = (lo + hi) / 2;
+
+		if (idx->offset[mid] < off)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo >= idx->number)
+		return e;
+
+	run = &idx->run[lo / IPT_RUN_MAX];
+	if (key->run != lo / IPT_RUN_MAX) {
+		for (w = 0; w < IPT_RUN_WORDS; w++)
+			key->bits[w] = ~0U;
+		for (i = 0; i < IPT_DIMS; i++) {
+			const struct ipt_index_dim *d = &run->dim[i];
+			const u_int32_t *b = d->bits + IPT_RUN_WORDS
+				* index_dim_find(d, key->val[i]);
+
+			for (w = 0; w < IPT_RUN_WORDS; w++)
+				key->bits[w] &= b[w];
+		}
+		key->run = lo / IPT_RUN_MAX;
+	}
+
+	bit = lo - run->first;
+	for (w = bit / 32; w < IPT_RUN_WORDS; w++) {
+		u_int32_t m = key->bits[w];
+
+		if (w == bit / 32)
+			m &= ~0U << (bit % 32);
+		if (m) {
+			i = w * 32 + ffs(m) - 1;
+			break;
+		}
+	}
+	if (w == IPT_RUN_WORDS)
+		i = run->count;
+	if (i == bit)
+		return e;
+
+	skb->nfcache |= run->nfcache;
+	return get_entry(table_base, idx->offset[run->first + i]);
+}
+#endif /* CONFIG_IP_NF_IPTABLES_INDEX */
+
 /* Returns one of the generic firewall policies, like NF_ACCEPT. */
 unsigned int
 ipt_do_table(struct sk_buff **pskb,
@@ -270,6 +456,10 @@ ipt_do_table(struct sk_buff **pskb,
 	const char *indev, *outdev;
 	void *table_base;
 	struct ipt_entry *e, *back;
+#ifdef CONFIG_IP_NF_IPTABLES_INDEX
+	struct ipt_index *index;
+	struct ipt_index_key key;
+#endif
 
 	/* Initialization */
 	ip = (*pskb)->nh.iph;
@@ -308,9 +498,19 @@ ipt_do_table(struct sk_buff **pskb,
 	/* For return from builtin chain */
 	back = get_entry(table_base, table->private->underflow[hook]);
 
+#ifdef CONFIG_IP_NF_IPTABLES_INDEX
+	index = table->noindex ? NULL : table->private->index;
+	if (index && !index_key(&key, ip, protohdr, datalen, offset))
+		index = NULL;
+#endif
+
 	do {
 		IP_NF_ASSERT(e);
 		IP_NF_ASSERT(back);
+#ifdef CONFIG_IP_NF_IPTABLES_INDEX
+		if (index)
+			e = index_next(index, table_base, e, &key, *pskb);
+#endif
 		(*pskb)->nfcache |= e->nfcache;
 		if (ip_packet_match(ip, indev, outdev, &e->ip, offset)) {
 			struct ipt_entry_target *t;
@@ -381,6 +581,11 @@ ipt_do_table(struct sk_buff **pskb,
 				ip = (*pskb)->nh.iph;
 				protohdr = (u_int32_t *)ip + ip->ihl;
 				datalen = (*pskb)->len - ip->ihl * 4;
+#ifdef CONFIG_IP_NF_IPTABLES_INDEX
+				if (index && !index_key(&key, ip, protohdr,
+							datalen, offset))
+					index = NULL;
+#endif
 
 				if (verdict == IPT_CONTINUE)
 					e = (void *)e + e->next_offset;
@@ -792,6 +997,243 @@ cleanup_entry(struct ipt_entry *e, unsigned int *i)
 	return 0;
 }
 
+#ifdef CONFIG_IP_NF_IPTABLES_INDEX
+static struct ipt_match tcp_matchstruct, udp_matchstruct;
+
+/* Values of a masked address field an entry can match, if a prefix. */
+static void
+index_addr_range(u_int32_t addr, u_int32_t mask, u_int32_t *lo, u_int32_t *hi)
+{
+	u_int32_t host = ~ntohl(mask);
+
+	if (host & (host + 1))
+		return;
+	*lo = ntohl(addr) & ~host;
+	*hi = *lo | host;
+}
+
+static inline void
+index_port_range(const u_int16_t pts[2], int inv, u_int32_t *lo, u_int32_t *hi)
+{
+	if (inv)
+		return;
+	*lo = pts[0];
+	*hi = pts[1];
+}
+
+/* Per field, the smallest range holding every value @e may match. */
+static void
+index_entry_ranges(struct ipt_entry *e, u_int32_t *lo, u_int32_t *hi)
+{
+	const struct ipt_ip *ip = &e->ip;
+	unsigned int i;
+
+	for (i = 0; i < IPT_DIMS; i++) {
+		lo[i] = 0;
+		hi[i] = 0xFFFFFFFF;
+	}
+
+	if (!(ip->invflags & IPT_INV_SRCIP))
+		index_addr_range(ip->src.s_addr, ip->smsk.s_addr,
+				 &lo[IPT_DIM_SRC], &hi[IPT_DIM_SRC]);
+	if (!(ip->invflags & IPT_INV_DSTIP))
+		index_addr_range(ip->dst.s_addr, ip->dmsk.s_addr,
+				 &lo[IPT_DIM_DST], &hi[IPT_DIM_DST]);
+	if (ip->proto && !(ip->invflags & IPT_INV_PROTO))
+		lo[IPT_DIM_PROTO] = hi[IPT_DIM_PROTO] = ip->proto;
+
+	/* Only a leading tcp or udp match: see above. */
+	if (e->target_offset > sizeof(struct ipt_entry)) {
+		struct ipt_entry_match *m = (void *)e->elems;
+
+		if (m->u.kernel.match == &tcp_matchstruct) {
+			const struct ipt_tcp *t = (void *)m->data;
+
+			index_port_range(t->spts, t->invflags & IPT_TCP_INV_SRCPT,
+					 &lo[IPT_DIM_SPT], &hi[IPT_DIM_SPT]);
+			index_port_range(t->dpts, t->invflags & IPT_TCP_INV_DSTPT,
+					 &lo[IPT_DIM_DPT], &hi[IPT_DIM_DPT]);
+		} else if (m->u.kernel.match == &udp_matchstruct) {
+			const struct ipt_udp *u = (void *)m->data;
+
+			index_port_range(u->spts, u->invflags & IPT_UDP_INV_SRCPT,
+					 &lo[IPT_DIM_SPT], &hi[IPT_DIM_SPT]);
+			index_port_range(u->dpts, u->invflags & IPT_UDP_INV_DSTPT,
+					 &lo[IPT_DIM_DPT], &hi[IPT_DIM_DPT]);
+		}
+	}
+}
+
+/* Builds one field of a run from its entries' ranges.  An entry
+   with lo > hi can never match and gets no bits at all. */
+static int
+index_build_dim(struct ipt_index_dim *d, unsigned int count,
+		const u_int32_t *lo, const u_int32_t *hi)
+{
+	unsigned int i, j, n;
+	u_int32_t v;
+
+	d->start = kmalloc(sizeof(u_int32_t) * (2 * count + 1), GFP_KERNEL);
+	if (!d->start)
+		return -ENOMEM;
+
+	/* Sorted, unique interval boundaries. */
+	n = 0;
+	d->start[n++] = 0;
+	for (i = 0; i < 2 * count; i++) {
+		if (lo[i/2] > hi[i/2])
+			continue;
+		if (i % 2 == 0)
+			v = lo[i/2];
+		else if (hi[i/2] != 0xFFFFFFFF)
+			v = hi[i/2] + 1;
+		else
+			continue;
+
+		for (j = n; j > 0 && d->start[j-1] > v; j--)
+			;
+		if (d->start[j-1] == v)
+			continue;
+		memmove(&d->start[j+1], &d->start[j],
+			(n - j) * sizeof(u_int32_t));
+		d->start[j] = v;
+		n++;
+	}
+	d->n = n;
+
+	d->bits = kmalloc(sizeof(u_int32_t) * IPT_RUN_WORDS * n, GFP_KERNEL);
+	if (!d->bits)
+		return -ENOMEM;
+	memset(d->bits, 0, sizeof(u_int32_t) * IPT_RUN_WORDS * n);
+
+	for (i = 0; i < count; i++) {
+		if (lo[i] > hi[i])
+			continue;
+		for (j = index_dim_find(d, lo[i]);
+		     j < n && d->start[j] <= hi[i]; j++)
+			d->bits[j * IPT_RUN_WORDS + i / 32] |= 1U << (i % 32);
+	}
+	return 0;
+}
+
+static inline int
+index_offset(struct ipt_entry *e, void *base, unsigned int *offset,
+	     unsigned int *i)
+{
+	offset[(*i)++] = (void *)e - base;
+	return 0;
+}
+
+static void
+index_free(struct ipt_index *idx)
+{
+	unsigned int r, i;
+
+	if (!idx)
+		return;
+
+	if (idx->run) {
+		for (r = 0; r < idx->nruns; r++) {
+			for (i = 0; i < IPT_DIMS; i++) {
+				if (idx->run[r].dim[i].start)
+					kfree(idx->run[r].dim[i].start);
+				if (idx->run[r].dim[i].bits)
+					kfree(idx->run[r].dim[i].bits);
+			}
+		}
+		kfree(idx->run);
+	}
+	if (idx->offset)
+		kfree(idx->offset);
+	kfree(idx);
+}
+
+/* Returns the index for a translated table, or NULL if it is too
+   small to bother or memory is short: the linear walk still works. */
+static struct ipt_index *
+index_build(struct ipt_table_info *info)
+{
+	struct ipt_index *idx;
+	u_int32_t *lo, *hi;
+	unsigned int r, i, j;
+
+	if (info->number < IPT_INDEX_MIN)
+		return NULL;
+
+	idx = kmalloc(sizeof(*idx), GFP_KERNEL);
+	if (!idx)
+		return NULL;
+	memset(idx, 0, sizeof(*idx));
+	lo = kmalloc(2 * sizeof(u_int32_t) * IPT_DIMS * IPT_RUN_MAX,
+		     GFP_KERNEL);
+	if (!lo)
+		goto fail;
+	hi = lo + IPT_DIMS * IPT_RUN_MAX;
+
+	idx->number = info->number - 1;
+	idx->offset = kmalloc(sizeof(unsigned int) * info->number, GFP_KERNEL);
+	if (!idx->offset)
+		goto fail_free;
+	i = 0;
+	IPT_ENTRY_ITERATE(info->entries, info->size, index_offset,
+			  info->entries, idx->offset, &i);
+
+	idx->nruns = (idx->number + IPT_RUN_MAX - 1) / IPT_RUN_MAX;
+	idx->run = kmalloc(sizeof(struct ipt_index_run) * idx->nruns,
+			   GFP_KERNEL);
+	if (!idx->run)
+		goto fail_free;
+	memset(idx->run, 0, sizeof(struct ipt_index_run) * idx->nruns);
+
+	for (r = 0; r < idx->nruns; r++) {
+		struct ipt_index_run *run = &idx->run[r];
+		u_int32_t elo[IPT_DIMS], ehi[IPT_DIMS];
+
+		run->first = r * IPT_RUN_MAX;
+		run->count = idx->number - run->first;
+		if (run->count > IPT_RUN_MAX)
+			run->count = IPT_RUN_MAX;
+
+		for (i = 0; i < run->count; i++) {
+			struct ipt_entry *e = get_entry(info->entries,
+				idx->offset[run->first + i]);
+
+			run->nfcache |= e->nfcache;
+			index_entry_ranges(e, elo, ehi);
+			for (j = 0; j < IPT_DIMS; j++) {
+				lo[j * IPT_RUN_MAX + i] = elo[j];
+				hi[j * IPT_RUN_MAX + i] = ehi[j];
+			}
+		}
+		for (j = 0; j < IPT_DIMS; j++)
+			if (index_build_dim(&run->dim[j], run->count,
+					    lo + j * IPT_RUN_MAX,
+					    hi + j * IPT_RUN_MAX) != 0)
+				goto fail_free;
+	}
+
+	kfree(lo);
+	return idx;
+
+ fail_free:
+	kfree(lo);
+ fail:
+	index_free(idx);
+	return NULL;
+}
+#else
+#define index_build(info)	NULL
+#define index_free(idx)		do { } while (0)
+#endif /* CONFIG_IP_NF_IPTABLES_INDEX */
+
+/* Frees a table that went through translate_table(). */
+static void
+free_table_info(struct ipt_table_info *info)
+{
+	index_free(info->index);
+	vfree(info);
+}
+
 /* Checks and translates the user-supplied table segment (held in
    newinfo) */
 static int
@@ -808,6 +1250,7 @@ translate_table(const char *name,
 
 	newinfo->size = size;
 	newinfo->number = number;
+	newinfo->index = NULL;
 
 	/* Init all hooks to impossible value. */
 	for (i = 0; i < NF_IP_NUMHOOKS; i++) {
@@ -871,6 +1314,7 @@ translate_table(const char *name,
 		       SMP_ALIGN(newinfo->size));
 	}
 
+	newinfo->index = index_build(newinfo);
 	return ret;
 }
 
@@ -1127,7 +1571,7 @@ do_replace(void *user, unsigned int len)
 	get_counters(oldinfo, counters);
 	/* Decrease module usage counts and free resource */
 	IPT_ENTRY_ITERATE(oldinfo->entries, oldinfo->size, cleanup_entry,NULL);
-	vfree(oldinfo);
+	free_table_info(oldinfo);
 	/* Silent error: too late now. */
 	copy_to_user(tmp.counters, counters,
 		     sizeof(struct ipt_counters) * tmp.num_counters);
@@ -1139,6 +1583,7 @@ do_replace(void *user, unsigned int len)
 	up(&ipt_mutex);
  free_newinfo_counters_untrans:
 	IPT_ENTRY_ITERATE(newinfo->entries, newinfo->size, cleanup_entry,NULL);
+	index_free(newinfo->index);
  free_newinfo_counters:
 	vfree(counters);
  free_newinfo:
@@ -1381,7 +1826,7 @@ int ipt_register_table(struct ipt_table *table)
 	int ret;
 	struct ipt_table_info *newinfo;
 	static struct ipt_table_info bootstrap
-		= { 0, 0, 0, { 0 }, { 0 }, { } };
+		= { 0, 0, 0, { 0 }, { 0 }, NULL, { } };
 
 	MOD_INC_USE_COUNT;
 	newinfo = vmalloc(sizeof(struct ipt_table_info)
@@ -1436,7 +1881,7 @@ int ipt_register_table(struct ipt_table *table)
 	return ret;
 
  free_unlock:
-	vfree(newinfo);
+	free_table_info(newinfo);
 	MOD_DEC_USE_COUNT;
 	goto unlock;
 }
@@ -1450,7 +1895,7 @@ void ipt_unregister_table(struct ipt_table *table)
 	/* Decrease module usage counts and free resources */
 	IPT_ENTRY_ITERATE(table->private->entries, table->private->size,
 			  cleanup_entry, NULL);
-	vfree(table->private);
+	free_table_info(table->private);
 	MOD_DEC_USE_COUNT;
 }
 
@@ -0,0 +1,229 @@
+/*
+ * Rule evaluation benchmark.
+ *
+ * Registers a table `bench' with a single FORWARD chain that is never
+ * attached to a netfilter hook.  Load the ruleset to be measured with
+ * `iptables -t bench -A FORWARD ...', then read /proc/net/iptable_bench:
+ * each read pushes the same pseudo-random stream of TCP packets through
+ * the table, with the rule index on and off, and reports the rate and
+ * the verdicts.  Source and destination addresses are drawn from the
+ * low `bits' bits below `net', destination ports from 0-1023.
+ *
+ * The packets have no input or output device, so -i and -o rules never
+ * match.  Stick to ACCEPT, DROP, RETURN and jumps: targets that send or
+ * mangle packets will act on the generated ones.
+ */
+#include <linux/module.h>
+#include <linux/skbuff.h>
+#include <linux/ip.h>
+#include <linux/tcp.h>
+#include <linux/proc_fs.h>
+#include <linux/sched.h>
+#include <linux/netfilter_ipv4/ip_tables.h>
+#include <asm/div64.h>
+#include <asm/semaphore.h>
+
+#define BENCH_VALID_HOOKS (1 << NF_IP_FORWARD)
+
+/* Standard entry. */
+struct ipt_standard
+{
+	struct ipt_entry entry;
+	struct ipt_standard_target target;
+};
+
+struct ipt_error_target
+{
+	struct ipt_entry_target target;
+	char errorname[IPT_FUNCTION_MAXNAMELEN];
+};
+
+struct ipt_error
+{
+	struct ipt_entry entry;
+	struct ipt_error_target target;
+};
+
+static struct
+{
+	struct ipt_replace repl;
+	struct ipt_standard entries[1];
+	struct ipt_error term;
+} initial_table __initdata
+= { { "bench", BENCH_VALID_HOOKS, 2,
+      sizeof(struct ipt_standard) + sizeof(struct ipt_error),
+      { [NF_IP_FORWARD] 0 },
+      { [NF_IP_FORWARD] 0 },
+      0, NULL, { } },
+    {
+	    /* FORWARD */
+	    { { { { 0 }, { 0 }, { 0 }, { 0 }, "", "", { 0 }, { 0 }, 0, 0, 0 },
+		0,
+		sizeof(struct ipt_entry),
+		sizeof(struct ipt_standard),
+		0, { 0, 0 }, { } },
+	      { { { { IPT_ALIGN(sizeof(struct ipt_standard_target)), "" } }, { } },
+		-NF_ACCEPT - 1 } }
+    },
+    /* ERROR */
+    { { { { 0 }, { 0 }, { 0 }, { 0 }, "", "", { 0 }, { 0 }, 0, 0, 0 },
+	0,
+	sizeof(struct ipt_entry),
+	sizeof(struct ipt_error),
+	0, { 0, 0 }, { } },
+      { { { { IPT_ALIGN(sizeof(struct ipt_error_target)), IPT_ERROR_TARGET } },
+	  { } },
+	"ERROR"
+      }
+    }
+};
+
+static struct ipt_table bench_table
+= { { NULL, NULL }, "bench", &initial_table.repl,
+    BENCH_VALID_HOOKS, RW_LOCK_UNLOCKED, NULL, THIS_MODULE };
+
+#ifdef CONFIG_IP_NF_IPTABLES_INDEX
+/* Keeps concurrent readers from timing each other's linear walk */
+static DECLARE_MUTEX(bench_sem);
+#endif
+
+static int packets = 100000;
+MODULE_PARM(packets, "i");
+MODULE_PARM_DESC(packets, "packets per measurement");
+static unsigned long net = 0x0a000000;		/* 10.0.0.0 */
+MODULE_PARM(net, "l");
+MODULE_PARM_DESC(net, "base address of generated packets, host order");
+static int bits = 16;
+MODULE_PARM(bits, "i");
+MODULE_PARM_DESC(bits, "number of random low address bits");
+
+/* Pushes `packets' packets through the table; returns microseconds. */
+static long bench_run(struct sk_buff *skb, unsigned int *verdicts)
+{
+	struct iphdr *iph = skb->nh.iph;
+	struct tcphdr *th = (struct tcphdr *)(iph + 1);
+	u_int32_t mask = bits >= 32 ? ~0U : (1U << bits) - 1;
+	u_int32_t seed = 1;
+	struct timeval start, end;
+	int i;
+
+	do_gettimeofday(&start);
+	for (i = 0; i < packets; i++) {
+		struct sk_buff *pskb = skb;
+		unsigned int verdict;
+
+		seed = seed * 1103515245 + 12345;
+		iph->saddr = htonl(net | (seed & mask));
+		seed = seed * 1103515245 + 12345;
+		iph->daddr = htonl(net | (seed & mask));
+		th->dest = htons((seed >> 16) & 1023);
+		th->source = htons(1024 + ((seed >> 6) & 0x3ff));
+
+		verdict = ipt_do_table(&pskb, NF_IP_FORWARD, NULL, NULL,
+				       &bench_table, NULL);
+		verdicts[verdict == NF_ACCEPT]++;
+
+		if ((i & 1023) == 0 && current->need_resched)
+			schedule();
+	}
+	do_gettimeofday(&end);
+
+	return (end.tv_sec - start.tv_sec) * 1000000L
+		+ (end.tv_usec - start.tv_usec);
+}
+
+static int bench_report(char *buffer, const char *what, long usec,
+			unsigned int *verdicts)
+{
+	u_int64_t pps = (u_int64_t)packets * 1000000;
+
+	if (usec <= 0)
+		usec = 1;
+	do_div(pps, usec);
+	return sprintf(buffer, "%-8s %9d packets %9ld usec %9lu pps"
+		       " %9u accepted %9u dropped\n", what, packets, usec,
+		       (unsigned long)pps, verdicts[1], verdicts[0]);
+}
+
+static int
+bench_get_info(char *buffer, char **start, off_t offset, int length)
+{
+	struct sk_buff *skb;
+	struct iphdr *iph;
+	struct tcphdr *th;
+	unsigned int verdicts[2];
+	long usec;
+	int len = 0;
+
+	/* One shot: every read reruns the measurement. */
+	if (offset > 0)
+		return 0;
+
+	skb = alloc_skb(sizeof(struct iphdr) + sizeof(struct tcphdr),
+			GFP_KERNEL);
+	if (!skb)
+		return -ENOMEM;
+	iph = (struct iphdr *)skb_put(skb, sizeof(struct iphdr));
+	th = (struct tcphdr *)skb_put(skb, sizeof(struct tcphdr));
+	skb->nh.iph = iph;
+	memset(iph, 0, sizeof(*iph) + sizeof(*th));
+	iph->version = 4;
+	iph->ihl = sizeof(struct iphdr) / 4;
+	iph->tot_len = htons(skb->len);
+	iph->ttl = 64;
+	iph->protocol = IPPROTO_TCP;
+	th->doff = sizeof(struct tcphdr) / 4;
+	th->ack = 1;
+
+#ifdef CONFIG_IP_NF_IPTABLES_INDEX
+	down(&bench_sem);
+	verdicts[0] = verdicts[1] = 0;
+	usec = bench_run(skb, verdicts);
+	up(&bench_sem);
+	len += bench_report(buffer + len, "indexed", usec, verdicts);
+
+	/* Only this table: the others keep using their index. */
+	down(&bench_sem);
+	bench_table.noindex = 1;
+	verdicts[0] = verdicts[1] = 0;
+	usec = bench_run(skb, verdicts);
+	bench_table.noindex = 0;
+	up(&bench_sem);
+#else
+	verdicts[0] = verdicts[1] = 0;
+	usec = bench_run(skb, verdicts);
+#endif
+	len += bench_report(buffer + len, "linear", usec, verdicts);
+
+	kfree_skb(skb);
+	*start = buffer;
+	return len > length ? length : len;
+}
+
+static int __init init(void)
+{
+	int ret;
+
+	if (packets <= 0 || bits < 0 || bits > 32)
+		return -EINVAL;
+
+	ret = ipt_register_table(&bench_table);
+	if (ret < 0)
+		return ret;
+
+	if (!proc_net_create("iptable_bench", 0, bench_get_info)) {
+		ipt_unregister_table(&bench_table);
+		return -ENOMEM;
+	}
+	return 0;
+}
+
+static void __exit fini(void)
+{
+	proc_net_remove("iptable_bench");
+	ipt_unregister_table(&bench_table);
+}
+
+module_init(init);
+module_exit(fini);
+MODULE_LICENSE("GPL");
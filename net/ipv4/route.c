@@ -86,6 +86,7 @@
 #include <linux/netfilter_ipv4.h>
 #include <linux/random.h>
 #include <linux/jhash.h>
+#include <linux/brlock.h>
 #include <net/protocol.h>
 #include <net/ip.h>
 #include <net/route.h>
@@ -119,6 +120,7 @@ int ip_rt_mtu_expires		= 10 * 60 * HZ;
 int ip_rt_min_pmtu		= 512 + 20 + 20;
 int ip_rt_min_advmss		= 256;
 int ip_rt_secret_interval	= 10 * 60 * HZ;
+int ip_rt_gc_budget		= 2000;		/* usecs per collection */
 static unsigned long rt_deadline;
 
 #define RTprint(a...)	printk(KERN_DEBUG a)
@@ -186,6 +188,9 @@ __u8 ip_tos2prio[16] = {
  * 3) Only readers acquire references to rtable entries,
  *    they do so with atomic increments and with the
  *    lock held.
+ * 4) rt_hash_table, rt_hash_mask and rt_hash_log change only when
+ *    the table is resized, under the BR_RT_CACHE_LOCK write lock.
+ *    Everybody who indexes the table holds it for reading.
  */
 
 struct rt_hash_bucket {
@@ -203,12 +208,43 @@ struct rt_cache_stat rt_cache_stat[NR_CPUS];
 static int rt_intern_hash(unsigned hash, struct rtable *rth,
 				struct rtable **res);
 
+/* While rt_secret_rebuild() moves entries to their buckets under a new
+ * secret, buckets from rt_rebuild_next on may still hold entries hashed
+ * with rt_hash_rnd_old.  rt_rebuild_next is -1 otherwise.
+ */
+static unsigned int		rt_hash_rnd_old;
+static int			rt_rebuild_next = -1;
+
 static unsigned int rt_hash_code(u32 daddr, u32 saddr, u8 tos)
 {
 	return (jhash_3words(daddr, saddr, (u32) tos, rt_hash_rnd)
 		& rt_hash_mask);
 }
 
+static inline unsigned int __rt_key_hash(struct rtable *rt, u32 rnd)
+{
+	/* Input routes are keyed by iif, output routes by oif. */
+	return (jhash_3words(rt->key.dst,
+			     rt->key.src ^ ((rt->key.iif | rt->key.oif) << 5),
+			     (u32) rt->key.tos, rnd)
+		& rt_hash_mask);
+}
+
+static inline unsigned int rt_key_hash(struct rtable *rt)
+{
+	return __rt_key_hash(rt, rt_hash_rnd);
+}
+
+/* Microseconds since start, for the GC time budget. */
+static inline long rt_gc_elapsed(struct timeval *start)
+{
+	struct timeval now;
+
+	do_gettimeofday(&now);
+	return (now.tv_sec - start->tv_sec) * 1000000L +
+		(now.tv_usec - start->tv_usec);
+}
+
 static int rt_cache_get_info(char *buffer, char **start, off_t offset,
 				int length)
 {
@@ -227,7 +263,13 @@ static int rt_cache_get_info(char *buffer, char **start, off_t offset,
   	}
 	
 	for (i = rt_hash_mask; i >= 0; i--) {
-		read_lock_bh(&rt_hash_table[i].lock);
+		br_read_lock_bh(BR_RT_CACHE_LOCK);
+		if (i > rt_hash_mask) {
+			/* Shrunk under us. */
+			br_read_unlock_bh(BR_RT_CACHE_LOCK);
+			continue;
+		}
+		read_lock(&rt_hash_table[i].lock);
 		for (r = rt_hash_table[i].chain; r; r = r->u.rt_next) {
 			/*
 			 *	Spin through entries until we are ready
@@ -263,11 +305,13 @@ static int rt_cache_get_info(char *buffer, char **start, off_t offset,
 			sprintf(buffer + len, "%-127s\n", temp);
 			len += 128;
 			if (pos >= offset+length) {
-				read_unlock_bh(&rt_hash_table[i].lock);
+				read_unlock(&rt_hash_table[i].lock);
+				br_read_unlock_bh(BR_RT_CACHE_LOCK);
 				goto done;
 			}
 		}
-		read_unlock_bh(&rt_hash_table[i].lock);
+		read_unlock(&rt_hash_table[i].lock);
+		br_read_unlock_bh(BR_RT_CACHE_LOCK);
         }
 
 done:
@@ -287,7 +331,7 @@ static int rt_cache_stat_get_info(char *buffer, char **start, off_t offset, int
         for (lcpu = 0; lcpu < smp_num_cpus; lcpu++) {
                 i = cpu_logical_map(lcpu);
 
-		len += sprintf(buffer+len, "%08x  %08x %08x %08x %08x %08x %08x %08x  %08x %08x %08x %08x %08x %08x %08x %08x %08x \n",
+		len += sprintf(buffer+len, "%08x  %08x %08x %08x %08x %08x %08x %08x  %08x %08x %08x %08x %08x %08x %08x %08x %08x %08x \n",
 			       dst_entries,		       
 			       rt_cache_stat[i].in_hit,
 			       rt_cache_stat[i].in_slow_tot,
@@ -306,8 +350,8 @@ static int rt_cache_stat_get_info(char *buffer, char **start, off_t offset, int
 			       rt_cache_stat[i].gc_goal_miss,
 			       rt_cache_stat[i].gc_dst_overflow,
 			       rt_cache_stat[i].in_hlist_search,
-			       rt_cache_stat[i].out_hlist_search
-
+			       rt_cache_stat[i].out_hlist_search,
+			       rt_cache_stat[i].gc_time
 			);
 	}
 	len -= offset;
@@ -396,7 +440,11 @@ static void SMP_TIMER_NAME(rt_check_expire)(unsigned long dummy)
 	int i = rover, t;
 	struct rtable *rth, **rthp;
 	unsigned long now = jiffies;
+	struct timeval start;
+	long elapsed;
 
+	do_gettimeofday(&start);
+	br_read_lock(BR_RT_CACHE_LOCK);
 	for (t = ip_rt_gc_interval << rt_hash_log; t >= 0;
 	     t -= ip_rt_gc_timeout) {
 		unsigned long tmo = ip_rt_gc_timeout;
@@ -425,11 +473,20 @@ static void SMP_TIMER_NAME(rt_check_expire)(unsigned long dummy)
 		}
 		write_unlock(&rt_hash_table[i].lock);
 
+		/* Leave the rest for the next run. */
+		if ((i & 15) == 0 && ip_rt_gc_budget > 0 &&
+		    rt_gc_elapsed(&start) > ip_rt_gc_budget)
+			break;
+
 		/* Fallback loop breaker. */
 		if (time_after(jiffies, now))
 			break;
 	}
+	br_read_unlock(BR_RT_CACHE_LOCK);
 	rover = i;
+	elapsed = rt_gc_elapsed(&start);
+	if (elapsed > 0)
+		rt_cache_stat[smp_processor_id()].gc_time += elapsed;
 	mod_timer(&rt_periodic_timer, now + ip_rt_gc_interval);
 }
 
@@ -448,11 +505,16 @@ static void SMP_TIMER_NAME(rt_run_flush)(unsigned long dummy)
 	get_random_bytes(&rt_hash_rnd, 4);
 
 	for (i = rt_hash_mask; i >= 0; i--) {
-		write_lock_bh(&rt_hash_table[i].lock);
-		rth = rt_hash_table[i].chain;
-		if (rth)
-			rt_hash_table[i].chain = NULL;
-		write_unlock_bh(&rt_hash_table[i].lock);
+		br_read_lock_bh(BR_RT_CACHE_LOCK);
+		rth = NULL;
+		if (i <= rt_hash_mask) {
+			write_lock(&rt_hash_table[i].lock);
+			rth = rt_hash_table[i].chain;
+			if (rth)
+				rt_hash_table[i].chain = NULL;
+			write_unlock(&rt_hash_table[i].lock);
+		}
+		br_read_unlock_bh(BR_RT_CACHE_LOCK);
 
 		for (; rth; rth = next) {
 			next = rth->u.rt_next;
@@ -505,12 +567,122 @@ void rt_cache_flush(int delay)
 	spin_unlock_bh(&rt_flush_lock);
 }
 
+/*
+ * Change the hash secret and move every entry to its new bucket
+ * instead of flushing the cache.  The move is spread over as many
+ * timer runs as the gc time budget asks for, from rt_rebuild_next on.
+ * A lookup racing with it may miss an entry that has not moved yet
+ * and add a duplicate, which is harmless and ages out.  Only this
+ * timer holds two bucket locks at once, so the nesting cannot
+ * deadlock.
+ */
 static void rt_secret_rebuild(unsigned long dummy)
 {
 	unsigned long now = jiffies;
+	struct rtable *rth, **rthp;
+	struct timeval start;
+	unsigned hash;
+	long elapsed;
+	int i;
 
-	rt_cache_flush(0);
-	mod_timer(&rt_secret_timer, now + ip_rt_secret_interval);
+	do_gettimeofday(&start);
+	br_read_lock(BR_RT_CACHE_LOCK);
+	if (rt_rebuild_next < 0) {
+		rt_hash_rnd_old = rt_hash_rnd;
+		get_random_bytes(&rt_hash_rnd, 4);
+		rt_rebuild_next = 0;
+	}
+	for (i = rt_rebuild_next; i <= rt_hash_mask; i++) {
+		/* Leave the rest for the next run. */
+		if ((i & 15) == 0 && i != rt_rebuild_next &&
+		    ip_rt_gc_budget > 0 &&
+		    rt_gc_elapsed(&start) > ip_rt_gc_budget)
+			break;
+
+		rthp = &rt_hash_table[i].chain;
+		write_lock(&rt_hash_table[i].lock);
+		while ((rth = *rthp) != NULL) {
+			hash = rt_key_hash(rth);
+			if (hash == i) {
+				rthp = &rth->u.rt_next;
+				continue;
+			}
+			*rthp = rth->u.rt_next;
+			write_lock(&rt_hash_table[hash].lock);
+			rth->u.rt_next = rt_hash_table[hash].chain;
+			rt_hash_table[hash].chain = rth;
+			write_unlock(&rt_hash_table[hash].lock);
+		}
+		write_unlock(&rt_hash_table[i].lock);
+	}
+	rt_rebuild_next = i <= rt_hash_mask ? i : -1;
+	br_read_unlock(BR_RT_CACHE_LOCK);
+
+	elapsed = rt_gc_elapsed(&start);
+	if (elapsed > 0)
+		rt_cache_stat[smp_processor_id()].gc_time += elapsed;
+	mod_timer(&rt_secret_timer,
+		  now + (rt_rebuild_next < 0 ? ip_rt_secret_interval : 1));
+}
+
+static struct rt_hash_bucket *rt_hash_alloc(int log)
+{
+	unsigned long size = sizeof(struct rt_hash_bucket) << log;
+	struct rt_hash_bucket *table;
+	int i;
+
+	table = (struct rt_hash_bucket *)
+		__get_free_pages(GFP_KERNEL, get_order(size));
+	if (table == NULL)
+		return NULL;
+	for (i = 0; i < (1 << log); i++) {
+		table[i].lock = RW_LOCK_UNLOCKED;
+		table[i].chain = NULL;
+	}
+	return table;
+}
+
+/*
+ * Move the cache to a table of 2^log buckets.  Entries are rehashed
+ * rather than flushed.  gc_thresh and max_size are reset to the boot
+ * time defaults for the new size.
+ */
+static int rt_hash_resize(int log)
+{
+	struct rt_hash_bucket *new, *old;
+	struct rtable *rth, *next;
+	int i, old_log;
+
+	new = rt_hash_alloc(log);
+	if (new == NULL)
+		return -ENOMEM;
+
+	br_write_lock_bh(BR_RT_CACHE_LOCK);
+	old = rt_hash_table;
+	old_log = rt_hash_log;
+	rt_hash_table = new;
+	rt_hash_log = log;
+	rt_hash_mask = (1 << log) - 1;
+	/* Everything moves under the current secret. */
+	rt_rebuild_next = -1;
+	for (i = 0; i < (1 << old_log); i++) {
+		for (rth = old[i].chain; rth; rth = next) {
+			unsigned hash = rt_key_hash(rth);
+
+			next = rth->u.rt_next;
+			rth->u.rt_next = new[hash].chain;
+			new[hash].chain = rth;
+		}
+	}
+	ipv4_dst_ops.gc_thresh = (rt_hash_mask + 1);
+	ip_rt_max_size = (rt_hash_mask + 1) * 16;
+	br_write_unlock_bh(BR_RT_CACHE_LOCK);
+
+	free_pages((unsigned long)old,
+		   get_order(sizeof(struct rt_hash_bucket) << old_log));
+	printk(KERN_INFO "IP: routing cache hash table resized from %u to "
+	       "%u buckets\n", 1 << old_log, 1 << log);
+	return 0;
 }
 
 /*
@@ -534,7 +706,9 @@ static int rt_garbage_collect(void)
 	static int equilibrium;
 	struct rtable *rth, **rthp;
 	unsigned long now = jiffies;
-	int goal;
+	struct timeval start;
+	long elapsed;
+	int goal, ret = 0, over = 0;
 
 	/*
 	 * Garbage collection is pretty expensive,
@@ -546,9 +720,12 @@ static int rt_garbage_collect(void)
 	if (now - last_gc < ip_rt_gc_min_interval &&
 	    atomic_read(&ipv4_dst_ops.entries) < ip_rt_max_size) {
 		rt_cache_stat[smp_processor_id()].gc_ignored++;
-		goto out;
+		return 0;
 	}
 
+	do_gettimeofday(&start);
+	br_read_lock_bh(BR_RT_CACHE_LOCK);
+
 	/* Calculate number of entries, which we want to expire now. */
 	goal = atomic_read(&ipv4_dst_ops.entries) -
 		(ip_rt_gc_elasticity << rt_hash_log);
@@ -584,7 +761,7 @@ static int rt_garbage_collect(void)
 
 			k = (k + 1) & rt_hash_mask;
 			rthp = &rt_hash_table[k].chain;
-			write_lock_bh(&rt_hash_table[k].lock);
+			write_lock(&rt_hash_table[k].lock);
 			while ((rth = *rthp) != NULL) {
 				if (!rt_may_expire(rth, tmo, expire)) {
 					tmo >>= 1;
@@ -595,9 +772,17 @@ static int rt_garbage_collect(void)
 				rt_free(rth);
 				goal--;
 			}
-			write_unlock_bh(&rt_hash_table[k].lock);
+			write_unlock(&rt_hash_table[k].lock);
 			if (goal <= 0)
 				break;
+
+			/* A flood must not keep us here: resume at
+			   rover next time rather than finish the pass. */
+			if ((i & 15) == 0 && ip_rt_gc_budget > 0 &&
+			    rt_gc_elapsed(&start) > ip_rt_gc_budget) {
+				over = 1;
+				break;
+			}
 		}
 		rover = k;
 
@@ -609,6 +794,7 @@ static int rt_garbage_collect(void)
 		   - if expire reduced to zero. Otherwise, expire is halfed.
 		   - if table is not full.
 		   - if we are called from interrupt.
+		   - if the time budget is spent.
 		   - jiffies check is just fallback/debug loop breaker.
 		     We will not spin here for long time in any case.
 		 */
@@ -626,14 +812,15 @@ static int rt_garbage_collect(void)
 
 		if (atomic_read(&ipv4_dst_ops.entries) < ip_rt_max_size)
 			goto out;
-	} while (!in_softirq() && time_before_eq(jiffies, now));
+	} while (!over && !in_softirq() && time_before_eq(jiffies, now));
 
 	if (atomic_read(&ipv4_dst_ops.entries) < ip_rt_max_size)
 		goto out;
 	if (net_ratelimit())
 		printk(KERN_WARNING "dst cache overflow\n");
 	rt_cache_stat[smp_processor_id()].gc_dst_overflow++;
-	return 1;
+	ret = 1;
+	goto out;
 
 work_done:
 	expire += ip_rt_gc_min_interval;
@@ -644,12 +831,37 @@ work_done:
 	printk(KERN_DEBUG "expire++ %u %d %d %d\n", expire,
 			atomic_read(&ipv4_dst_ops.entries), goal, rover);
 #endif
-out:	return 0;
+out:
+	br_read_unlock_bh(BR_RT_CACHE_LOCK);
+	elapsed = rt_gc_elapsed(&start);
+	if (elapsed > 0)
+		rt_cache_stat[smp_processor_id()].gc_time += elapsed;
+	return ret;
+}
+
+/* Least valuable unreferenced entry of a chain.  Bucket lock held. */
+static struct rtable **rt_chain_victim(struct rtable **rthp)
+{
+	struct rtable *rth, **candp = NULL;
+	u32 min_score = ~(u32)0;
+
+	for (; (rth = *rthp) != NULL; rthp = &rth->u.rt_next) {
+		if (!atomic_read(&rth->u.dst.__refcnt)) {
+			u32 score = rt_score(rth);
+
+			if (score <= min_score) {
+				candp = rthp;
+				min_score = score;
+			}
+		}
+	}
+	return candp;
 }
 
 static int rt_intern_hash(unsigned hash, struct rtable *rt, struct rtable **rp)
 {
 	struct rtable	*rth, **rthp;
+	struct rt_hash_bucket *rtb;
 	unsigned long	now;
 	struct rtable *cand, **candp;
 	u32 		min_score;
@@ -663,20 +875,27 @@ restart:
 	candp = NULL;
 	now = jiffies;
 
-	rthp = &rt_hash_table[hash].chain;
+	br_read_lock_bh(BR_RT_CACHE_LOCK);
+	/* The table may have been resized since hash was computed, and
+	 * it was masked to the old size: compute it again.
+	 */
+	hash = rt_key_hash(rt);
+	rtb = &rt_hash_table[hash];
+	rthp = &rtb->chain;
 
-	write_lock_bh(&rt_hash_table[hash].lock);
+	write_lock(&rtb->lock);
 	while ((rth = *rthp) != NULL) {
 		if (memcmp(&rth->key, &rt->key, sizeof(rt->key)) == 0) {
 			/* Put it first */
 			*rthp = rth->u.rt_next;
-			rth->u.rt_next = rt_hash_table[hash].chain;
-			rt_hash_table[hash].chain = rth;
+			rth->u.rt_next = rtb->chain;
+			rtb->chain = rth;
 
 			rth->u.dst.__use++;
 			dst_hold(&rth->u.dst);
 			rth->u.dst.lastuse = now;
-			write_unlock_bh(&rt_hash_table[hash].lock);
+			write_unlock(&rtb->lock);
+			br_read_unlock_bh(BR_RT_CACHE_LOCK);
 
 			rt_drop(rt);
 			*rp = rth;
@@ -698,17 +917,20 @@ restart:
 		rthp = &rth->u.rt_next;
 	}
 
-	if (cand) {
-		/* ip_rt_gc_elasticity used to be average length of chain
-		 * length, when exceeded gc becomes really aggressive.
-		 *
-		 * The second limit is less certain. At the moment it allows
-		 * only 2 entries per bucket. We will see.
-		 */
-		if (chain_length > ip_rt_gc_elasticity) {
-			*candp = cand->u.rt_next;
-			rt_free(cand);
-		}
+	/* ip_rt_gc_elasticity used to be average length of chain
+	 * length, when exceeded gc becomes really aggressive.
+	 *
+	 * It is also the hard limit on a chain: evict the least
+	 * valuable unreferenced entries until the new one fits, so
+	 * that a flood of new keys cannot grow a chain without bound
+	 * between collections.
+	 */
+	while (candp && chain_length > ip_rt_gc_elasticity) {
+		cand = *candp;
+		*candp = cand->u.rt_next;
+		rt_free(cand);
+		chain_length--;
+		candp = rt_chain_victim(&rtb->chain);
 	}
 
 	/* Try to bind route to arp only if it is output
@@ -717,7 +939,8 @@ restart:
 	if (rt->rt_type == RTN_UNICAST || rt->key.iif == 0) {
 		int err = arp_bind_neighbour(&rt->u.dst);
 		if (err) {
-			write_unlock_bh(&rt_hash_table[hash].lock);
+			write_unlock(&rtb->lock);
+			br_read_unlock_bh(BR_RT_CACHE_LOCK);
 
 			if (err != -ENOBUFS) {
 				rt_drop(rt);
@@ -746,7 +969,7 @@ restart:
 		}
 	}
 
-	rt->u.rt_next = rt_hash_table[hash].chain;
+	rt->u.rt_next = rtb->chain;
 #if RT_CACHE_DEBUG >= 2
 	if (rt->u.rt_next) {
 		struct rtable *trt;
@@ -757,8 +980,9 @@ restart:
 		printk("\n");
 	}
 #endif
-	rt_hash_table[hash].chain = rt;
-	write_unlock_bh(&rt_hash_table[hash].lock);
+	rtb->chain = rt;
+	write_unlock(&rtb->lock);
+	br_read_unlock_bh(BR_RT_CACHE_LOCK);
 	*rp = rt;
 	return 0;
 }
@@ -821,20 +1045,43 @@ void __ip_select_ident(struct iphdr *iph, struct dst_entry *dst)
 	ip_select_fb_ident(iph);
 }
 
-static void rt_del(unsigned hash, struct rtable *rt)
+/* Unlink @rt from bucket @hash; returns 1 if it was there. */
+static int rt_del_bucket(unsigned hash, struct rtable *rt)
 {
 	struct rtable **rthp;
+	int found = 0;
 
-	write_lock_bh(&rt_hash_table[hash].lock);
-	ip_rt_put(rt);
+	write_lock(&rt_hash_table[hash].lock);
 	for (rthp = &rt_hash_table[hash].chain; *rthp;
 	     rthp = &(*rthp)->u.rt_next)
 		if (*rthp == rt) {
 			*rthp = rt->u.rt_next;
-			rt_free(rt);
+			found = 1;
 			break;
 		}
-	write_unlock_bh(&rt_hash_table[hash].lock);
+	write_unlock(&rt_hash_table[hash].lock);
+	return found;
+}
+
+static void rt_del(struct rtable *rt)
+{
+	unsigned hash;
+	int found = 0;
+
+	br_read_lock_bh(BR_RT_CACHE_LOCK);
+	ip_rt_put(rt);
+	/* Not moved by rt_secret_rebuild() yet?  The move goes from the
+	 * old bucket to the new one, so look there first.
+	 */
+	if (rt_rebuild_next >= 0) {
+		hash = __rt_key_hash(rt, rt_hash_rnd_old);
+		found = rt_del_bucket(hash, rt);
+	}
+	if (!found)
+		found = rt_del_bucket(rt_key_hash(rt), rt);
+	if (found)
+		rt_free(rt);
+	br_read_unlock_bh(BR_RT_CACHE_LOCK);
 }
 
 void ip_rt_redirect(u32 old_gw, u32 daddr, u32 new_gw,
@@ -867,10 +1114,11 @@ void ip_rt_redirect(u32 old_gw, u32 daddr, u32 new_gw,
 
 	for (i = 0; i < 2; i++) {
 		for (k = 0; k < 2; k++) {
-			unsigned hash = rt_hash_code(daddr,
-						     skeys[i] ^ (ikeys[k] << 5),
-						     tos);
+			unsigned hash;
 
+			br_read_lock(BR_RT_CACHE_LOCK);
+			hash = rt_hash_code(daddr, skeys[i] ^ (ikeys[k] << 5),
+					    tos);
 			rthp=&rt_hash_table[hash].chain;
 
 			read_lock(&rt_hash_table[hash].lock);
@@ -895,6 +1143,7 @@ void ip_rt_redirect(u32 old_gw, u32 daddr, u32 new_gw,
 
 				dst_hold(&rth->u.dst);
 				read_unlock(&rt_hash_table[hash].lock);
+				br_read_unlock(BR_RT_CACHE_LOCK);
 
 				rt = dst_alloc(&ipv4_dst_ops);
 				if (rt == NULL) {
@@ -935,12 +1184,13 @@ void ip_rt_redirect(u32 old_gw, u32 daddr, u32 new_gw,
 					goto do_next;
 				}
 
-				rt_del(hash, rth);
+				rt_del(rth);
 				if (!rt_intern_hash(hash, rt, &rt))
 					ip_rt_put(rt);
 				goto do_next;
 			}
 			read_unlock(&rt_hash_table[hash].lock);
+			br_read_unlock(BR_RT_CACHE_LOCK);
 		do_next:
 			;
 		}
@@ -972,16 +1222,12 @@ static struct dst_entry *ipv4_negative_advice(struct dst_entry *dst)
 			ret = NULL;
 		} else if ((rt->rt_flags & RTCF_REDIRECTED) ||
 			   rt->u.dst.expires) {
-			unsigned hash = rt_hash_code(rt->key.dst,
-						     rt->key.src ^
-							(rt->key.oif << 5),
-						     rt->key.tos);
 #if RT_CACHE_DEBUG >= 1
 			printk(KERN_DEBUG "ip_rt_advice: redirect to "
 					  "%u.%u.%u.%u/%02x dropped\n",
 				NIPQUAD(rt->rt_dst), rt->key.tos);
 #endif
-			rt_del(hash, rt);
+			rt_del(rt);
 			ret = NULL;
 		}
 	}
@@ -1119,8 +1365,10 @@ unsigned short ip_rt_frag_needed(struct iphdr *iph, unsigned short new_mtu)
 		return 0;
 
 	for (i = 0; i < 2; i++) {
-		unsigned hash = rt_hash_code(daddr, skeys[i], tos);
+		unsigned hash;
 
+		br_read_lock(BR_RT_CACHE_LOCK);
+		hash = rt_hash_code(daddr, skeys[i], tos);
 		read_lock(&rt_hash_table[hash].lock);
 		for (rth = rt_hash_table[hash].chain; rth;
 		     rth = rth->u.rt_next) {
@@ -1160,6 +1408,7 @@ unsigned short ip_rt_frag_needed(struct iphdr *iph, unsigned short new_mtu)
 			}
 		}
 		read_unlock(&rt_hash_table[hash].lock);
+		br_read_unlock(BR_RT_CACHE_LOCK);
 	}
 	return est_mtu ? : new_mtu;
 }
@@ -1711,8 +1960,9 @@ int ip_route_input(struct sk_buff *skb, u32 daddr, u32 saddr,
 	int iif = dev->ifindex;
 
 	tos &= IPTOS_RT_MASK;
-	hash = rt_hash_code(daddr, saddr ^ (iif << 5), tos);
 
+	br_read_lock(BR_RT_CACHE_LOCK);
+	hash = rt_hash_code(daddr, saddr ^ (iif << 5), tos);
 	read_lock(&rt_hash_table[hash].lock);
 	for (rth = rt_hash_table[hash].chain; rth; rth = rth->u.rt_next) {
 		if (rth->key.dst == daddr &&
@@ -1728,12 +1978,14 @@ int ip_route_input(struct sk_buff *skb, u32 daddr, u32 saddr,
 			rth->u.dst.__use++;
 			rt_cache_stat[smp_processor_id()].in_hit++;
 			read_unlock(&rt_hash_table[hash].lock);
+			br_read_unlock(BR_RT_CACHE_LOCK);
 			skb->dst = (struct dst_entry*)rth;
 			return 0;
 		}
 		rt_cache_stat[smp_processor_id()].in_hlist_search++;
 	}
 	read_unlock(&rt_hash_table[hash].lock);
+	br_read_unlock(BR_RT_CACHE_LOCK);
 
 	/* Multicast recognition logic is moved from route cache to here.
 	   The problem was that too many Ethernet cards have broken/missing
@@ -2071,9 +2323,9 @@ int ip_route_output_key(struct rtable **rp, const struct rt_key *key)
 	unsigned hash;
 	struct rtable *rth;
 
+	br_read_lock_bh(BR_RT_CACHE_LOCK);
 	hash = rt_hash_code(key->dst, key->src ^ (key->oif << 5), key->tos);
-
-	read_lock_bh(&rt_hash_table[hash].lock);
+	read_lock(&rt_hash_table[hash].lock);
 	for (rth = rt_hash_table[hash].chain; rth; rth = rth->u.rt_next) {
 		if (rth->key.dst == key->dst &&
 		    rth->key.src == key->src &&
@@ -2088,13 +2340,15 @@ int ip_route_output_key(struct rtable **rp, const struct rt_key *key)
 			dst_hold(&rth->u.dst);
 			rth->u.dst.__use++;
 			rt_cache_stat[smp_processor_id()].out_hit++;
-			read_unlock_bh(&rt_hash_table[hash].lock);
+			read_unlock(&rt_hash_table[hash].lock);
+			br_read_unlock_bh(BR_RT_CACHE_LOCK);
 			*rp = rth;
 			return 0;
 		}
 		rt_cache_stat[smp_processor_id()].out_hlist_search++;
 	}
-	read_unlock_bh(&rt_hash_table[hash].lock);
+	read_unlock(&rt_hash_table[hash].lock);
+	br_read_unlock_bh(BR_RT_CACHE_LOCK);
 
 	return ip_route_output_slow(rp, key);
 }	
@@ -2278,11 +2532,12 @@ int ip_rt_dump(struct sk_buff *skb,  struct netlink_callback *cb)
 
 	s_h = cb->args[0];
 	s_idx = idx = cb->args[1];
+	br_read_lock_bh(BR_RT_CACHE_LOCK);
 	for (h = 0; h <= rt_hash_mask; h++) {
 		if (h < s_h) continue;
 		if (h > s_h)
 			s_idx = 0;
-		read_lock_bh(&rt_hash_table[h].lock);
+		read_lock(&rt_hash_table[h].lock);
 		for (rt = rt_hash_table[h].chain, idx = 0; rt;
 		     rt = rt->u.rt_next, idx++) {
 			if (idx < s_idx)
@@ -2292,15 +2547,16 @@ int ip_rt_dump(struct sk_buff *skb,  struct netlink_callback *cb)
 					 cb->nlh->nlmsg_seq,
 					 RTM_NEWROUTE, 1) <= 0) {
 				dst_release(xchg(&skb->dst, NULL));
-				read_unlock_bh(&rt_hash_table[h].lock);
+				read_unlock(&rt_hash_table[h].lock);
 				goto done;
 			}
 			dst_release(xchg(&skb->dst, NULL));
 		}
-		read_unlock_bh(&rt_hash_table[h].lock);
+		read_unlock(&rt_hash_table[h].lock);
 	}
 
 done:
+	br_read_unlock_bh(BR_RT_CACHE_LOCK);
 	cb->args[0] = h;
 	cb->args[1] = idx;
 	return skb->len;
@@ -2327,6 +2583,31 @@ static int ipv4_sysctl_rtcache_flush(ctl_table *ctl, int write,
 	return -EINVAL;
 }
 
+static int ip_rt_hash_buckets;
+static DECLARE_MUTEX(rt_hash_resize_sem);
+
+static int ipv4_sysctl_rt_hash_buckets(ctl_table *ctl, int write,
+				       struct file *filp, void *buffer,
+				       size_t *lenp)
+{
+	int size, log, ret;
+
+	down(&rt_hash_resize_sem);
+	ip_rt_hash_buckets = rt_hash_mask + 1;
+	ret = proc_dointvec(ctl, write, filp, buffer, lenp);
+	if (write && ret == 0) {
+		size = ip_rt_hash_buckets;
+		for (log = 0; (1 << log) < size && log < 30; log++)
+			/* NOTHING */;
+		if (size < 16 || (1 << log) != size)
+			ret = -EINVAL;
+		else if (log != rt_hash_log)
+			ret = rt_hash_resize(log);
+	}
+	up(&rt_hash_resize_sem);
+	return ret;
+}
+
 static int ipv4_sysctl_rtcache_flush_strategy(ctl_table *table, int *name,
 						int nlen, void *oldval,
 						size_t *oldlenp, void *newval,
@@ -2493,6 +2774,22 @@ ctl_table ipv4_route_table[] = {
 		mode:		0644,
 		proc_handler:	&proc_dointvec_jiffies,
 		strategy:	&sysctl_jiffies,
+	},
+	{
+		ctl_name:	NET_IPV4_ROUTE_GC_BUDGET,
+		procname:	"gc_budget_us",
+		data:		&ip_rt_gc_budget,
+		maxlen:		sizeof(int),
+		mode:		0644,
+		proc_handler:	&proc_dointvec,
+	},
+	{
+		ctl_name:	NET_IPV4_ROUTE_HASH_BUCKETS,
+		procname:	"hash_buckets",
+		data:		&ip_rt_hash_buckets,
+		maxlen:		sizeof(int),
+		mode:		0644,
+		proc_handler:	&ipv4_sysctl_rt_hash_buckets,
 	},
 	 { 0 }
 };
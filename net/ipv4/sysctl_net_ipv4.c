@@ -73,6 +73,29 @@ int ipv4_sysctl_forward(ctl_table *ctl, int write, struct file * filp,
 	return ret;
 }
 
+static int tcp_ehash_buckets;
+static DECLARE_MUTEX(tcp_ehash_resize_sem);
+
+static int ipv4_sysctl_tcp_ehash_buckets(ctl_table *ctl, int write,
+					 struct file *filp, void *buffer,
+					 size_t *lenp)
+{
+	int ret;
+
+	down(&tcp_ehash_resize_sem);
+	tcp_ehash_buckets = tcp_ehash_size;
+	ret = proc_dointvec(ctl, write, filp, buffer, lenp);
+	if (write && ret == 0) {
+		if (tcp_ehash_buckets < 16 || tcp_ehash_buckets > TCP_EHASH_MAX_SIZE ||
+		    (tcp_ehash_buckets & (tcp_ehash_buckets - 1)))
+			ret = -EINVAL;
+		else if (tcp_ehash_buckets != tcp_ehash_size)
+			ret = tcp_ehash_resize(tcp_ehash_buckets);
+	}
+	up(&tcp_ehash_resize_sem);
+	return ret;
+}
+
 static int ipv4_sysctl_forward_strategy(ctl_table *table, int *name, int nlen,
 			 void *oldval, size_t *oldlenp,
 			 void *newval, size_t newlen, 
@@ -229,6 +252,11 @@ ctl_table ipv4_table[] = {
 	{NET_IPV4_IPFRAG_SECRET_INTERVAL, "ipfrag_secret_interval",
 	 &sysctl_ipfrag_secret_interval, sizeof(int), 0644, NULL, &proc_dointvec_jiffies, 
 	 &sysctl_jiffies},
+	{NET_TCP_GSO_SEGS, "tcp_gso_segs",
+	 &sysctl_tcp_gso_segs, sizeof(int), 0644, NULL, &proc_dointvec},
+	{NET_TCP_EHASH_BUCKETS, "tcp_ehash_buckets",
+	 &tcp_ehash_buckets, sizeof(int), 0644, NULL,
+	 &ipv4_sysctl_tcp_ehash_buckets},
 	{0}
 };
 
@@ -2530,6 +2530,170 @@ int tcp_getsockopt(struct sock *sk, int level, int optname, char *optval,
 }
 
 
+/* Smallest page order that holds @entries hash buckets of @size bytes. */
+static int tcp_hash_order(unsigned long entries, unsigned long size)
+{
+	int order;
+
+	for (order = 0; order < MAX_ORDER - 1; order++)
+		if ((PAGE_SIZE << order) / size >= entries)
+			break;
+	return order;
+}
+
+static int tcp_ehash_order;
+
+/* Rehash the established and TIME_WAIT halves into a table of @size
+ * (a power of two) buckets each.  Entries carry their full hash in
+ * ->hashent, so each is just moved to its new chain.  The caller
+ * serializes resizes.
+ */
+int tcp_ehash_resize(int size)
+{
+	struct tcp_ehash_bucket *new, *old;
+	int order, old_order, old_size, i;
+
+	if (size <= 0 || size > TCP_EHASH_MAX_SIZE)
+		return -EINVAL;
+	order = tcp_hash_order(size << 1, sizeof(struct tcp_ehash_bucket));
+	if ((PAGE_SIZE << order) / sizeof(struct tcp_ehash_bucket) < (size << 1))
+		return -EINVAL;
+	new = (struct tcp_ehash_bucket *)__get_free_pages(GFP_KERNEL, order);
+	if (new == NULL)
+		return -ENOMEM;
+	for (i = 0; i < (size<<1); i++) {
+		new[i].lock = RW_LOCK_UNLOCKED;
+		new[i].chain = NULL;
+	}
+
+	br_write_lock_bh(BR_TCP_EHASH_LOCK);
+	old = tcp_ehash;
+	old_size = tcp_ehash_size;
+	old_order = tcp_ehash_order;
+
+	for (i = 0; i < (old_size<<1); i++) {
+		struct tcp_ehash_bucket *head;
+		struct sock *sk;
+		int hash;
+
+		while ((sk = old[i].chain) != NULL) {
+			old[i].chain = sk->next;
+			if (i < old_size) {
+				hash = sk->hashent & (size - 1);
+			} else {
+				hash = ((struct tcp_tw_bucket *)sk)->hashent;
+				hash = (hash & (size - 1)) + size;
+			}
+			head = &new[hash];
+			if ((sk->next = head->chain) != NULL)
+				head->chain->pprev = &sk->next;
+			head->chain = sk;
+			sk->pprev = &head->chain;
+		}
+	}
+
+	tcp_ehash = new;
+	tcp_ehash_size = size;
+	tcp_ehash_order = order;
+	br_write_unlock_bh(BR_TCP_EHASH_LOCK);
+
+	free_pages((unsigned long)old, old_order);
+	return 0;
+}
+
+/* Occupancy of one half of the established hash or of the bind hash. */
+struct tcp_hash_stat {
+	unsigned int used;
+	unsigned int entries;
+	unsigned int max_chain;
+};
+
+static void tcp_hash_stat_add(struct tcp_hash_stat *st, unsigned int chain)
+{
+	if (chain) {
+		st->used++;
+		st->entries += chain;
+		if (chain > st->max_chain)
+			st->max_chain = chain;
+	}
+}
+
+int tcp_hash_get_info(char *buffer, char **start, off_t offset, int length)
+{
+	struct tcp_hash_stat est, tw, bind;
+	int i, len, size;
+
+	memset(&est, 0, sizeof(est));
+	memset(&tw, 0, sizeof(tw));
+	memset(&bind, 0, sizeof(bind));
+
+	br_read_lock_bh(BR_TCP_EHASH_LOCK);
+	size = tcp_ehash_size;
+	for (i = 0; i < size; i++) {
+		struct tcp_ehash_bucket *head = &tcp_ehash[i];
+		unsigned int n;
+		struct sock *sk;
+
+		read_lock(&head->lock);
+		for (n = 0, sk = head->chain; sk; sk = sk->next)
+			n++;
+		tcp_hash_stat_add(&est, n);
+		for (n = 0, sk = (head + size)->chain; sk; sk = sk->next)
+			n++;
+		tcp_hash_stat_add(&tw, n);
+		read_unlock(&head->lock);
+	}
+	br_read_unlock_bh(BR_TCP_EHASH_LOCK);
+
+	for (i = 0; i < tcp_bhash_size; i++) {
+		struct tcp_bind_hashbucket *head = &tcp_bhash[i];
+		struct tcp_bind_bucket *tb;
+		unsigned int n = 0;
+
+		spin_lock_bh(&head->lock);
+		for (tb = head->chain; tb; tb = tb->next)
+			n++;
+		spin_unlock_bh(&head->lock);
+		tcp_hash_stat_add(&bind, n);
+	}
+
+	len = sprintf(buffer, "table       buckets     used  entries max_chain\n");
+	len += sprintf(buffer+len, "established %7d %8u %8u %9u\n",
+		       size, est.used, est.entries, est.max_chain);
+	len += sprintf(buffer+len, "timewait    %7d %8u %8u %9u\n",
+		       size, tw.used, tw.entries, tw.max_chain);
+	len += sprintf(buffer+len, "bind        %7d %8u %8u %9u\n",
+		       tcp_bhash_size, bind.used, bind.entries, bind.max_chain);
+	len += sprintf(buffer+len, "tw_scheduled %d\n", tcp_tw_count);
+
+	len -= offset;
+	if (len > length)
+		len = length;
+	if (len < 0)
+		len = 0;
+	*start = buffer + offset;
+	return len;
+}
+
+/* Boot time overrides of the hash table sizes, in buckets. */
+static unsigned long tcp_ehash_entries __initdata;
+static unsigned long tcp_bhash_entries __initdata;
+
+static int __init tcp_ehash_entries_setup(char *str)
+{
+	tcp_ehash_entries = simple_strtoul(str, NULL, 0);
+	return 1;
+}
+
+static int __init tcp_bhash_entries_setup(char *str)
+{
+	tcp_bhash_entries = simple_strtoul(str, NULL, 0);
+	return 1;
+}
+
+__setup("tcp_ehash_entries=", tcp_ehash_entries_setup);
+__setup("tcp_bhash_entries=", tcp_bhash_entries_setup);
+
 extern void __skb_cb_too_small_for_tcp(int, int);
 extern void tcpdiag_init(void);
 
@@ -2537,7 +2701,7 @@ void __init tcp_init(void)
 {
 	struct sk_buff *skb = NULL;
 	unsigned long goal;
-	int order, i;
+	int order, eorder, border, i;
 
 	if(sizeof(struct tcp_skb_cb) > sizeof(skb->cb))
 		__skb_cb_too_small_for_tcp(sizeof(struct tcp_skb_cb),
@@ -2576,34 +2740,58 @@ void __init tcp_init(void)
 
 	for(order = 0; (1UL << order) < goal; order++)
 		;
+
+	/* The "tcp_ehash_entries=" and "tcp_bhash_entries=" boot options
+	 * override the sizes; the defaults below still follow memory.
+	 */
+	eorder = order;
+	if (tcp_ehash_entries)
+		eorder = tcp_hash_order(tcp_ehash_entries << 1,
+					sizeof(struct tcp_ehash_bucket));
 	do {
-		tcp_ehash_size = (1UL << order) * PAGE_SIZE /
+		tcp_ehash_size = (1UL << eorder) * PAGE_SIZE /
 			sizeof(struct tcp_ehash_bucket);
 		tcp_ehash_size >>= 1;
 		while (tcp_ehash_size & (tcp_ehash_size-1))
 			tcp_ehash_size--;
 		tcp_ehash = (struct tcp_ehash_bucket *)
-			__get_free_pages(GFP_ATOMIC, order);
-	} while (tcp_ehash == NULL && --order > 0);
+			__get_free_pages(GFP_ATOMIC, eorder);
+	} while (tcp_ehash == NULL && --eorder > 0);
 
 	if (!tcp_ehash)
 		panic("Failed to allocate TCP established hash table\n");
+	while (tcp_ehash_entries && tcp_ehash_size > 16 &&
+	       (tcp_ehash_size >> 1) >= tcp_ehash_entries)
+		tcp_ehash_size >>= 1;
 	for (i = 0; i < (tcp_ehash_size<<1); i++) {
 		tcp_ehash[i].lock = RW_LOCK_UNLOCKED;
 		tcp_ehash[i].chain = NULL;
 	}
-
+	tcp_ehash_order = eorder;
+	if (!tcp_ehash_entries)
+		order = eorder;
+
+	border = order;
+	if (tcp_bhash_entries)
+		border = tcp_hash_order(tcp_bhash_entries,
+					sizeof(struct tcp_bind_hashbucket));
 	do {
-		tcp_bhash_size = (1UL << order) * PAGE_SIZE /
+		tcp_bhash_size = (1UL << border) * PAGE_SIZE /
 			sizeof(struct tcp_bind_hashbucket);
-		if ((tcp_bhash_size > (64 * 1024)) && order > 0)
+		if (!tcp_bhash_entries &&
+		    (tcp_bhash_size > (64 * 1024)) && border > 0)
 			continue;
 		tcp_bhash = (struct tcp_bind_hashbucket *)
-			__get_free_pages(GFP_ATOMIC, order);
-	} while (tcp_bhash == NULL && --order >= 0);
+			__get_free_pages(GFP_ATOMIC, border);
+	} while (tcp_bhash == NULL && --border >= 0);
 
 	if (!tcp_bhash)
 		panic("Failed to allocate TCP bind hash table\n");
+	while (tcp_bhash_entries && tcp_bhash_size > 16 &&
+	       (tcp_bhash_size >> 1) >= tcp_bhash_entries)
+		tcp_bhash_size >>= 1;
+	if (!tcp_bhash_entries)
+		order = border;
 	for (i = 0; i < tcp_bhash_size; i++) {
 		tcp_bhash[i].lock = SPIN_LOCK_UNLOCKED;
 		tcp_bhash[i].chain = NULL;
@@ -477,14 +477,21 @@ skip_listen_ht:
 	if (!(r->tcpdiag_states&~(TCPF_LISTEN|TCPF_SYN_RECV)))
 		return skb->len;
 
-	for (i = s_i; i < tcp_ehash_size; i++) {
-		struct tcp_ehash_bucket *head = &tcp_ehash[i];
+	for (i = s_i; ; i++) {
+		struct tcp_ehash_bucket *head;
 		struct sock *sk;
 
 		if (i > s_i)
 			s_num = 0;
 
-		read_lock_bh(&head->lock);
+		/* The table may be resized between buckets. */
+		br_read_lock_bh(BR_TCP_EHASH_LOCK);
+		if (i >= tcp_ehash_size) {
+			br_read_unlock_bh(BR_TCP_EHASH_LOCK);
+			break;
+		}
+		head = &tcp_ehash[i];
+		read_lock(&head->lock);
 
 		for (sk = head->chain, num = 0;
 		     sk != NULL;
@@ -502,7 +509,8 @@ skip_listen_ht:
 			if (tcpdiag_fill(skb, sk, r->tcpdiag_ext,
 					 NETLINK_CB(cb->skb).pid,
 					 cb->nlh->nlmsg_seq) <= 0) {
-				read_unlock_bh(&head->lock);
+				read_unlock(&head->lock);
+				br_read_unlock_bh(BR_TCP_EHASH_LOCK);
 				goto done;
 			}
 		}
@@ -524,12 +532,14 @@ skip_listen_ht:
 				if (tcpdiag_fill(skb, sk, r->tcpdiag_ext,
 						 NETLINK_CB(cb->skb).pid,
 						 cb->nlh->nlmsg_seq) <= 0) {
-					read_unlock_bh(&head->lock);
+					read_unlock(&head->lock);
+					br_read_unlock_bh(BR_TCP_EHASH_LOCK);
 					goto done;
 				}
 			}
 		}
-		read_unlock_bh(&head->lock);
+		read_unlock(&head->lock);
+		br_read_unlock_bh(BR_TCP_EHASH_LOCK);
 	}
 
 done:
@@ -113,7 +113,7 @@ static __inline__ int tcp_hashfn(__u32 laddr, __u16 lport,
 	int h = ((laddr ^ lport) ^ (faddr ^ fport));
 	h ^= h>>16;
 	h ^= h>>8;
-	return h & (tcp_ehash_size - 1);
+	return h;
 }
 
 static __inline__ int tcp_sk_hashfn(struct sock *sk)
@@ -362,8 +362,12 @@ static __inline__ void __tcp_v4_hash(struct sock *sk, const int listen_possible)
 		lock = &tcp_lhash_lock;
 		tcp_listen_wlock();
 	} else {
-		skp = &tcp_ehash[(sk->hashent = tcp_sk_hashfn(sk))].chain;
-		lock = &tcp_ehash[sk->hashent].lock;
+		struct tcp_ehash_bucket *head;
+
+		br_read_lock(BR_TCP_EHASH_LOCK);
+		head = tcp_ehash_head(sk->hashent = tcp_sk_hashfn(sk));
+		skp = &head->chain;
+		lock = &head->lock;
 		write_lock(lock);
 	}
 	if((sk->next = *skp) != NULL)
@@ -374,6 +378,8 @@ static __inline__ void __tcp_v4_hash(struct sock *sk, const int listen_possible)
 	write_unlock(lock);
 	if (listen_possible && sk->state == TCP_LISTEN)
 		wake_up(&tcp_lhash_wait);
+	else
+		br_read_unlock(BR_TCP_EHASH_LOCK);
 }
 
 static void tcp_v4_hash(struct sock *sk)
@@ -392,14 +398,17 @@ void tcp_unhash(struct sock *sk)
 	if (!sk->pprev)
 		goto ende;
 
+	local_bh_disable();
 	if (sk->state == TCP_LISTEN) {
-		local_bh_disable();
 		tcp_listen_wlock();
 		lock = &tcp_lhash_lock;
 	} else {
-		struct tcp_ehash_bucket *head = &tcp_ehash[sk->hashent];
+		struct tcp_ehash_bucket *head;
+
+		br_read_lock(BR_TCP_EHASH_LOCK);
+		head = tcp_ehash_head(sk->hashent);
 		lock = &head->lock;
-		write_lock_bh(&head->lock);
+		write_lock(&head->lock);
 	}
 
 	if(sk->pprev) {
@@ -409,7 +418,10 @@ void tcp_unhash(struct sock *sk)
 		sk->pprev = NULL;
 		sock_prot_dec_use(sk->prot);
 	}
-	write_unlock_bh(lock);
+	write_unlock(lock);
+	if (sk->state != TCP_LISTEN)
+		br_read_unlock(BR_TCP_EHASH_LOCK);
+	local_bh_enable();
 
  ende:
 	if (sk->state == TCP_LISTEN)
@@ -501,7 +513,8 @@ static inline struct sock *__tcp_v4_lookup_established(u32 saddr, u16 sport,
 	 * have wildcards anyways.
 	 */
 	hash = tcp_hashfn(daddr, hnum, saddr, sport);
-	head = &tcp_ehash[hash];
+	br_read_lock(BR_TCP_EHASH_LOCK);
+	head = tcp_ehash_head(hash);
 	read_lock(&head->lock);
 	for(sk = head->chain; sk; sk = sk->next) {
 		if(TCP_IPV4_MATCH(sk, acookie, saddr, daddr, ports, dif))
@@ -513,12 +526,14 @@ static inline struct sock *__tcp_v4_lookup_established(u32 saddr, u16 sport,
 		if(TCP_IPV4_MATCH(sk, acookie, saddr, daddr, ports, dif))
 			goto hit;
 	read_unlock(&head->lock);
+	br_read_unlock(BR_TCP_EHASH_LOCK);
 
 	return NULL;
 
 hit:
 	sock_hold(sk);
 	read_unlock(&head->lock);
+	br_read_unlock(BR_TCP_EHASH_LOCK);
 	return sk;
 }
 
@@ -564,10 +579,12 @@ static int __tcp_v4_check_established(struct sock *sk, __u16 lport,
 	TCP_V4_ADDR_COOKIE(acookie, saddr, daddr)
 	__u32 ports = TCP_COMBINED_PORTS(sk->dport, lport);
 	int hash = tcp_hashfn(daddr, lport, saddr, sk->dport);
-	struct tcp_ehash_bucket *head = &tcp_ehash[hash];
+	struct tcp_ehash_bucket *head;
 	struct sock *sk2, **skp;
 	struct tcp_tw_bucket *tw;
 
+	br_read_lock(BR_TCP_EHASH_LOCK);
+	head = tcp_ehash_head(hash);
 	write_lock(&head->lock);
 
 	/* Check TIME-WAIT sockets first. */
@@ -628,6 +645,7 @@ unique:
 	sk->hashent = hash;
 	sock_prot_inc_use(sk->prot);
 	write_unlock(&head->lock);
+	br_read_unlock(BR_TCP_EHASH_LOCK);
 
 	if (twp) {
 		*twp = tw;
@@ -645,6 +663,7 @@ unique:
 
 not_unique:
 	write_unlock(&head->lock);
+	br_read_unlock(BR_TCP_EHASH_LOCK);
 	return -EADDRNOTAVAIL;
 }
 
@@ -1142,6 +1161,55 @@ void tcp_v4_send_check(struct sock *sk, struct tcphdr *th, int len,
 	}
 }
 
+/*
+ *	Cut a TCP super-packet built by tcp_write_xmit() into MSS-sized
+ *	segments for a device that cannot do it itself.  Each segment
+ *	gets its own IP length, ID and checksum, sequence number and TCP
+ *	checksum; PSH and FIN stay on the last segment, CWR on the first.
+ *	@sw_csum is set when the device cannot checksum the segments.
+ *	Returns the list of segments or NULL; the caller frees @skb.
+ */
+struct sk_buff *tcp_v4_gso_segment(struct sk_buff *skb, int sw_csum)
+{
+	struct sk_buff *segs, *seg;
+	struct iphdr *iph = skb->nh.iph;
+	struct tcphdr *th = skb->h.th;
+	unsigned int nhoff = skb->nh.raw - skb->data;
+	unsigned int thoff = skb->h.raw - skb->data;
+	unsigned int hlen = thoff + (th->doff << 2);
+	u32 seq = ntohl(th->seq);
+	u16 id = ntohs(iph->id);
+
+	segs = skb_segment(skb, hlen, skb_shinfo(skb)->gso_size, sw_csum);
+
+	for (seg = segs; seg; seg = seg->next) {
+		unsigned int len = seg->len - thoff;
+
+		iph = seg->nh.iph;
+		iph->tot_len = htons(seg->len - nhoff);
+		iph->id = htons(id++);
+		ip_send_check(iph);
+
+		th = seg->h.th;
+		th->seq = htonl(seq);
+		seq += seg->len - hlen;
+		if (seg != segs)
+			th->cwr = 0;
+		if (seg->next)
+			th->psh = th->fin = 0;
+
+		if (seg->ip_summed == CHECKSUM_HW) {
+			th->check = ~tcp_v4_check(th, len, iph->saddr, iph->daddr, 0);
+			seg->csum = offsetof(struct tcphdr, check);
+		} else {
+			th->check = 0;
+			th->check = tcp_v4_check(th, len, iph->saddr, iph->daddr,
+						 csum_partial((char *)th, th->doff<<2, seg->csum));
+		}
+	}
+	return segs;
+}
+
 /*
  *	This routine will send an RST to the other tcp.
  *
@@ -2235,6 +2303,7 @@ skip_listen:
 	tcp_listen_unlock();
 
 	local_bh_disable();
+	br_read_lock(BR_TCP_EHASH_LOCK);
 
 	/* Next, walk established hash chain. */
 	for (i = 0; i < tcp_ehash_size; i++) {
@@ -2275,6 +2344,7 @@ skip_listen:
 	}
 
 out:
+	br_read_unlock(BR_TCP_EHASH_LOCK);
 	local_bh_enable();
 out_no_bh:
 
@@ -60,10 +60,12 @@ void tcp_timewait_kill(struct tcp_tw_bucket *tw)
 	struct tcp_bind_bucket *tb;
 
 	/* Unlink from established hashes. */
-	ehead = &tcp_ehash[tw->hashent];
+	br_read_lock(BR_TCP_EHASH_LOCK);
+	ehead = tcp_ehash_head(tw->hashent);
 	write_lock(&ehead->lock);
 	if (!tw->pprev) {
 		write_unlock(&ehead->lock);
+		br_read_unlock(BR_TCP_EHASH_LOCK);
 		return;
 	}
 	if(tw->next)
@@ -71,6 +73,7 @@ void tcp_timewait_kill(struct tcp_tw_bucket *tw)
 	*(tw->pprev) = tw->next;
 	tw->pprev = NULL;
 	write_unlock(&ehead->lock);
+	br_read_unlock(BR_TCP_EHASH_LOCK);
 
 	/* Disassociate with bind bucket. */
 	bhead = &tcp_bhash[tcp_bhashfn(tw->num)];
@@ -299,7 +302,7 @@ kill:
  */
 static void __tcp_tw_hashdance(struct sock *sk, struct tcp_tw_bucket *tw)
 {
-	struct tcp_ehash_bucket *ehead = &tcp_ehash[sk->hashent];
+	struct tcp_ehash_bucket *ehead;
 	struct tcp_bind_hashbucket *bhead;
 	struct sock **head, *sktw;
 
@@ -317,6 +320,8 @@ static void __tcp_tw_hashdance(struct sock *sk, struct tcp_tw_bucket *tw)
 	tw->bind_pprev = &tw->tb->owners;
 	spin_unlock(&bhead->lock);
 
+	br_read_lock(BR_TCP_EHASH_LOCK);
+	ehead = tcp_ehash_head(sk->hashent);
 	write_lock(&ehead->lock);
 
 	/* Step 2: Remove SK from established hash. */
@@ -338,6 +343,7 @@ static void __tcp_tw_hashdance(struct sock *sk, struct tcp_tw_bucket *tw)
 	atomic_inc(&tw->refcnt);
 
 	write_unlock(&ehead->lock);
+	br_read_unlock(BR_TCP_EHASH_LOCK);
 }
 
 /* 
@@ -420,8 +426,15 @@ void tcp_time_wait(struct sock *sk, int state, int timeo)
 	tcp_done(sk);
 }
 
-/* Kill off TIME_WAIT sockets once their lifetime has expired. */
+/* Kill off TIME_WAIT sockets once their lifetime has expired.
+ *
+ * The slot that falls due every TCP_TWKILL_PERIOD can hold tens of
+ * thousands of buckets on a busy server, so it is drained at most
+ * TCP_TWKILL_QUOTA buckets per tick rather than in one burst.
+ * tcp_tw_slot_due is when the next slot is due.
+ */
 static int tcp_tw_death_row_slot = 0;
+static unsigned long tcp_tw_slot_due;
 
 static void tcp_twkill(unsigned long);
 
@@ -445,7 +458,8 @@ static void SMP_TIMER_NAME(tcp_twkill)(unsigned long dummy)
 	if (tcp_tw_count == 0)
 		goto out;
 
-	while((tw = tcp_tw_death_row[tcp_tw_death_row_slot]) != NULL) {
+	while (killed < TCP_TWKILL_QUOTA &&
+	       (tw = tcp_tw_death_row[tcp_tw_death_row_slot]) != NULL) {
 		tcp_tw_death_row[tcp_tw_death_row_slot] = tw->next_death;
 		if (tw->next_death)
 			tw->next_death->pprev_death = tw->pprev_death;
@@ -459,11 +473,20 @@ static void SMP_TIMER_NAME(tcp_twkill)(unsigned long dummy)
 
 		spin_lock(&tw_death_lock);
 	}
-	tcp_tw_death_row_slot =
-		((tcp_tw_death_row_slot + 1) & (TCP_TWKILL_SLOTS - 1));
 
-	if ((tcp_tw_count -= killed) != 0)
-		mod_timer(&tcp_tw_timer, jiffies+TCP_TWKILL_PERIOD);
+	tcp_tw_count -= killed;
+	if (tcp_tw_death_row[tcp_tw_death_row_slot] != NULL) {
+		/* Over quota, carry on with this slot next tick. */
+		mod_timer(&tcp_tw_timer, jiffies+1);
+	} else {
+		tcp_tw_death_row_slot =
+			((tcp_tw_death_row_slot + 1) & (TCP_TWKILL_SLOTS - 1));
+		tcp_tw_slot_due += TCP_TWKILL_PERIOD;
+		if (time_before_eq(tcp_tw_slot_due, jiffies))
+			tcp_tw_slot_due = jiffies + 1;
+		if (tcp_tw_count != 0)
+			mod_timer(&tcp_tw_timer, tcp_tw_slot_due);
+	}
 	net_statistics[smp_processor_id()*2].TimeWaited += killed;
 out:
 	spin_unlock(&tw_death_lock);
@@ -575,8 +598,10 @@ void tcp_tw_schedule(struct tcp_tw_bucket *tw, int timeo)
 	*tpp = tw;
 	tw->pprev_death = tpp;
 
-	if (tcp_tw_count++ == 0)
-		mod_timer(&tcp_tw_timer, jiffies+TCP_TWKILL_PERIOD);
+	if (tcp_tw_count++ == 0) {
+		tcp_tw_slot_due = jiffies+TCP_TWKILL_PERIOD;
+		mod_timer(&tcp_tw_timer, tcp_tw_slot_due);
+	}
 	spin_unlock(&tw_death_lock);
 }
 
@@ -37,6 +37,7 @@
  */
 
 #include <net/tcp.h>
+#include <linux/netfilter_ipv4.h>
 
 #include <linux/compiler.h>
 #include <linux/smp_lock.h>
@@ -44,6 +45,9 @@
 /* People can turn this off for buggy TCP's found in printers etc. */
 int sysctl_tcp_retrans_collapse = 1;
 
+/* Most full-sized segments sent as one super-packet, 0 or 1 is off. */
+int sysctl_tcp_gso_segs = 44;
+
 static __inline__
 void update_send_head(struct sock *sk, struct tcp_opt *tp, struct sk_buff *skb)
 {
@@ -273,7 +277,10 @@ int tcp_transmit_skb(struct sock *sk, struct sk_buff *skb)
 		if (skb->len != tcp_header_size)
 			tcp_event_data_sent(tp, skb);
 
-		TCP_INC_STATS(TcpOutSegs);
+		if (skb_shinfo(skb)->gso_segs)
+			TCP_ADD_STATS(TcpOutSegs, skb_shinfo(skb)->gso_segs);
+		else
+			TCP_INC_STATS(TcpOutSegs);
 
 		err = tp->af_specific->queue_xmit(skb, 0);
 		if (err <= 0)
@@ -536,6 +543,97 @@ int tcp_sync_mss(struct sock *sk, u32 pmtu)
 }
 
 
+/* A super-packet must still fit an IPv4 datagram with all headers. */
+#define TCP_GSO_MAX_PAYLOAD	(65535 - MAX_TCP_HEADER)
+
+/* Can this connection hand super-packets to IP?  They are cut up by
+ * the device layer, so they must go to IPv4 with DF set; urgent data
+ * needs a pointer per segment, and netfilter would linearize them.
+ */
+static inline int tcp_gso_ok(struct sock *sk, struct tcp_opt *tp)
+{
+	struct dst_entry *dst = __sk_dst_get(sk);
+
+	if (sysctl_tcp_gso_segs < 2 || sk->family != AF_INET ||
+	    tp->urg_mode || dst == NULL || !ip_dont_fragment(sk, dst))
+		return 0;
+#ifdef CONFIG_NETFILTER
+	if (!list_empty(&nf_hooks[PF_INET][NF_IP_LOCAL_OUT]) ||
+	    !list_empty(&nf_hooks[PF_INET][NF_IP_POST_ROUTING]))
+		return 0;
+#endif
+	return 1;
+}
+
+/* Send the run of full-sized data segments starting at send_head, as far
+ * as the congestion and send windows allow, as one super-packet whose
+ * payload is a frag_list of clones.  TCP_SKB_CB(skb)->when is set on
+ * each.  Returns the number of segments sent, 0 if they should be sent
+ * one at a time instead, or -1 if the packet was not sent.
+ */
+static int tcp_gso_xmit(struct sock *sk, struct tcp_opt *tp,
+			unsigned int mss_now)
+{
+	struct sk_buff *skb = tp->send_head;
+	struct sk_buff *head, *clone, **tail;
+	unsigned int max_segs, segs, i;
+
+	max_segs = TCP_GSO_MAX_PAYLOAD / mss_now;
+	if (max_segs > sysctl_tcp_gso_segs)
+		max_segs = sysctl_tcp_gso_segs;
+	if (max_segs > tp->snd_cwnd - tcp_packets_in_flight(tp))
+		max_segs = tp->snd_cwnd - tcp_packets_in_flight(tp);
+
+	for (segs = 0; segs < max_segs; segs++, skb = skb->next) {
+		if (skb == (struct sk_buff *)&sk->write_queue ||
+		    skb->len != mss_now ||
+		    (TCP_SKB_CB(skb)->flags &
+		     (TCPCB_FLAG_SYN|TCPCB_FLAG_FIN|TCPCB_FLAG_URG)) ||
+		    after(TCP_SKB_CB(skb)->end_seq, tp->snd_una + tp->snd_wnd))
+			break;
+	}
+	if (segs < 2)
+		return 0;
+
+	head = alloc_skb(MAX_TCP_HEADER, GFP_ATOMIC);
+	if (head == NULL)
+		return 0;
+	skb_reserve(head, MAX_TCP_HEADER);
+
+	skb = tp->send_head;
+	memcpy(head->cb, skb->cb, sizeof(skb->cb));
+	tail = &skb_shinfo(head)->frag_list;
+	for (i = 0; i < segs; i++, skb = skb->next) {
+		TCP_SKB_CB(skb)->when = tcp_time_stamp;
+		clone = skb_clone(skb, GFP_ATOMIC);
+		if (clone == NULL) {
+			kfree_skb(head);
+			return 0;
+		}
+		*tail = clone;
+		tail = &clone->next;
+
+		head->len += clone->len;
+		head->data_len += clone->len;
+		head->truesize += clone->truesize;
+		TCP_SKB_CB(head)->flags |= TCP_SKB_CB(skb)->flags & TCPCB_FLAG_PSH;
+		TCP_SKB_CB(head)->end_seq = TCP_SKB_CB(skb)->end_seq;
+	}
+	TCP_SKB_CB(head)->when = tcp_time_stamp;
+
+	/* Segments get their own checksums when they are cut. */
+	head->ip_summed = CHECKSUM_HW;
+	skb_shinfo(head)->gso_size = mss_now;
+	skb_shinfo(head)->gso_segs = segs;
+
+	if (tcp_transmit_skb(sk, head))
+		return -1;
+
+	for (i = 0; i < segs; i++)
+		update_send_head(sk, tp, tp->send_head);
+	return segs;
+}
+
 /* This routine writes packets to the network.  It advances the
  * send_head.  This happens as incoming acks open up the remote
  * window for us.
@@ -555,6 +653,7 @@ int tcp_write_xmit(struct sock *sk, int nonagle)
 	if(sk->state != TCP_CLOSE) {
 		struct sk_buff *skb;
 		int sent_pkts = 0;
+		int gso;
 
 		/* Account for SACKS, we may need to fragment due to this.
 		 * It is just like the real MSS changing on us midstream.
@@ -562,6 +661,7 @@ int tcp_write_xmit(struct sock *sk, int nonagle)
 		 * IP options mid-stream.  Silly to do, but cover it.
 		 */
 		mss_now = tcp_current_mss(sk); 
+		gso = tcp_gso_ok(sk, tp);
 
 		while((skb = tp->send_head) &&
 		      tcp_snd_test(tp, skb, mss_now, tcp_skb_is_last(sk, skb) ? nonagle : 1)) {
@@ -570,6 +670,17 @@ int tcp_write_xmit(struct sock *sk, int nonagle)
 					break;
 			}
 
+			if (gso && skb->len == mss_now) {
+				int segs = tcp_gso_xmit(sk, tp, mss_now);
+
+				if (segs < 0)
+					break;
+				if (segs > 0) {
+					sent_pkts = 1;
+					continue;
+				}
+			}
+
 			TCP_SKB_CB(skb)->when = tcp_time_stamp;
 			if (tcp_transmit_skb(sk, skb_clone(skb, GFP_ATOMIC)))
 				break;
@@ -73,7 +73,7 @@ static __inline__ int tcp_v6_hashfn(struct in6_addr *laddr, u16 lport,
 	hashent ^= (laddr->s6_addr32[3] ^ faddr->s6_addr32[3]);
 	hashent ^= hashent>>16;
 	hashent ^= hashent>>8;
-	return (hashent & (tcp_ehash_size - 1));
+	return hashent;
 }
 
 static __inline__ int tcp_v6_sk_hashfn(struct sock *sk)
@@ -225,8 +225,12 @@ static __inline__ void __tcp_v6_hash(struct sock *sk)
 		lock = &tcp_lhash_lock;
 		tcp_listen_wlock();
 	} else {
-		skp = &tcp_ehash[(sk->hashent = tcp_v6_sk_hashfn(sk))].chain;
-		lock = &tcp_ehash[sk->hashent].lock;
+		struct tcp_ehash_bucket *head;
+
+		br_read_lock(BR_TCP_EHASH_LOCK);
+		head = tcp_ehash_head(sk->hashent = tcp_v6_sk_hashfn(sk));
+		skp = &head->chain;
+		lock = &head->lock;
 		write_lock(lock);
 	}
 
@@ -236,6 +240,8 @@ static __inline__ void __tcp_v6_hash(struct sock *sk)
 	sk->pprev = skp;
 	sock_prot_inc_use(sk->prot);
 	write_unlock(lock);
+	if (sk->state != TCP_LISTEN)
+		br_read_unlock(BR_TCP_EHASH_LOCK);
 }
 
 
@@ -311,7 +317,8 @@ static inline struct sock *__tcp_v6_lookup_established(struct in6_addr *saddr, u
 	 * have wildcards anyways.
 	 */
 	hash = tcp_v6_hashfn(daddr, hnum, saddr, sport);
-	head = &tcp_ehash[hash];
+	br_read_lock(BR_TCP_EHASH_LOCK);
+	head = tcp_ehash_head(hash);
 	read_lock(&head->lock);
 	for(sk = head->chain; sk; sk = sk->next) {
 		/* For IPV6 do the cheaper port and family tests first. */
@@ -330,11 +337,13 @@ static inline struct sock *__tcp_v6_lookup_established(struct in6_addr *saddr, u
 		}
 	}
 	read_unlock(&head->lock);
+	br_read_unlock(BR_TCP_EHASH_LOCK);
 	return NULL;
 
 hit:
 	sock_hold(sk);
 	read_unlock(&head->lock);
+	br_read_unlock(BR_TCP_EHASH_LOCK);
 	return sk;
 }
 
@@ -448,11 +457,13 @@ static int tcp_v6_check_established(struct sock *sk)
 	int dif = sk->bound_dev_if;
 	u32 ports = TCP_COMBINED_PORTS(sk->dport, sk->num);
 	int hash = tcp_v6_hashfn(daddr, sk->num, saddr, sk->dport);
-	struct tcp_ehash_bucket *head = &tcp_ehash[hash];
+	struct tcp_ehash_bucket *head;
 	struct sock *sk2, **skp;
 	struct tcp_tw_bucket *tw;
 
-	write_lock_bh(&head->lock);
+	br_read_lock_bh(BR_TCP_EHASH_LOCK);
+	head = tcp_ehash_head(hash);
+	write_lock(&head->lock);
 
 	for(skp = &(head + tcp_ehash_size)->chain; (sk2=*skp)!=NULL; skp = &sk2->next) {
 		tw = (struct tcp_tw_bucket*)sk2;
@@ -493,7 +504,8 @@ unique:
 	sk->pprev = skp;
 	sk->hashent = hash;
 	sock_prot_inc_use(sk->prot);
-	write_unlock_bh(&head->lock);
+	write_unlock(&head->lock);
+	br_read_unlock_bh(BR_TCP_EHASH_LOCK);
 
 	if (tw) {
 		/* Silly. Should hash-dance instead... */
@@ -508,7 +520,8 @@ unique:
 	return 0;
 
 not_unique:
-	write_unlock_bh(&head->lock);
+	write_unlock(&head->lock);
+	br_read_unlock_bh(BR_TCP_EHASH_LOCK);
 	return -EADDRNOTAVAIL;
 }
 
@@ -2070,6 +2083,7 @@ int tcp6_get_info(char *buffer, char **start, off_t offset, int length)
 	tcp_listen_unlock();
 
 	local_bh_disable();
+	br_read_lock(BR_TCP_EHASH_LOCK);
 
 	/* Next, walk established hash chain. */
 	for (i = 0; i < tcp_ehash_size; i++) {
@@ -2110,6 +2124,7 @@ int tcp6_get_info(char *buffer, char **start, off_t offset, int length)
 	}
 
 out:
+	br_read_unlock(BR_TCP_EHASH_LOCK);
 	local_bh_enable();
 out_no_bh:
 
@@ -32,8 +32,8 @@ Accept connections
 
 Purpose:
 
-AcceptConnections puts all "accepted" connections in the 
-"WaitForHeader" queue.
+AcceptConnections puts up to "accept_batch" newly accepted connections in the
+"WaitForHeader" queue and hooks their sockets to this thread.
 
 Return value:
 	The number of accepted connections
@@ -69,7 +69,7 @@ int AcceptConnections(const int CPUNR, struct socket *Socket)
 	}
 	
 	error = 0;	
-	while (error>=0)
+	while ((error>=0)&&(count<sysctl_khttpd_acceptbatch))
 	{
 		NewSock = sock_alloc();
 		if (NewSock==NULL)
@@ -107,14 +107,12 @@ int AcceptConnections(const int CPUNR, struct socket *Socket)
 		memset(NewRequest,0,sizeof(struct http_request));  
 		
 		NewRequest->sock = NewSock;
+		NewRequest->State = KHTTPD_WAITHEADERS;
+		do_gettimeofday(&NewRequest->Accepted);
 		
-		NewRequest->Next = threadinfo[CPUNR].WaitForHeaderQueue;
+		list_add(&NewRequest->List,&threadinfo[CPUNR].WaitForHeaderQueue);
 		
-		init_waitqueue_entry(&NewRequest->sleep,current);
-		
-		add_wait_queue(NewSock->sk->sleep,&(NewRequest->sleep));
-		
-		threadinfo[CPUNR].WaitForHeaderQueue = NewRequest;
+		AttachRequest(CPUNR,NewRequest);
 		
 		atomic_inc(&ConnectCount);
 
@@ -125,3 +123,17 @@ int AcceptConnections(const int CPUNR, struct socket *Socket)
 	LeaveFunction("AcceptConnections");
 	return count;
 }
+
+/*
+
+AcceptPending tells whether AcceptConnections would find something to do.
+
+*/
+int AcceptPending(struct socket *Socket)
+{
+	if ((Socket==NULL)||(Socket->sk==NULL))
+		return 0;
+	if (atomic_read(&ConnectCount)>sysctl_khttpd_maxconnect)
+		return 0;
+	return Socket->sk->tp_pinfo.af_tcp.accept_queue!=NULL;
+}
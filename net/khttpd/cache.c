@@ -0,0 +1,361 @@
+/*
+
+kHTTPd -- the next generation
+
+Open-file and header cache
+
+*/
+/****************************************************************
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2, or (at your option)
+ *	any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ ****************************************************************/
+
+/*
+
+Purpose:
+
+For a small file, most of the work of a request is looking up the filename,
+checking it against the security rules, finding the mime-type and formatting
+the header. The cache remembers all of that per URL: on a hit the request
+takes a reference on the already open file and sends the stored header.
+
+An entry is only used as long as the file is the same: its inode still has
+the mtime and size it had when the entry was made, the path of its dentry is
+still the decoded URL (so it was not deleted, renamed or renamed over) and
+its mode still passes the permission rules. Otherwise the entry is dropped
+and the request is handled as a miss. A URL that does not name the file
+directly, through a symlink or "//" for example, is not cached. Changing the dynamic strings
+or "sloppymime" empties the cache, and so does stopping kHTTPd.
+
+All threads share the cache, under one spinlock. Entries are charged for
+their own size plus the pages of the file they keep in use against
+"cache_size" kilobytes; the least recently used ones go first.
+
+*/
+
+#include <linux/config.h>
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/fs.h>
+#include <linux/file.h>
+#include <linux/dcache.h>
+#include <linux/sched.h>
+#include <linux/fs_struct.h>
+#include <linux/string.h>
+
+#include "structure.h"
+#include "prototypes.h"
+#include "sysctl.h"
+
+#define CACHE_HASH_SIZE	256
+
+static struct list_head	CacheHash[CACHE_HASH_SIZE];
+static LIST_HEAD(CacheLRU);
+static spinlock_t	CacheLock = SPIN_LOCK_UNLOCKED;
+static int		CacheBytes;
+static int		CacheEntries;
+
+static struct {
+	unsigned long	lookups;
+	unsigned long	hits;
+	unsigned long	stale;		/* Found, but the file had changed */
+	unsigned long	evictions;	/* Pushed out by cache_size */
+} CacheStats;
+
+static char HeaderFormat[] = "\r\nContent-type: %.*s\r\nLast-modified: %s\r\nContent-length: %s\r\n\r\n";
+
+
+void CachePut(struct khttpd_cache_entry *Entry)
+{
+	if (atomic_dec_and_test(&Entry->Count))
+	{
+		fput(Entry->filp);
+		kfree(Entry);
+	}
+}
+
+/* Takes the entry out of the cache. The cache's reference is for the caller to drop. */
+static void Unhash(struct khttpd_cache_entry *Entry)
+{
+	list_del(&Entry->Hash);
+	list_del(&Entry->LRU);
+	CacheBytes -= Entry->Size;
+	CacheEntries--;
+}
+
+/* Moves entries off the LRU end to Evicted until the cache fits in Limit bytes */
+static void ShrinkLocked(int Limit, struct list_head *Evicted)
+{
+	struct khttpd_cache_entry *Entry;
+
+	while ((CacheBytes>Limit)&&(!list_empty(&CacheLRU)))
+	{
+		Entry = list_entry(CacheLRU.prev,struct khttpd_cache_entry,LRU);
+		Unhash(Entry);
+		list_add(&Entry->LRU,Evicted);
+		CacheStats.evictions++;
+	}
+}
+
+/* fput() can sleep, so this is done after dropping the lock */
+static void ReleaseList(struct list_head *Evicted)
+{
+	struct khttpd_cache_entry *Entry;
+
+	while (!list_empty(Evicted))
+	{
+		Entry = list_entry(Evicted->next,struct khttpd_cache_entry,LRU);
+		list_del(&Entry->LRU);
+		CachePut(Entry);
+	}
+}
+
+/* PathMatches checks that Path, decoded, is still the name of the open file */
+static int PathMatches(struct file *filp, const char *Path)
+{
+	char Buffer[300];	/* OpenFileForSecurity allows 255 bytes */
+	char *Name;
+	int Match;
+
+	read_lock(&current->fs->lock);
+	spin_lock(&dcache_lock);
+	Name = __d_path(filp->f_dentry,filp->f_vfsmnt,
+			current->fs->root,current->fs->rootmnt,
+			Buffer,sizeof(Buffer));
+	Match = (!IS_ERR(Name))&&(strcmp(Name,Path)==0);
+	spin_unlock(&dcache_lock);
+	read_unlock(&current->fs->lock);
+
+	return Match;
+}
+
+static int EntryValid(struct khttpd_cache_entry *Entry)
+{
+	struct dentry *dentry = Entry->filp->f_dentry;
+	struct inode *inode = dentry->d_inode;
+
+	if ((inode->i_mtime!=Entry->Mtime)||(inode->i_size!=(loff_t)Entry->FileLength))
+		return 0;
+	if (d_unhashed(dentry))		/* Deleted or renamed over */
+		return 0;
+	if (!PathMatches(Entry->filp,Entry->Path))	/* Renamed */
+		return 0;
+	return FilePermitted(inode->i_mode);
+}
+
+
+/*
+
+CacheLookup looks for the URL in Request->FileName, before it is decoded.
+On a hit it fills in the file and everything the header needs, and returns 1.
+
+*/
+int CacheLookup(struct http_request *Request)
+{
+	struct khttpd_cache_entry *Entry;
+	struct list_head *Head,*l;
+	unsigned int hash;
+
+	EnterFunction("CacheLookup");
+
+	if (sysctl_khttpd_cachesize<=0)
+		return 0;
+
+	hash = full_name_hash(Request->FileName,strlen(Request->FileName));
+	Head = &CacheHash[hash % CACHE_HASH_SIZE];
+
+	spin_lock(&CacheLock);
+	CacheStats.lookups++;
+	list_for_each(l,Head)
+	{
+		Entry = list_entry(l,struct khttpd_cache_entry,Hash);
+		if ((Entry->HashValue!=hash)||(strcmp(Entry->URL,Request->FileName)!=0))
+			continue;
+
+		if (!EntryValid(Entry))
+		{
+			Unhash(Entry);
+			CacheStats.stale++;
+			spin_unlock(&CacheLock);
+			CachePut(Entry);
+			LeaveFunction("CacheLookup - stale");
+			return 0;
+		}
+
+		list_del(&Entry->LRU);
+		list_add(&Entry->LRU,&CacheLRU);
+		atomic_inc(&Entry->Count);
+		CacheStats.hits++;
+		spin_unlock(&CacheLock);
+
+		get_file(Entry->filp);
+		Request->filp       = Entry->filp;
+		Request->FileLength = Entry->FileLength;
+		Request->Time       = Entry->Mtime;
+		Request->MimeType   = Entry->MimeType;
+		Request->MimeLength = Entry->MimeLength;
+		Request->Cached     = Entry;
+
+		LeaveFunction("CacheLookup - hit");
+		return 1;
+	}
+	spin_unlock(&CacheLock);
+
+	LeaveFunction("CacheLookup - miss");
+	return 0;
+}
+
+/*
+
+CacheInsert makes an entry for URL out of a request that has just passed the
+security checks, and has the request use it. Request->FileName is the URL
+after decoding, the path the file was opened by.
+
+*/
+void CacheInsert(struct http_request *Request, const char *URL)
+{
+	struct khttpd_cache_entry *Entry,*Old;
+	struct list_head Evicted,*Head,*l;
+	int urllen,pathlen,size,charge;
+
+	EnterFunction("CacheInsert");
+
+	if (sysctl_khttpd_cachesize<=0)
+		return;
+
+	if (!PathMatches(Request->filp,Request->FileName))
+		return;
+
+	urllen = strlen(URL);
+	pathlen = strlen(Request->FileName);
+	size = sizeof(struct khttpd_cache_entry) + urllen + 1 + pathlen + 1 +
+	       sizeof(HeaderFormat) + Request->MimeLength +
+	       strlen(Request->TimeS) + strlen(Request->LengthS);
+	charge = size + PAGE_ALIGN(Request->FileLength);
+	if (charge>sysctl_khttpd_cachesize*1024)
+		return;
+
+	Entry = kmalloc(size,(int)GFP_KERNEL);
+	if (Entry==NULL)
+		return;
+	memset(Entry,0,sizeof(struct khttpd_cache_entry));
+
+	memcpy(Entry->URL,URL,urllen+1);
+	Entry->Path = Entry->URL + urllen + 1;
+	memcpy(Entry->Path,Request->FileName,pathlen+1);
+	Entry->Header = Entry->Path + pathlen + 1;
+	Entry->HeaderLength = sprintf(Entry->Header,HeaderFormat,
+				      (int)Request->MimeLength,Request->MimeType,
+				      Request->TimeS,Request->LengthS);
+	Entry->Size       = charge;
+	Entry->HashValue  = full_name_hash(URL,urllen);
+	Entry->Mtime      = Request->Time;
+	Entry->FileLength = Request->FileLength;
+	Entry->MimeType   = Request->MimeType;
+	Entry->MimeLength = Request->MimeLength;
+	get_file(Request->filp);
+	Entry->filp = Request->filp;
+	atomic_set(&Entry->Count,2);	/* The cache and this request */
+
+	INIT_LIST_HEAD(&Evicted);
+	Head = &CacheHash[Entry->HashValue % CACHE_HASH_SIZE];
+
+	spin_lock(&CacheLock);
+
+	/* Another thread may have beaten us to it */
+	list_for_each(l,Head)
+	{
+		Old = list_entry(l,struct khttpd_cache_entry,Hash);
+		if ((Old->HashValue==Entry->HashValue)&&(strcmp(Old->URL,URL)==0))
+		{
+			Unhash(Old);
+			list_add(&Old->LRU,&Evicted);
+			break;
+		}
+	}
+
+	list_add(&Entry->Hash,Head);
+	list_add(&Entry->LRU,&CacheLRU);
+	CacheBytes += charge;
+	CacheEntries++;
+	ShrinkLocked(sysctl_khttpd_cachesize*1024,&Evicted);
+
+	spin_unlock(&CacheLock);
+
+	Request->Cached = Entry;
+	ReleaseList(&Evicted);
+
+	LeaveFunction("CacheInsert");
+}
+
+
+/* ShrinkCache makes the cache fit "cache_size" again after it was lowered */
+void ShrinkCache(void)
+{
+	struct list_head Evicted;
+
+	INIT_LIST_HEAD(&Evicted);
+	spin_lock(&CacheLock);
+	ShrinkLocked(max_t(int,sysctl_khttpd_cachesize,0)*1024,&Evicted);
+	spin_unlock(&CacheLock);
+	ReleaseList(&Evicted);
+}
+
+void FlushCache(void)
+{
+	struct khttpd_cache_entry *Entry;
+	struct list_head Evicted;
+
+	EnterFunction("FlushCache");
+
+	INIT_LIST_HEAD(&Evicted);
+	spin_lock(&CacheLock);
+	while (!list_empty(&CacheLRU))
+	{
+		Entry = list_entry(CacheLRU.next,struct khttpd_cache_entry,LRU);
+		Unhash(Entry);
+		list_add(&Entry->LRU,&Evicted);
+	}
+	spin_unlock(&CacheLock);
+	ReleaseList(&Evicted);
+
+	LeaveFunction("FlushCache");
+}
+
+/*
+
+GetCacheStats fills in, in this order: lookups, hits, stale entries found,
+evictions, current number of entries and current size in bytes.
+
+*/
+void GetCacheStats(int *Stats)
+{
+	spin_lock(&CacheLock);
+	Stats[0] = (int)CacheStats.lookups;
+	Stats[1] = (int)CacheStats.hits;
+	Stats[2] = (int)CacheStats.stale;
+	Stats[3] = (int)CacheStats.evictions;
+	Stats[4] = CacheEntries;
+	Stats[5] = CacheBytes;
+	spin_unlock(&CacheLock);
+}
+
+void InitCache(void)
+{
+	int I;
+
+	for (I=0; I<CACHE_HASH_SIZE; I++)
+		INIT_LIST_HEAD(&CacheHash[I]);
+}
@@ -26,12 +26,15 @@ Send actual file-data to the connections
 
 Purpose:
 
-DataSending does the actual sending of file-data to the socket.
+DataSending does the actual sending of file-data to the socket, for a request
+in the "DataSendingQueue" that had an event. As long as data goes out and
+the socket has room for more, the request stays on the ready-list; once the
+socket is full, write_space puts it back.
 
 Note: Since asynchronous reads do not -yet- exists, this might block!
 
 Return value:
-	The number of requests that changed status (ie: made some progress)
+	1 if the request made some progress, 0 otherwise
 */
 
 #include <linux/config.h>
@@ -84,113 +87,113 @@ static int sock_send_actor(read_descriptor_t * desc, struct page *page, unsigned
 
 
 
-int DataSending(const int CPUNR)
+int DataSending(const int CPUNR, struct http_request *CurrentRequest)
 {
-	struct http_request *CurrentRequest,**Prev;
+	struct sock *sk = CurrentRequest->sock->sk;
+	int ReadSize,Space;
+	int retval;
 	int count = 0;
+	int Error = 0;
 	
 	EnterFunction("DataSending");
 	
-	Prev = &(threadinfo[CPUNR].DataSendingQueue);
-	CurrentRequest = threadinfo[CPUNR].DataSendingQueue;
-	while (CurrentRequest!=NULL)
-	{
-		int ReadSize,Space;
-		int retval;
-
+	/* First, test if the socket has any buffer-space left.
+	   If not, no need to actually try to send something.  */
+	  
+	
+	Space = sock_wspace(sk);
+	
+	ReadSize = min_t(int, 4 * 4096, CurrentRequest->FileLength - CurrentRequest->BytesSent);
+	ReadSize = min_t(int, ReadSize, Space);
 
-		/* First, test if the socket has any buffer-space left.
-		   If not, no need to actually try to send something.  */
-		  
+	if (ReadSize>0)
+	{			
+		struct inode *inode;
 		
-		Space = sock_wspace(CurrentRequest->sock->sk);
+		inode = CurrentRequest->filp->f_dentry->d_inode;
 		
-		ReadSize = min_t(int, 4 * 4096, CurrentRequest->FileLength - CurrentRequest->BytesSent);
-		ReadSize = min_t(int, ReadSize, Space);
-
-		if (ReadSize>0)
-		{			
-			struct inode *inode;
-			
-			inode = CurrentRequest->filp->f_dentry->d_inode;
+		if (inode->i_mapping->a_ops->readpage) {
+			/* This does the actual transfer using sendfile */		
+			read_descriptor_t desc;
+			loff_t pos;
+	
+			/* Not f_pos: the file may be shared through the cache */
+			pos = CurrentRequest->BytesSent;
+
+			desc.written = 0;
+			desc.count = ReadSize;
+			desc.buf = (char *) CurrentRequest->sock;
+			desc.error = 0;
+			do_generic_file_read(CurrentRequest->filp, &pos, &desc, sock_send_actor);
+			if (desc.written>0)
+			{	
+				CurrentRequest->BytesSent += desc.written;
+				count++;
+			}			
+			if (desc.error<0)
+				Error = desc.error;
+			else if (desc.written==0)
+				Error = -EIO;	/* The file got shorter */
+		} 
+		else  /* FS doesn't support sendfile() */
+		{
+			mm_segment_t oldfs;
+			loff_t pos = CurrentRequest->BytesSent;
 			
-			if (inode->i_mapping->a_ops->readpage) {
-				/* This does the actual transfer using sendfile */		
-				read_descriptor_t desc;
-				loff_t *ppos;
-		
-				CurrentRequest->filp->f_pos = CurrentRequest->BytesSent;
-
-				ppos = &CurrentRequest->filp->f_pos;
-
-				desc.written = 0;
-				desc.count = ReadSize;
-				desc.buf = (char *) CurrentRequest->sock;
-				desc.error = 0;
-				do_generic_file_read(CurrentRequest->filp, ppos, &desc, sock_send_actor);
-				if (desc.written>0)
-				{	
-					CurrentRequest->BytesSent += desc.written;
-					count++;
-				}			
-			} 
-			else  /* FS doesn't support sendfile() */
+			oldfs = get_fs(); set_fs(KERNEL_DS);
+			retval = CurrentRequest->filp->f_op->read(CurrentRequest->filp, Block[CPUNR], ReadSize, &pos);
+			set_fs(oldfs);
+	
+			if (retval>0)
 			{
-				mm_segment_t oldfs;
-				CurrentRequest->filp->f_pos = CurrentRequest->BytesSent;
-				
-				oldfs = get_fs(); set_fs(KERNEL_DS);
-				retval = CurrentRequest->filp->f_op->read(CurrentRequest->filp, Block[CPUNR], ReadSize, &CurrentRequest->filp->f_pos);
-				set_fs(oldfs);
-		
+				retval = SendBuffer_async(CurrentRequest->sock,Block[CPUNR],(size_t)retval);
 				if (retval>0)
 				{
-					retval = SendBuffer_async(CurrentRequest->sock,Block[CPUNR],(size_t)retval);
-					if (retval>0)
-					{
-						CurrentRequest->BytesSent += retval;
-						count++;				
-					}
+					CurrentRequest->BytesSent += retval;
+					count++;				
 				}
 			}
-		
+			if (retval<0)
+				Error = retval;
+			else if (retval==0)
+				Error = -EIO;
 		}
-		
-		/* 
-		   If end-of-file or closed connection: Finish this request 
-		   by moving it to the "logging" queue. 
-		*/
-		if ((CurrentRequest->BytesSent>=CurrentRequest->FileLength)||
-		    (CurrentRequest->sock->sk->state!=TCP_ESTABLISHED
-		     && CurrentRequest->sock->sk->state!=TCP_CLOSE_WAIT))
+	
+	}
+	
+	/* 
+	   If end-of-file, closed connection or an error other than a full
+	   socket: Finish this request by moving it to the "logging" queue. 
+	   No write_space event is coming to wake it up otherwise.
+	*/
+	if ((CurrentRequest->BytesSent>=CurrentRequest->FileLength)||
+	    (sk->state!=TCP_ESTABLISHED && sk->state!=TCP_CLOSE_WAIT)||
+	    (Error<0 && Error!=-EAGAIN))
+	{
+		lock_sock(sk);
+		if  (sk->state == TCP_ESTABLISHED ||
+		     sk->state == TCP_CLOSE_WAIT)
 		{
-			struct http_request *Next;
-			Next = CurrentRequest->Next;
-
-			lock_sock(CurrentRequest->sock->sk);
-			if  (CurrentRequest->sock->sk->state == TCP_ESTABLISHED ||
-			     CurrentRequest->sock->sk->state == TCP_CLOSE_WAIT)
-			{
-				CurrentRequest->sock->sk->tp_pinfo.af_tcp.nonagle = 0;
-				tcp_push_pending_frames(CurrentRequest->sock->sk,&(CurrentRequest->sock->sk->tp_pinfo.af_tcp));
-			}
-			release_sock(CurrentRequest->sock->sk);
-
-			(*Prev) = CurrentRequest->Next;
-			
-			CurrentRequest->Next = threadinfo[CPUNR].LoggingQueue;
-			threadinfo[CPUNR].LoggingQueue = CurrentRequest;	
-				
-			CurrentRequest = Next;
-			continue;
-		
+			sk->tp_pinfo.af_tcp.nonagle = 0;
+			tcp_push_pending_frames(sk,&(sk->tp_pinfo.af_tcp));
 		}
-		
+		release_sock(sk);
 
-		Prev = &(CurrentRequest->Next);	
-		CurrentRequest = CurrentRequest->Next;
+		list_move(&CurrentRequest->List,&threadinfo[CPUNR].LoggingQueue);
+		
+		LeaveFunction("DataSending - done");
+		return 1;
 	}
 	
+	/* 
+	   Only a full socket gets here: either there was no space to begin
+	   with or the send returned -EAGAIN. Ask for write_space before
+	   looking at the space again, or the event could slip in between. 
+	*/
+	set_bit(SOCK_NOSPACE,&CurrentRequest->sock->flags);
+	if ((count>0)&&(sock_wspace(sk)>0))
+		RequestReady(CurrentRequest);
+	
 	LeaveFunction("DataSending");
 	return count;
 }
@@ -222,19 +225,18 @@ int InitDataSending(int ThreadCount)
 
 void StopDataSending(const int CPUNR)
 {
-	struct http_request *CurrentRequest,*Next;
+	struct http_request *CurrentRequest;
+	struct list_head *Queue;
 	
 	EnterFunction("StopDataSending");
-	CurrentRequest = threadinfo[CPUNR].DataSendingQueue;
+	Queue = &threadinfo[CPUNR].DataSendingQueue;
 
-	while (CurrentRequest!=NULL)
+	while (!list_empty(Queue))
 	{	
-		Next = CurrentRequest->Next;
+		CurrentRequest = list_entry(Queue->next,struct http_request,List);
+		list_del(&CurrentRequest->List);
 		CleanUpRequest(CurrentRequest);
-		CurrentRequest=Next;		
 	}
-	
-	threadinfo[CPUNR].DataSendingQueue = NULL;
 
 	free_page( (unsigned long)Block[CPUNR]);
 	LeaveFunction("StopDataSending");
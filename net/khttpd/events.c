@@ -0,0 +1,237 @@
+/*
+
+kHTTPd -- the next generation
+
+Socket events
+
+*/
+/****************************************************************
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2, or (at your option)
+ *	any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program; if not, write to the Free Software
+ *	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ ****************************************************************/
+
+/*
+
+Purpose:
+
+While kHTTPd owns a connection, the data_ready, write_space and state_change
+callbacks of its socket point here. They put the request on the ready-list
+of the thread that owns it and wake that thread up, so the threads only look
+at requests something happened to, instead of polling all of them every tick.
+
+The callbacks run from the network bottom-half, so the ready-list has its
+own lock. The stage queues are only ever touched by the owning thread.
+
+*/
+
+#include <linux/config.h>
+#include <linux/kernel.h>
+#include <linux/sched.h>
+#include <linux/skbuff.h>
+
+#include <net/sock.h>
+
+#include "structure.h"
+#include "prototypes.h"
+
+
+void RequestReady(struct http_request *Req)
+{
+	struct khttpd_threadinfo *ti = &threadinfo[Req->CPU];
+
+	spin_lock_bh(&ti->ReadyLock);
+	if (!Req->Ready)
+	{
+		Req->Ready = 1;
+		list_add_tail(&Req->ReadyList,&ti->ReadyQueue);
+	}
+	spin_unlock_bh(&ti->ReadyLock);
+
+	wake_up_interruptible(&ti->Wait);
+}
+
+static void khttpd_data_ready(struct sock *sk, int bytes)
+{
+	read_lock(&sk->callback_lock);
+	if (sk->user_data!=NULL)
+		RequestReady((struct http_request *)sk->user_data);
+	read_unlock(&sk->callback_lock);
+}
+
+/* 
+   The socket's own write_space decides whether there is enough room to
+   bother; it clears SOCK_NOSPACE when there is.
+*/
+static void khttpd_write_space(struct sock *sk)
+{
+	struct http_request *Req;
+
+	read_lock(&sk->callback_lock);
+	Req = (struct http_request *)sk->user_data;
+	if (Req!=NULL)
+	{
+		Req->old_write_space(sk);
+		if ((sk->socket!=NULL)&&(!test_bit(SOCK_NOSPACE,&sk->socket->flags)))
+			RequestReady(Req);
+	}
+	read_unlock(&sk->callback_lock);
+}
+
+static void khttpd_state_change(struct sock *sk)
+{
+	read_lock(&sk->callback_lock);
+	if (sk->user_data!=NULL)
+		RequestReady((struct http_request *)sk->user_data);
+	read_unlock(&sk->callback_lock);
+}
+
+
+/*
+
+AttachRequest hooks the socket of a freshly accepted request to thread CPUNR.
+The request starts out ready: the headers may well have arrived before it
+was accepted.
+
+*/
+void AttachRequest(const int CPUNR, struct http_request *Req)
+{
+	struct sock *sk = Req->sock->sk;
+
+	EnterFunction("AttachRequest");
+
+	Req->CPU = CPUNR;
+
+	write_lock_bh(&sk->callback_lock);
+	Req->old_data_ready   = sk->data_ready;
+	Req->old_write_space  = sk->write_space;
+	Req->old_state_change = sk->state_change;
+	sk->user_data    = Req;
+	sk->data_ready   = khttpd_data_ready;
+	sk->write_space  = khttpd_write_space;
+	sk->state_change = khttpd_state_change;
+	write_unlock_bh(&sk->callback_lock);
+
+	RequestReady(Req);
+	LeaveFunction("AttachRequest");
+}
+
+/*
+
+DetachRequest gives the socket its own callbacks back and takes the request
+off the ready-list. Once it returns, no callback will look at the request
+anymore. It is safe to call it more than once.
+
+*/
+void DetachRequest(struct http_request *Req)
+{
+	struct khttpd_threadinfo *ti = &threadinfo[Req->CPU];
+	struct sock *sk;
+
+	EnterFunction("DetachRequest");
+
+	if ((Req->sock!=NULL)&&((sk = Req->sock->sk)!=NULL))
+	{
+		write_lock_bh(&sk->callback_lock);
+		if (sk->user_data==Req)
+		{
+			sk->data_ready   = Req->old_data_ready;
+			sk->write_space  = Req->old_write_space;
+			sk->state_change = Req->old_state_change;
+			sk->user_data    = NULL;
+		}
+		write_unlock_bh(&sk->callback_lock);
+	}
+
+	spin_lock_bh(&ti->ReadyLock);
+	if (Req->Ready)
+	{
+		list_del(&Req->ReadyList);
+		Req->Ready = 0;
+	}
+	spin_unlock_bh(&ti->ReadyLock);
+
+	LeaveFunction("DetachRequest");
+}
+
+
+/*
+
+Purpose:
+
+ProcessReady runs every request on the ready-list through the step that
+belongs to its state. Requests that become ready while this runs are left
+for the next round, so one busy connection cannot starve accept().
+
+Return value:
+	The number of requests that changed status
+*/
+int ProcessReady(const int CPUNR)
+{
+	struct khttpd_threadinfo *ti = &threadinfo[CPUNR];
+	struct http_request *Req;
+	struct list_head Batch;
+	int count = 0;
+
+	EnterFunction("ProcessReady");
+
+	INIT_LIST_HEAD(&Batch);
+
+	spin_lock_bh(&ti->ReadyLock);
+	list_splice_init(&ti->ReadyQueue,&Batch);
+
+	while (!list_empty(&Batch))
+	{
+		Req = list_entry(Batch.next,struct http_request,ReadyList);
+		list_del(&Req->ReadyList);
+		Req->Ready = 0;
+		spin_unlock_bh(&ti->ReadyLock);
+
+		if (Req->State==KHTTPD_WAITHEADERS)
+			count += WaitForHeaders(CPUNR,Req);
+		else
+			count += DataSending(CPUNR,Req);
+
+		spin_lock_bh(&ti->ReadyLock);
+	}
+	spin_unlock_bh(&ti->ReadyLock);
+
+	LeaveFunction("ProcessReady");
+	return count;
+}
+
+/*
+
+InitEvents sets up the queues of the threads before they are started.
+
+*/
+void InitEvents(int ThreadCount)
+{
+	struct khttpd_threadinfo *ti;
+	int I;
+
+	for (I=0; I<ThreadCount; I++)
+	{
+		ti = &threadinfo[I];
+
+		INIT_LIST_HEAD(&ti->WaitForHeaderQueue);
+		INIT_LIST_HEAD(&ti->DataSendingQueue);
+		INIT_LIST_HEAD(&ti->LoggingQueue);
+		INIT_LIST_HEAD(&ti->UserspaceQueue);
+		INIT_LIST_HEAD(&ti->ReadyQueue);
+		spin_lock_init(&ti->ReadyLock);
+		init_waitqueue_head(&ti->Wait);
+		memset(ti->Latency,0,sizeof(ti->Latency));
+	}
+}
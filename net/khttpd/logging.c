@@ -2,7 +2,8 @@
 
 kHTTPd -- the next generation
 
-logging.c takes care of shutting down a connection.
+logging.c takes care of shutting down a connection, and keeps the
+request latency histogram.
 
 */
 /****************************************************************
@@ -32,6 +33,86 @@ logging.c takes care of shutting down a connection.
 
 /*
 
+The latency of a request is the time from accept() until it is finished.
+Each thread counts them in its own histogram: below 4 microseconds one
+bucket per microsecond, above that 4 buckets per power of two, so a
+percentile is never more than 25% off.
+
+*/
+static int LatencyBucket(unsigned long usec)
+{
+	int bit;
+
+	if (usec<4)
+		return (int)usec;
+	bit = 2;
+	while ((usec>>(bit-2))>7)
+		bit++;
+	/* usec is now (4..7) << (bit-2) */
+	return 4*(bit-1) + (int)((usec>>(bit-2))&3);
+}
+
+/* The highest latency that is counted in bucket B */
+static unsigned long LatencyLimit(int B)
+{
+	int bit;
+
+	if (B<4)
+		return (unsigned long)B;
+	bit = B/4 + 1;
+	return ((unsigned long)(4 + B%4 + 1) << (bit-2)) - 1;
+}
+
+static void CountLatency(const int CPUNR, struct http_request *Req)
+{
+	struct timeval now;
+	long usec;
+
+	do_gettimeofday(&now);
+	usec = (now.tv_sec - Req->Accepted.tv_sec) * 1000000L
+		+ (now.tv_usec - Req->Accepted.tv_usec);
+	if (usec<0)
+		usec = 0;
+	threadinfo[CPUNR].Latency[LatencyBucket((unsigned long)usec)]++;
+}
+
+/*
+
+LatencyPercentile returns, in microseconds, the latency that "permille"
+thousandths of the requests finished within, over all threads.
+
+*/
+int LatencyPercentile(const int permille)
+{
+	unsigned long total,target,sum;
+	int B,I;
+
+	total = 0;
+	for (I=0; I<CONFIG_KHTTPD_NUMCPU; I++)
+		for (B=0; B<KHTTPD_LATENCY_BUCKETS; B++)
+			total += threadinfo[I].Latency[B];
+	if (total==0)
+		return 0;
+
+	target = total/1000*permille + (total%1000)*permille/1000;
+	if (target==0)
+		target = 1;
+
+	sum = 0;
+	for (B=0; B<KHTTPD_LATENCY_BUCKETS; B++)
+	{
+		for (I=0; I<CONFIG_KHTTPD_NUMCPU; I++)
+			sum += threadinfo[I].Latency[B];
+		if (sum>=target)
+			break;
+	}
+	if (B==KHTTPD_LATENCY_BUCKETS)
+		B--;
+	return (int)min_t(unsigned long, LatencyLimit(B), INT_MAX);
+}
+
+/*
+
 Purpose:
 
 Logging() terminates "finished" connections and will eventually log them to a 
@@ -45,26 +126,24 @@ Return value:
 
 int Logging(const int CPUNR)
 {
-	struct http_request *CurrentRequest,*Req;
+	struct http_request *CurrentRequest;
+	struct list_head *Queue;
 	int count = 0;
 	
 	EnterFunction("Logging");
 	
-	CurrentRequest = threadinfo[CPUNR].LoggingQueue;
+	Queue = &threadinfo[CPUNR].LoggingQueue;
 	
 	/* For now, all requests are removed immediatly, but this changes
 	   when userspace-logging is added. */
 	   
-	while (CurrentRequest!=NULL)
+	while (!list_empty(Queue))
 	{
+		CurrentRequest = list_entry(Queue->next,struct http_request,List);
+		list_del(&CurrentRequest->List);
 
-		Req = CurrentRequest->Next;
-
+		CountLatency(CPUNR,CurrentRequest);
 		CleanUpRequest(CurrentRequest);
-		
-		threadinfo[CPUNR].LoggingQueue = Req;
-			
-		CurrentRequest = Req;
 	
 		count++;
 		
@@ -78,18 +157,17 @@ int Logging(const int CPUNR)
 
 void StopLogging(const int CPUNR)
 {
-	struct http_request *CurrentRequest,*Next;
+	struct http_request *CurrentRequest;
+	struct list_head *Queue;
 	
 	EnterFunction("StopLogging");
-	CurrentRequest = threadinfo[CPUNR].LoggingQueue;
+	Queue = &threadinfo[CPUNR].LoggingQueue;
 	
-	while (CurrentRequest!=NULL)
+	while (!list_empty(Queue))
 	{
-		Next=CurrentRequest->Next;
+		CurrentRequest = list_entry(Queue->next,struct http_request,List);
+		list_del(&CurrentRequest->List);
 		CleanUpRequest(CurrentRequest);
-		CurrentRequest=Next;		
 	}
-	
-	threadinfo[CPUNR].LoggingQueue = NULL;
 	LeaveFunction("StopLogging");
 }
@@ -31,6 +31,15 @@ WaitForHeaders
 Userspace
 
 
+The threads do not poll the queues. Each accepted socket gets its callbacks
+pointed to events.c, which puts the request on the ready-list of its thread
+and wakes that thread up; the thread then only runs the requests on that
+list through the step belonging to their stage. A thread with nothing on
+its ready-list and no connections waiting to be accepted sleeps until
+either shows up, or for at most a second so the date string stays fresh.
+
+Each thread is bound to a CPU, and the connections it accepts stay with it
+for their whole life.
 
 */
 /****************************************************************
@@ -77,27 +86,17 @@ atomic_t	DaemonCount;
 static int	ActualThreads; /* The number of actual, active threads */
 
 
-static int ConnectionsPending(int CPUNR)
-{
-	if (threadinfo[CPUNR].DataSendingQueue!=NULL) return O_NONBLOCK;
-	if (threadinfo[CPUNR].WaitForHeaderQueue!=NULL) return O_NONBLOCK;
-	if (threadinfo[CPUNR].LoggingQueue!=NULL) return O_NONBLOCK;
-	if (threadinfo[CPUNR].UserspaceQueue!=NULL) return O_NONBLOCK;
-  return 0;
-}
-
-
-
-static wait_queue_head_t DummyWQ[CONFIG_KHTTPD_NUMCPU];
 static atomic_t Running[CONFIG_KHTTPD_NUMCPU]; 
 
 static int MainDaemon(void *cpu_pointer)
 {
-	int CPUNR;
+	int CPUNR,cpu;
 	sigset_t tmpsig;
 	int old_stop_count;
+	struct khttpd_threadinfo *ti;
 	
 	DECLARE_WAITQUEUE(main_wait,current);
+	DECLARE_WAITQUEUE(thread_wait,current);
 	
 	MOD_INC_USE_COUNT;
 
@@ -114,7 +113,13 @@ static int MainDaemon(void *cpu_pointer)
 	sprintf(current->comm,"khttpd - %i",CPUNR);
 	daemonize();
 	
-	init_waitqueue_head(&(DummyWQ[CPUNR]));
+	ti = &threadinfo[CPUNR];
+	
+	/* Migrate to our CPU */
+	cpu = cpu_logical_map(CPUNR % smp_num_cpus);
+	current->cpus_allowed = 1UL << cpu;
+	while (smp_processor_id() != cpu)
+		schedule();
 	
 
 	/* Block all signals except SIGKILL, SIGSTOP and SIGHUP */
@@ -128,6 +133,7 @@ static int MainDaemon(void *cpu_pointer)
 	if (MainSocket->sk==NULL)
 	 	return 0;
 	add_wait_queue_exclusive(MainSocket->sk->sleep,&(main_wait));
+	add_wait_queue(&ti->Wait,&(thread_wait));
 	atomic_inc(&DaemonCount);
 	atomic_set(&Running[CPUNR],1);
 	
@@ -136,25 +142,23 @@ static int MainDaemon(void *cpu_pointer)
 		int changes = 0;
 		
 		changes +=AcceptConnections(CPUNR,MainSocket);
-		if (ConnectionsPending(CPUNR))
-		{
-			changes +=WaitForHeaders(CPUNR);
-			changes +=DataSending(CPUNR);
-			changes +=Userspace(CPUNR);
-			changes +=Logging(CPUNR);
-			/* Test for incoming connections _again_, because it is possible
-			   one came in during the other steps, and the wakeup doesn't happen
-			   then.
-			*/
-			changes +=AcceptConnections(CPUNR,MainSocket);
-		}
+		changes +=ProcessReady(CPUNR);
+		changes +=Userspace(CPUNR);
+		changes +=Logging(CPUNR);
 		
 		if (changes==0) 
 		{
-			(void)interruptible_sleep_on_timeout(&(DummyWQ[CPUNR]),1);	
-			if (CPUNR==0) 
-				UpdateCurrentDate();
+			/* The state is set before looking, so a wakeup that comes
+			   in between is not lost. */
+			set_current_state(TASK_INTERRUPTIBLE);
+			if (list_empty(&ti->ReadyQueue) && !AcceptPending(MainSocket)
+			    && old_stop_count == atomic_read(&khttpd_stopCount))
+				(void)schedule_timeout(HZ);
+			set_current_state(TASK_RUNNING);
 		}
+		
+		if ((CPUNR==0)&&(CurrentTime_i!=CURRENT_TIME))
+			UpdateCurrentDate();
 			
 		if (signal_pending(current)!=0)
 		{
@@ -164,6 +168,7 @@ static int MainDaemon(void *cpu_pointer)
 	
 	}
 	
+	remove_wait_queue(&ti->Wait,&(thread_wait));
 	remove_wait_queue(MainSocket->sk->sleep,&(main_wait));
 	
 	StopWaitingForHeaders(CPUNR);
@@ -239,6 +244,7 @@ static int ManagementDaemon(void *unused)
 		/* Write back the actual value */
 		sysctl_khttpd_threads = ActualThreads;
 		
+		InitEvents(ActualThreads);
 		InitUserspace(ActualThreads);
 		
 		if (InitDataSending(ActualThreads)!=0)
@@ -256,9 +262,6 @@ static int ManagementDaemon(void *unused)
 			sysctl_khttpd_start = 0;
 			continue;
 		}
-	
-		/* Clean all queues */
-		memset(threadinfo, 0, sizeof(struct khttpd_threadinfo));
 
 		for (I=0; I<ActualThreads; I++) {
 			atomic_set(&Running[I],1);
@@ -283,6 +286,7 @@ static int ManagementDaemon(void *unused)
 		while (atomic_read(&DaemonCount)>0)
 			interruptible_sleep_on_timeout(&WQ,HZ);
 		StopListening();
+		FlushCache();	/* Let go of the files */
 		sysctl_khttpd_start = 0;
 		/* reap the zombie-daemons */
 		do
@@ -297,6 +301,7 @@ static int ManagementDaemon(void *unused)
 	while (atomic_read(&DaemonCount)>0)
  		interruptible_sleep_on_timeout(&WQ,HZ);
 	StopListening();
+	FlushCache();
 	/* reap the zombie-daemons */
 	do
 		waitpid_result = waitpid(-1,NULL,__WCLONE|WNOHANG);
@@ -323,6 +328,7 @@ int __init khttpd_init(void)
 	atomic_set(&DaemonCount,0);
 	atomic_set(&khttpd_stopCount,0);
 	
+	InitCache();
 
 	/* Maybe the mime-types will be set-able through sysctl in the future */	   
 		
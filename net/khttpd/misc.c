@@ -109,11 +109,13 @@ void CleanUpRequest(struct http_request *Req)
 {
 	EnterFunction("CleanUpRequest");	
 	
-	/* Close the socket ....*/
+	/* Make sure the socket callbacks forget about it ... */
+	DetachRequest(Req);
+	
+	/* ... close the socket ....*/
 	if ((Req->sock!=NULL)&&(Req->sock->sk!=NULL))
 	{
 		ReadRest(Req->sock);
-		remove_wait_queue(Req->sock->sk->sleep,&(Req->sleep));
 	    	sock_release(Req->sock);
 	}
 	
@@ -124,6 +126,13 @@ void CleanUpRequest(struct http_request *Req)
 	    	Req->filp = NULL;
 	}
 	
+	/* ... and the cache entry ... */
+	if (Req->Cached!=NULL)
+	{
+		CachePut(Req->Cached);
+		Req->Cached = NULL;
+	}
+	
 	
 	/* ... and release the memory for the structure. */
 	kfree(Req);
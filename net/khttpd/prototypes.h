@@ -49,7 +49,6 @@ extern int sysctl_khttpd_stop;
 extern struct khttpd_threadinfo threadinfo[CONFIG_KHTTPD_NUMCPU];
 extern char CurrentTime[];
 extern atomic_t ConnectCount;
-extern struct wait_queue main_wait[CONFIG_KHTTPD_NUMCPU];
 
 /* misc.c */
 
@@ -63,16 +62,25 @@ void Send50x(struct socket *sock);
 /* accept.c */
 
 int AcceptConnections(const int CPUNR,struct socket *Socket);
+int AcceptPending(struct socket *Socket);
+
+/* events.c */
+
+void RequestReady(struct http_request *Req);
+void AttachRequest(const int CPUNR, struct http_request *Req);
+void DetachRequest(struct http_request *Req);
+int ProcessReady(const int CPUNR);
+void InitEvents(int ThreadCount);
 
 /* waitheaders.c */
 
-int WaitForHeaders(const int CPUNR);
+int WaitForHeaders(const int CPUNR, struct http_request *CurrentRequest);
 void StopWaitingForHeaders(const int CPUNR);
 int InitWaitHeaders(int ThreadCount);
 
 /* datasending.c */
 
-int DataSending(const int CPUNR);
+int DataSending(const int CPUNR, struct http_request *CurrentRequest);
 void StopDataSending(const int CPUNR);
 int InitDataSending(int ThreadCount);
 
@@ -103,13 +111,26 @@ void SendHTTPHeader(struct http_request *Request);
 /* security.c */
 
 struct file *OpenFileForSecurity(char *Filename);
+int FilePermitted(const umode_t Mode);
 void AddDynamicString(const char *String);
 void GetSecureString(char *String);
 
 
+/* cache.c */
+
+int CacheLookup(struct http_request *Request);
+void CacheInsert(struct http_request *Request, const char *URL);
+void CachePut(struct khttpd_cache_entry *Entry);
+void ShrinkCache(void);
+void FlushCache(void);
+void GetCacheStats(int *Stats);
+void InitCache(void);
+
+
 /* logging.c */
 
 int Logging(const int CPUNR);
+int LatencyPercentile(const int permille);
 void StopLogging(const int CPUNR);
 
 
@@ -237,6 +237,22 @@ void SendHTTPHeader(struct http_request *Request)
 	iov[0].iov_len  = 45;
 	iov[1].iov_base = CurrentTime;
 	iov[1].iov_len  = 29;
+	
+	if (Request->Cached!=NULL)
+	{
+		/* Everything after the date comes from the cache */
+		iov[2].iov_base = Request->Cached->Header;
+		iov[2].iov_len  = Request->Cached->HeaderLength;
+		msg.msg_iovlen  = 3;
+		len2 = 45+29+iov[2].iov_len;
+		
+		oldfs = get_fs(); set_fs(KERNEL_DS);
+		len = sock_sendmsg(Request->sock,&msg,len2);
+		set_fs(oldfs);
+		LeaveFunction("SendHTTPHeader - cached");
+		return;
+	}
+	
 	iov[2].iov_base = HeaderPart3;
 	iov[2].iov_len  = 16;
 	
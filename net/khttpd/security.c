@@ -85,7 +85,6 @@ struct file *OpenFileForSecurity(char *Filename)
 {
 	struct file *filp = NULL;
 	struct DynamicString *List;
-	umode_t permission;
 	
 	EnterFunction("OpenFileForSecurity");
 	if (Filename==NULL)
@@ -116,19 +115,12 @@ struct file *OpenFileForSecurity(char *Filename)
 	if (IS_ERR(filp))
 		goto out_error;
 
-#ifndef BENCHMARK		
-	permission = filp->f_dentry->d_inode->i_mode;
-	
-	/* Rule no. 4 : must have enough permissions */
+	/* Rule no. 4 and 5 : permissions */
 	
-	if ((permission & sysctl_khttpd_permreq)==0)
+	if (!FilePermitted(filp->f_dentry->d_inode->i_mode))
 		goto out_error_put;	
 
-	/* Rule no. 5 : cannot have "forbidden" permission */
-	
-	if ((permission & sysctl_khttpd_permforbid)!=0)
-		goto out_error_put;	
-		
+#ifndef BENCHMARK		
 	/* Rule no. 6 : No string in DynamicList can be a
 			substring of the filename */
 	
@@ -154,6 +146,28 @@ out_error:
 	goto out;
 }
 
+/*
+
+FilePermitted checks the mode of a file against rules 4 and 5.
+The cache uses it too, since a chmod doesn't change the mtime.
+
+*/
+int FilePermitted(const umode_t Mode)
+{
+#ifndef BENCHMARK		
+	/* Rule no. 4 : must have enough permissions */
+	
+	if ((Mode & sysctl_khttpd_permreq)==0)
+		return 0;
+
+	/* Rule no. 5 : cannot have "forbidden" permission */
+	
+	if ((Mode & sysctl_khttpd_permforbid)!=0)
+		return 0;
+#endif
+	return 1;
+}
+
 /* 
 
 DecodeHexChars does the actual %HEX decoding, in place. 
@@ -225,6 +239,9 @@ void AddDynamicString(const char *String)
 	Temp->Next = DynamicList;
 	DynamicList = Temp;
 	
+	/* URLs that are cached may be "dynamic" now */
+	FlushCache();
+	
 	LeaveFunction("AddDynamicString");
 }
 
@@ -3,14 +3,62 @@
 
 #include <linux/time.h>
 #include <linux/wait.h>
+#include <linux/list.h>
+#include <linux/cache.h>
+#include <linux/spinlock.h>
+#include <asm/atomic.h>
+
+struct sock;
+
+/* Request states, see ProcessReady() */
+#define KHTTPD_WAITHEADERS	0
+#define KHTTPD_SENDING		1
+
+/* Latency histogram: 4 buckets per power of two microseconds */
+#define KHTTPD_LATENCY_BUCKETS	128
 
 
 struct http_request;
 
+/*
+
+struct khttpd_cache_entry is what the open-file cache (cache.c) remembers
+about a URL: the file, opened and checked, and the part of the HTTP-header
+that only depends on the file.
+
+*/
+struct khttpd_cache_entry
+{
+	struct list_head Hash;
+	struct list_head LRU;
+	atomic_t	Count;		/* 1 for the cache, 1 per request using it */
+	int		Size;		/* Bytes charged against cache_size,
+					   the file's pages included */
+	unsigned int	HashValue;
+	
+	struct file	*filp;		/* The open file, pinned */
+	time_t		Mtime;		/* Validators: the file as it was */
+	int		FileLength;	/* when it was opened */
+	
+	char		*MimeType;
+	__kernel_size_t	MimeLength;
+	char		*Path;		/* The filename after decoding */
+	char		*Header;	/* "Content-type:" up to the empty line */
+	int		HeaderLength;
+	char		URL[0];		/* The requested filename, undecoded */
+};
+
 struct http_request
 {
-	/* Linked list */
-	struct http_request *Next;
+	/* The stage queue of the owning thread */
+	struct list_head List;
+	
+	/* The ready list, protected by the thread's ReadyLock */
+	struct list_head ReadyList;
+	int		Ready;		/* 1 while on the ready list */
+	int		State;		/* KHTTPD_WAITHEADERS or KHTTPD_SENDING */
+	int		CPU;		/* The thread that owns this request */
+	struct timeval	Accepted;	/* For the latency histogram */
 	
 	/* Network and File data */
 	struct socket	*sock;		
@@ -23,9 +71,11 @@ struct http_request
 	int		BytesSent;	/* The number of bytes already sent */
 	int		IsForUserspace;	/* 1 means let Userspace handle this one */
 	
-	/* Wait queue */
+	/* Socket callbacks, saved while kHTTPd owns the connection */
 	
-	wait_queue_t sleep;		/* For putting in the socket's waitqueue */
+	void		(*old_data_ready)(struct sock *, int);
+	void		(*old_write_space)(struct sock *);
+	void		(*old_state_change)(struct sock *);
 	
 	/* HTTP request information */
 	char		FileName[256];	/* The requested filename */
@@ -44,24 +94,32 @@ struct http_request
 					   based on the filename */
 	__kernel_size_t	MimeLength;	/* The length of this string */
 	
+	struct khttpd_cache_entry *Cached; /* Cache entry in use, or NULL */
+	
 };
 
 
 
 /*
 
-struct khttpd_threadinfo represents the four queues that 1 thread has to deal with.
-It is padded to occupy 1 (Intel) cache-line, to avoid "cacheline-pingpong".
+struct khttpd_threadinfo represents the four queues that 1 thread has to deal with,
+plus the list of requests the socket callbacks have marked ready and the wait-queue
+the thread sleeps on. It is cache-line aligned, to avoid "cacheline-pingpong".
 
 */
 struct khttpd_threadinfo
 {
-	struct http_request* WaitForHeaderQueue;
-	struct http_request* DataSendingQueue;
-	struct http_request* LoggingQueue;
-	struct http_request* UserspaceQueue;
-	char  dummy[16];  /* Padding for cache-lines */
-};
+	struct list_head WaitForHeaderQueue;
+	struct list_head DataSendingQueue;
+	struct list_head LoggingQueue;
+	struct list_head UserspaceQueue;
+	
+	spinlock_t	 ReadyLock;
+	struct list_head ReadyQueue;
+	wait_queue_head_t Wait;
+	
+	unsigned long	 Latency[KHTTPD_LATENCY_BUCKETS];
+} ____cacheline_aligned;
 
 
 
@@ -63,6 +63,15 @@ char	sysctl_khttpd_dynamicstring[200];
 int 	sysctl_khttpd_sloppymime= 0;
 int	sysctl_khttpd_threads	= 2;
 int	sysctl_khttpd_maxconnect = 1000;
+int	sysctl_khttpd_acceptbatch = 16;
+
+int	sysctl_khttpd_cachesize = 1024;	/* kilobytes */
+
+/* Request latency percentiles in microseconds, filled in when read */
+static int sysctl_khttpd_latency[3];
+
+/* Cache statistics, filled in when read; see GetCacheStats() */
+static int sysctl_khttpd_cachestats[6];
 
 atomic_t        khttpd_stopCount;
 
@@ -75,6 +84,15 @@ static int proc_dosecurestring(ctl_table *table, int write, struct file *filp,
 		  void *buffer, size_t *lenp);
 static int khttpd_stop_wrap_proc_dointvec(ctl_table *table, int write, struct file *filp,
 		  void *buffer, size_t *lenp);
+static int khttpd_latency_proc_dointvec(ctl_table *table, int write, struct file *filp,
+		  void *buffer, size_t *lenp);
+static int khttpd_cache_proc_dointvec(ctl_table *table, int write, struct file *filp,
+		  void *buffer, size_t *lenp);
+static int khttpd_flush_wrap_proc_dointvec(ctl_table *table, int write, struct file *filp,
+		  void *buffer, size_t *lenp);
+
+static int khttpd_acceptbatch_min = 1;
+static int khttpd_acceptbatch_max = 1024;
 
 
 static ctl_table khttpd_table[] = {
@@ -156,7 +174,7 @@ static ctl_table khttpd_table[] = {
 		sizeof(int),
 		0644,
 		NULL,
-		proc_dointvec,
+		khttpd_flush_wrap_proc_dointvec,
 		&sysctl_intvec,
 		NULL,
 		NULL,
@@ -222,6 +240,78 @@ static ctl_table khttpd_table[] = {
 		NULL,
 		NULL
 	},
+	{	NET_KHTTPD_ACCEPTBATCH,
+		"accept_batch",
+		&sysctl_khttpd_acceptbatch,
+		sizeof(int),
+		0644,
+		NULL,
+		proc_dointvec_minmax,
+		&sysctl_intvec,
+		NULL,
+		&khttpd_acceptbatch_min,
+		&khttpd_acceptbatch_max
+	},
+	{	NET_KHTTPD_LATENCY_P50,
+		"latency_p50",
+		&sysctl_khttpd_latency[0],
+		sizeof(int),
+		0444,
+		NULL,
+		khttpd_latency_proc_dointvec,
+		NULL,
+		NULL,
+		(void *)500,
+		NULL
+	},
+	{	NET_KHTTPD_LATENCY_P90,
+		"latency_p90",
+		&sysctl_khttpd_latency[1],
+		sizeof(int),
+		0444,
+		NULL,
+		khttpd_latency_proc_dointvec,
+		NULL,
+		NULL,
+		(void *)900,
+		NULL
+	},
+	{	NET_KHTTPD_LATENCY_P99,
+		"latency_p99",
+		&sysctl_khttpd_latency[2],
+		sizeof(int),
+		0444,
+		NULL,
+		khttpd_latency_proc_dointvec,
+		NULL,
+		NULL,
+		(void *)990,
+		NULL
+	},
+	{	NET_KHTTPD_CACHESIZE,
+		"cache_size",
+		&sysctl_khttpd_cachesize,
+		sizeof(int),
+		0644,
+		NULL,
+		khttpd_cache_proc_dointvec,
+		&sysctl_intvec,
+		NULL,
+		NULL,
+		NULL
+	},
+	{	NET_KHTTPD_CACHESTATS,
+		"cache_stats",
+		&sysctl_khttpd_cachestats,
+		sizeof(sysctl_khttpd_cachestats),
+		0444,
+		NULL,
+		khttpd_cache_proc_dointvec,
+		NULL,
+		NULL,
+		NULL,
+		NULL
+	},
 	{	NET_KHTTPD_DYNAMICSTRING,
 		"dynamic",
 		&sysctl_khttpd_dynamicstring,
@@ -328,6 +418,44 @@ static int khttpd_stop_wrap_proc_dointvec(ctl_table *table, int write, struct fi
 }
 		
 
+/* Percentiles are worked out from the histograms each time they are read.
+ * extra1 holds the percentile in thousandths.
+ */
+static int khttpd_latency_proc_dointvec(ctl_table *table, int write, struct file *filp,
+		  void *buffer, size_t *lenp)
+{
+	if (!write)
+		*(int *)table->data = LatencyPercentile((int)(long)table->extra1);
+	return proc_dointvec(table, write, filp, buffer, lenp);
+}
+
+/* cache_size shrinks the cache when lowered, cache_stats is filled in when read */
+static int khttpd_cache_proc_dointvec(ctl_table *table, int write, struct file *filp,
+		  void *buffer, size_t *lenp)
+{
+	int rv;
+
+	if (!write && table->data==sysctl_khttpd_cachestats)
+		GetCacheStats(sysctl_khttpd_cachestats);
+	rv = proc_dointvec(table, write, filp, buffer, lenp);
+	if (write && rv==0)
+		ShrinkCache();
+	return rv;
+}
+
+/* For settings that change which files kHTTPd serves itself */
+static int khttpd_flush_wrap_proc_dointvec(ctl_table *table, int write, struct file *filp,
+		  void *buffer, size_t *lenp)
+{
+	int rv;
+
+	rv = proc_dointvec(table, write, filp, buffer, lenp);
+	if (write && rv==0)
+		FlushCache();
+	return rv;
+}
+		
+
 static int sysctl_SecureString (/*@unused@*/ctl_table *table, 
 				/*@unused@*/int *name, 
 				/*@unused@*/int nlen,
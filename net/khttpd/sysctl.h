@@ -13,6 +13,8 @@ extern int 	sysctl_khttpd_serverport;
 extern int 	sysctl_khttpd_sloppymime;
 extern int 	sysctl_khttpd_threads;
 extern int	sysctl_khttpd_maxconnect;
+extern int	sysctl_khttpd_acceptbatch;
+extern int	sysctl_khttpd_cachesize;
 
 /* incremented each time sysctl_khttpd_stop goes nonzero */
 extern atomic_t	khttpd_stopCount;
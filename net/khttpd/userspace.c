@@ -66,63 +66,35 @@ static int AddSocketToAcceptQueue(struct socket *sock,const int Port);
 
 int Userspace(const int CPUNR)
 {
-	struct http_request *CurrentRequest,**Prev,*Next;
+	struct http_request *CurrentRequest;
+	struct list_head *Queue;
 	
 	EnterFunction("Userspace");
 
+	Queue = &threadinfo[CPUNR].UserspaceQueue;
 	
-
-	
-	CurrentRequest = threadinfo[CPUNR].UserspaceQueue;
-	Prev = &(threadinfo[CPUNR].UserspaceQueue);
-	
-	while (CurrentRequest!=NULL)
+	while (!list_empty(Queue))
 	{
+		CurrentRequest = list_entry(Queue->next,struct http_request,List);
+		list_del(&CurrentRequest->List);
 
-		/* Clean-up the waitqueue of the socket.. Bad things happen if
+		/* Give the socket its callbacks back.. Bad things happen if
 		   this is forgotten. */
-		if (CurrentRequest->sock!=NULL)
-		{
-			if ((CurrentRequest->sock!=NULL)&&(CurrentRequest->sock->sk!=NULL))
-			{
-				remove_wait_queue(CurrentRequest->sock->sk->sleep,&(CurrentRequest->sleep));
-			}
-		} 
-		
+		DetachRequest(CurrentRequest);
 
 		if  (AddSocketToAcceptQueue(CurrentRequest->sock,sysctl_khttpd_clientport)>=0)
 		{
-			
-			(*Prev) = CurrentRequest->Next;
-			Next = CurrentRequest->Next;
-			
-			
 			sock_release(CurrentRequest->sock);
 			CurrentRequest->sock = NULL;	 /* We no longer own it */
 			
 			CleanUpRequest(CurrentRequest); 
-				
-			CurrentRequest = Next;
-			continue;
-		
 		}
 		else /* No userspace-daemon present, or other problems with it */
 		{
-			(*Prev) = CurrentRequest->Next;
-			Next = CurrentRequest->Next;
-			
 			Send403(CurrentRequest->sock); /* Sorry, no go... */
 			
 			CleanUpRequest(CurrentRequest); 
-				
-			CurrentRequest = Next;
-			continue;
-		
 		}
-
-		
-		Prev = &(CurrentRequest->Next);	
-		CurrentRequest = CurrentRequest->Next;
 	}
 	
 	LeaveFunction("Userspace");
@@ -131,18 +103,18 @@ int Userspace(const int CPUNR)
 
 void StopUserspace(const int CPUNR)
 {
-	struct http_request *CurrentRequest,*Next;
+	struct http_request *CurrentRequest;
+	struct list_head *Queue;
 	
 	EnterFunction("StopUserspace");
-	CurrentRequest = threadinfo[CPUNR].UserspaceQueue;
+	Queue = &threadinfo[CPUNR].UserspaceQueue;
 
-	while (CurrentRequest!=NULL)
+	while (!list_empty(Queue))
 	{
-		Next= CurrentRequest->Next;
+		CurrentRequest = list_entry(Queue->next,struct http_request,List);
+		list_del(&CurrentRequest->List);
 		CleanUpRequest(CurrentRequest);
-		CurrentRequest=Next;		
 	}
-	threadinfo[CPUNR].UserspaceQueue = NULL;
 	
 	LeaveFunction("StopUserspace");
 }
@@ -26,12 +26,12 @@ Wait for headers on the accepted connections
 
 Purpose:
 
-WaitForHeaders polls all connections in "WaitForHeaderQueue" to see if
-headers have arived. If so, the headers are decoded and the request is
-moved to either the "SendingDataQueue" or the "UserspaceQueue".
+WaitForHeaders is called for a request in "WaitForHeaderQueue" when its
+socket had an event. If headers have arived, they are decoded and the
+request is moved to either the "SendingDataQueue" or the "UserspaceQueue".
 
 Return value:
-	The number of requests that changed status
+	1 if the request changed status, 0 otherwise
 */
 
 #include <linux/config.h>
@@ -51,109 +51,73 @@ static	char			*Buffer[CONFIG_KHTTPD_NUMCPU];
 static int DecodeHeader(const int CPUNR, struct http_request *Request);
 
 
-int WaitForHeaders(const int CPUNR)
+int WaitForHeaders(const int CPUNR, struct http_request *CurrentRequest)
 {
-	struct http_request *CurrentRequest,**Prev;
 	struct sock *sk;
-	int count = 0;
 	
 	EnterFunction("WaitForHeaders");
 	
-	CurrentRequest = threadinfo[CPUNR].WaitForHeaderQueue;
+	sk = CurrentRequest->sock->sk;
 	
-	Prev = &(threadinfo[CPUNR].WaitForHeaderQueue);
+	/* If the connection is lost, remove from queue */
 	
-	while (CurrentRequest!=NULL)
+	if (sk->state != TCP_ESTABLISHED && sk->state != TCP_CLOSE_WAIT)
 	{
+		list_del(&CurrentRequest->List);
+		CleanUpRequest(CurrentRequest);
+		LeaveFunction("WaitForHeaders - connection lost");
+		return 1;
+	}
+	
+	/* If no data pending, wait for the next event */
+	
+	if (skb_queue_empty(&(sk->receive_queue)))
+	{
+		LeaveFunction("WaitForHeaders - no data");
+		return 0;
+	}
+	
+	/* Decode header */
+	
+	if (DecodeHeader(CPUNR,CurrentRequest)<0)
+	{
+		LeaveFunction("WaitForHeaders - bad header");
+		return 0;
+	}
+	
+	/* Move to either the UserspaceQueue or the DataSendingQueue */
+	
+	if (CurrentRequest->IsForUserspace!=0)
+	{
+		list_move(&CurrentRequest->List,&threadinfo[CPUNR].UserspaceQueue);
+	} else
+	{
+		CurrentRequest->State = KHTTPD_SENDING;
+		list_move(&CurrentRequest->List,&threadinfo[CPUNR].DataSendingQueue);
 		
-		/* If the connection is lost, remove from queue */
-		
-		if (CurrentRequest->sock->sk->state != TCP_ESTABLISHED
-		    && CurrentRequest->sock->sk->state != TCP_CLOSE_WAIT)
-		{
-			struct http_request *Next;
-			
-			Next = CurrentRequest->Next;
-			
-			*Prev = CurrentRequest->Next;
-			CurrentRequest->Next = NULL;
-			
-		
-			CleanUpRequest(CurrentRequest);
-			CurrentRequest = Next;
-			continue;
-		}
-		
-		
-		
-		/* If data pending, take action */	
-		
-		sk = CurrentRequest->sock->sk;
-		
-		if (!skb_queue_empty(&(sk->receive_queue))) /* Do we have data ? */
-		{
-			struct http_request *Next;
-			
-			
-			
-			/* Decode header */
-			
-			if (DecodeHeader(CPUNR,CurrentRequest)<0)
-			{
-				CurrentRequest = CurrentRequest->Next;
-				continue;
-			} 
-			
-			
-			/* Remove from WaitForHeaderQueue */		
-			
-			Next= CurrentRequest->Next;
-		
-			*Prev = Next;
-			count++;
-			
-			/* Add to either the UserspaceQueue or the DataSendingQueue */
-			
-			if (CurrentRequest->IsForUserspace!=0)
-			{
-				CurrentRequest->Next = threadinfo[CPUNR].UserspaceQueue;
-				threadinfo[CPUNR].UserspaceQueue = CurrentRequest;	
-			} else
-			{
-				CurrentRequest->Next = threadinfo[CPUNR].DataSendingQueue;
-				threadinfo[CPUNR].DataSendingQueue = CurrentRequest;	
-			} 	
-			
-			CurrentRequest = Next;
-			continue;
-		
-		}	
-
-		
-		Prev = &(CurrentRequest->Next);
-		CurrentRequest = CurrentRequest->Next;
+		/* The socket is writable, no need to wait for an event */
+		RequestReady(CurrentRequest);
 	}
-
+	
 	LeaveFunction("WaitForHeaders");
-	return count;
+	return 1;
 }
 
 void StopWaitingForHeaders(const int CPUNR)
 {
-	struct http_request *CurrentRequest,*Next;
+	struct http_request *CurrentRequest;
+	struct list_head *Queue;
 	
 	EnterFunction("StopWaitingForHeaders");
-	CurrentRequest = threadinfo[CPUNR].WaitForHeaderQueue;
+	Queue = &threadinfo[CPUNR].WaitForHeaderQueue;
 
-	while (CurrentRequest!=NULL)
+	while (!list_empty(Queue))
 	{
-		Next = CurrentRequest->Next;
+		CurrentRequest = list_entry(Queue->next,struct http_request,List);
+		list_del(&CurrentRequest->List);
 		CleanUpRequest(CurrentRequest);
-		CurrentRequest=Next;		
 	}
 	
-	threadinfo[CPUNR].WaitForHeaderQueue = NULL; /* The queue is empty now */
-	
 	free_page((unsigned long)Buffer[CPUNR]);
 	Buffer[CPUNR]=NULL;
 	
@@ -173,6 +137,7 @@ static int DecodeHeader(const int CPUNR, struct http_request *Request)
 	struct msghdr		msg;
 	struct iovec		iov;
 	int			len;
+	char			URL[256];
 
 	mm_segment_t		oldfs;
 	
@@ -221,52 +186,58 @@ static int DecodeHeader(const int CPUNR, struct http_request *Request)
 	
 	ParseHeader(Buffer[CPUNR],len,Request);
 	
-	Request->filp = OpenFileForSecurity(Request->FileName);
-	
-	
-	Request->MimeType = ResolveMimeType(Request->FileName,&Request->MimeLength);
-	
-	
-	if (Request->MimeType==NULL) /* Unknown mime-type */
+	if (CacheLookup(Request)==0)
 	{
-		if (Request->filp!=NULL)
+		/* OpenFileForSecurity decodes the filename in place, the
+		   cache wants it the way it was asked for. */
+		memcpy(URL,Request->FileName,sizeof(URL));
+		
+		Request->filp = OpenFileForSecurity(Request->FileName);
+		
+		
+		Request->MimeType = ResolveMimeType(Request->FileName,&Request->MimeLength);
+		
+		
+		if (Request->MimeType==NULL) /* Unknown mime-type */
+		{
+			if (Request->filp!=NULL)
+			{
+				fput(Request->filp);
+				Request->filp = NULL;
+			}
+			Request->IsForUserspace = 1;
+			
+			return 0;
+		}
+
+		if (Request->filp==NULL)
 		{
-			fput(Request->filp);
-			Request->filp = NULL;
+			Request->IsForUserspace = 1;
+			return 0;
 		}
-		Request->IsForUserspace = 1;
 		
-		return 0;
-	}
-
-	if (Request->filp==NULL)
-	{
-		Request->IsForUserspace = 1;
-		return 0;
-	}
-	else
-	{
 		Request->FileLength = (int)Request->filp->f_dentry->d_inode->i_size;
 		Request->Time       = Request->filp->f_dentry->d_inode->i_mtime;
-		Request->IMS_Time   = mimeTime_to_UnixTime(Request->IMS);
 		sprintf(Request->LengthS,"%i",Request->FileLength);
 		time_Unix2RFC(min_t(unsigned int, Request->Time,CurrentTime_i),Request->TimeS);
    	        /* The min() is required by rfc1945, section 10.10:
    	           It is not allowed to send a filetime in the future */
-
-		if (Request->IMS_Time>Request->Time)
-		{	/* Not modified since last time */
-			Send304(Request->sock);
-			Request->FileLength=0;
-		}
-		else   /* Normal Case */
-		{
-			Request->sock->sk->tp_pinfo.af_tcp.nonagle = 2; /* this is TCP_CORK */
-			if (Request->HTTPVER!=9)  /* HTTP/0.9 doesn't allow a header */
-				SendHTTPHeader(Request);
-		}
 		
+		CacheInsert(Request,URL);
+	}
 	
+	Request->IMS_Time   = mimeTime_to_UnixTime(Request->IMS);
+
+	if (Request->IMS_Time>Request->Time)
+	{	/* Not modified since last time */
+		Send304(Request->sock);
+		Request->FileLength=0;
+	}
+	else   /* Normal Case */
+	{
+		Request->sock->sk->tp_pinfo.af_tcp.nonagle = 2; /* this is TCP_CORK */
+		if (Request->HTTPVER!=9)  /* HTTP/0.9 doesn't allow a header */
+			SendHTTPHeader(Request);
 	}
 	
 	LeaveFunction("DecodeHeader");
@@ -33,6 +33,7 @@
 #include <linux/if_bridge.h>
 #include <linux/if_vlan.h>
 #include <linux/random.h>
+#include <linux/rxpool.h>
 #ifdef CONFIG_NET_DIVERT
 #include <linux/divert.h>
 #endif /* CONFIG_NET_DIVERT */
@@ -98,6 +99,11 @@ extern int sysctl_max_syn_backlog;
 EXPORT_SYMBOL(skb_over_panic);
 EXPORT_SYMBOL(skb_under_panic);
 EXPORT_SYMBOL(skb_pad);
+EXPORT_SYMBOL(skb_rx_pool_create);
+EXPORT_SYMBOL(skb_rx_pool_destroy);
+EXPORT_SYMBOL(skb_rx_pool_alloc);
+EXPORT_SYMBOL(skb_rx_pool_receive);
+EXPORT_SYMBOL(skb_rx_pool_release);
 
 /* Socket layer registration */
 EXPORT_SYMBOL(sock_register);
@@ -154,6 +160,7 @@ EXPORT_SYMBOL(skb_copy_and_csum_datagram_iovec);
 EXPORT_SYMBOL(skb_copy_bits);
 EXPORT_SYMBOL(skb_copy_and_csum_bits);
 EXPORT_SYMBOL(skb_copy_and_csum_dev);
+EXPORT_SYMBOL(skb_segment);
 EXPORT_SYMBOL(skb_copy_expand);
 EXPORT_SYMBOL(___pskb_trim);
 EXPORT_SYMBOL(__pskb_pull_tail);
@@ -521,6 +528,7 @@ EXPORT_SYMBOL(dev_load);
 #endif
 EXPORT_SYMBOL(dev_ioctl);
 EXPORT_SYMBOL(dev_queue_xmit);
+EXPORT_SYMBOL(netdev_nit);
 #ifdef CONFIG_NET_HW_FLOWCONTROL
 EXPORT_SYMBOL(netdev_dropping);
 EXPORT_SYMBOL(netdev_register_fc);
@@ -169,7 +169,21 @@ struct packet_mclist
 };
 #endif
 #ifdef CONFIG_PACKET_MMAP
-static int packet_set_ring(struct sock *sk, struct tpacket_req *req, int closing);
+static int packet_set_ring(struct sock *sk, struct tpacket_req *req,
+			   int closing, int tx_ring);
+
+struct packet_ring
+{
+	unsigned long		*pg_vec;
+	unsigned int		pg_vec_order;
+	unsigned int		pg_vec_pages;
+	unsigned int		pg_vec_len;
+
+	struct tpacket_hdr	**iovec;
+	unsigned int		frame_size;
+	unsigned int		iovmax;
+	unsigned int		head;
+};
 #endif
 
 static void packet_flush_mclist(struct sock *sk);
@@ -186,19 +200,30 @@ struct packet_opt
 #endif
 #ifdef CONFIG_PACKET_MMAP
 	atomic_t		mapped;
-	unsigned long		*pg_vec;
-	unsigned int		pg_vec_order;
-	unsigned int		pg_vec_pages;
-	unsigned int		pg_vec_len;
-
-	struct tpacket_hdr	**iovec;
-	unsigned int		frame_size;
-	unsigned int		iovmax;
-	unsigned int		head;
+	struct packet_ring	rx_ring;
+	struct packet_ring	tx_ring;
+	atomic_t		tx_pending;	/* TX frames the device has */
+	struct tpacket_tx_stats	tx_stats;
+	struct timer_list	tx_free_timer;	/* see packet_sock_destruct */
 	int			copy_thresh;
 #endif
 };
 
+#ifdef CONFIG_PACKET_MMAP
+static void free_pg_vec(unsigned long *pg_vec, unsigned order, unsigned len);
+
+static void packet_free_tx_ring(unsigned long data)
+{
+	struct packet_opt *po = (struct packet_opt *)data;
+
+	free_pg_vec(po->tx_ring.pg_vec, po->tx_ring.pg_vec_order,
+		    po->tx_ring.pg_vec_len);
+	kfree(po->tx_ring.iovec);
+	kfree(po);
+	MOD_DEC_USE_COUNT;
+}
+#endif
+
 void packet_sock_destruct(struct sock *sk)
 {
 	BUG_TRAP(atomic_read(&sk->rmem_alloc)==0);
@@ -209,6 +234,25 @@ void packet_sock_destruct(struct sock *sk)
 		return;
 	}
 
+#ifdef CONFIG_PACKET_MMAP
+	/* packet_release() left the TX ring to frames the device was still
+	 * sending.  The last of them has just run its destructor, but
+	 * kfree_skb() has yet to drop its frags, which point into the ring:
+	 * free it a little later.
+	 */
+	if (sk->protinfo.af_packet && sk->protinfo.af_packet->tx_ring.pg_vec) {
+		struct packet_opt *po = sk->protinfo.af_packet;
+
+		atomic_dec(&packet_socks_nr);
+		init_timer(&po->tx_free_timer);
+		po->tx_free_timer.function = packet_free_tx_ring;
+		po->tx_free_timer.data = (unsigned long)po;
+		po->tx_free_timer.expires = jiffies + HZ;
+		add_timer(&po->tx_free_timer);
+		return;
+	}
+#endif
+
 	if (sk->protinfo.destruct_hook)
 		kfree(sk->protinfo.destruct_hook);
 	atomic_dec(&packet_socks_nr);
@@ -570,7 +614,7 @@ static int tpacket_rcv(struct sk_buff *skb, struct net_device *dev,  struct pack
 		macoff = netoff - maclen;
 	}
 
-	if (macoff + snaplen > po->frame_size) {
+	if (macoff + snaplen > po->rx_ring.frame_size) {
 		if (po->copy_thresh &&
 		    atomic_read(&sk->rmem_alloc) + skb->truesize < (unsigned)sk->rcvbuf) {
 			if (skb_shared(skb)) {
@@ -582,7 +626,7 @@ static int tpacket_rcv(struct sk_buff *skb, struct net_device *dev,  struct pack
 			if (copy_skb)
 				skb_set_owner_r(copy_skb, sk);
 		}
-		snaplen = po->frame_size - macoff;
+		snaplen = po->rx_ring.frame_size - macoff;
 		if ((int)snaplen < 0)
 			snaplen = 0;
 	}
@@ -590,11 +634,12 @@ static int tpacket_rcv(struct sk_buff *skb, struct net_device *dev,  struct pack
 		snaplen = skb->len-skb->data_len;
 
 	spin_lock(&sk->receive_queue.lock);
-	h = po->iovec[po->head];
+	h = po->rx_ring.iovec[po->rx_ring.head];
 
 	if (h->tp_status)
 		goto ring_is_full;
-	po->head = po->head != po->iovmax ? po->head+1 : 0;
+	po->rx_ring.head = po->rx_ring.head != po->rx_ring.iovmax ?
+			   po->rx_ring.head+1 : 0;
 	po->stats.tp_packets++;
 	if (copy_skb) {
 		status |= TP_STATUS_COPY;
@@ -659,6 +704,185 @@ ring_is_full:
 	goto drop_n_restore;
 }
 
+/* Frames shorter than this are always copied out of the TX ring */
+#define TPACKET_TX_COPYBREAK	256
+
+/* The device is done with a zero-copy TX ring frame: give it back to the
+ * user.
+ */
+static void tpacket_destruct_skb(struct sk_buff *skb)
+{
+	struct tpacket_hdr *h = *(struct tpacket_hdr **)skb->cb;
+
+	h->tp_status = TP_STATUS_AVAILABLE;
+	mb();
+	atomic_dec(&skb->sk->protinfo.af_packet->tx_pending);
+	sock_wfree(skb);
+}
+
+/*
+ * Build the skb for a TX ring frame. A large frame for a scatter-gather
+ * device is not copied: the skb points into the ring pages, which are
+ * reserved, so freeing the skb leaves them alone, and the frame is given
+ * back by tpacket_destruct_skb(). That is not done while there are taps,
+ * as their clones of the skb could outlive the frame, nor for loopback,
+ * which orphans the skb before it is done with it.
+ */
+static struct sk_buff *tpacket_tx_skb(struct sock *sk, struct net_device *dev,
+				      struct tpacket_hdr *h, int len,
+				      unsigned short proto, unsigned char *addr,
+				      int nonblock, int *err)
+{
+	u8 *data = (u8 *)h + TPACKET_TX_HDRLEN;
+	struct sk_buff *skb;
+	int hlen = len;		/* copied into the skb */
+	int i;
+
+	if ((dev->features & NETIF_F_SG) && !netdev_nit &&
+	    !(dev->flags & IFF_LOOPBACK) && len > TPACKET_TX_COPYBREAK) {
+		hlen = sk->type == SOCK_RAW ? dev->hard_header_len : 0;
+		if ((((unsigned long)data + hlen) & ~PAGE_MASK) + len - hlen >
+		    MAX_SKB_FRAGS*PAGE_SIZE)
+			hlen = len;
+	}
+
+	skb = sock_alloc_send_skb(sk, hlen+dev->hard_header_len+15,
+				  nonblock, err);
+	if (skb == NULL)
+		return NULL;
+
+	skb_reserve(skb, (dev->hard_header_len+15)&~15);
+	skb->nh.raw = skb->data;
+
+	if (dev->hard_header) {
+		int res;
+		res = dev->hard_header(skb, dev, ntohs(proto), addr, NULL, len);
+		if (sk->type != SOCK_DGRAM) {
+			skb->tail = skb->data;
+			skb->len = 0;
+		} else if (res < 0) {
+			kfree_skb(skb);
+			*err = -EINVAL;
+			return NULL;
+		}
+	}
+
+	memcpy(skb_put(skb, hlen), data, hlen);
+
+	data += hlen;
+	for (i = 0; hlen < len; i++) {
+		skb_frag_t *frag = &skb_shinfo(skb)->frags[i];
+
+		frag->page = virt_to_page(data);
+		frag->page_offset = (unsigned long)data & ~PAGE_MASK;
+		frag->size = min_t(int, len - hlen, PAGE_SIZE - frag->page_offset);
+		skb->len += frag->size;
+		skb->data_len += frag->size;
+		data += frag->size;
+		hlen += frag->size;
+	}
+	skb_shinfo(skb)->nr_frags = i;
+
+	skb->protocol = proto;
+	skb->dev = dev;
+	skb->priority = sk->priority;
+
+	if (i) {
+		*(struct tpacket_hdr **)skb->cb = h;
+		skb->destructor = tpacket_destruct_skb;
+	}
+	return skb;
+}
+
+/*
+ * send() on a socket with a TX ring: hand every frame the user has asked
+ * to be sent on to the device, in ring order. Returns the number of bytes
+ * queued.
+ */
+static int tpacket_snd(struct socket *sock, struct msghdr *msg)
+{
+	struct sock *sk = sock->sk;
+	struct packet_opt *po = sk->protinfo.af_packet;
+	struct packet_ring *ring = &po->tx_ring;
+	struct sockaddr_ll *saddr=(struct sockaddr_ll *)msg->msg_name;
+	struct tpacket_hdr *h;
+	struct sk_buff *skb;
+	struct net_device *dev;
+	unsigned short proto;
+	unsigned char *addr;
+	int ifindex, len, err, reserve = 0, total = 0;
+
+	if (saddr == NULL) {
+		ifindex	= po->ifindex;
+		proto	= sk->num;
+		addr	= NULL;
+	} else {
+		if (msg->msg_namelen < sizeof(struct sockaddr_ll))
+			return -EINVAL;
+		ifindex	= saddr->sll_ifindex;
+		proto	= saddr->sll_protocol;
+		addr	= saddr->sll_addr;
+	}
+
+	dev = dev_get_by_index(ifindex);
+	if (dev == NULL)
+		return -ENXIO;
+	if (sock->type == SOCK_RAW)
+		reserve = dev->hard_header_len;
+
+	lock_sock(sk);
+	err = -ENETDOWN;
+	if (!(dev->flags & IFF_UP))
+		goto out;
+
+	err = 0;
+	while (ring->iovec) {
+		h = ring->iovec[ring->head];
+		if (h->tp_status != TP_STATUS_SEND_REQUEST)
+			break;
+		rmb();
+
+		len = h->tp_len;
+		skb = NULL;
+		if (len > 0 && len <= dev->mtu+reserve &&
+		    TPACKET_TX_HDRLEN + len <= ring->frame_size) {
+			skb = tpacket_tx_skb(sk, dev, h, len, proto, addr,
+					     msg->msg_flags & MSG_DONTWAIT, &err);
+			if (skb == NULL && err != -EINVAL)
+				break;
+		}
+		ring->head = ring->head != ring->iovmax ? ring->head+1 : 0;
+		if (skb == NULL) {
+			h->tp_status = TP_STATUS_WRONG_FORMAT;
+			po->tx_stats.tp_wrong_format++;
+			err = 0;
+			continue;
+		}
+
+		/* A copied frame is done with as soon as it is copied */
+		if (skb_shinfo(skb)->nr_frags) {
+			h->tp_status = TP_STATUS_SENDING;
+			atomic_inc(&po->tx_pending);
+		} else {
+			h->tp_status = TP_STATUS_AVAILABLE;
+			mb();
+		}
+		po->tx_stats.tp_packets++;
+
+		err = dev_queue_xmit(skb);
+		if (err > 0 && (err = net_xmit_errno(err)) != 0) {
+			po->tx_stats.tp_drops++;
+			break;
+		}
+		total += len;
+	}
+
+out:
+	release_sock(sk);
+	dev_put(dev);
+	return total ? total : err;
+}
+
 #endif
 
 
@@ -673,6 +897,11 @@ static int packet_sendmsg(struct socket *sock, struct msghdr *msg, int len,
 	unsigned char *addr;
 	int ifindex, err, reserve = 0;
 
+#ifdef CONFIG_PACKET_MMAP
+	if (sk->protinfo.af_packet->tx_ring.pg_vec)
+		return tpacket_snd(sock, msg);
+#endif
+
 	/*
 	 *	Get and verify the address. 
 	 */
@@ -796,10 +1025,29 @@ static int packet_release(struct socket *sock)
 #endif
 
 #ifdef CONFIG_PACKET_MMAP
-	if (sk->protinfo.af_packet->pg_vec) {
+	if (sk->protinfo.af_packet->rx_ring.pg_vec) {
 		struct tpacket_req req;
 		memset(&req, 0, sizeof(req));
-		packet_set_ring(sk, &req, 1);
+		packet_set_ring(sk, &req, 1, 0);
+	}
+	if (sk->protinfo.af_packet->tx_ring.pg_vec) {
+		struct tpacket_req req;
+		int i;
+
+		/* The device may still be sending out of the ring. Give it
+		 * a second; after that the frames it holds keep the ring,
+		 * and packet_sock_destruct() frees it.
+		 */
+		for (i = 0; i < HZ; i++) {
+			if (!atomic_read(&sk->protinfo.af_packet->tx_pending))
+				break;
+			set_current_state(TASK_UNINTERRUPTIBLE);
+			schedule_timeout(1);
+		}
+		if (!atomic_read(&sk->protinfo.af_packet->tx_pending)) {
+			memset(&req, 0, sizeof(req));
+			packet_set_ring(sk, &req, 1, 1);
+		}
 	}
 #endif
 
@@ -1298,6 +1546,7 @@ packet_setsockopt(struct socket *sock, int level, int optname, char *optval, int
 #endif
 #ifdef CONFIG_PACKET_MMAP
 	case PACKET_RX_RING:
+	case PACKET_TX_RING:
 	{
 		struct tpacket_req req;
 
@@ -1305,7 +1554,7 @@ packet_setsockopt(struct socket *sock, int level, int optname, char *optval, int
 			return -EINVAL;
 		if (copy_from_user(&req,optval,sizeof(req)))
 			return -EFAULT;
-		return packet_set_ring(sk, &req, 0);
+		return packet_set_ring(sk, &req, 0, optname == PACKET_TX_RING);
 	}
 	case PACKET_COPY_THRESH:
 	{
@@ -1330,6 +1579,9 @@ int packet_getsockopt(struct socket *sock, int level, int optname,
 {
 	int len;
 	struct sock *sk = sock->sk;
+#ifdef CONFIG_PACKET_MMAP
+	struct packet_opt *po = sk->protinfo.af_packet;
+#endif
 
 	if (level != SOL_PACKET)
 		return -ENOPROTOOPT;
@@ -1357,6 +1609,48 @@ int packet_getsockopt(struct socket *sock, int level, int optname,
 			return -EFAULT;
 		break;
 	}
+#ifdef CONFIG_PACKET_MMAP
+	case PACKET_TX_STATISTICS:
+	{
+		struct tpacket_tx_stats st;
+
+		if (len > sizeof(st))
+			len = sizeof(st);
+		lock_sock(sk);
+		st = po->tx_stats;
+		st.tp_completed = st.tp_packets - atomic_read(&po->tx_pending);
+		release_sock(sk);
+
+		if (copy_to_user(optval, &st, len))
+			return -EFAULT;
+		break;
+	}
+	case PACKET_RING_FILL:
+	{
+		struct tpacket_fill fill;
+		int i;
+
+		if (len > sizeof(fill))
+			len = sizeof(fill);
+		memset(&fill, 0, sizeof(fill));
+		lock_sock(sk);
+		if (po->rx_ring.iovec) {
+			fill.tp_rx_frames = po->rx_ring.iovmax+1;
+			for (i = 0; i < fill.tp_rx_frames; i++)
+				if (po->rx_ring.iovec[i]->tp_status)
+					fill.tp_rx_user++;
+		}
+		if (po->tx_ring.iovec) {
+			fill.tp_tx_frames = po->tx_ring.iovmax+1;
+			fill.tp_tx_sending = atomic_read(&po->tx_pending);
+		}
+		release_sock(sk);
+
+		if (copy_to_user(optval, &fill, len))
+			return -EFAULT;
+		break;
+	}
+#endif
 	default:
 		return -ENOPROTOOPT;
 	}
@@ -1555,10 +1849,10 @@ unsigned int packet_poll(struct file * file, struct socket *sock, poll_table *wa
 	unsigned int mask = datagram_poll(file, sock, wait);
 
 	spin_lock_bh(&sk->receive_queue.lock);
-	if (po->iovec) {
-		unsigned last = po->head ? po->head-1 : po->iovmax;
+	if (po->rx_ring.iovec) {
+		unsigned last = po->rx_ring.head ? po->rx_ring.head-1 : po->rx_ring.iovmax;
 
-		if (po->iovec[last]->tp_status)
+		if (po->rx_ring.iovec[last]->tp_status)
 			mask |= POLLIN | POLLRDNORM;
 	}
 	spin_unlock_bh(&sk->receive_queue.lock);
@@ -1615,11 +1909,13 @@ static void free_pg_vec(unsigned long *pg_vec, unsigned order, unsigned len)
 }
 
 
-static int packet_set_ring(struct sock *sk, struct tpacket_req *req, int closing)
+static int packet_set_ring(struct sock *sk, struct tpacket_req *req,
+			   int closing, int tx_ring)
 {
 	unsigned long *pg_vec = NULL;
 	struct tpacket_hdr **io_vec = NULL;
 	struct packet_opt *po = sk->protinfo.af_packet;
+	struct packet_ring *ring = tx_ring ? &po->tx_ring : &po->rx_ring;
 	int order = 0;
 	int err = 0;
 
@@ -1692,39 +1988,48 @@ static int packet_set_ring(struct sock *sk, struct tpacket_req *req, int closing
 	lock_sock(sk);
 
 	/* Detach socket from network */
-	spin_lock(&po->bind_lock);
-	if (po->running)
-		dev_remove_pack(&po->prot_hook);
-	spin_unlock(&po->bind_lock);
+	if (!tx_ring) {
+		spin_lock(&po->bind_lock);
+		if (po->running)
+			dev_remove_pack(&po->prot_hook);
+		spin_unlock(&po->bind_lock);
+	}
 
 	err = -EBUSY;
-	if (closing || atomic_read(&po->mapped) == 0) {
+	if (closing || (atomic_read(&po->mapped) == 0 &&
+			(!tx_ring || atomic_read(&po->tx_pending) == 0))) {
 		err = 0;
 #define XC(a, b) ({ __typeof__ ((a)) __t; __t = (a); (a) = (b); __t; })
 
 		spin_lock_bh(&sk->receive_queue.lock);
-		pg_vec = XC(po->pg_vec, pg_vec);
-		io_vec = XC(po->iovec, io_vec);
-		po->iovmax = req->tp_frame_nr-1;
-		po->head = 0;
-		po->frame_size = req->tp_frame_size;
+		pg_vec = XC(ring->pg_vec, pg_vec);
+		io_vec = XC(ring->iovec, io_vec);
+		ring->iovmax = req->tp_frame_nr-1;
+		ring->head = 0;
+		ring->frame_size = req->tp_frame_size;
 		spin_unlock_bh(&sk->receive_queue.lock);
 
-		order = XC(po->pg_vec_order, order);
-		req->tp_block_nr = XC(po->pg_vec_len, req->tp_block_nr);
+		order = XC(ring->pg_vec_order, order);
+		req->tp_block_nr = XC(ring->pg_vec_len, req->tp_block_nr);
 
-		po->pg_vec_pages = req->tp_block_size/PAGE_SIZE;
-		po->prot_hook.func = po->iovec ? tpacket_rcv : packet_rcv;
-		skb_queue_purge(&sk->receive_queue);
+		ring->pg_vec_pages = req->tp_block_size/PAGE_SIZE;
+		if (tx_ring)
+			memset(&po->tx_stats, 0, sizeof(po->tx_stats));
+		else {
+			po->prot_hook.func = ring->iovec ? tpacket_rcv : packet_rcv;
+			skb_queue_purge(&sk->receive_queue);
+		}
 #undef XC
 		if (atomic_read(&po->mapped))
 			printk(KERN_DEBUG "packet_mmap: vma is busy: %d\n", atomic_read(&po->mapped));
 	}
 
-	spin_lock(&po->bind_lock);
-	if (po->running)
-		dev_add_pack(&po->prot_hook);
-	spin_unlock(&po->bind_lock);
+	if (!tx_ring) {
+		spin_lock(&po->bind_lock);
+		if (po->running)
+			dev_add_pack(&po->prot_hook);
+		spin_unlock(&po->bind_lock);
+	}
 
 	release_sock(sk);
 
@@ -1742,31 +2047,39 @@ static int packet_mmap(struct file *file, struct socket *sock, struct vm_area_st
 {
 	struct sock *sk = sock->sk;
 	struct packet_opt *po = sk->protinfo.af_packet;
-	unsigned long size;
+	struct packet_ring *rings[2] = { &po->rx_ring, &po->tx_ring };
+	unsigned long size, expected;
 	unsigned long start;
 	int err = -EINVAL;
-	int i;
+	int i, r;
 
 	if (vma->vm_pgoff)
 		return -EINVAL;
 
 	size = vma->vm_end - vma->vm_start;
 
+	/* The RX ring, followed by the TX ring */
 	lock_sock(sk);
-	if (po->pg_vec == NULL)
-		goto out;
-	if (size != po->pg_vec_len*po->pg_vec_pages*PAGE_SIZE)
+	expected = 0;
+	for (r=0; r<2; r++)
+		if (rings[r]->pg_vec)
+			expected += rings[r]->pg_vec_len*rings[r]->pg_vec_pages*PAGE_SIZE;
+	if (expected == 0 || size != expected)
 		goto out;
 
 	atomic_inc(&po->mapped);
 	start = vma->vm_start;
 	err = -EAGAIN;
-	for (i=0; i<po->pg_vec_len; i++) {
-		if (remap_page_range(start, __pa(po->pg_vec[i]),
-				     po->pg_vec_pages*PAGE_SIZE,
-				     vma->vm_page_prot))
-			goto out;
-		start += po->pg_vec_pages*PAGE_SIZE;
+	for (r=0; r<2; r++) {
+		struct packet_ring *ring = rings[r];
+
+		for (i=0; ring->pg_vec && i<ring->pg_vec_len; i++) {
+			if (remap_page_range(start, __pa(ring->pg_vec[i]),
+					     ring->pg_vec_pages*PAGE_SIZE,
+					     vma->vm_page_prot))
+				goto out;
+			start += ring->pg_vec_pages*PAGE_SIZE;
+		}
 	}
 	vma->vm_ops = &packet_mmap_ops;
 	err = 0;
@@ -751,7 +751,13 @@ static int tc_fill_qdisc(struct sk_buff *skb, struct Qdisc *q, u32 clid,
 	if (q->ops->dump && q->ops->dump(q, skb) < 0)
 		goto rtattr_failure;
 	q->stats.qlen = q->q.qlen;
-	if (qdisc_copy_stats(skb, &q->stats))
+	if (q->cpu_stats) {
+		struct tc_stats st;
+
+		qdisc_fold_stats(q, &st);
+		if (qdisc_copy_stats(skb, &st))
+			goto rtattr_failure;
+	} else if (qdisc_copy_stats(skb, &q->stats))
 		goto rtattr_failure;
 	nlh->nlmsg_len = skb->tail - b;
 	return skb->len;
@@ -1232,6 +1238,9 @@ int __init pktsched_init(void)
 #ifdef CONFIG_NET_SCH_SFQ
 	INIT_QDISC(sfq);
 #endif
+#ifdef CONFIG_NET_SCH_FQ
+	INIT_QDISC(fq);
+#endif
 #ifdef CONFIG_NET_SCH_TBF
 	INIT_QDISC(tbf);
 #endif
@@ -0,0 +1,776 @@
+/*
+ * net/sched/sch_fq.c	Fair Queueing discipline with a dynamic flow table.
+ *
+ *		This program is free software; you can redistribute it and/or
+ *		modify it under the terms of the GNU General Public License
+ *		as published by the Free Software Foundation; either version
+ *		2 of the License, or (at your option) any later version.
+ */
+
+#include <linux/config.h>
+#include <linux/module.h>
+#include <asm/uaccess.h>
+#include <asm/system.h>
+#include <asm/bitops.h>
+#include <asm/div64.h>
+#include <linux/types.h>
+#include <linux/kernel.h>
+#include <linux/sched.h>
+#include <linux/string.h>
+#include <linux/ctype.h>
+#include <linux/mm.h>
+#include <linux/slab.h>
+#include <linux/socket.h>
+#include <linux/sockios.h>
+#include <linux/in.h>
+#include <linux/errno.h>
+#include <linux/interrupt.h>
+#include <linux/if_ether.h>
+#include <linux/inet.h>
+#include <linux/netdevice.h>
+#include <linux/etherdevice.h>
+#include <linux/init.h>
+#include <linux/proc_fs.h>
+#include <linux/jhash.h>
+#include <net/ip.h>
+#include <linux/ipv6.h>
+#include <net/route.h>
+#include <linux/skbuff.h>
+#include <net/sock.h>
+#include <net/pkt_sched.h>
+
+
+/*	Fair Queuing with a dynamic flow table.
+	=======================================
+
+	The same deficit round robin as SFQ, for when there are too many
+	flows for it:
+
+	- Flows are told apart by their full address/port/protocol key,
+	  not by a 10 bit hash, so they do not share a queue. The key is
+	  hashed with a secret chosen once; there is no perturbation, so
+	  packets of a flow are never reordered.
+
+	- A flow exists only while it has packets queued. The hash table
+	  grows as flows are added, up to FQ_MAX_BUCKETS, and shrinks when
+	  most of them are gone. When there is no memory for a new table,
+	  resizing is left alone for a second.
+
+	- The deficit is kept in bytes: a flow is served until it has
+	  used up its quantum, and the excess is carried over into its
+	  next round.
+
+	- Each flow may hold "flow_limit" bytes of skb memory; packets
+	  beyond that are dropped at once. When the whole queue is over
+	  "limit" packets, the head packet of the fattest flow is dropped.
+	  Flows are kept on lists by the power of two of their backlog, so
+	  a flow at most twice smaller than the fattest one is found at
+	  once.
+
+	All operations cost the same whatever the number of flows, except
+	the resizes of the table, which are amortized. With
+	CONFIG_NET_SCH_FQ_BENCH, /proc/net/fq_bench measures it.
+ */
+
+#define FQ_MIN_BUCKETS	(PAGE_SIZE/sizeof(struct fq_flow *))
+#define FQ_MAX_BUCKETS	32768
+#define FQ_LIMIT	10240		/* packets */
+#define FQ_FLOW_LIMIT	(128*1024)	/* bytes of skb memory */
+#define FQ_CLASSES	32
+
+struct fq_key
+{
+	u32		src[4];		/* IPv4 uses the first word */
+	u32		dst[4];
+	u32		ports;
+	u32		proto;
+};
+
+struct fq_flow
+{
+	struct fq_flow		*next;		/* Hash chain */
+	struct list_head	list;		/* Round robin */
+	struct list_head	fat;		/* Flows of the same backlog class */
+	struct sk_buff_head	q;
+	struct fq_key		key;
+	u32			hash;
+	int			deficit;
+	unsigned int		backlog;	/* bytes */
+	unsigned int		mem;		/* skb truesize */
+	int			class;		/* fq_fls(backlog) */
+};
+
+struct fq_sched_data
+{
+/* Parameters */
+	unsigned	quantum;
+	u32		limit;
+	u32		flow_limit;
+
+/* Variables */
+	struct fq_flow	**ht;
+	unsigned	hash_mask;
+	int		ht_order;
+	u32		hash_rnd;
+	unsigned	flows;
+	int		resize_failed;
+	unsigned long	resize_retry;		/* jiffies */
+	struct list_head active;		/* Flows in round robin order */
+	u32		fat_map;		/* Non empty classes */
+	struct list_head fat[FQ_CLASSES];
+	struct tc_fq_xstats xstats;
+};
+
+static kmem_cache_t *fq_flow_cachep;
+
+static __inline__ int fq_fls(u32 x)
+{
+	int r = 0;
+
+	while (x) {
+		x >>= 1;
+		r++;
+	}
+	return r;
+}
+
+static void fq_flow_key(struct sk_buff *skb, struct fq_key *key)
+{
+	memset(key, 0, sizeof(*key));
+
+	switch (skb->protocol) {
+	case __constant_htons(ETH_P_IP):
+	{
+		struct iphdr *iph = skb->nh.iph;
+		key->src[0] = iph->saddr;
+		key->dst[0] = iph->daddr;
+		key->proto = iph->protocol;
+		if (!(iph->frag_off&htons(IP_MF|IP_OFFSET)) &&
+		    (iph->protocol == IPPROTO_TCP ||
+		     iph->protocol == IPPROTO_UDP ||
+		     iph->protocol == IPPROTO_ESP))
+			key->ports = *(((u32*)iph) + iph->ihl);
+		break;
+	}
+	case __constant_htons(ETH_P_IPV6):
+	{
+		struct ipv6hdr *iph = skb->nh.ipv6h;
+		memcpy(key->src, iph->saddr.s6_addr32, sizeof(key->src));
+		memcpy(key->dst, iph->daddr.s6_addr32, sizeof(key->dst));
+		key->proto = iph->nexthdr;
+		if (iph->nexthdr == IPPROTO_TCP ||
+		    iph->nexthdr == IPPROTO_UDP ||
+		    iph->nexthdr == IPPROTO_ESP)
+			key->ports = *(u32*)&iph[1];
+		break;
+	}
+	default:
+		key->src[0] = (u32)(unsigned long)skb->sk;
+		key->dst[0] = (u32)(unsigned long)skb->dst;
+		key->proto = skb->protocol;
+	}
+}
+
+static __inline__ int fq_key_equal(struct fq_key *a, struct fq_key *b)
+{
+	return memcmp(a, b, sizeof(*a)) == 0;
+}
+
+/* The addresses are folded for the hash only, the key stays whole */
+static __inline__ u32 fq_key_hash(struct fq_sched_data *q, struct fq_key *key)
+{
+	return jhash_3words(key->src[0]^key->src[1]^key->src[2]^key->src[3],
+			    key->dst[0]^key->dst[1]^key->dst[2]^key->dst[3],
+			    key->ports, q->hash_rnd ^ key->proto);
+}
+
+/* Rehash all the flows into a table of "buckets" chains */
+static int fq_resize(struct fq_sched_data *q, unsigned buckets, int gfp)
+{
+	int order = get_order(buckets*sizeof(struct fq_flow *));
+	struct fq_flow **ht, *f, *next;
+	unsigned i;
+
+	ht = (struct fq_flow **)__get_free_pages(gfp, order);
+	if (ht == NULL)
+		return -ENOMEM;
+	memset(ht, 0, buckets*sizeof(struct fq_flow *));
+
+	if (q->ht) {
+		for (i = 0; i <= q->hash_mask; i++) {
+			for (f = q->ht[i]; f; f = next) {
+				next = f->next;
+				f->next = ht[f->hash & (buckets-1)];
+				ht[f->hash & (buckets-1)] = f;
+			}
+		}
+		free_pages((unsigned long)q->ht, q->ht_order);
+		q->xstats.resizes++;
+	}
+	q->ht = ht;
+	q->ht_order = order;
+	q->hash_mask = buckets-1;
+	return 0;
+}
+
+/* Resize from the packet path. After a failed allocation this is not
+   tried again for a second, rather than for every new or freed flow. */
+static void fq_try_resize(struct fq_sched_data *q, unsigned buckets)
+{
+	if (q->resize_failed && time_before(jiffies, q->resize_retry))
+		return;
+	q->resize_failed = fq_resize(q, buckets, GFP_ATOMIC) != 0;
+	if (q->resize_failed)
+		q->resize_retry = jiffies + HZ;
+}
+
+/* Move the flow to the list of its backlog class */
+static __inline__ void fq_reclass(struct fq_sched_data *q, struct fq_flow *f)
+{
+	int c = f->class;
+
+	if (c && f->backlog >= (1U<<(c-1)) && (c == 32 || f->backlog < (1U<<c)))
+		return;
+
+	if (c) {
+		list_del(&f->fat);
+		if (list_empty(&q->fat[c-1]))
+			q->fat_map &= ~(1U<<(c-1));
+	}
+	f->class = c = fq_fls(f->backlog);
+	if (c) {
+		list_add_tail(&f->fat, &q->fat[c-1]);
+		q->fat_map |= 1U<<(c-1);
+	}
+}
+
+static struct fq_flow *fq_classify(struct fq_sched_data *q, struct sk_buff *skb)
+{
+	struct fq_flow *f;
+	struct fq_key key;
+	u32 hash;
+
+	fq_flow_key(skb, &key);
+	hash = fq_key_hash(q, &key);
+
+	for (f = q->ht[hash & q->hash_mask]; f; f = f->next)
+		if (f->hash == hash && fq_key_equal(&f->key, &key))
+			return f;
+
+	f = kmem_cache_alloc(fq_flow_cachep, GFP_ATOMIC);
+	if (f == NULL)
+		return NULL;
+	skb_queue_head_init(&f->q);
+	f->key = key;
+	f->hash = hash;
+	f->deficit = q->quantum;
+	f->backlog = 0;
+	f->mem = 0;
+	f->class = 0;
+	f->next = q->ht[hash & q->hash_mask];
+	q->ht[hash & q->hash_mask] = f;
+	INIT_LIST_HEAD(&f->list);
+
+	/* Keep the chains short. If there is no memory for a bigger
+	   table now, fq_try_resize() backs off for a while. */
+	if (++q->flows > q->hash_mask+1 && q->hash_mask+1 < FQ_MAX_BUCKETS)
+		fq_try_resize(q, (q->hash_mask+1)*2);
+	return f;
+}
+
+/* The flow has no packets left */
+static void fq_flow_free(struct fq_sched_data *q, struct fq_flow *f)
+{
+	struct fq_flow **fp;
+
+	for (fp = &q->ht[f->hash & q->hash_mask]; *fp != f; fp = &(*fp)->next)
+		;
+	*fp = f->next;
+	list_del(&f->list);
+	fq_reclass(q, f);
+	kmem_cache_free(fq_flow_cachep, f);
+
+	if (--q->flows < (q->hash_mask+1)/8 && q->hash_mask+1 > FQ_MIN_BUCKETS)
+		fq_try_resize(q, (q->hash_mask+1)/2);
+}
+
+static __inline__ struct sk_buff *
+fq_flow_dequeue(struct Qdisc *sch, struct fq_flow *f)
+{
+	struct fq_sched_data *q = (struct fq_sched_data *)sch->data;
+	struct sk_buff *skb = __skb_dequeue(&f->q);
+
+	f->backlog -= skb->len;
+	f->mem -= skb->truesize;
+	sch->q.qlen--;
+	if (skb_queue_empty(&f->q))
+		fq_flow_free(q, f);
+	else
+		fq_reclass(q, f);
+	return skb;
+}
+
+static unsigned int fq_drop(struct Qdisc *sch)
+{
+	struct fq_sched_data *q = (struct fq_sched_data *)sch->data;
+	struct fq_flow *f;
+	struct sk_buff *skb;
+	unsigned int len;
+	int c;
+
+	/* Drop the oldest packet of the fattest flow */
+	c = fq_fls(q->fat_map);
+	if (c == 0)
+		return 0;
+
+	f = list_entry(q->fat[c-1].next, struct fq_flow, fat);
+	skb = fq_flow_dequeue(sch, f);
+	len = skb->len;
+	kfree_skb(skb);
+	sch->stats.drops++;
+	return len;
+}
+
+static int
+fq_enqueue(struct sk_buff *skb, struct Qdisc* sch)
+{
+	struct fq_sched_data *q = (struct fq_sched_data *)sch->data;
+	struct fq_flow *f;
+
+	f = fq_classify(q, skb);
+	if (f == NULL) {
+		q->xstats.alloc_fails++;
+		goto drop;
+	}
+	if (f->mem && f->mem + skb->truesize > q->flow_limit) {
+		q->xstats.flow_drops++;
+		goto drop;
+	}
+
+	__skb_queue_tail(&f->q, skb);
+	f->backlog += skb->len;
+	f->mem += skb->truesize;
+	fq_reclass(q, f);
+	if (list_empty(&f->list))		/* The flow is new */
+		list_add_tail(&f->list, &q->active);
+
+	sch->stats.bytes += skb->len;
+	sch->stats.packets++;
+	if (++sch->q.qlen <= q->limit)
+		return 0;
+
+	q->xstats.fat_drops++;
+	fq_drop(sch);
+	return NET_XMIT_CN;
+
+drop:
+	sch->stats.drops++;
+	kfree_skb(skb);
+	return NET_XMIT_DROP;
+}
+
+static int
+fq_requeue(struct sk_buff *skb, struct Qdisc* sch)
+{
+	struct fq_sched_data *q = (struct fq_sched_data *)sch->data;
+	struct fq_flow *f;
+
+	f = fq_classify(q, skb);
+	if (f == NULL) {
+		q->xstats.alloc_fails++;
+		sch->stats.drops++;
+		kfree_skb(skb);
+		return NET_XMIT_DROP;
+	}
+
+	/* It was the flow served last: give it the turn back */
+	__skb_queue_head(&f->q, skb);
+	f->backlog += skb->len;
+	f->mem += skb->truesize;
+	fq_reclass(q, f);
+	if (list_empty(&f->list))
+		list_add(&f->list, &q->active);
+	else
+		f->deficit += skb->len;
+	sch->q.qlen++;
+	return 0;
+}
+
+static struct sk_buff *
+fq_dequeue(struct Qdisc* sch)
+{
+	struct fq_sched_data *q = (struct fq_sched_data *)sch->data;
+	struct fq_flow *f;
+	struct sk_buff *skb;
+
+	while (!list_empty(&q->active)) {
+		f = list_entry(q->active.next, struct fq_flow, list);
+
+		if (f->deficit <= 0) {
+			/* Done for this round */
+			f->deficit += q->quantum;
+			list_del(&f->list);
+			list_add_tail(&f->list, &q->active);
+			continue;
+		}
+
+		f->deficit -= f->q.next->len;
+		skb = fq_flow_dequeue(sch, f);
+		return skb;
+	}
+	return NULL;
+}
+
+static void
+fq_reset(struct Qdisc* sch)
+{
+	struct sk_buff *skb;
+
+	while ((skb = fq_dequeue(sch)) != NULL)
+		kfree_skb(skb);
+}
+
+static int fq_set(struct fq_sched_data *q, struct tc_fq_qopt *ctl)
+{
+	if (ctl->quantum)
+		q->quantum = ctl->quantum;
+	if (ctl->limit)
+		q->limit = ctl->limit;
+	if (ctl->flow_limit)
+		q->flow_limit = ctl->flow_limit;
+	return 0;
+}
+
+static int fq_change(struct Qdisc *sch, struct rtattr *opt)
+{
+	struct fq_sched_data *q = (struct fq_sched_data *)sch->data;
+	struct tc_fq_qopt *ctl = RTA_DATA(opt);
+
+	if (opt->rta_len < RTA_LENGTH(sizeof(*ctl)))
+		return -EINVAL;
+
+	sch_tree_lock(sch);
+	fq_set(q, ctl);
+	while (sch->q.qlen > q->limit)
+		fq_drop(sch);
+	sch_tree_unlock(sch);
+	return 0;
+}
+
+/* Everything but the parameters, which may be set before or after */
+static int fq_setup(struct fq_sched_data *q, unsigned buckets)
+{
+	int i;
+
+	if (fq_flow_cachep == NULL) {
+		fq_flow_cachep = kmem_cache_create("fq_flow", sizeof(struct fq_flow),
+						   0, SLAB_HWCACHE_ALIGN, NULL, NULL);
+		if (fq_flow_cachep == NULL)
+			return -ENOMEM;
+	}
+
+	if (buckets < FQ_MIN_BUCKETS)
+		buckets = FQ_MIN_BUCKETS;
+	if (buckets > FQ_MAX_BUCKETS)
+		buckets = FQ_MAX_BUCKETS;
+	buckets = 1U<<(fq_fls(buckets-1));
+	if (fq_resize(q, buckets, GFP_KERNEL))
+		return -ENOMEM;
+
+	INIT_LIST_HEAD(&q->active);
+	for (i=0; i<FQ_CLASSES; i++)
+		INIT_LIST_HEAD(&q->fat[i]);
+	q->hash_rnd = net_random();
+	return 0;
+}
+
+static int fq_init(struct Qdisc *sch, struct rtattr *opt)
+{
+	struct fq_sched_data *q = (struct fq_sched_data *)sch->data;
+	struct tc_fq_qopt *ctl = NULL;
+	int err;
+
+	if (opt) {
+		ctl = RTA_DATA(opt);
+		if (opt->rta_len < RTA_LENGTH(sizeof(*ctl)))
+			return -EINVAL;
+	}
+
+	q->quantum = psched_mtu(sch->dev);
+	q->limit = FQ_LIMIT;
+	q->flow_limit = FQ_FLOW_LIMIT;
+	if (ctl)
+		fq_set(q, ctl);
+
+	err = fq_setup(q, ctl ? ctl->buckets : 0);
+	if (err)
+		return err;
+	MOD_INC_USE_COUNT;
+	return 0;
+}
+
+static void fq_destroy(struct Qdisc *sch)
+{
+	struct fq_sched_data *q = (struct fq_sched_data *)sch->data;
+
+	fq_reset(sch);
+	free_pages((unsigned long)q->ht, q->ht_order);
+	MOD_DEC_USE_COUNT;
+}
+
+static int fq_dump(struct Qdisc *sch, struct sk_buff *skb)
+{
+	struct fq_sched_data *q = (struct fq_sched_data *)sch->data;
+	unsigned char	 *b = skb->tail;
+	struct tc_fq_qopt opt;
+
+	opt.quantum = q->quantum;
+	opt.limit = q->limit;
+	opt.flow_limit = q->flow_limit;
+	opt.buckets = q->hash_mask+1;
+	RTA_PUT(skb, TCA_OPTIONS, sizeof(opt), &opt);
+
+	q->xstats.flows = q->flows;
+	q->xstats.buckets = q->hash_mask+1;
+	RTA_PUT(skb, TCA_XSTATS, sizeof(q->xstats), &q->xstats);
+
+	return skb->len;
+
+rtattr_failure:
+	skb_trim(skb, b - skb->data);
+	return -1;
+}
+
+struct Qdisc_ops fq_qdisc_ops =
+{
+	NULL,
+	NULL,
+	"fq",
+	sizeof(struct fq_sched_data),
+
+	fq_enqueue,
+	fq_dequeue,
+	fq_requeue,
+	fq_drop,
+
+	fq_init,
+	fq_reset,
+	fq_destroy,
+	fq_change,
+
+	fq_dump,
+};
+
+#ifdef CONFIG_NET_SCH_FQ_BENCH
+/*
+ * Dequeue benchmark.
+ *
+ * Each read of /proc/net/fq_bench fills a private fq queue with
+ * `packets' small UDP packets for each of 16, 64, 256 ... up to `flows'
+ * flows, empties it, and reports the cost per packet of both. Write
+ * "flows packets" (e.g. "65536 2") to set them.
+ */
+
+static int fq_bench_flows = 16384;
+static int fq_bench_packets = 4;
+
+#define FQ_BENCH_MAX	262144		/* packets in the queue at once */
+
+static struct sk_buff *fq_bench_skb(int flow)
+{
+	struct sk_buff *skb;
+	struct iphdr *iph;
+
+	skb = alloc_skb(64, GFP_KERNEL);
+	if (skb == NULL)
+		return NULL;
+	skb_reserve(skb, 16);
+	iph = (struct iphdr *)skb_put(skb, sizeof(struct iphdr) + 8);
+	memset(iph, 0, sizeof(struct iphdr) + 8);
+	iph->version = 4;
+	iph->ihl = 5;
+	iph->protocol = IPPROTO_UDP;
+	iph->saddr = htonl(0x0a000000 | (flow >> 8));
+	iph->daddr = htonl(0x0a800001);
+	*(u32 *)(iph + 1) = htonl(((1024 + (flow & 0xff)) << 16) | 9);
+	skb->nh.iph = iph;
+	skb->protocol = htons(ETH_P_IP);
+	return skb;
+}
+
+static unsigned long fq_bench_usec(struct timeval *start, struct timeval *end)
+{
+	long usec = (end->tv_sec - start->tv_sec) * 1000000L
+		+ (end->tv_usec - start->tv_usec);
+
+	return usec > 0 ? usec : 1;
+}
+
+/* Returns the length of the line printed, or -ENOMEM */
+static int fq_bench_run(char *buffer, int flows, int packets)
+{
+	struct Qdisc *sch;
+	struct fq_sched_data *q;
+	struct sk_buff *skb, *list = NULL;
+	struct timeval tv_start, tv_mid, tv_end;
+	unsigned long enq, deq, n = 0;
+	u64 ns;
+	int i, err = -ENOMEM;
+
+	sch = kmalloc(sizeof(*sch) + sizeof(*q), GFP_KERNEL);
+	if (sch == NULL)
+		return -ENOMEM;
+	memset(sch, 0, sizeof(*sch) + sizeof(*q));
+	skb_queue_head_init(&sch->q);
+	q = (struct fq_sched_data *)sch->data;
+	q->quantum = 1514;
+	q->limit = ~0U;
+	q->flow_limit = ~0U;
+	if (fq_setup(q, 0))
+		goto out;
+
+	/* Packets are made beforehand, so only the qdisc is timed. Round
+	   robin over the flows, as they would arrive. */
+	for (i = 0; i < flows*packets; i++) {
+		skb = fq_bench_skb(i % flows);
+		if (skb == NULL)
+			goto out_free;
+		skb->next = list;
+		list = skb;
+		if ((i & 1023) == 0 && current->need_resched)
+			schedule();
+	}
+
+	do_gettimeofday(&tv_start);
+	while ((skb = list) != NULL) {
+		list = skb->next;
+		skb->next = NULL;
+		fq_enqueue(skb, sch);
+	}
+	do_gettimeofday(&tv_mid);
+	while ((skb = fq_dequeue(sch)) != NULL) {
+		skb->next = list;
+		list = skb;
+		n++;
+	}
+	do_gettimeofday(&tv_end);
+
+	ns = (u64)fq_bench_usec(&tv_start, &tv_mid) * 1000;
+	do_div(ns, flows*packets);
+	enq = (unsigned long)ns;
+	ns = (u64)fq_bench_usec(&tv_mid, &tv_end) * 1000;
+	do_div(ns, flows*packets);
+	deq = (unsigned long)ns;
+
+	err = sprintf(buffer, "%7d flows %3d pkts %6u buckets %6lu ns/enqueue"
+		      " %6lu ns/dequeue %9lu out %6u resizes\n",
+		      flows, packets, q->hash_mask+1, enq, deq, n,
+		      q->xstats.resizes);
+
+out_free:
+	while ((skb = list) != NULL) {
+		list = skb->next;
+		skb->next = NULL;
+		kfree_skb(skb);
+	}
+	fq_reset(sch);
+	free_pages((unsigned long)q->ht, q->ht_order);
+out:
+	kfree(sch);
+	return err;
+}
+
+static int fq_bench_read(char *buffer, char **start, off_t offset,
+			 int length, int *eof, void *data)
+{
+	int flows, len = 0, ret;
+
+	/* One shot: every read reruns the measurement. */
+	if (offset > 0) {
+		*eof = 1;
+		return 0;
+	}
+
+	for (flows = 16; ; flows *= 4) {
+		if (flows > fq_bench_flows)
+			flows = fq_bench_flows;
+		if (len + 128 > PAGE_SIZE)
+			break;
+		ret = fq_bench_run(buffer + len, flows, fq_bench_packets);
+		if (ret < 0) {
+			len += sprintf(buffer + len, "%7d flows: out of memory\n", flows);
+			break;
+		}
+		len += ret;
+		if (flows == fq_bench_flows)
+			break;
+		if (current->need_resched)
+			schedule();
+	}
+
+	*eof = 1;
+	*start = buffer;
+	return len > length ? length : len;
+}
+
+static int fq_bench_write(struct file *file, const char *buffer,
+			  unsigned long count, void *data)
+{
+	char buf[32], *p;
+	unsigned long flows, packets;
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+	if (copy_from_user(buf, buffer, count))
+		return -EFAULT;
+	buf[count] = '\0';
+
+	flows = simple_strtoul(buf, &p, 0);
+	while (isspace(*p))
+		p++;
+	packets = simple_strtoul(p, NULL, 0);
+
+	if (flows == 0 || packets == 0 || flows > FQ_BENCH_MAX ||
+	    flows*packets > FQ_BENCH_MAX)
+		return -EINVAL;
+
+	fq_bench_flows = flows;
+	fq_bench_packets = packets;
+	return count;
+}
+
+static int __init fq_bench_init(void)
+{
+	struct proc_dir_entry *ent;
+
+	ent = create_proc_entry("net/fq_bench", S_IFREG|S_IRUSR|S_IWUSR, 0);
+	if (ent) {
+		ent->read_proc = fq_bench_read;
+		ent->write_proc = fq_bench_write;
+	}
+	return 0;
+}
+#endif
+
+#ifdef MODULE
+int init_module(void)
+{
+#ifdef CONFIG_NET_SCH_FQ_BENCH
+	fq_bench_init();
+#endif
+	return register_qdisc(&fq_qdisc_ops);
+}
+
+void cleanup_module(void)
+{
+#ifdef CONFIG_NET_SCH_FQ_BENCH
+	remove_proc_entry("net/fq_bench", 0);
+#endif
+	unregister_qdisc(&fq_qdisc_ops);
+	if (fq_flow_cachep)
+		kmem_cache_destroy(fq_flow_cachep);
+}
+#elif defined(CONFIG_NET_SCH_FQ_BENCH)
+__initcall(fq_bench_init);
+#endif
+MODULE_LICENSE("GPL");
@@ -72,15 +72,29 @@ rwlock_t qdisc_tree_lock = RW_LOCK_UNLOCKED;
 	    <0  - queue is not empty. Device is throttled, if dev->tbusy != 0.
 
    NOTE: Called under dev->queue_lock with locally disabled BH.
+
+   A FIFO qdisc (TCQ_F_CAN_BYPASS) gives up to QDISC_RESTART_BATCH
+   packets at a time, which then go to the driver under one hold of
+   dev->xmit_lock. What the driver does not take is requeued, last
+   packet first, so the queue is as it was.
 */
 
+#define QDISC_RESTART_BATCH	8
+
 int qdisc_restart(struct net_device *dev)
 {
 	struct Qdisc *q = dev->qdisc;
-	struct sk_buff *skb;
+	struct sk_buff *skb[QDISC_RESTART_BATCH];
+	int n, i, max;
 
-	/* Dequeue packet */
-	if ((skb = q->dequeue(q)) != NULL) {
+	/* Dequeue packets */
+	max = (q->flags & TCQ_F_CAN_BYPASS) ? QDISC_RESTART_BATCH : 1;
+	for (n = 0; n < max; n++)
+		if ((skb[n] = q->dequeue(q)) == NULL)
+			break;
+
+	if (n) {
+		i = 0;
 		if (spin_trylock(&dev->xmit_lock)) {
 			/* Remember that the driver is grabbed by us. */
 			dev->xmit_lock_owner = smp_processor_id();
@@ -88,23 +102,20 @@ int qdisc_restart(struct net_device *dev)
 			/* And release queue */
 			spin_unlock(&dev->queue_lock);
 
-			if (!netif_queue_stopped(dev)) {
+			for (; i < n && !netif_queue_stopped(dev); i++) {
 				if (netdev_nit)
-					dev_queue_xmit_nit(skb, dev);
-
-				if (dev->hard_start_xmit(skb, dev) == 0) {
-					dev->xmit_lock_owner = -1;
-					spin_unlock(&dev->xmit_lock);
+					dev_queue_xmit_nit(skb[i], dev);
 
-					spin_lock(&dev->queue_lock);
-					return -1;
-				}
+				if (dev->hard_start_xmit(skb[i], dev) != 0)
+					break;
 			}
 
 			/* Release the driver */
 			dev->xmit_lock_owner = -1;
 			spin_unlock(&dev->xmit_lock);
 			spin_lock(&dev->queue_lock);
+			if (i == n)
+				return -1;
 			q = dev->qdisc;
 		} else {
 			/* So, someone grabbed the driver. */
@@ -115,7 +126,8 @@ int qdisc_restart(struct net_device *dev)
 			   packet when deadloop is detected.
 			 */
 			if (dev->xmit_lock_owner == smp_processor_id()) {
-				kfree_skb(skb);
+				while (n > 0)
+					kfree_skb(skb[--n]);
 				if (net_ratelimit())
 					printk(KERN_DEBUG "Dead loop on netdevice %s, fix it urgently!\n", dev->name);
 				return -1;
@@ -133,7 +145,8 @@ int qdisc_restart(struct net_device *dev)
 		   3. device is buggy (ppp)
 		 */
 
-		q->ops->requeue(skb, q);
+		while (n > i)
+			q->ops->requeue(skb[--n], q);
 		netif_schedule(dev);
 		return 1;
 	}
@@ -353,6 +366,12 @@ static int pfifo_fast_init(struct Qdisc *qdisc, struct rtattr *opt)
 	int i;
 	struct sk_buff_head *list;
 
+	qdisc->cpu_stats = kmalloc(NR_CPUS*sizeof(struct qdisc_cpu_stats), GFP_KERNEL);
+	if (qdisc->cpu_stats == NULL)
+		return -ENOMEM;
+	memset(qdisc->cpu_stats, 0, NR_CPUS*sizeof(struct qdisc_cpu_stats));
+	qdisc->flags |= TCQ_F_CAN_BYPASS;
+
 	list = ((struct sk_buff_head*)qdisc->data);
 
 	for (i=0; i<3; i++)
@@ -361,6 +380,11 @@ static int pfifo_fast_init(struct Qdisc *qdisc, struct rtattr *opt)
 	return 0;
 }
 
+static void pfifo_fast_destroy(struct Qdisc *qdisc)
+{
+	kfree(qdisc->cpu_stats);
+}
+
 static struct Qdisc_ops pfifo_fast_ops =
 {
 	NULL,
@@ -375,12 +399,29 @@ static struct Qdisc_ops pfifo_fast_ops =
 
 	pfifo_fast_init,
 	pfifo_fast_reset,
-	NULL,
+	pfifo_fast_destroy,
 	NULL,
 	pfifo_fast_dump,
 
 };
 
+/* The stats of a qdisc, with the packets that bypassed it added in */
+void qdisc_fold_stats(struct Qdisc *q, struct tc_stats *st)
+{
+	int cpu;
+
+	spin_lock_bh(q->stats.lock);
+	*st = q->stats;
+	spin_unlock_bh(q->stats.lock);
+
+	for (cpu = 0; cpu < smp_num_cpus; cpu++) {
+		struct qdisc_cpu_stats *cs = &q->cpu_stats[cpu_logical_map(cpu)];
+
+		st->bytes += cs->bytes;
+		st->packets += cs->packets;
+	}
+}
+
 struct Qdisc * qdisc_create_dflt(struct net_device *dev, struct Qdisc_ops *ops)
 {
 	struct Qdisc *sch;
@@ -131,7 +131,7 @@ pmap_getport_done(struct rpc_task *task)
 	} else {
 		/* byte-swap port number first */
 		clnt->cl_port = htons(clnt->cl_port);
-		clnt->cl_xprt->addr.sin_port = clnt->cl_port;
+		xprt_set_port(clnt->cl_xprt, clnt->cl_port);
 	}
 	spin_lock(&pmap_lock);
 	clnt->cl_binding = 0;
@@ -745,6 +745,7 @@ rpc_init_task(struct rpc_task *task, struct rpc_clnt *clnt,
 	task->tk_timer.data     = (unsigned long) task;
 	task->tk_timer.function = (void (*)(unsigned long)) rpc_run_timer;
 	task->tk_client = clnt;
+	task->tk_xprt   = clnt ? clnt->cl_xprt : NULL;
 	task->tk_flags  = flags;
 	task->tk_exit   = callback;
 	init_waitqueue_head(&task->tk_wait);
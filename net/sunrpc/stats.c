@@ -168,6 +168,10 @@ rpc_proc_init(void)
 		if (ent) {
 			ent->owner = THIS_MODULE;
 			proc_net_rpc = ent;
+			ent = create_proc_read_entry("xprt", 0, proc_net_rpc,
+						     xprt_proc_read, NULL);
+			if (ent)
+				ent->owner = THIS_MODULE;
 		}
 	}
 }
@@ -177,6 +181,7 @@ rpc_proc_exit(void)
 {
 	dprintk("RPC: unregistering /proc/net/rpc\n");
 	if (proc_net_rpc) {
+		remove_proc_entry("xprt", proc_net_rpc);
 		proc_net_rpc = NULL;
 		remove_proc_entry("net/rpc", 0);
 	}
@@ -186,9 +191,7 @@ rpc_proc_exit(void)
 static int __init
 init_sunrpc(void)
 {
-#ifdef RPC_DEBUG
 	rpc_register_sysctl();
-#endif
 	rpc_proc_init();
 	return 0;
 }
@@ -196,9 +199,7 @@ init_sunrpc(void)
 static void __exit
 cleanup_sunrpc(void)
 {
-#ifdef RPC_DEBUG
 	rpc_unregister_sysctl();
-#endif
 	rpc_proc_exit();
 }
 MODULE_LICENSE("GPL");
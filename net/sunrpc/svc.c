@@ -341,9 +341,13 @@ svc_process(struct svc_serv *serv, struct svc_rqst *rqstp)
 		}
 	}
 
-	/* Check RPC status result */
-	if (*statp != rpc_success)
+	/* Check RPC status result.  An error reply carries no data, so
+	 * the pages of a READ must not go out after it either.
+	 */
+	if (*statp != rpc_success) {
 		resp->len = statp + 1 - resp->base;
+		svc_release_pages(rqstp);
+	}
 
 	/* Release reply info */
 	if (procp->pc_release)
@@ -31,6 +31,7 @@
 #include <linux/slab.h>
 #include <linux/netdevice.h>
 #include <linux/skbuff.h>
+#include <linux/pagemap.h>
 #include <net/sock.h>
 #include <net/checksum.h>
 #include <net/ip.h>
@@ -106,6 +107,20 @@ svc_release_skb(struct svc_rqst *rqstp)
 	skb_free_datagram(rqstp->rq_sock->sk_sk, skb);
 }
 
+/*
+ * Drop the page cache references of a reply
+ */
+void
+svc_release_pages(struct svc_rqst *rqstp)
+{
+	int	i;
+
+	for (i = 0; i < rqstp->rq_nrpages; i++)
+		page_cache_release(rqstp->rq_respages[i].page);
+	rqstp->rq_nrpages = 0;
+	rqstp->rq_pagelen = 0;
+}
+
 /*
  * Queue up a socket with data pending. If there are idle nfsd
  * processes, wake 'em up.
@@ -265,6 +280,7 @@ svc_sock_release(struct svc_rqst *rqstp)
 	struct svc_sock	*svsk = rqstp->rq_sock;
 
 	svc_release_skb(rqstp);
+	svc_release_pages(rqstp);
 
 	/* Reset response buffer and release
 	 * the reservation.
@@ -307,6 +323,35 @@ svc_wake_up(struct svc_serv *serv)
 	spin_unlock_bh(&serv->sv_lock);
 }
 
+/*
+ * Send the page cache part of a reply with sendpage, padded to a
+ * whole XDR word from the zero page.  Returns the number of bytes
+ * sent, short on error.
+ */
+static int
+svc_sendpages(struct svc_rqst *rqstp)
+{
+	struct socket	*sock = rqstp->rq_sock->sk_sock;
+	struct svc_page	*p = rqstp->rq_respages;
+	int		pad = svc_pagelen(rqstp) - rqstp->rq_pagelen;
+	int		i, len, sent = 0;
+
+	for (i = 0; i < rqstp->rq_nrpages; i++, p++) {
+		len = sock->ops->sendpage(sock, p->page, p->offset, p->len,
+				(i + 1 < rqstp->rq_nrpages || pad) ? MSG_MORE : 0);
+		if (len > 0)
+			sent += len;
+		if (len != p->len)
+			return sent;
+	}
+	if (pad) {
+		len = sock->ops->sendpage(sock, ZERO_PAGE(0), 0, pad, 0);
+		if (len > 0)
+			sent += len;
+	}
+	return sent;
+}
+
 /*
  * Generic sendto routine
  */
@@ -320,7 +365,29 @@ svc_sendto(struct svc_rqst *rqstp, struct iovec *iov, int nr)
 	char 		buffer[CMSG_SPACE(sizeof(struct in_pktinfo))];
 	struct cmsghdr *cmh = (struct cmsghdr *)buffer;
 	struct in_pktinfo *pki = (struct in_pktinfo *)CMSG_DATA(cmh);
-	int		i, buflen, len;
+	struct iovec	vec[RPCSVC_MAXIOV + RPCSVC_MAXPAGES + 1];
+	int		i, buflen, len, pages = rqstp->rq_nrpages;
+
+	if (pages && rqstp->rq_prot == IPPROTO_UDP) {
+		/* There is no sendpage for datagrams, but udp_sendmsg()
+		 * can still take the page cache data straight from the
+		 * pages.  sk_pages is only set for UDP without highmem.
+		 */
+		struct svc_page	*p = rqstp->rq_respages;
+		int		pad = svc_pagelen(rqstp) - rqstp->rq_pagelen;
+
+		memcpy(vec, iov, nr * sizeof(*iov));
+		for (i = 0; i < pages; i++, p++, nr++) {
+			vec[nr].iov_base = page_address(p->page) + p->offset;
+			vec[nr].iov_len  = p->len;
+		}
+		if (pad) {
+			vec[nr].iov_base = page_address(ZERO_PAGE(0));
+			vec[nr++].iov_len = pad;
+		}
+		iov = vec;
+		pages = 0;
+	}
 
 	for (i = buflen = 0; i < nr; i++)
 		buflen += iov[i].iov_len;
@@ -348,12 +415,15 @@ svc_sendto(struct svc_rqst *rqstp, struct iovec *iov, int nr)
 	 * to make much progress anyway.
 	 * sk->sndtimeo is set to 30seconds just in case.
 	 */
-	msg.msg_flags	= 0;
+	msg.msg_flags	= pages ? MSG_MORE : 0;
 
 	oldfs = get_fs(); set_fs(KERNEL_DS);
 	len = sock_sendmsg(sock, &msg, buflen);
 	set_fs(oldfs);
 
+	if (pages && len == buflen)
+		len += svc_sendpages(rqstp);
+
 	dprintk("svc: socket %p sendto([%p %Zu... ], %d, %d) = %d\n",
 			rqstp->rq_sock, iov[0].iov_base, iov[0].iov_len, nr, buflen, len);
 
@@ -585,6 +655,9 @@ svc_udp_init(struct svc_sock *svsk)
 	svsk->sk_sk->write_space = svc_write_space;
 	svsk->sk_recvfrom = svc_udp_recvfrom;
 	svsk->sk_sendto = svc_udp_sendto;
+#ifndef CONFIG_HIGHMEM
+	svsk->sk_pages = 1;	/* svc_sendto() needs page_address() */
+#endif
 
 	/* initialise setting must have enough space to
 	 * receive and respond to one request.  
@@ -936,6 +1009,8 @@ static int
 svc_tcp_sendto(struct svc_rqst *rqstp)
 {
 	struct svc_buf	*bufp = &rqstp->rq_resbuf;
+	struct svc_sock	*svsk = rqstp->rq_sock;
+	int len = (bufp->len << 2) + svc_pagelen(rqstp);
 	int sent;
 
 	/* Set up the first element of the reply iovec.
@@ -944,17 +1019,23 @@ svc_tcp_sendto(struct svc_rqst *rqstp)
 	 */
 	bufp->iov[0].iov_base = bufp->base;
 	bufp->iov[0].iov_len  = bufp->len << 2;
-	bufp->base[0] = htonl(0x80000000|((bufp->len << 2) - 4));
+	bufp->base[0] = htonl(0x80000000|(len - 4));
 
-	if (test_bit(SK_DEAD, &rqstp->rq_sock->sk_flags))
+	/* A reply with pages takes several calls into TCP; keep other
+	 * threads' replies from getting in between.
+	 */
+	down(&svsk->sk_sem);
+	if (test_bit(SK_DEAD, &svsk->sk_flags)) {
+		up(&svsk->sk_sem);
 		return -ENOTCONN;
+	}
 
 	sent = svc_sendto(rqstp, bufp->iov, bufp->nriov);
-	if (sent != bufp->len<<2) {
+	up(&svsk->sk_sem);
+	if (sent != len) {
 		printk(KERN_NOTICE "rpc-srv/tcp: %s: sent only %d bytes of %d - shutting down socket\n",
-		       rqstp->rq_sock->sk_server->sv_name,
-		       sent, bufp->len << 2);
-		svc_delete_socket(rqstp->rq_sock);
+		       svsk->sk_server->sv_name, sent, len);
+		svc_delete_socket(svsk);
 		sent = -EAGAIN;
 	}
 	return sent;
@@ -968,6 +1049,7 @@ svc_tcp_init(struct svc_sock *svsk)
 
 	svsk->sk_recvfrom = svc_tcp_recvfrom;
 	svsk->sk_sendto = svc_tcp_sendto;
+	svsk->sk_pages = 1;
 
 	if (sk->state == TCP_LISTEN) {
 		dprintk("setting up TCP socket for listening\n");
@@ -1200,6 +1282,7 @@ svc_setup_socket(struct svc_serv *serv, struct socket *sock,
 	svsk->sk_owspace = inet->write_space;
 	svsk->sk_server = serv;
 	svsk->sk_lastrecv = CURRENT_TIME;
+	init_MUTEX(&svsk->sk_sem);
 
 	/* Initialize the socket */
 	if (sock->type == SOCK_DGRAM)
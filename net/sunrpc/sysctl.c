@@ -1,7 +1,8 @@
 /*
  * linux/net/sunrpc/sysctl.c
  *
- * Sysctl interface to sunrpc module. This is for debugging only now.
+ * Sysctl interface to sunrpc module: debug flags and client transport
+ * tunables.
  *
  * I would prefer to register the sunrpc table below sys/net, but that's
  * impossible at the moment.
@@ -20,6 +21,7 @@
 #include <linux/sunrpc/types.h>
 #include <linux/sunrpc/sched.h>
 #include <linux/sunrpc/stats.h>
+#include <linux/sunrpc/xprt.h>
 
 /*
  * Declare the debug flags here
@@ -29,8 +31,6 @@ unsigned int	nfs_debug;
 unsigned int	nfsd_debug;
 unsigned int	nlm_debug;
 
-#ifdef RPC_DEBUG
-
 static struct ctl_table_header *sunrpc_table_header;
 static ctl_table		sunrpc_table[];
 
@@ -56,6 +56,7 @@ rpc_unregister_sysctl(void)
 	}
 }
 
+#ifdef RPC_DEBUG
 static int
 proc_dodebug(ctl_table *table, int write, struct file *file,
 				void *buffer, size_t *lenp)
@@ -114,6 +115,7 @@ done:
 	file->f_pos += *lenp;
 	return 0;
 }
+#endif
 
 #define DIRENTRY(nam1, nam2, child)	\
 	{CTL_##nam1, #nam2, NULL, 0, 0555, child }
@@ -121,11 +123,22 @@ done:
 	{CTL_##nam1##DEBUG, #nam2 "_debug", &nam2##_debug, sizeof(int),\
 	 0644, NULL, &proc_dodebug}
 
+static unsigned int	min_conns = 1, max_conns = RPC_MAXCONNS;
+static unsigned int	min_slots = RPC_MAXREQS, max_slots = RPC_MAXSLOTS;
+
 static ctl_table		debug_table[] = {
+#ifdef RPC_DEBUG
 	DBGENTRY(RPC,  rpc),
 	DBGENTRY(NFS,  nfs),
 	DBGENTRY(NFSD, nfsd),
 	DBGENTRY(NLM,  nlm),
+#endif
+	{CTL_TCP_CONNECTIONS, "tcp_connections", &xprt_tcp_connections,
+	 sizeof(unsigned int), 0644, NULL, &proc_dointvec_minmax,
+	 &sysctl_intvec, NULL, &min_conns, &max_conns},
+	{CTL_SLOTTABLE_TCP, "tcp_slot_table_entries",
+	 &xprt_tcp_slot_table_entries, sizeof(unsigned int), 0644, NULL,
+	 &proc_dointvec_minmax, &sysctl_intvec, NULL, &min_slots, &max_slots},
 	{0}
 };
 
@@ -133,5 +146,3 @@ static ctl_table		sunrpc_table[] = {
 	DIRENTRY(SUNRPC, sunrpc, debug_table),
 	{0}
 };
-
-#endif
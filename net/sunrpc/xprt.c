@@ -66,6 +66,7 @@
 #include <net/tcp.h>
 
 #include <asm/uaccess.h>
+#include <asm/div64.h>
 
 /*
  * Local variables
@@ -78,6 +79,15 @@
 
 #define XPRT_MAX_BACKOFF	(8)
 
+/*
+ * Tunables, see Documentation/sysctl/sunrpc.txt
+ */
+unsigned int	xprt_tcp_connections = 1;
+unsigned int	xprt_tcp_slot_table_entries = RPC_DEF_TCP_SLOTS;
+
+static LIST_HEAD(xprt_list);
+static spinlock_t xprt_list_lock = SPIN_LOCK_UNLOCKED;
+
 /*
  * Local functions
  */
@@ -460,6 +470,7 @@ xprt_connect(struct rpc_task *task)
 		task->tk_rqstp->rq_bytes_sent = 0;
 
 	xprt_close(xprt);
+	xprt->stat.connects++;
 	/* Create an unconnected socket */
 	sock = xprt_create_socket(xprt->prot, &xprt->timeout, xprt->resvport);
 	if (!sock) {
@@ -594,6 +605,12 @@ xprt_complete_rqst(struct rpc_xprt *xprt, struct rpc_rqst *req, int copied)
 	struct rpc_task	*task = req->rq_task;
 	struct rpc_clnt *clnt = task->tk_client;
 
+	xprt->stat.replies++;
+	if (req->rq_ntrans == 1) {
+		xprt->stat.rtt += (long)jiffies - req->rq_xtime;
+		xprt->stat.rttcnt++;
+	}
+
 	/* Adjust congestion window */
 	if (!xprt->nocong) {
 		int timer = rpcproc_timer(clnt, task->tk_msg.rpc_proc);
@@ -1221,6 +1238,8 @@ do_xprt_transmit(struct rpc_task *task)
  out_receive:
 	dprintk("RPC: %4d xmit complete\n", task->tk_pid);
 	spin_lock_bh(&xprt->sock_lock);
+	xprt->stat.sends++;
+	xprt->stat.reqs += xprt->nreqs;
 	/* Set the task's receive timeout value */
 	if (!xprt->nocong) {
 		int timer = rpcproc_timer(clnt, task->tk_msg.rpc_proc);
@@ -1241,13 +1260,33 @@ do_xprt_transmit(struct rpc_task *task)
 	spin_unlock_bh(&xprt->sock_lock);
 }
 
+/*
+ * Choose the connection for a new request: the one with the fewest
+ * requests outstanding.  Connections other than the first are only
+ * set up once they are needed.
+ */
+static inline struct rpc_xprt *
+xprt_pick(struct rpc_xprt *xprt)
+{
+	struct rpc_xprt	*best = xprt;
+
+	for (xprt = xprt->next_conn; xprt; xprt = xprt->next_conn)
+		if (xprt->nreqs < best->nreqs)
+			best = xprt;
+	return best;
+}
+
 /*
  * Reserve an RPC call slot.
  */
 void
 xprt_reserve(struct rpc_task *task)
 {
-	struct rpc_xprt	*xprt = task->tk_xprt;
+	struct rpc_xprt	*xprt;
+
+	if (!task->tk_rqstp)
+		task->tk_xprt = xprt_pick(task->tk_client->cl_xprt);
+	xprt = task->tk_xprt;
 
 	task->tk_status = -EIO;
 	if (!xprt->shutdown) {
@@ -1265,15 +1304,27 @@ do_xprt_reserve(struct rpc_task *task)
 	task->tk_status = 0;
 	if (task->tk_rqstp)
 		return;
+	if (!xprt->free && xprt->nslots < xprt->max_slots) {
+		struct rpc_rqst	*req;
+
+		req = (struct rpc_rqst *) kmalloc(sizeof(*req), GFP_ATOMIC);
+		if (req) {
+			memset(req, 0, sizeof(*req));
+			xprt->free = req;
+			xprt->nslots++;
+		}
+	}
 	if (xprt->free) {
 		struct rpc_rqst	*req = xprt->free;
 		xprt->free = req->rq_next;
 		req->rq_next = NULL;
 		task->tk_rqstp = req;
+		xprt->nreqs++;
 		xprt_request_init(task, xprt);
 		return;
 	}
 	dprintk("RPC:      waiting for request slot\n");
+	xprt->stat.backlog++;
 	task->tk_status = -EAGAIN;
 	task->tk_timeout = 0;
 	rpc_sleep_on(&xprt->backlog, task, NULL, NULL);
@@ -1308,7 +1359,7 @@ xprt_request_init(struct rpc_task *task, struct rpc_xprt *xprt)
 {
 	struct rpc_rqst	*req = task->tk_rqstp;
 
-	req->rq_timeout = xprt->timeout;
+	req->rq_timeout = task->tk_client->cl_timeout;
 	req->rq_task	= task;
 	req->rq_xprt    = xprt;
 	req->rq_xid     = xprt_alloc_xid();
@@ -1342,6 +1393,7 @@ xprt_release(struct rpc_task *task)
 	spin_lock(&xprt->xprt_lock);
 	req->rq_next = xprt->free;
 	xprt->free   = req;
+	xprt->nreqs--;
 
 	xprt_clear_backlog(xprt);
 	spin_unlock(&xprt->xprt_lock);
@@ -1421,10 +1473,19 @@ xprt_setup(int proto, struct sockaddr_in *ap, struct rpc_timeout *to)
 		req->rq_next = req + 1;
 	req->rq_next = NULL;
 	xprt->free = xprt->slot;
+	xprt->nslots = xprt->max_slots = RPC_MAXREQS;
+	if (xprt->stream && xprt_tcp_slot_table_entries > RPC_MAXREQS)
+		xprt->max_slots = min_t(unsigned int,
+					xprt_tcp_slot_table_entries,
+					RPC_MAXSLOTS);
 
 	/* Check whether we want to use a reserved port */
 	xprt->resvport = capable(CAP_NET_BIND_SERVICE) ? 1 : 0;
 
+	spin_lock(&xprt_list_lock);
+	list_add_tail(&xprt->all, &xprt_list);
+	spin_unlock(&xprt_list_lock);
+
 	dprintk("RPC:      created transport %p\n", xprt);
 	
 	return xprt;
@@ -1558,6 +1619,18 @@ xprt_create_proto(int proto, struct sockaddr_in *sap, struct rpc_timeout *to)
 	if (!xprt)
 		goto out_bad;
 
+	/* Additional connections to spread requests over */
+	if (xprt->stream) {
+		struct rpc_xprt	**pp = &xprt->next_conn;
+		unsigned int	n;
+
+		for (n = 1; n < xprt_tcp_connections && n < RPC_MAXCONNS; n++) {
+			if (!(*pp = xprt_setup(proto, sap, to)))
+				break;
+			pp = &(*pp)->next_conn;
+		}
+	}
+
 	dprintk("RPC:      xprt_create_proto created xprt %p\n", xprt);
 	return xprt;
 out_bad:
@@ -1573,13 +1646,15 @@ out_bad:
 void
 xprt_shutdown(struct rpc_xprt *xprt)
 {
-	xprt->shutdown = 1;
-	rpc_wake_up(&xprt->sending);
-	rpc_wake_up(&xprt->resend);
-	rpc_wake_up(&xprt->pending);
-	rpc_wake_up(&xprt->backlog);
-	if (waitqueue_active(&xprt->cong_wait))
-		wake_up(&xprt->cong_wait);
+	for (; xprt; xprt = xprt->next_conn) {
+		xprt->shutdown = 1;
+		rpc_wake_up(&xprt->sending);
+		rpc_wake_up(&xprt->resend);
+		rpc_wake_up(&xprt->pending);
+		rpc_wake_up(&xprt->backlog);
+		if (waitqueue_active(&xprt->cong_wait))
+			wake_up(&xprt->cong_wait);
+	}
 }
 
 /*
@@ -1599,10 +1674,96 @@ xprt_clear_backlog(struct rpc_xprt *xprt) {
 int
 xprt_destroy(struct rpc_xprt *xprt)
 {
-	dprintk("RPC:      destroying transport %p\n", xprt);
+	struct rpc_xprt	*next;
+	struct rpc_rqst	*req;
+
 	xprt_shutdown(xprt);
-	xprt_close(xprt);
-	kfree(xprt);
+	for (; xprt; xprt = next) {
+		next = xprt->next_conn;
+		dprintk("RPC:      destroying transport %p\n", xprt);
+		xprt_close(xprt);
+
+		spin_lock(&xprt_list_lock);
+		list_del(&xprt->all);
+		spin_unlock(&xprt_list_lock);
+
+		/* Free the slots grown beyond the built-in table */
+		while ((req = xprt->free) != NULL) {
+			xprt->free = req->rq_next;
+			if (req < xprt->slot || req >= xprt->slot + RPC_MAXREQS)
+				kfree(req);
+		}
+		kfree(xprt);
+	}
 
 	return 0;
 }
+
+/*
+ * Set the server port of a transport and all its connections
+ */
+void
+xprt_set_port(struct rpc_xprt *xprt, unsigned short port)
+{
+	for (; xprt; xprt = xprt->next_conn)
+		xprt->addr.sin_port = port;
+}
+
+/*
+ * /proc/net/rpc/xprt: one line per transport connection
+ */
+int
+xprt_proc_read(char *buffer, char **start, off_t offset, int length,
+	       int *eof, void *data)
+{
+	off_t		pos = 0, begin = 0;
+	struct list_head *p;
+	int		len;
+
+	len = sprintf(buffer, "prot server                 conn slots  reqs"
+		      "      sends    replies rtt_ms  avgreqs  backlog connects\n");
+	spin_lock(&xprt_list_lock);
+	list_for_each(p, &xprt_list) {
+		struct rpc_xprt	*xprt = list_entry(p, struct rpc_xprt, all);
+		u64		rtt = 0, reqs = 0;
+
+		if (xprt->stat.rttcnt) {
+			rtt = (u64) xprt->stat.rtt * 1000;
+			do_div(rtt, HZ);
+			do_div(rtt, xprt->stat.rttcnt);
+		}
+		if (xprt->stat.sends) {
+			reqs = xprt->stat.reqs;
+			do_div(reqs, xprt->stat.sends);
+		}
+		len += sprintf(buffer + len, "%-4s %u.%u.%u.%u:%-5u %4d %5u %5u"
+			       " %10lu %10lu %6lu %8lu %8lu %8lu\n",
+			       xprt->stream ? "tcp" : "udp",
+			       NIPQUAD(xprt->addr.sin_addr.s_addr),
+			       ntohs(xprt->addr.sin_port),
+			       xprt_connected(xprt) ? 1 : 0,
+			       xprt->nslots, xprt->nreqs,
+			       xprt->stat.sends, xprt->stat.replies,
+			       (unsigned long) rtt, (unsigned long) reqs,
+			       xprt->stat.backlog, xprt->stat.connects);
+
+		pos = begin + len;
+		if (pos < offset) {
+			len = 0;
+			begin = pos;
+		}
+		if (pos > offset + length)
+			goto done;
+	}
+	*eof = 1;
+
+done:
+	spin_unlock(&xprt_list_lock);
+	*start = buffer + (offset - begin);
+	len -= (offset - begin);
+	if (len > length)
+		len = length;
+	if (len < 0)
+		len = 0;
+	return len;
+}